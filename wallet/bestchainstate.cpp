@@ -0,0 +1,31 @@
+#include "bestchainstate.h"
+
+#include "blockindex.h"
+#include "itxdb.h"
+
+BestChainState::SnapshotPtr BestChainState::MakeSnapshot(const CBlockIndex& bestBlockIndex,
+                                                         const ITxDB&       txdb)
+{
+    std::shared_ptr<Snapshot> result = std::make_shared<Snapshot>();
+    result->blockHash                = bestBlockIndex.GetBlockHash();
+    result->height                   = bestBlockIndex.nHeight;
+    result->chainTrust               = bestBlockIndex.nChainTrust;
+    result->blockTime                = bestBlockIndex.GetBlockTime();
+    result->medianTimePast           = bestBlockIndex.GetMedianTimePast(txdb);
+    return result;
+}
+
+BestChainState::SnapshotPtr BestChainState::get() const { return std::atomic_load(&snapshot); }
+
+void BestChainState::set(const SnapshotPtr& newSnapshot) { std::atomic_store(&snapshot, newSnapshot); }
+
+void BestChainState::clear() { set(nullptr); }
+
+boost::optional<int> BestChainState::getBestHeight() const
+{
+    const SnapshotPtr s = get();
+    if (!s) {
+        return boost::none;
+    }
+    return s->height;
+}
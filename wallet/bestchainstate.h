@@ -0,0 +1,59 @@
+#ifndef BESTCHAINSTATE_H
+#define BESTCHAINSTATE_H
+
+#include "uint256.h"
+#include <boost/optional.hpp>
+#include <cstdint>
+#include <memory>
+
+class CBlockIndex;
+class ITxDB;
+
+/**
+ * @brief The BestChainState class holds an in-memory snapshot of the tip of the main chain, which is
+ * what the consensus helpers (fork activation, block size, coinbase maturity, etc) need on every
+ * transaction, so that they don't have to read the best hash and then the block index from the db.
+ *
+ * The snapshot is immutable and replaced atomically as a whole, so readers never lock and never see
+ * a mix of two tips. It's published by CTxDB when the best chain is written, or when the db
+ * transaction that wrote it is committed, and it's empty until the block index is loaded; in which
+ * case CTxDB falls back to reading the db.
+ */
+class BestChainState
+{
+public:
+    struct Snapshot
+    {
+        uint256 blockHash;
+        int32_t height = 0;
+        uint256 chainTrust;
+        int64_t blockTime      = 0;
+        int64_t medianTimePast = 0;
+    };
+
+    using SnapshotPtr = std::shared_ptr<const Snapshot>;
+
+private:
+    SnapshotPtr snapshot;
+
+public:
+    BestChainState() {}
+
+    BestChainState(const BestChainState&) = delete;
+    BestChainState& operator=(const BestChainState&) = delete;
+
+    /// creates a snapshot of the given block as the tip; the db is used only for the median time
+    static SnapshotPtr MakeSnapshot(const CBlockIndex& bestBlockIndex, const ITxDB& txdb);
+
+    /// returns nullptr if there's no snapshot
+    SnapshotPtr get() const;
+
+    /// replaces the snapshot; nullptr clears it
+    void set(const SnapshotPtr& newSnapshot);
+
+    void clear();
+
+    boost::optional<int> getBestHeight() const;
+};
+
+#endif // BESTCHAINSTATE_H
@@ -323,6 +323,9 @@ static const CRPCCommand vRPCCommands[] =
     { "getrawmempool",             &getrawmempool,             true,   false },
     { "calculateblockhash",        &calculateblockhash,        false,  false },
     { "gettxout",                  &gettxout,                  false,  false },
+    { "getntp1addressbalances",    &getntp1addressbalances,    false,  false },
+    { "getntp1tokeninfo",          &getntp1tokeninfo,          false,  false },
+    { "getntp1scriptcacheinfo",    &getntp1scriptcacheinfo,    true,   false },
     { "listvotes",                 &listvotes,                 false,  false },
     { "castvote",                  &castvote,                  false,  false },
     { "cancelallvotesofproposal",  &cancelallvotesofproposal,  false,  false },
@@ -291,6 +291,9 @@ extern json_spirit::Value calculateblockhash(const json_spirit::Array& params, b
 extern json_spirit::Value getblock(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value getblockbynumber(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value gettxout(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value getntp1addressbalances(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value getntp1tokeninfo(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value getntp1scriptcacheinfo(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value exportblockchain(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value waitforblockheight(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value listvotes(const json_spirit::Array& params, bool fHelp);
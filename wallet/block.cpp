@@ -6,10 +6,13 @@
 #include "blocklocator.h"
 #include "blockmetadata.h"
 #include "checkpoints.h"
+#include "checkqueue.h"
 #include "kernel.h"
 #include "main.h"
 #include "merkle.h"
+#include "ntp1/ntp1index.h"
 #include "ntp1/ntp1transaction.h"
+#include "stakemodifiercache.h"
 #include "txmempool.h"
 #include "ui_interface.h"
 #include "util.h"
@@ -120,9 +123,64 @@ void CBlock::SetNull()
     vtx.clear();
     vchBlockSig.clear();
     nDoS = 0;
+    powHashCache.clear();
 }
 
-uint256 CBlock::GetPoWHash() const { return scrypt_blockhash(CVOIDBEGIN(nVersion)); }
+CBlock::PoWHashCache::PoWHashCache(const PoWHashCache& other)
+{
+    std::lock_guard<std::mutex> lg(other.mtx);
+    header = other.header;
+    hash   = other.hash;
+    valid  = other.valid;
+}
+
+CBlock::PoWHashCache& CBlock::PoWHashCache::operator=(const PoWHashCache& other)
+{
+    if (this == &other) {
+        return *this;
+    }
+    std::lock(mtx, other.mtx);
+    std::lock_guard<std::mutex> lg1(mtx, std::adopt_lock);
+    std::lock_guard<std::mutex> lg2(other.mtx, std::adopt_lock);
+    header = other.header;
+    hash   = other.hash;
+    valid  = other.valid;
+    return *this;
+}
+
+boost::optional<uint256> CBlock::PoWHashCache::get(const void* currentHeader) const
+{
+    std::lock_guard<std::mutex> lg(mtx);
+    if (valid && std::memcmp(header.data(), currentHeader, header.size()) == 0) {
+        return hash;
+    }
+    return boost::none;
+}
+
+void CBlock::PoWHashCache::set(const void* currentHeader, const uint256& powHash)
+{
+    std::lock_guard<std::mutex> lg(mtx);
+    std::memcpy(header.data(), currentHeader, header.size());
+    hash  = powHash;
+    valid = true;
+}
+
+void CBlock::PoWHashCache::clear()
+{
+    std::lock_guard<std::mutex> lg(mtx);
+    valid = false;
+}
+
+uint256 CBlock::GetPoWHash() const
+{
+    const void* header = CVOIDBEGIN(nVersion);
+    if (const boost::optional<uint256> cached = powHashCache.get(header)) {
+        return *cached;
+    }
+    const uint256 result = scrypt_blockhash(header);
+    powHashCache.set(header, result);
+    return result;
+}
 
 int64_t CBlock::GetBlockTime() const { return (int64_t)nTime; }
 
@@ -137,14 +195,26 @@ void CBlock::UpdateTime(const CBlockIndex* /*pindexPrev*/)
 
 bool CBlock::DisconnectBlock(CTxDB& txdb, const CBlockIndex& pindex)
 {
+    // the tx index write cache only holds changes on top of the blocks that are connected; disconnecting
+    // blocks writes them to the db first, which keeps the tx index marker in the db in the best chain
+    if (!txdb.FlushTxIndexWriteCache())
+        return NLog.error("DisconnectBlock() : FlushTxIndexWriteCache failed");
+
     // Disconnect in reverse order
     for (int i = vtx.size() - 1; i >= 0; i--)
         if (!vtx[i].DisconnectInputs(txdb))
             return false;
 
+    if (NTP1Index::Enabled &&
+        !NTP1Index::DisconnectBlock(txdb, pindex.GetBlockHash(), pindex.hashPrev, vtx))
+        return NLog.error("DisconnectBlock() : failed to write the best block of the NTP1 index");
+
     if (!txdb.EraseBlockHashOfHeight(pindex.nHeight))
         return NLog.error("DisconnectBlock() : EraseBlockHashOfHeight failed");
 
+    // the stake modifiers found by walking through this block are not valid anymore
+    stakeModifierCache.invalidateFromHeight(pindex.nHeight);
+
     // Update block index on disk without changing it in memory.
     // The memory index structure will be changed after the db commits.
     if (pindex.hashPrev != 0) {
@@ -485,6 +555,120 @@ Result<void, CBlock::VIUError> CBlock::VerifyInputsUnspent(const CTxDB& txdb) co
     return Ok();
 }
 
+bool CBlock::ReadInputsFromDisk(const ITxDB& txdb, MapPrevTx& inputsRet) const
+{
+    std::set<uint256> blockTxHashes;
+    for (const CTransaction& tx : vtx) {
+        blockTxHashes.insert(tx.GetHash());
+    }
+
+    std::set<uint256> prevHashesSet;
+    for (const CTransaction& tx : vtx) {
+        if (tx.IsCoinBase())
+            continue;
+        for (const CTxIn& txin : tx.vin) {
+            if (blockTxHashes.count(txin.prevout.hash) == 0)
+                prevHashesSet.insert(txin.prevout.hash);
+        }
+    }
+    if (prevHashesSet.empty())
+        return true;
+
+    const std::vector<uint256>             prevHashes(prevHashesSet.begin(), prevHashesSet.end());
+    std::vector<boost::optional<CTxIndex>> txIndices;
+    if (!txdb.ReadTxIndexBatch(prevHashes, txIndices))
+        return NLog.error("ReadInputsFromDisk() : failed to read the tx index of the inputs of block {}",
+                          GetHash().ToString());
+
+    std::vector<unsigned>   onDisk;
+    std::vector<CDiskTxPos> txPositions;
+    for (unsigned i = 0; i < prevHashes.size(); i++) {
+        if (txIndices[i] && txIndices[i]->pos != CDiskTxPos(1, 1)) {
+            onDisk.push_back(i);
+            txPositions.push_back(txIndices[i]->pos);
+        }
+    }
+
+    std::vector<boost::optional<CTransaction>> txs;
+    if (!txPositions.empty() && !txdb.ReadTxBatch(txPositions, txs))
+        return NLog.error("ReadInputsFromDisk() : failed to read the inputs of block {}",
+                          GetHash().ToString());
+    for (unsigned i = 0; i < onDisk.size(); i++) {
+        if (txs[i]) {
+            inputsRet[prevHashes[onDisk[i]]] =
+                std::make_pair(std::move(*txIndices[onDisk[i]]), std::move(*txs[i]));
+        }
+    }
+    return true;
+}
+
+unsigned int CBlock::GetFirstTxPos() const
+{
+    return ::GetSerializeSize(CBlock(), SER_DISK, CLIENT_VERSION) - (2 * GetSizeOfCompactSize(0)) +
+           GetSizeOfCompactSize(vtx.size());
+}
+
+bool CBlock::GetTxIndexChanges(const ITxDB& txdb, const uint256& blockHash,
+                               std::map<uint256, CTxIndex>& changes) const
+{
+    unsigned int nTxPos = GetFirstTxPos();
+    for (const CTransaction& tx : vtx) {
+        const CDiskTxPos posThisTx(blockHash, nTxPos);
+        nTxPos += ::GetSerializeSize(tx, SER_DISK, CLIENT_VERSION);
+
+        if (!tx.IsCoinBase()) {
+            for (const CTxIn& txin : tx.vin) {
+                const COutPoint& prevout = txin.prevout;
+                auto             it      = changes.find(prevout.hash);
+                if (it == changes.end()) {
+                    CTxIndex txindex;
+                    if (!txdb.ReadTxIndex(prevout.hash, txindex))
+                        return NLog.error("GetTxIndexChanges() : tx index of {} not found",
+                                          prevout.hash.ToString());
+                    it = changes.insert(std::make_pair(prevout.hash, txindex)).first;
+                }
+                if (prevout.n >= it->second.vSpent.size())
+                    return NLog.error("GetTxIndexChanges() : prevout {} is out of range",
+                                      prevout.ToString());
+                it->second.vSpent[prevout.n] = posThisTx;
+            }
+        }
+
+        changes[tx.GetHash()] = CTxIndex(posThisTx, tx.vout.size());
+    }
+    return true;
+}
+
+bool CBlock::ReconnectTxIndex(ITxDB& txdb, const uint256& fromBlockHash, const uint256& toBlockHash)
+{
+    std::vector<CBlockIndex> blocks;
+    for (boost::optional<CBlockIndex> bi = txdb.ReadBlockIndex(toBlockHash);
+         !bi || bi->GetBlockHash() != fromBlockHash; bi = bi->getPrev(txdb)) {
+        if (!bi)
+            return NLog.error("ReconnectTxIndex() : block {} is not an ancestor of block {}",
+                              fromBlockHash.ToString(), toBlockHash.ToString());
+        blocks.push_back(*bi);
+    }
+    std::reverse(blocks.begin(), blocks.end());
+
+    std::map<uint256, CTxIndex> changes;
+    for (const CBlockIndex& bi : blocks) {
+        CBlock block;
+        if (!txdb.ReadBlock(bi.GetBlockHash(), block))
+            return NLog.error("ReconnectTxIndex() : failed to read block {}",
+                              bi.GetBlockHash().ToString());
+        if (!block.GetTxIndexChanges(txdb, bi.GetBlockHash(), changes))
+            return NLog.error("ReconnectTxIndex() : failed to get the tx index of block {}",
+                              bi.GetBlockHash().ToString());
+    }
+
+    for (const auto& p : changes) {
+        if (!txdb.UpdateTxIndex(p.first, p.second))
+            return NLog.error("ReconnectTxIndex() : UpdateTxIndex failed for {}", p.first.ToString());
+    }
+    return true;
+}
+
 bool CBlock::CheckBIP30Attack(ITxDB& txdb, const uint256& hashTx)
 {
     // Do not allow blocks that contain transactions which 'overwrite' older transactions,
@@ -527,8 +711,7 @@ bool CBlock::ConnectBlock(ITxDB& txdb, const boost::optional<CBlockIndex>& pinde
         // shouldn't) be on the disk to get the transaction from
         nTxPos = 1;
     else
-        nTxPos = ::GetSerializeSize(CBlock(), SER_DISK, CLIENT_VERSION) - (2 * GetSizeOfCompactSize(0)) +
-                 GetSizeOfCompactSize(vtx.size());
+        nTxPos = GetFirstTxPos();
 
     // Comment by Sam: mapQueuedChanges is the list of transactions that already happened in the same
     // block. This is necessary for verifying outputs that are being spent in the same blocks
@@ -541,14 +724,29 @@ bool CBlock::ConnectBlock(ITxDB& txdb, const boost::optional<CBlockIndex>& pinde
 
     std::map<uint256, std::vector<std::pair<CTransaction, NTP1Transaction>>> mapQueuedNTP1Inputs;
 
+    // the NTP1 transactions parsed while verifying, by their index in the block; they're written as
+    // they are after the verification, instead of being parsed again from their inputs
+    std::vector<boost::optional<NTP1Transaction>> parsedNTP1Txs(vtx.size());
+
     unsigned int nSigOps = 0;
 
     // map of issued token names in this block vs token hashes
     // this is used to prevent duplicate token names
     std::unordered_map<std::string, uint256> issuedTokensSymbolsInThisBlock;
 
-    for (const CTransaction& tx : vtx) {
-        const uint256 hashTx = tx.GetHash();
+    // signatures are verified by the script check queue while the inputs of the following
+    // transactions are being connected; the control waits for the checks even on early returns
+    CCheckQueueControl<CScriptCheck> control(
+        scriptCheckQueue.WorkerThreadsCount() > 0 ? &scriptCheckQueue : nullptr);
+
+    // the inputs of the block that are on disk are read at once, instead of with reads per tx
+    MapPrevTx blockInputs;
+    if (!ReadInputsFromDisk(txdb, blockInputs))
+        return false;
+
+    for (unsigned txIndex = 0; txIndex < vtx.size(); txIndex++) {
+        const CTransaction& tx     = vtx[txIndex];
+        const uint256       hashTx = tx.GetHash();
 
         std::vector<std::pair<CTransaction, NTP1Transaction>> inputsWithNTP1;
 
@@ -573,7 +771,7 @@ bool CBlock::ConnectBlock(ITxDB& txdb, const boost::optional<CBlockIndex>& pinde
             nValueOut += tx.GetValueOut();
         else {
             bool fInvalid;
-            if (!tx.FetchInputs(txdb, mapQueuedChanges, true, false, mapInputs, fInvalid))
+            if (!tx.FetchInputs(txdb, mapQueuedChanges, true, false, mapInputs, fInvalid, &blockInputs))
                 return false;
 
             // Add in sigops done by pay-to-script-hash inputs;
@@ -604,6 +802,7 @@ bool CBlock::ConnectBlock(ITxDB& txdb, const boost::optional<CBlockIndex>& pinde
                         // write NTP1 transactions' data
                         NTP1Transaction ntp1tx;
                         ntp1tx.readNTP1DataFromTx(txdb, tx, inputsWithNTP1);
+                        parsedNTP1Txs[txIndex] = std::move(ntp1tx);
                     }
                 } catch (std::exception& ex) {
                     return NLog.error(
@@ -619,8 +818,13 @@ bool CBlock::ConnectBlock(ITxDB& txdb, const boost::optional<CBlockIndex>& pinde
 
             if (EnableEnforceUniqueTokenSymbols(txdb)) {
                 try {
-                    AssertIssuanceUniquenessInBlock(issuedTokensSymbolsInThisBlock, txdb, tx,
-                                                    mapQueuedNTP1Inputs, mapQueuedChanges);
+                    if (parsedNTP1Txs[txIndex]) {
+                        AssertIssuanceUniquenessInBlock(issuedTokensSymbolsInThisBlock, txdb,
+                                                        *parsedNTP1Txs[txIndex]);
+                    } else {
+                        AssertIssuanceUniquenessInBlock(issuedTokensSymbolsInThisBlock, txdb, tx,
+                                                        mapQueuedNTP1Inputs, mapQueuedChanges);
+                    }
                 } catch (std::exception& ex) {
                     reject = CBlockReject(REJECT_INVALID, "ntp1-error-issuance-symbol-duplicate",
                                           this->GetHash());
@@ -638,14 +842,43 @@ bool CBlock::ConnectBlock(ITxDB& txdb, const boost::optional<CBlockIndex>& pinde
                 }
             }
 
-            if (tx.ConnectInputs(txdb, mapInputs, mapQueuedChanges, posThisTx, pindex, true, false, this)
+            std::vector<CScriptCheck> vChecks;
+            if (tx.ConnectInputs(txdb, mapInputs, mapQueuedChanges, posThisTx, pindex, true, false, this,
+                                 control.IsActive() ? &vChecks : nullptr)
                     .isErr()) {
                 return false;
             }
+            control.Add(vChecks);
         }
 
-        mapQueuedChanges[hashTx]          = CTxIndex(posThisTx, tx.vout.size());
-        mapQueuedNTP1Inputs[tx.GetHash()] = inputsWithNTP1;
+        mapQueuedChanges[hashTx]    = CTxIndex(posThisTx, tx.vout.size());
+        mapQueuedNTP1Inputs[hashTx] = inputsWithNTP1;
+    }
+
+    // barrier: all the signatures of the block must be verified before anything is written
+    boost::optional<CScriptCheck> failedCheck;
+    if (!control.Wait(failedCheck)) {
+        // as in ConnectInputs(), an input that fails only because of P2SH doesn't invoke the anti-DoS
+        // code, since old clients may relay such transactions
+        if (failedCheck && failedCheck->GetTxTo() && failedCheck->CheckMandatoryFlagsOnly().isOk()) {
+            return NLog.error("ConnectBlock() : {} P2SH VerifySignature failed on input {}: "
+                              "non-mandatory-script-verify-flag ({})",
+                              failedCheck->GetTxTo()->GetHash().ToString(),
+                              failedCheck->GetInputIndex(),
+                              ScriptErrorString(failedCheck->GetScriptError()));
+        }
+        const std::string msg = fmt::format(
+            "mandatory-script-verify-flag-failed ({})",
+            ScriptErrorString(failedCheck ? failedCheck->GetScriptError() : SCRIPT_ERR_UNKNOWN_ERROR));
+        reject = CBlockReject(REJECT_INVALID, msg, this->GetHash());
+        if (failedCheck && failedCheck->GetTxTo()) {
+            const CTransaction& failedTx = *failedCheck->GetTxTo();
+            failedTx.reject = CTransaction::CTxReject(REJECT_INVALID, msg, failedTx.GetHash());
+            return DoS(100, NLog.error("ConnectBlock() : {} VerifySignature failed on input {}: {}",
+                                       failedTx.GetHash().ToString(), failedCheck->GetInputIndex(),
+                                       msg));
+        }
+        return DoS(100, NLog.error("ConnectBlock() : script verification failed: {}", msg));
     }
 
     if (IsProofOfWork()) {
@@ -719,7 +952,7 @@ bool CBlock::ConnectBlock(ITxDB& txdb, const boost::optional<CBlockIndex>& pinde
     // This scope does NTP1 data writing
     {
         try {
-            WriteNTP1BlockTransactionsToDisk(vtx, txdb);
+            WriteNTP1BlockTransactionsToDisk(vtx, parsedNTP1Txs, txdb);
         } catch (std::exception& ex) {
             if (Params().GetNetForks().isForkActivated(NetworkFork::NETFORK__3_TACHYON, txdb)) {
                 return NLog.error("Unable to get NTP1 transaction written in ConnectBlock(). Error: {}",
@@ -734,6 +967,10 @@ bool CBlock::ConnectBlock(ITxDB& txdb, const boost::optional<CBlockIndex>& pinde
         }
     }
 
+    if (NTP1Index::Enabled &&
+        !NTP1Index::ConnectBlock(txdb, blockHash, pindex->hashPrev, vtx, parsedNTP1Txs))
+        return NLog.error("ConnectBlock() : failed to write the best block of the NTP1 index");
+
     // Update block index on disk without changing it in memory.
     // The memory index structure will be changed after the db commits.
     if (pindex->hashPrev != 0) {
@@ -993,8 +1230,8 @@ bool CBlock::Reorganize(CTxDB& txdb, const boost::optional<CBlockIndex>& pindexN
     boost::optional<CBlockIndex> pfork   = txdb.GetBestBlockIndex();
     boost::optional<CBlockIndex> plonger = pindexNew;
     while (pfork->GetBlockHash() != plonger->GetBlockHash()) {
-        while (plonger->nHeight > pfork->nHeight)
-            if (!(plonger = plonger->getPrev(txdb)))
+        if (plonger->nHeight > pfork->nHeight)
+            if (!(plonger = txdb.ReadBlockIndexAncestor(plonger->GetBlockHash(), pfork->nHeight)))
                 return NLog.error("Reorganize() : plonger->pprev is null");
         if (pfork->GetBlockHash() == plonger->GetBlockHash())
             break;
@@ -1416,9 +1653,10 @@ bool CBlock::AcceptBlock(const CBlockIndex& prevBlockIndex, const uint256& block
         strMiscWarning = _("WARNING: syncronized checkpoint violation detected, but skipped!");
 
     // Enforce rule that the coinbase starts with serialized block height
-    CScript expect = CScript() << nHeight;
-    if (vtx[0].vin[0].scriptSig.size() < expect.size() ||
-        !std::equal(expect.begin(), expect.end(), vtx[0].vin[0].scriptSig.begin()))
+    CScript             expect   = CScript() << nHeight;
+    const CTransaction& coinbase = vtx[0];
+    if (coinbase.vin[0].scriptSig.size() < expect.size() ||
+        !std::equal(expect.begin(), expect.end(), coinbase.vin[0].scriptSig.begin()))
         return DoS(100, NLog.error("AcceptBlock() : block height mismatch in coinbase"));
 
     // Write block to history file
@@ -1739,6 +1977,7 @@ void UpdateWallets(const uint256& prevBestChain, const ITxDB& txdb)
             assert(ancestorOfPrevInMainChain);
             while (ancestorOfPrevInMainChain->hashPrev != 0 &&
                    !ancestorOfPrevInMainChain->IsInMainChain(txdb)) {
+                BlockDisconnected(ancestorOfPrevInMainChain->GetBlockHash());
                 // we can't cache this because IsInMainChain() call can change over time
                 ancestorOfPrevInMainChain = ancestorOfPrevInMainChain->getPrev(txdb);
             }
@@ -1760,6 +1999,15 @@ void UpdateWallets(const uint256& prevBestChain, const ITxDB& txdb)
                 mainChainCurrentHash = prev->prevHash;
             }
 
+            // mainChain goes backwards from the best block
+            const int bestHeight = txdb.GetBestChainHeight().value_or(0);
+            for (unsigned i = 0; i < mainChain.size(); i++) {
+                BlockConnected(mainChain[i], bestHeight - static_cast<int>(i));
+            }
+
+            // the wallet transactions of all the blocks are written in one database transaction
+            const auto walletBatches = BeginWalletDBBatches();
+
             // loop over all blocks from the common ancestor, to now, and sync these txs
             for (const uint256& h : boost::adaptors::reverse(mainChain)) {
                 CBlock block;
@@ -1800,7 +2048,9 @@ bool CBlock::WriteToDisk(const boost::optional<CBlockIndex>& prevBlockIndex, con
     // before adding the new block, we keep in mind what the current best block is
     const uint256 prevBestChain = txdb.GetBestBlockHash();
 
-    std::size_t req_size = 1000 * ::GetSerializeSize(*this, SER_DISK, CLIENT_VERSION);
+    // the tx index write cache may be flushed in this transaction
+    std::size_t req_size = 1000 * ::GetSerializeSize(*this, SER_DISK, CLIENT_VERSION) +
+                           2 * txIndexWriteCache.getMemoryUsage();
     if (!txdb.TxnBegin(req_size)) {
         NLog.write(b_sev::err, "Failed to start transaction for writing a new block.");
         return false;
@@ -1836,7 +2086,18 @@ bool CBlock::WriteToDisk(const boost::optional<CBlockIndex>& prevBlockIndex, con
                    blockHash.ToString());
     }
 
-    uiInterface.NotifyBlockTip(IsInitialBlockDownload(txdb), *pindexNew);
+    const bool fInitialDownload = IsInitialBlockDownload(txdb);
+
+    // tx index changes are cached only during the initial sync; the cache is written with this block
+    // when it's full or when the initial sync is done
+    txIndexWriteCache.setCachingWrites(fInitialDownload);
+    if (!fInitialDownload || txIndexWriteCache.isFull()) {
+        if (!txdb.FlushTxIndexWriteCache()) {
+            return NLog.error("Failed to flush the tx index write cache");
+        }
+    }
+
+    uiInterface.NotifyBlockTip(fInitialDownload, *pindexNew);
 
     success = true;
     txEnder.reset();
@@ -8,6 +8,9 @@
 #include "transaction.h"
 #include "txindex.h"
 #include "uint256.h"
+#include <array>
+#include <map>
+#include <mutex>
 #include <unordered_map>
 #include <vector>
 
@@ -130,6 +133,21 @@ public:
 
     static bool CheckBIP30Attack(ITxDB& txdb, const uint256& hashTx);
 
+    /// reads the txs spent by this block that are on disk, with their tx index entries, in one batch
+    /// read of each, to be passed to CTransaction::FetchInputs(); the inputs created in this block or
+    /// in the mempool, or that aren't found, are left out
+    bool ReadInputsFromDisk(const ITxDB& txdb, MapPrevTx& inputsRet) const;
+
+    /// the tx index entries that connecting this block, which is at blockHash, writes; the entries of
+    /// the spent txs are taken from changes, or read from txdb if they aren't there, and changes gets
+    /// all the new ones
+    bool GetTxIndexChanges(const ITxDB& txdb, const uint256& blockHash,
+                           std::map<uint256, CTxIndex>& changes) const;
+
+    /// writes the tx index entries of the main chain blocks after fromBlockHash up to toBlockHash again,
+    /// as connecting them did, without writing anything else of them
+    static bool ReconnectTxIndex(ITxDB& txdb, const uint256& fromBlockHash, const uint256& toBlockHash);
+
     struct ChainReplaceTxs
     {
         // transactions that are being spent in the above ones
@@ -202,8 +220,37 @@ public:
                     const bool createDbTransaction = true);
 
 private:
+    /// the position of the first tx in the block on disk
+    unsigned int GetFirstTxPos() const;
+
     bool SetBestChainInner(CTxDB& txdb, const boost::optional<CBlockIndex>& pindexNew,
                            const bool createDbTransaction = true);
+
+    static constexpr const std::size_t HEADER_SIZE = 80;
+
+    /**
+     * The scrypt hash of the header is expensive, so it's memoized along with the header bytes it was
+     * calculated from. Since the header members are public and can be modified directly (e.g., by the
+     * miner), the cache is invalidated by comparing the stored header with the current one.
+     */
+    class PoWHashCache
+    {
+        mutable std::mutex               mtx;
+        std::array<uint8_t, HEADER_SIZE> header;
+        uint256                          hash;
+        bool                             valid = false;
+
+    public:
+        PoWHashCache() = default;
+        PoWHashCache(const PoWHashCache& other);
+        PoWHashCache& operator=(const PoWHashCache& other);
+
+        boost::optional<uint256> get(const void* currentHeader) const;
+        void                     set(const void* currentHeader, const uint256& powHash);
+        void                     clear();
+    };
+
+    mutable PoWHashCache powHashCache;
 };
 
 #endif // BLOCK_H
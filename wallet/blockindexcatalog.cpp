@@ -1 +1,368 @@
 #include "blockindexcatalog.h"
+
+#include "itxdb.h"
+#include "logging/logger.h"
+#include <algorithm>
+
+constexpr const BlockIndexCatalog::Slot BlockIndexCatalog::NullSlot;
+
+namespace {
+/** Turn the lowest '1' bit in the binary representation of a number into a '0'. */
+int32_t InvertLowestOne(int32_t n) { return n & (n - 1); }
+
+/** Compute what height to jump back to with the skip pointer. */
+int32_t GetSkipHeight(int32_t height)
+{
+    if (height < 2)
+        return 0;
+
+    // Determine which height to jump back to. Any number strictly lower than height is acceptable,
+    // but the following expression seems to perform well in simulations (max 110 steps to go back
+    // up to 2**18 blocks).
+    return (height & 1) ? InvertLowestOne(InvertLowestOne(height - 1)) + 1 : InvertLowestOne(height);
+}
+} // namespace
+
+void BlockIndexCatalog::PendingChanges::addBlockIndex(const CBlockIndex& bi)
+{
+    blockIndices[bi.GetBlockHash()] = bi;
+}
+
+void BlockIndexCatalog::PendingChanges::setMainChainHash(int32_t height, const uint256& blockHash)
+{
+    mainChainHashes[height] = blockHash;
+}
+
+void BlockIndexCatalog::PendingChanges::eraseMainChainHeight(int32_t height)
+{
+    mainChainHashes[height] = 0;
+}
+
+boost::optional<CBlockIndex>
+BlockIndexCatalog::PendingChanges::getBlockIndex(const uint256& blockHash) const
+{
+    const auto it = blockIndices.find(blockHash);
+    if (it == blockIndices.cend()) {
+        return boost::none;
+    }
+    return it->second;
+}
+
+boost::optional<uint256> BlockIndexCatalog::PendingChanges::getMainChainHash(int32_t height) const
+{
+    const auto it = mainChainHashes.find(height);
+    if (it == mainChainHashes.cend()) {
+        return boost::none;
+    }
+    return it->second;
+}
+
+void BlockIndexCatalog::PendingChanges::applyTo(BlockIndexCatalog& catalog) const
+{
+    boost::unique_lock<boost::shared_mutex> lg(catalog.mtx);
+
+    // parents have to be added before children for skip pointers to be calculated
+    std::vector<const CBlockIndex*> sortedIndices;
+    sortedIndices.reserve(blockIndices.size());
+    for (const auto& p : blockIndices) {
+        sortedIndices.push_back(&p.second);
+    }
+    std::sort(sortedIndices.begin(), sortedIndices.end(),
+              [](const CBlockIndex* a, const CBlockIndex* b) { return a->nHeight < b->nHeight; });
+    for (const CBlockIndex* bi : sortedIndices) {
+        catalog.add_unsafe(*bi);
+    }
+
+    for (const auto& p : mainChainHashes) {
+        if (p.second == 0) {
+            catalog.eraseMainChainHeight_unsafe(p.first);
+        } else {
+            catalog.setMainChainHash_unsafe(p.first, p.second);
+        }
+    }
+}
+
+BlockIndexCatalog::Slot BlockIndexCatalog::getOrCreateSlot_unsafe(const uint256& blockHash)
+{
+    const auto it = slotsByHash.find(blockHash);
+    if (it != slotsByHash.cend()) {
+        return it->second;
+    }
+
+    Entry entry{};
+    entry.blockHash = blockHash;
+    entry.nHeight   = -1;
+    entry.parent    = NullSlot;
+    entry.next      = NullSlot;
+    entry.skip      = NullSlot;
+    entry.present   = false;
+
+    const Slot slot = static_cast<Slot>(entries.size());
+    entries.push_back(entry);
+    slotsByHash.insert(std::make_pair(blockHash, slot));
+    return slot;
+}
+
+BlockIndexCatalog::Slot BlockIndexCatalog::findSlot_unsafe(const uint256& blockHash) const
+{
+    const auto it = slotsByHash.find(blockHash);
+    if (it == slotsByHash.cend() || !entries[it->second].present) {
+        return NullSlot;
+    }
+    return it->second;
+}
+
+BlockIndexCatalog::Slot BlockIndexCatalog::getAncestor_unsafe(Slot slot, int32_t height) const
+{
+    if (slot == NullSlot || height < 0 || height > entries[slot].nHeight) {
+        return NullSlot;
+    }
+
+    while (slot != NullSlot && entries[slot].nHeight > height) {
+        const Entry& e = entries[slot];
+        const Slot   s = e.skip;
+        if (s != NullSlot && entries[s].present && entries[s].nHeight >= height) {
+            slot = s;
+        } else {
+            slot = e.parent;
+        }
+        if (slot != NullSlot && !entries[slot].present) {
+            return NullSlot;
+        }
+    }
+    return slot;
+}
+
+CBlockIndex BlockIndexCatalog::toBlockIndex_unsafe(Slot slot) const
+{
+    const Entry& e = entries[slot];
+
+    CBlockIndex result;
+    result.blockHash              = e.blockHash;
+    result.hashPrev               = (e.parent != NullSlot ? entries[e.parent].blockHash : 0);
+    result.hashNext               = (e.next != NullSlot ? entries[e.next].blockHash : 0);
+    result.nChainTrust            = e.nChainTrust;
+    result.nHeight                = e.nHeight;
+    result.nFlags                 = e.nFlags;
+    result.nStakeModifier         = e.nStakeModifier;
+    result.nStakeModifierChecksum = e.nStakeModifierChecksum;
+    result.prevoutStake           = e.prevoutStake;
+    result.nStakeTime             = e.nStakeTime;
+    result.hashProof              = e.hashProof;
+    result.nVersion               = e.nVersion;
+    result.hashMerkleRoot         = e.hashMerkleRoot;
+    result.nTime                  = e.nTime;
+    result.nBits                  = e.nBits;
+    result.nNonce                 = e.nNonce;
+    return result;
+}
+
+void BlockIndexCatalog::add_unsafe(const CBlockIndex& bi)
+{
+    const Slot parent = (bi.hashPrev != 0 ? getOrCreateSlot_unsafe(bi.hashPrev) : NullSlot);
+    const Slot next   = (bi.hashNext != 0 ? getOrCreateSlot_unsafe(bi.hashNext) : NullSlot);
+    const Slot slot   = getOrCreateSlot_unsafe(bi.GetBlockHash());
+
+    Entry& e                 = entries[slot];
+    e.nChainTrust            = bi.nChainTrust;
+    e.hashProof              = bi.hashProof;
+    e.hashMerkleRoot         = bi.hashMerkleRoot;
+    e.prevoutStake           = bi.prevoutStake;
+    e.nStakeModifier         = bi.nStakeModifier;
+    e.nHeight                = bi.nHeight;
+    e.nFlags                 = bi.nFlags;
+    e.nStakeModifierChecksum = bi.nStakeModifierChecksum;
+    e.nStakeTime             = bi.nStakeTime;
+    e.nVersion               = bi.nVersion;
+    e.nTime                  = bi.nTime;
+    e.nBits                  = bi.nBits;
+    e.nNonce                 = bi.nNonce;
+    e.parent                 = parent;
+    e.next                   = next;
+    e.present                = true;
+
+    // the skip pointer is only valid if the parent's ancestry is known
+    e.skip = (parent != NullSlot && entries[parent].present)
+                 ? getAncestor_unsafe(parent, GetSkipHeight(bi.nHeight))
+                 : parent;
+}
+
+void BlockIndexCatalog::setMainChainHash_unsafe(int32_t height, const uint256& blockHash)
+{
+    if (height < 0) {
+        return;
+    }
+    const Slot slot = getOrCreateSlot_unsafe(blockHash);
+    if (mainChain.size() <= static_cast<std::size_t>(height)) {
+        mainChain.resize(height + 1, NullSlot);
+    }
+    mainChain[height] = slot;
+}
+
+void BlockIndexCatalog::eraseMainChainHeight_unsafe(int32_t height)
+{
+    if (height < 0 || static_cast<std::size_t>(height) >= mainChain.size()) {
+        return;
+    }
+    mainChain[height] = NullSlot;
+    while (!mainChain.empty() && mainChain.back() == NullSlot) {
+        mainChain.pop_back();
+    }
+}
+
+bool BlockIndexCatalog::loadFromDB(const ITxDB& txdb)
+{
+    const boost::optional<std::map<uint256, CBlockIndex>> allEntries = txdb.ReadAllBlockIndexEntries();
+    if (!allEntries) {
+        NLog.write(b_sev::err, "BlockIndexCatalog: Failed to read block index entries from the db");
+        clear();
+        return false;
+    }
+
+    const uint256 bestBlockHash = txdb.GetBestBlockHash();
+
+    boost::unique_lock<boost::shared_mutex> lg(mtx);
+
+    entries.clear();
+    slotsByHash.clear();
+    mainChain.clear();
+    loaded = false;
+
+    entries.reserve(allEntries->size());
+    slotsByHash.reserve(allEntries->size());
+
+    // parents have to be added before children for skip pointers to be calculated
+    std::vector<const CBlockIndex*> sortedIndices;
+    sortedIndices.reserve(allEntries->size());
+    for (const auto& p : *allEntries) {
+        sortedIndices.push_back(&p.second);
+    }
+    std::sort(sortedIndices.begin(), sortedIndices.end(),
+              [](const CBlockIndex* a, const CBlockIndex* b) { return a->nHeight < b->nHeight; });
+    for (const CBlockIndex* bi : sortedIndices) {
+        add_unsafe(*bi);
+    }
+
+    // the main chain is rebuilt by walking back from the tip in memory
+    Slot slot = findSlot_unsafe(bestBlockHash);
+    if (slot != NullSlot) {
+        mainChain.resize(entries[slot].nHeight + 1, NullSlot);
+        while (slot != NullSlot && entries[slot].present) {
+            mainChain[entries[slot].nHeight] = slot;
+            slot                             = entries[slot].parent;
+        }
+    }
+
+    loaded = true;
+
+    NLog.write(b_sev::info, "BlockIndexCatalog: Loaded {} block index entries; main chain height: {}",
+               entries.size(), static_cast<int64_t>(mainChain.size()) - 1);
+
+    return true;
+}
+
+bool BlockIndexCatalog::isLoaded() const
+{
+    boost::shared_lock<boost::shared_mutex> lg(mtx);
+    return loaded;
+}
+
+void BlockIndexCatalog::clear()
+{
+    boost::unique_lock<boost::shared_mutex> lg(mtx);
+    entries.clear();
+    slotsByHash.clear();
+    mainChain.clear();
+    loaded = false;
+}
+
+std::size_t BlockIndexCatalog::size() const
+{
+    boost::shared_lock<boost::shared_mutex> lg(mtx);
+    return slotsByHash.size();
+}
+
+void BlockIndexCatalog::add(const CBlockIndex& bi)
+{
+    boost::unique_lock<boost::shared_mutex> lg(mtx);
+    add_unsafe(bi);
+}
+
+boost::optional<CBlockIndex> BlockIndexCatalog::get(const uint256& blockHash) const
+{
+    boost::shared_lock<boost::shared_mutex> lg(mtx);
+    const Slot                              slot = findSlot_unsafe(blockHash);
+    if (slot == NullSlot) {
+        return boost::none;
+    }
+    return toBlockIndex_unsafe(slot);
+}
+
+bool BlockIndexCatalog::contains(const uint256& blockHash) const
+{
+    boost::shared_lock<boost::shared_mutex> lg(mtx);
+    return findSlot_unsafe(blockHash) != NullSlot;
+}
+
+void BlockIndexCatalog::setMainChainHash(int32_t height, const uint256& blockHash)
+{
+    boost::unique_lock<boost::shared_mutex> lg(mtx);
+    setMainChainHash_unsafe(height, blockHash);
+}
+
+void BlockIndexCatalog::eraseMainChainHeight(int32_t height)
+{
+    boost::unique_lock<boost::shared_mutex> lg(mtx);
+    eraseMainChainHeight_unsafe(height);
+}
+
+boost::optional<uint256> BlockIndexCatalog::getMainChainHash(int32_t height) const
+{
+    boost::shared_lock<boost::shared_mutex> lg(mtx);
+    if (height < 0 || static_cast<std::size_t>(height) >= mainChain.size()) {
+        return boost::none;
+    }
+    const Slot slot = mainChain[height];
+    if (slot == NullSlot) {
+        return boost::none;
+    }
+    return entries[slot].blockHash;
+}
+
+boost::optional<CBlockIndex> BlockIndexCatalog::getAncestor(const uint256& blockHash,
+                                                            int32_t        height) const
+{
+    boost::shared_lock<boost::shared_mutex> lg(mtx);
+    const Slot ancestor = getAncestor_unsafe(findSlot_unsafe(blockHash), height);
+    if (ancestor == NullSlot) {
+        return boost::none;
+    }
+    return toBlockIndex_unsafe(ancestor);
+}
+
+boost::optional<CBlockIndex> BlockIndexCatalog::findFork(const uint256& blockHash1,
+                                                         const uint256& blockHash2) const
+{
+    boost::shared_lock<boost::shared_mutex> lg(mtx);
+
+    Slot s1 = findSlot_unsafe(blockHash1);
+    Slot s2 = findSlot_unsafe(blockHash2);
+    if (s1 == NullSlot || s2 == NullSlot) {
+        return boost::none;
+    }
+
+    // bring both to the same height, then step back together
+    if (entries[s1].nHeight > entries[s2].nHeight) {
+        s1 = getAncestor_unsafe(s1, entries[s2].nHeight);
+    } else if (entries[s2].nHeight > entries[s1].nHeight) {
+        s2 = getAncestor_unsafe(s2, entries[s1].nHeight);
+    }
+    while (s1 != s2 && s1 != NullSlot && s2 != NullSlot) {
+        s1 = entries[s1].parent;
+        s2 = entries[s2].parent;
+    }
+    if (s1 == NullSlot || s2 == NullSlot || !entries[s1].present) {
+        return boost::none;
+    }
+    return toBlockIndex_unsafe(s1);
+}
@@ -3,17 +3,128 @@
 
 #include "blockindex.h"
 #include "globals.h"
+#include <boost/optional.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/thread.hpp>
+#include <cstdint>
 #include <map>
 #include <uint256.h>
+#include <unordered_map>
+#include <vector>
 
 class CBlockIndex;
+class ITxDB;
 
+/**
+ * @brief The BlockIndexCatalog class is an in-memory mirror of the block index database
+ * (DB_BLOCKINDEX_INDEX) and the main-chain heights database (DB_BLOCKHEIGHTS_INDEX).
+ *
+ * Entries are stored contiguously in a vector, and are linked to each other with integer offsets
+ * (slots) instead of hashes, which makes walking the chain a memory operation instead of a database
+ * read and a deserialization per hop. Every entry also has a skip pointer (like a skip-list) to an
+ * ancestor at a deterministic height, which makes ancestor lookups O(log n).
+ *
+ * The catalog is loaded once at CTxDB::LoadBlockIndex() and then kept in sync by CTxDB, which writes
+ * through to it after every successful write (or on commit, if the write was in a transaction).
+ */
 class BlockIndexCatalog
 {
+public:
+    using Slot = uint32_t;
+
+    static constexpr const Slot NullSlot = static_cast<Slot>(-1);
+
+    /**
+     * Changes done to the block index within a database transaction. They're applied to the catalog
+     * only when the transaction is committed, and discarded if it's aborted.
+     */
+    class PendingChanges
+    {
+        std::map<uint256, CBlockIndex> blockIndices;
+        // a zero hash means the height was erased
+        std::map<int32_t, uint256> mainChainHashes;
+
+    public:
+        void                         addBlockIndex(const CBlockIndex& bi);
+        void                         setMainChainHash(int32_t height, const uint256& blockHash);
+        void                         eraseMainChainHeight(int32_t height);
+        boost::optional<CBlockIndex> getBlockIndex(const uint256& blockHash) const;
+        /// returns none if there's no change for that height, and a zero hash if the height was erased
+        boost::optional<uint256> getMainChainHash(int32_t height) const;
+        void                     applyTo(BlockIndexCatalog& catalog) const;
+    };
+
+private:
+    struct Entry
+    {
+        uint256   blockHash;
+        uint256   nChainTrust;
+        uint256   hashProof;
+        uint256   hashMerkleRoot;
+        COutPoint prevoutStake;
+        uint64_t  nStakeModifier;
+        int32_t   nHeight;
+        uint32_t  nFlags;
+        uint32_t  nStakeModifierChecksum;
+        uint32_t  nStakeTime;
+        int32_t   nVersion;
+        uint32_t  nTime;
+        uint32_t  nBits;
+        uint32_t  nNonce;
+        Slot      parent;
+        Slot      next;
+        Slot      skip;
+        // an entry is a placeholder if it was referenced (by hashPrev, hashNext or a height) before it
+        // was added
+        bool present;
+    };
+
+    mutable boost::shared_mutex mtx;
+
+    std::vector<Entry>                entries;
+    std::unordered_map<uint256, Slot> slotsByHash;
+    std::vector<Slot>                 mainChain;
+    bool                              loaded = false;
+
+    Slot        getOrCreateSlot_unsafe(const uint256& blockHash);
+    Slot        findSlot_unsafe(const uint256& blockHash) const;
+    Slot        getAncestor_unsafe(Slot slot, int32_t height) const;
+    CBlockIndex toBlockIndex_unsafe(Slot slot) const;
+    void        add_unsafe(const CBlockIndex& bi);
+    void        setMainChainHash_unsafe(int32_t height, const uint256& blockHash);
+    void        eraseMainChainHeight_unsafe(int32_t height);
+
 public:
     BlockIndexCatalog() {}
+
+    /// replaces the content of the catalog with all the block index entries in the database
+    bool loadFromDB(const ITxDB& txdb);
+
+    /// a catalog is loaded when it's a complete mirror of the database
+    bool isLoaded() const;
+
+    void clear();
+
+    std::size_t size() const;
+
+    /// inserts a new block index or updates the existing one with the same hash
+    void add(const CBlockIndex& bi);
+
+    boost::optional<CBlockIndex> get(const uint256& blockHash) const;
+
+    bool contains(const uint256& blockHash) const;
+
+    void setMainChainHash(int32_t height, const uint256& blockHash);
+
+    void eraseMainChainHeight(int32_t height);
+
+    boost::optional<uint256> getMainChainHash(int32_t height) const;
+
+    /// returns the ancestor of the given block at the given height in O(log n)
+    boost::optional<CBlockIndex> getAncestor(const uint256& blockHash, int32_t height) const;
+
+    /// returns the last common ancestor of the two given blocks
+    boost::optional<CBlockIndex> findFork(const uint256& blockHash1, const uint256& blockHash2) const;
 };
 
 #endif // BLOCKINDEXCATALOG_H
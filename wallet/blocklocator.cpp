@@ -104,3 +104,5 @@ int CBlockLocator::GetHeight(const ITxDB& txdb)
 }
 
 std::size_t CBlockLocator::size() const { return vHave.size(); }
+
+const std::vector<uint256>& CBlockLocator::GetHashes() const { return vHave; }
@@ -8,7 +8,9 @@
 #include <amount.h>
 #include <util.h>
 
+#include "bestchainstate.h"
 #include "block.h"
+#include "globals.h"
 #include <assert.h>
 #include <boost/optional.hpp>
 #include <cinttypes>
@@ -565,6 +567,12 @@ NetworkType CChainParams::NetType() const { return networkType; }
 
 bool CChainParams::PassedFirstValidNTP1Tx(const ITxDB* txdb) const
 {
+    if (!txdb) {
+        // avoid opening the db if the best chain is in memory
+        if (const boost::optional<int> bestHeight = bestChain.getBestHeight()) {
+            return *bestHeight >= consensus.firstValidNTP1Height;
+        }
+    }
     return ((txdb ? txdb->GetBestChainHeight().value_or(0) : CTxDB().GetBestChainHeight().value_or(0)) >=
             consensus.firstValidNTP1Height);
 }
@@ -0,0 +1,324 @@
+#ifndef CHECKQUEUE_H
+#define CHECKQUEUE_H
+
+#include <algorithm>
+#include <boost/optional.hpp>
+#include <boost/thread.hpp>
+#include <vector>
+
+#include "logging/logger.h"
+#include "util.h"
+
+template <typename T>
+class CCheckQueueControl;
+
+/**
+ * @brief The CCheckQueue class is a queue of verifications (like script checks) that are done in
+ * parallel by a pool of worker threads.
+ *
+ * A "master" thread (the one connecting a block) adds checks to the queue with a
+ * CCheckQueueControl as it goes, while the workers are already verifying the ones that were added
+ * before. When the master is done adding checks, it joins the workers in processing the queue and
+ * then waits for all the checks to finish; which is the barrier before anything is committed.
+ *
+ * T must be default constructible, swappable, and have a `bool operator()()` that returns true when
+ * the check succeeds. When a check fails, the remaining checks in the batch are skipped.
+ */
+template <typename T>
+class CCheckQueue
+{
+    mutable boost::mutex mtx;
+
+    /// worker threads block on this when out of work
+    boost::condition_variable condWorker;
+
+    /// the master thread blocks on this when out of work
+    boost::condition_variable condMaster;
+
+    /// the queue of elements to be processed; as the order of checks doesn't matter, it's a LIFO
+    std::vector<T> queue;
+
+    /// the number of workers (including the master) that are idle
+    int nIdle = 0;
+
+    /// the total number of workers (including the master)
+    int nTotal = 0;
+
+    /// the temporary evaluation result
+    bool fAllOk = true;
+
+    /// the first check that failed in the current batch, if any
+    boost::optional<T> firstFailure;
+
+    /// the number of verifications that haven't completed yet; this includes elements that are no
+    /// longer queued, but are still in the worker's own batches
+    unsigned int nTodo = 0;
+
+    /// the maximum number of elements to be processed in one batch
+    const unsigned int nBatchSize;
+
+    bool fRequestStop = false;
+
+    std::vector<boost::thread> workerThreads;
+
+    /// this is locked by CCheckQueueControl, so that only one master uses the queue at a time
+    boost::mutex controlMtx;
+
+    /// internal function that does bulk of the verification work
+    bool Loop(bool fMaster);
+
+    friend class CCheckQueueControl<T>;
+
+public:
+    explicit CCheckQueue(unsigned int batchSize) : nBatchSize(batchSize) {}
+
+    CCheckQueue(const CCheckQueue&) = delete;
+    CCheckQueue& operator=(const CCheckQueue&) = delete;
+
+    ~CCheckQueue();
+
+    /// starts the given number of worker threads; the master thread is not counted
+    void StartWorkerThreads(int threadsCount);
+
+    /// stops and joins all worker threads
+    void StopWorkerThreads();
+
+    /// the number of worker threads that are running, without the master thread
+    int WorkerThreadsCount() const;
+
+    /// waits until all the checks are done; returns true if all of them succeeded
+    bool Wait(boost::optional<T>& failedCheck);
+
+    /// adds a batch of checks to the queue; the checks are moved out of the vector, which is cleared
+    void Add(std::vector<T>& vChecks);
+};
+
+template <typename T>
+bool CCheckQueue<T>::Loop(bool fMaster)
+{
+    boost::condition_variable& cond = fMaster ? condMaster : condWorker;
+
+    std::vector<T>     vChecks;
+    boost::optional<T> failure;
+    vChecks.reserve(nBatchSize);
+    unsigned int nNow = 0;
+    bool         fOk  = true;
+    do {
+        {
+            boost::unique_lock<boost::mutex> lock(mtx);
+            // first do the clean-up of the previous loop run (allowing us to do it in the same
+            // critsect)
+            if (nNow) {
+                fAllOk &= fOk;
+                if (failure && !firstFailure) {
+                    firstFailure = std::move(failure);
+                }
+                failure = boost::none;
+                nTodo -= nNow;
+                if (nTodo == 0 && !fMaster) {
+                    // we processed the last element; inform the master it can exit and return the
+                    // result
+                    condMaster.notify_one();
+                }
+            } else {
+                // first iteration
+                nTotal++;
+            }
+            // logically, the do loop starts here
+            while (queue.empty() && !fRequestStop) {
+                if (fMaster && nTodo == 0) {
+                    nTotal--;
+                    bool fRet = fAllOk;
+                    // reset the status for new work later
+                    fAllOk = true;
+                    // return the current status
+                    return fRet;
+                }
+                nIdle++;
+                cond.wait(lock); // wait
+                nIdle--;
+            }
+            if (fRequestStop) {
+                nTotal--;
+                return false;
+            }
+
+            // Decide how many work units to process now.
+            // * Do not try to do everything at once, but aim for increasingly smaller batches so
+            //   all workers finish approximately simultaneously.
+            // * Try to account for idle jobs which will instantly start helping.
+            // * Don't do batches smaller than 1 (duh), or larger than nBatchSize.
+            nNow = std::max(
+                1U, std::min(nBatchSize, static_cast<unsigned int>(queue.size()) /
+                                             static_cast<unsigned int>(nTotal + nIdle + 1)));
+            vChecks.resize(nNow);
+            for (unsigned int i = 0; i < nNow; i++) {
+                // We want the lock on the mutex to be as short as possible, so swap jobs from the
+                // global queue to the local batch vector instead of copying.
+                using std::swap;
+                swap(vChecks[i], queue.back());
+                queue.pop_back();
+            }
+            // Check whether we need to do work at all
+            fOk = fAllOk;
+        }
+        // execute work
+        for (T& check : vChecks) {
+            if (fOk) {
+                fOk = check();
+                if (!fOk) {
+                    failure = std::move(check);
+                }
+            }
+        }
+        vChecks.clear();
+    } while (true);
+}
+
+template <typename T>
+CCheckQueue<T>::~CCheckQueue()
+{
+    StopWorkerThreads();
+}
+
+template <typename T>
+void CCheckQueue<T>::StartWorkerThreads(int threadsCount)
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mtx);
+        nIdle        = 0;
+        nTotal       = 0;
+        fAllOk       = true;
+        fRequestStop = false;
+    }
+    for (int i = 0; i < threadsCount; i++) {
+        workerThreads.emplace_back([this]() {
+            RenameThread("neblio-scriptch");
+            Loop(false);
+        });
+    }
+    NLog.write(b_sev::info, "Using {} threads for script verification", threadsCount + 1);
+}
+
+template <typename T>
+void CCheckQueue<T>::StopWorkerThreads()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mtx);
+        fRequestStop = true;
+    }
+    condWorker.notify_all();
+    for (boost::thread& t : workerThreads) {
+        t.join();
+    }
+    workerThreads.clear();
+    {
+        boost::unique_lock<boost::mutex> lock(mtx);
+        fRequestStop = false;
+    }
+}
+
+template <typename T>
+int CCheckQueue<T>::WorkerThreadsCount() const
+{
+    return static_cast<int>(workerThreads.size());
+}
+
+template <typename T>
+bool CCheckQueue<T>::Wait(boost::optional<T>& failedCheck)
+{
+    const bool result = Loop(true);
+    {
+        boost::unique_lock<boost::mutex> lock(mtx);
+        failedCheck = std::move(firstFailure);
+        firstFailure = boost::none;
+    }
+    return result;
+}
+
+template <typename T>
+void CCheckQueue<T>::Add(std::vector<T>& vChecks)
+{
+    if (vChecks.empty()) {
+        return;
+    }
+    {
+        boost::unique_lock<boost::mutex> lock(mtx);
+        for (T& check : vChecks) {
+            queue.push_back(T());
+            using std::swap;
+            swap(check, queue.back());
+        }
+        nTodo += static_cast<unsigned int>(vChecks.size());
+    }
+    if (vChecks.size() == 1) {
+        condWorker.notify_one();
+    } else {
+        condWorker.notify_all();
+    }
+    // the emptied checks must not be added again if the caller reuses the vector
+    vChecks.clear();
+}
+
+/**
+ * RAII-style controller object for a CCheckQueue that guarantees the passed queue is finished
+ * before continuing, even if the caller returns early (which matters because the checks may refer
+ * to data owned by the caller, like the transactions of the block being connected).
+ *
+ * If constructed with a null queue, the controller is inactive, and the caller is expected to do
+ * the checks in place.
+ */
+template <typename T>
+class CCheckQueueControl
+{
+    CCheckQueue<T>* const             pqueue;
+    boost::unique_lock<boost::mutex> controlLock;
+    bool                              fDone;
+
+public:
+    explicit CCheckQueueControl(CCheckQueue<T>* const queue) : pqueue(queue), fDone(false)
+    {
+        // passed queue is supposed to be unused, or nullptr
+        if (pqueue != nullptr) {
+            controlLock = boost::unique_lock<boost::mutex>(pqueue->controlMtx);
+        }
+    }
+
+    CCheckQueueControl(const CCheckQueueControl&) = delete;
+    CCheckQueueControl& operator=(const CCheckQueueControl&) = delete;
+
+    bool IsActive() const { return pqueue != nullptr; }
+
+    /// waits for all the added checks to finish; failedCheck is set to the first check that failed
+    bool Wait(boost::optional<T>& failedCheck)
+    {
+        if (pqueue == nullptr) {
+            return true;
+        }
+        const bool fRet = pqueue->Wait(failedCheck);
+        fDone           = true;
+        return fRet;
+    }
+
+    bool Wait()
+    {
+        boost::optional<T> unused;
+        return Wait(unused);
+    }
+
+    void Add(std::vector<T>& vChecks)
+    {
+        if (pqueue != nullptr) {
+            pqueue->Add(vChecks);
+        }
+    }
+
+    ~CCheckQueueControl()
+    {
+        if (!fDone) {
+            Wait();
+        }
+    }
+};
+
+#endif // CHECKQUEUE_H
@@ -0,0 +1,334 @@
+#include "coinselection.h"
+
+#include "logging/logger.h"
+#include "util.h"
+#include <algorithm>
+#include <limits>
+
+using CoinValuePair = std::pair<CAmount, std::pair<const CWalletTx*, unsigned int>>;
+
+bool CoinSelectionIndex::Coin::isEligible(int nConfMine, int nConfTheirs) const
+{
+    return depth >= (fromMe ? nConfMine : nConfTheirs);
+}
+
+int CoinSelectionIndex::BucketOf(CAmount value)
+{
+    int bucket = 0;
+    while (value >>= 1) {
+        bucket++;
+    }
+    return bucket;
+}
+
+void CoinSelectionIndex::add(const Coin& coin)
+{
+    if (coin.value <= 0) {
+        return;
+    }
+    buckets[BucketOf(coin.value)].push_back(coin);
+    coinsCount++;
+}
+
+std::size_t CoinSelectionIndex::size() const { return coinsCount; }
+
+const CoinSelectionIndex::Coin* CoinSelectionIndex::findExact(CAmount value, int nConfMine,
+                                                              int nConfTheirs) const
+{
+    if (value <= 0) {
+        return nullptr;
+    }
+    for (const Coin& coin : buckets[BucketOf(value)]) {
+        if (coin.value == value && coin.isEligible(nConfMine, nConfTheirs)) {
+            return &coin;
+        }
+    }
+    return nullptr;
+}
+
+const CoinSelectionIndex::Coin* CoinSelectionIndex::findLowestAtLeast(CAmount value, int nConfMine,
+                                                                      int nConfTheirs) const
+{
+    // all the coins of the buckets after the bucket of the value are larger than the value, so the
+    // search stops at the first bucket with an eligible coin
+    for (int b = (value <= 0 ? 0 : BucketOf(value)); b < BUCKETS_COUNT; b++) {
+        const Coin* result = nullptr;
+        for (const Coin& coin : buckets[b]) {
+            if (coin.value >= value && (!result || coin.value < result->value) &&
+                coin.isEligible(nConfMine, nConfTheirs)) {
+                result = &coin;
+            }
+        }
+        if (result) {
+            return result;
+        }
+    }
+    return nullptr;
+}
+
+std::vector<const CoinSelectionIndex::Coin*>
+CoinSelectionIndex::getCoinsBelow(CAmount limit, int nConfMine, int nConfTheirs, std::size_t maxCount,
+                                  CAmount minTotal) const
+{
+    std::vector<const Coin*> result;
+    if (limit <= 0) {
+        return result;
+    }
+    const int lastBucket = BucketOf(limit);
+
+    std::size_t candidatesCount = 0;
+    for (int b = 0; b <= lastBucket; b++) {
+        candidatesCount += buckets[b].size();
+    }
+
+    if (candidatesCount > maxCount) {
+        // the same share of every bucket; the coins of a bucket were added shuffled, so the first ones
+        // are a random sample of the bucket
+        CAmount total = 0;
+        for (int b = 0; b <= lastBucket; b++) {
+            const std::size_t share =
+                (buckets[b].size() * maxCount + candidatesCount - 1) / candidatesCount;
+            std::size_t taken = 0;
+            for (const Coin& coin : buckets[b]) {
+                if (taken >= share) {
+                    break;
+                }
+                if (coin.value < limit && coin.isEligible(nConfMine, nConfTheirs)) {
+                    result.push_back(&coin);
+                    total += coin.value;
+                    taken++;
+                }
+            }
+        }
+        if (total >= minTotal) {
+            return result;
+        }
+        result.clear();
+    }
+
+    for (int b = 0; b <= lastBucket; b++) {
+        for (const Coin& coin : buckets[b]) {
+            if (coin.value < limit && coin.isEligible(nConfMine, nConfTheirs)) {
+                result.push_back(&coin);
+            }
+        }
+    }
+    return result;
+}
+
+bool SelectCoinsBnB(const std::vector<CAmount>& values, CAmount target, CAmount costOfChange,
+                    std::vector<char>& vfSelected, CAmount& nTotal, std::size_t maxTries)
+{
+    vfSelected.assign(values.size(), false);
+    nTotal = 0;
+
+    CAmount available = 0;
+    for (CAmount v : values) {
+        available += v;
+    }
+    if (available < target) {
+        return false;
+    }
+
+    std::vector<std::size_t> currentSelection;
+    std::vector<std::size_t> bestSelection;
+    CAmount                  currentValue = 0;
+    CAmount                  bestValue    = std::numeric_limits<CAmount>::max();
+
+    // depth first search; at every value, including it is tried first, then excluding it. available is
+    // the total of the values that weren't decided yet, to cut branches that can't reach the target
+    std::size_t index = 0;
+    for (std::size_t tries = 0; tries < maxTries; tries++, index++) {
+        bool backtrack = false;
+        if (currentValue + available < target || currentValue > target + costOfChange) {
+            backtrack = true;
+        } else if (currentValue >= target) {
+            if (currentValue < bestValue) {
+                bestValue     = currentValue;
+                bestSelection = currentSelection;
+            }
+            if (bestValue == target) {
+                break;
+            }
+            backtrack = true;
+        }
+
+        if (backtrack) {
+            if (currentSelection.empty()) {
+                // everything was tried
+                break;
+            }
+            // the values skipped after the last included value are undecided again
+            for (--index; index > currentSelection.back(); --index) {
+                available += values[index];
+            }
+            // and now the last included value is excluded
+            currentValue -= values[index];
+            currentSelection.pop_back();
+        } else {
+            available -= values[index];
+            // excluding a value and then including the same value next leads to the same subsets that
+            // were already tried, so that's skipped
+            if (currentSelection.empty() || index - 1 == currentSelection.back() ||
+                values[index] != values[index - 1]) {
+                currentSelection.push_back(index);
+                currentValue += values[index];
+            }
+        }
+    }
+
+    if (bestSelection.empty()) {
+        return false;
+    }
+    for (std::size_t i : bestSelection) {
+        vfSelected[i] = true;
+    }
+    nTotal = bestValue;
+    return true;
+}
+
+static void ApproximateBestSubset(const std::vector<CoinValuePair>& vValue, CAmount nTotalLower,
+                                  CAmount nTargetValue, std::vector<char>& vfBest, CAmount& nBest,
+                                  int iterations = 1000)
+{
+    std::vector<char> vfIncluded;
+
+    vfBest.assign(vValue.size(), true);
+    nBest = nTotalLower;
+
+    seed_insecure_rand();
+
+    for (int nRep = 0; nRep < iterations && nBest != nTargetValue; nRep++) {
+        vfIncluded.assign(vValue.size(), false);
+        CAmount nTotal         = 0;
+        bool    fReachedTarget = false;
+        for (int nPass = 0; nPass < 2 && !fReachedTarget; nPass++) {
+            for (unsigned int i = 0; i < vValue.size(); i++) {
+                // The solver here uses a randomized algorithm,
+                // the randomness serves no real security purpose but is just
+                // needed to prevent degenerate behavior and it is important
+                // that the rng fast. We do not use a constant random sequence,
+                // because there may be some privacy improvement by making
+                // the selection random.
+                if (nPass == 0 ? insecure_rand() & 1 : !vfIncluded[i]) {
+                    nTotal += vValue[i].first;
+                    vfIncluded[i] = true;
+                    if (nTotal >= nTargetValue) {
+                        fReachedTarget = true;
+                        if (nTotal < nBest) {
+                            nBest  = nTotal;
+                            vfBest = vfIncluded;
+                        }
+                        nTotal -= vValue[i].first;
+                        vfIncluded[i] = false;
+                    }
+                }
+            }
+        }
+    }
+}
+
+bool SelectCoinsFromIndex(const CoinSelectionIndex& index, CAmount nTargetValue, int nConfMine,
+                          int                                                  nConfTheirs,
+                          std::set<std::pair<const CWalletTx*, unsigned int>>& setCoinsRet,
+                          CAmount& nValueRet, bool tryBnB, std::size_t maxCandidates)
+{
+    setCoinsRet.clear();
+    nValueRet = 0;
+
+    const CoinSelectionIndex::Coin* exactCoin = index.findExact(nTargetValue, nConfMine, nConfTheirs);
+    if (exactCoin) {
+        setCoinsRet.insert(std::make_pair(exactCoin->tx, exactCoin->i));
+        nValueRet += exactCoin->value;
+        return true;
+    }
+
+    const CoinSelectionIndex::Coin* coinLowestLarger =
+        index.findLowestAtLeast(nTargetValue + CENT, nConfMine, nConfTheirs);
+
+    // List of values less than target. When there are too many of them, a sample of them is used as
+    // long as it's enough, which doesn't change whether the total is less, equal or more than the target
+    std::vector<CoinValuePair> vValue;
+    CAmount                    nTotalLower = 0;
+
+    for (const CoinSelectionIndex::Coin* coin : index.getCoinsBelow(
+             nTargetValue + CENT, nConfMine, nConfTheirs, maxCandidates, nTargetValue + CENT)) {
+        vValue.push_back(std::make_pair(coin->value, std::make_pair(coin->tx, coin->i)));
+        nTotalLower += coin->value;
+    }
+
+    if (nTotalLower == nTargetValue) {
+        for (unsigned int i = 0; i < vValue.size(); ++i) {
+            setCoinsRet.insert(vValue[i].second);
+            nValueRet += vValue[i].first;
+        }
+        return true;
+    }
+
+    if (nTotalLower < nTargetValue) {
+        if (coinLowestLarger == nullptr)
+            return false;
+        setCoinsRet.insert(std::make_pair(coinLowestLarger->tx, coinLowestLarger->i));
+        nValueRet += coinLowestLarger->value;
+        return true;
+    }
+
+    // the order of coins of the same value stays as they were added (shuffled), so that the choice
+    // among them is random
+    std::stable_sort(vValue.begin(), vValue.end(), [](const CoinValuePair& a, const CoinValuePair& b) {
+        return a.first > b.first;
+    });
+
+    // a subset with the exact value needs no change, and it always beats the smallest larger coin
+    if (tryBnB) {
+        std::vector<CAmount> values;
+        values.reserve(vValue.size());
+        for (const CoinValuePair& v : vValue) {
+            values.push_back(v.first);
+        }
+        std::vector<char> vfSelected;
+        CAmount           nSelected = 0;
+        if (SelectCoinsBnB(values, nTargetValue, 0, vfSelected, nSelected)) {
+            for (unsigned int i = 0; i < vValue.size(); i++) {
+                if (vfSelected[i]) {
+                    setCoinsRet.insert(vValue[i].second);
+                    nValueRet += vValue[i].first;
+                }
+            }
+            return true;
+        }
+    }
+
+    // Solve subset sum by stochastic approximation
+    std::vector<char> vfBest;
+    CAmount           nBest;
+
+    ApproximateBestSubset(vValue, nTotalLower, nTargetValue, vfBest, nBest, 1000);
+    if (nBest != nTargetValue && nTotalLower >= nTargetValue + CENT)
+        ApproximateBestSubset(vValue, nTotalLower, nTargetValue + CENT, vfBest, nBest, 1000);
+
+    // If we have a bigger coin and (either the stochastic approximation didn't find a good solution,
+    //                                   or the next bigger coin is closer), return the bigger coin
+    if (coinLowestLarger &&
+        ((nBest != nTargetValue && nBest < nTargetValue + CENT) || coinLowestLarger->value <= nBest)) {
+        setCoinsRet.insert(std::make_pair(coinLowestLarger->tx, coinLowestLarger->i));
+        nValueRet += coinLowestLarger->value;
+    } else {
+        for (unsigned int i = 0; i < vValue.size(); i++)
+            if (vfBest[i]) {
+                setCoinsRet.insert(vValue[i].second);
+                nValueRet += vValue[i].first;
+            }
+
+        if (fDebug) {
+            //// debug print
+            NLog.write(b_sev::debug, "SelectCoins() best subset: ");
+            for (unsigned int i = 0; i < vValue.size(); i++)
+                if (vfBest[i])
+                    NLog.write(b_sev::debug, "{} ", FormatMoney(vValue[i].first));
+            NLog.write(b_sev::debug, "total {}", FormatMoney(nBest));
+        }
+    }
+
+    return true;
+}
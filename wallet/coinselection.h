@@ -0,0 +1,93 @@
+#ifndef COINSELECTION_H
+#define COINSELECTION_H
+
+#include "amount.h"
+#include <array>
+#include <cstddef>
+#include <set>
+#include <utility>
+#include <vector>
+
+class CWalletTx;
+
+/**
+ * @brief The CoinSelectionIndex class keeps the coins that can be spent by a transaction, bucketed by
+ * the power of two of their value.
+ *
+ * Coin selection needs the coins below a limit, the smallest coin above it and the coins of an exact
+ * value; with the buckets, only the buckets of the limit are searched for those instead of all the
+ * coins of the wallet, and large wallets can be sampled evenly across values. The index is built once
+ * for all the tries of SelectCoins() with less and less confirmations, which are then only checked per
+ * coin.
+ */
+class CoinSelectionIndex
+{
+public:
+    struct Coin
+    {
+        CAmount          value  = 0;
+        const CWalletTx* tx     = nullptr;
+        unsigned int     i      = 0;
+        int              depth  = 0;
+        bool             fromMe = false;
+
+        bool isEligible(int nConfMine, int nConfTheirs) const;
+    };
+
+    static constexpr int BUCKETS_COUNT = 64;
+
+private:
+    std::array<std::vector<Coin>, BUCKETS_COUNT> buckets;
+    std::size_t                                  coinsCount = 0;
+
+public:
+    /// the bucket of a positive value, which is floor(log2(value))
+    static int BucketOf(CAmount value);
+
+    /// coins with a value that's not positive are ignored
+    void        add(const Coin& coin);
+    std::size_t size() const;
+
+    const Coin* findExact(CAmount value, int nConfMine, int nConfTheirs) const;
+
+    /// the smallest coin with at least the given value; the first added one of those on ties
+    const Coin* findLowestAtLeast(CAmount value, int nConfMine, int nConfTheirs) const;
+
+    /**
+     * The coins below the limit. If there are more than maxCount of them, a sample of about maxCount
+     * coins from all the buckets is returned instead, if its total is at least minTotal.
+     */
+    std::vector<const Coin*> getCoinsBelow(CAmount limit, int nConfMine, int nConfTheirs,
+                                           std::size_t maxCount, CAmount minTotal) const;
+};
+
+/**
+ * The stochastic approximation goes over all the candidate coins a thousand times, so when there are
+ * more coins below the target than that, only a sample of them is used, as long as it's enough
+ */
+static constexpr std::size_t MAX_SELECTION_CANDIDATES = 1000;
+
+static constexpr std::size_t BNB_MAX_TRIES = 100000;
+
+/**
+ * Branch and bound search for a subset of values (which must be sorted in descending order) with a
+ * total in [target, target + costOfChange], so that no change output is needed. The subset with the
+ * smallest total is chosen, and the search stops at the first exact match.
+ */
+bool SelectCoinsBnB(const std::vector<CAmount>& values, CAmount target, CAmount costOfChange,
+                    std::vector<char>& vfSelected, CAmount& nTotal,
+                    std::size_t maxTries = BNB_MAX_TRIES);
+
+/**
+ * Selects the coins of the index to pay the target with the given confirmations; first an exact coin,
+ * then an exact subset with branch and bound (if tryBnB is true), then the stochastic approximation
+ * of the best subset (over at most maxCandidates coins, if they're enough), or the smallest coin
+ * larger than the target
+ */
+bool SelectCoinsFromIndex(const CoinSelectionIndex& index, CAmount nTargetValue, int nConfMine,
+                          int                                                  nConfTheirs,
+                          std::set<std::pair<const CWalletTx*, unsigned int>>& setCoinsRet,
+                          CAmount& nValueRet, bool tryBnB = true,
+                          std::size_t maxCandidates = MAX_SELECTION_CANDIDATES);
+
+#endif // COINSELECTION_H
@@ -207,7 +207,8 @@ void CDBEnv::CheckpointLSN(std::string strFile)
     dbenv.lsn_reset(strFile.c_str(), 0);
 }
 
-CDB::CDB(const char* pszFile, const char* pszMode, bool fFlushOnCloseIn) : pdb(NULL), activeTxn(NULL)
+CDB::CDB(const char* pszFile, const char* pszMode, bool fFlushOnCloseIn)
+    : pdb(NULL), activeTxn(NULL), fBatchTxn(false)
 {
     int ret;
     if (pszFile == NULL)
@@ -266,6 +267,14 @@ CDB::CDB(const char* pszFile, const char* pszMode, bool fFlushOnCloseIn) : pdb(N
 
             bitdb.mapDb[strFile] = pdb;
         }
+
+        // join the write batch of this thread
+        const auto batchIt =
+            bitdb.mapBatchTxn.find(std::make_pair(strFile, boost::this_thread::get_id()));
+        if (batchIt != bitdb.mapBatchTxn.cend()) {
+            activeTxn = batchIt->second;
+            fBatchTxn = true;
+        }
     }
 }
 
@@ -286,12 +295,15 @@ void CDB::Close()
 {
     if (!pdb)
         return;
-    if (activeTxn)
+    // a database that joined a batch leaves the flush to the batch, which flushes once it's committed
+    const bool fJoinedBatch = fBatchTxn;
+    if (activeTxn && !fBatchTxn)
         activeTxn->abort();
     activeTxn = nullptr;
+    fBatchTxn = false;
     pdb       = nullptr;
 
-    if (fFlushOnClose)
+    if (fFlushOnClose && !fJoinedBatch)
         Flush();
 
     {
@@ -300,6 +312,50 @@ void CDB::Close()
     }
 }
 
+CDBBatch::CDBBatch(const std::string& strFilename, bool fFlushOnCommit)
+    : CDB(strFilename.c_str(), "r+", fFlushOnCommit), fOwner(false)
+{
+    // if the thread has a batch for the file already, this one joined it
+    if (!pdb || activeTxn)
+        return;
+    fOwner = Begin();
+    if (!fOwner)
+        NLog.write(b_sev::warn, "CDBBatch: failed to begin a transaction for {}", strFile);
+}
+
+CDBBatch::~CDBBatch()
+{
+    if (fOwner && !End())
+        NLog.write(b_sev::err, "CDBBatch: failed to commit the transaction of {}", strFile);
+}
+
+bool CDBBatch::Begin()
+{
+    if (!TxnBegin())
+        return false;
+    LOCK(bitdb.cs_db);
+    bitdb.mapBatchTxn[std::make_pair(strFile, boost::this_thread::get_id())] = activeTxn;
+    return true;
+}
+
+bool CDBBatch::End()
+{
+    {
+        LOCK(bitdb.cs_db);
+        bitdb.mapBatchTxn.erase(std::make_pair(strFile, boost::this_thread::get_id()));
+    }
+    return TxnCommit();
+}
+
+bool CDBBatch::Commit()
+{
+    if (!fOwner)
+        return false;
+    const bool fCommitted = End();
+    fOwner                = Begin();
+    return fCommitted && fOwner;
+}
+
 void CDBEnv::CloseDb(const string& strFile)
 {
     {
@@ -7,6 +7,7 @@
 
 #include <boost/atomic.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
 #include <map>
 #include <string>
 #include <vector>
@@ -46,6 +47,9 @@ public:
     DbEnv                      dbenv;
     std::map<std::string, int> mapFileUseCount;
     std::map<std::string, Db*> mapDb;
+    // the transactions of the open write batches by file and the thread that opened them (see
+    // CDBBatch)
+    std::map<std::pair<std::string, boost::thread::id>, DbTxn*> mapBatchTxn;
 
     CDBEnv();
     ~CDBEnv();
@@ -102,6 +106,8 @@ protected:
     Db*         pdb;
     std::string strFile;
     DbTxn*      activeTxn;
+    // whether activeTxn belongs to a batch of the thread (see CDBBatch), which commits it instead
+    bool        fBatchTxn;
     bool        fReadOnly;
     bool        fFlushOnClose;
 
@@ -229,7 +235,7 @@ protected:
         if (!pdb)
             return NULL;
         Dbc* pcursor = NULL;
-        int  ret     = pdb->cursor(NULL, &pcursor, 0);
+        int  ret     = pdb->cursor(activeTxn, &pcursor, 0);
         if (ret != 0)
             return NULL;
         return pcursor;
@@ -288,7 +294,7 @@ public:
 
     bool TxnCommit()
     {
-        if (!pdb || !activeTxn)
+        if (!pdb || !activeTxn || fBatchTxn)
             return false;
         int ret   = activeTxn->commit(0);
         activeTxn = NULL;
@@ -297,7 +303,7 @@ public:
 
     bool TxnAbort()
     {
-        if (!pdb || !activeTxn)
+        if (!pdb || !activeTxn || fBatchTxn)
             return false;
         int ret   = activeTxn->abort();
         activeTxn = NULL;
@@ -315,6 +321,39 @@ public:
     bool static Rewrite(const std::string& strFile, const char* pszSkip = NULL);
 };
 
+/**
+ * RAII class that groups the writes of the calling thread to a database file in one transaction.
+ *
+ * Every CDB of the file that the thread opens while the batch lives joins its transaction, and
+ * doesn't flush when it's closed, so thousands of writes through short lived CDB objects (like the
+ * keys of a key pool refill) cost one commit and one flush. The transaction is committed when the
+ * batch is destroyed. A batch opened while the thread has one for the file already does nothing.
+ *
+ * Other threads that write to the file wait for the commit, so the batch shouldn't be held while
+ * waiting for them.
+ */
+class CDBBatch : public CDB
+{
+    bool fOwner;
+
+public:
+    explicit CDBBatch(const std::string& strFilename, bool fFlushOnCommit = true);
+    ~CDBBatch();
+
+    /// whether this batch has the transaction (false if it's nested, or if it couldn't be started)
+    bool IsOwner() const { return fOwner; }
+
+    /**
+     * Commits the writes so far and starts a new transaction. No other CDB of the file may be open
+     * in the thread, since they keep the transaction that's committed
+     */
+    bool Commit();
+
+private:
+    bool Begin();
+    bool End();
+};
+
 /** Access to the (IP) address database (peers.dat) */
 class CAddrDB
 {
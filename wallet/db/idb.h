@@ -3,6 +3,7 @@
 
 #include <boost/filesystem/path.hpp>
 #include <boost/optional.hpp>
+#include <functional>
 #include <map>
 #include <vector>
 
@@ -20,13 +21,54 @@ public:
         DB_ADDRSVSPUBKEYS_INDEX = 6,
         DB_BLOCKMETADATA_INDEX  = 7,
         DB_BLOCKHEIGHTS_INDEX   = 8,
-        DB_STAKES_INDEX         = 9
+        DB_STAKES_INDEX         = 9,
+        // the optional NTP1 index (-ntp1index)
+        DB_NTP1ADDRESSOUTPUTS_INDEX = 10,
+        DB_NTP1TOKENS_INDEX         = 11,
+        DB_NTP1TOKENHOLDERS_INDEX   = 12
     };
 
+    /**
+     * a function that gets a view of a value in the db; the view is valid only inside the function
+     */
+    using ValueViewFunc = std::function<bool(const char* data, std::size_t size)>;
+
+    /**
+     * like ValueViewFunc, for batch reads, with the index of the key of the value in the given keys
+     */
+    using BatchValueViewFunc =
+        std::function<bool(std::size_t keyIndex, const char* data, std::size_t size)>;
+
     virtual boost::optional<std::string>
     read(IDB::Index dbindex, const std::string& key, std::size_t offset = 0,
          const boost::optional<std::size_t>& size = boost::none) const = 0;
 
+    /**
+     * @brief readView is like read(), but instead of copying the value out of the db, it calls func
+     * with a view of the value in the db's memory, which is valid only within the read transaction
+     * @param dbindex
+     * @param key
+     * @param func the function that processes the value, which must not keep the view
+     * @param offset
+     * @param size
+     * @return false if the key doesn't exist or reading failed, otherwise the return value of func
+     */
+    virtual bool readView(IDB::Index dbindex, const std::string& key, const ValueViewFunc& func,
+                          std::size_t offset = 0,
+                          const boost::optional<std::size_t>& size = boost::none) const = 0;
+
+    /**
+     * @brief readBatch reads many keys in a single read transaction. The keys are looked up in sorted
+     * order, which is the order of the db, and func is called with a view of every value found (see
+     * readView()), in that order
+     * @param dbindex
+     * @param keys
+     * @param func the function that processes the values; returning false stops the batch
+     * @return false if reading failed or func returned false; keys that don't exist are skipped
+     */
+    virtual bool readBatch(IDB::Index dbindex, const std::vector<std::string>& keys,
+                           const BatchValueViewFunc& func) const = 0;
+
     /**
      * @brief ReadMultiple reads all the elements under the given key
      * @param dbindex
@@ -51,6 +93,14 @@ public:
     virtual boost::optional<std::map<std::string, std::string>>
     readAllUnique(IDB::Index dbindex) const = 0;
 
+    /**
+     * @brief readAllUniqueWithPrefix is like readAllUnique, but only for the keys that start with
+     * keyPrefix
+     * @return boost::none on error, results otherwise
+     */
+    virtual boost::optional<std::map<std::string, std::string>>
+    readAllUniqueWithPrefix(IDB::Index dbindex, const std::string& keyPrefix) const = 0;
+
     virtual bool write(IDB::Index dbindex, const std::string& key, const std::string& value) = 0;
 
     /**
@@ -70,6 +120,13 @@ public:
      */
     virtual bool eraseAll(IDB::Index dbindex, const std::string& key) = 0;
 
+    /**
+     * @brief clear erases all the entries in the database
+     * @param dbindex
+     * @return true if the database is empty now, false otherwise (db access failed, etc)
+     */
+    virtual bool clear(IDB::Index dbindex) = 0;
+
     virtual bool exists(IDB::Index dbindex, const std::string& key) const = 0;
 
     virtual bool beginDBTransaction(std::size_t expectedDataSize = 0) = 0;
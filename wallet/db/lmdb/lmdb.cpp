@@ -3,6 +3,7 @@
 #include "logging/logger.h"
 #include "stringmanip.h"
 #include "ui_interface.h"
+#include <algorithm>
 #include <boost/filesystem.hpp>
 #include <boost/scope_exit.hpp>
 
@@ -21,6 +22,10 @@ const std::string LMDB_BLOCKMETADATADB  = "BlockMetadataDb";
 const std::string LMDB_BLOCKHEIGHTSDB   = "BlockHeightsDB";
 const std::string LMDB_STAKESDB         = "StakesDB";
 
+const std::string LMDB_NTP1ADDRESSOUTPUTSDB = "Ntp1AddrOutputsDb";
+const std::string LMDB_NTP1TOKENSDB         = "Ntp1TokensDb";
+const std::string LMDB_NTP1TOKENHOLDERSDB   = "Ntp1TokenHoldersDb";
+
 namespace {
 
 #define ENABLE_AUTO_RESIZE
@@ -294,6 +299,10 @@ void LMDB::openDatabase(const boost::filesystem::path& directory, bool clearDBBe
     glob_lmdb_db_pointers->db_blockHeights   = DbSmartPtrType(new MDB_dbi, dbDeleter);
     glob_lmdb_db_pointers->db_stakes         = DbSmartPtrType(new MDB_dbi, dbDeleter);
 
+    glob_lmdb_db_pointers->db_ntp1AddressOutputs = DbSmartPtrType(new MDB_dbi, dbDeleter);
+    glob_lmdb_db_pointers->db_ntp1Tokens         = DbSmartPtrType(new MDB_dbi, dbDeleter);
+    glob_lmdb_db_pointers->db_ntp1TokenHolders   = DbSmartPtrType(new MDB_dbi, dbDeleter);
+
     // MDB_CREATE: Create the named database if it doesn't exist.
     lmdb_db_open(txn, LMDB_MAINDB.c_str(), MDB_CREATE, *glob_lmdb_db_pointers->db_main,
                  "Failed to open db handle for db_main");
@@ -317,6 +326,14 @@ void LMDB::openDatabase(const boost::filesystem::path& directory, bool clearDBBe
                  "Failed to open db handle for db_blockHeights");
     lmdb_db_open(txn, LMDB_STAKESDB.c_str(), MDB_CREATE, *glob_lmdb_db_pointers->db_stakes,
                  "Failed to open db handle for db_stakes");
+    lmdb_db_open(txn, LMDB_NTP1ADDRESSOUTPUTSDB.c_str(), MDB_CREATE,
+                 *glob_lmdb_db_pointers->db_ntp1AddressOutputs,
+                 "Failed to open db handle for db_ntp1AddressOutputs");
+    lmdb_db_open(txn, LMDB_NTP1TOKENSDB.c_str(), MDB_CREATE, *glob_lmdb_db_pointers->db_ntp1Tokens,
+                 "Failed to open db handle for db_ntp1Tokens");
+    lmdb_db_open(txn, LMDB_NTP1TOKENHOLDERSDB.c_str(), MDB_CREATE,
+                 *glob_lmdb_db_pointers->db_ntp1TokenHolders,
+                 "Failed to open db handle for db_ntp1TokenHolders");
 
     // commit the transaction
     txn.commit();
@@ -351,6 +368,15 @@ void LMDB::openDatabase(const boost::filesystem::path& directory, bool clearDBBe
     if (!glob_lmdb_db_pointers->db_stakes) {
         throw std::runtime_error("LMDB nullptr after opening the db_stakes database.");
     }
+    if (!glob_lmdb_db_pointers->db_ntp1AddressOutputs) {
+        throw std::runtime_error("LMDB nullptr after opening the db_ntp1AddressOutputs database.");
+    }
+    if (!glob_lmdb_db_pointers->db_ntp1Tokens) {
+        throw std::runtime_error("LMDB nullptr after opening the db_ntp1Tokens database.");
+    }
+    if (!glob_lmdb_db_pointers->db_ntp1TokenHolders) {
+        throw std::runtime_error("LMDB nullptr after opening the db_ntp1TokenHolders database.");
+    }
 
     boost::atomic_thread_fence(boost::memory_order_seq_cst);
 
@@ -440,6 +466,20 @@ LMDB::LMDB(const boost::filesystem::path* const dbdir, bool startNewDatabase) :
 
 boost::optional<std::string> LMDB::read(IDB::Index dbindex, const std::string& key, std::size_t offset,
                                         const boost::optional<std::size_t>& size) const
+{
+    boost::optional<std::string> result;
+    readView(
+        dbindex, key,
+        [&result](const char* data, std::size_t dataSize) {
+            result = std::string(data, dataSize);
+            return true;
+        },
+        offset, size);
+    return result;
+}
+
+bool LMDB::readView(IDB::Index dbindex, const std::string& key, const ValueViewFunc& func,
+                    std::size_t offset, const boost::optional<std::size_t>& size) const
 {
     const MDB_dbi* dbPtr = getDbByIndex(dbindex);
 
@@ -456,6 +496,7 @@ boost::optional<std::string> LMDB::read(IDB::Index dbindex, const std::string& k
     // only one of them should be active
     assert(localTxn.rawPtr() == nullptr || activeBatch == nullptr);
 
+    // the view points to the memory map, and is valid until the transaction ends
     BOOST_SCOPE_EXIT(&localTxn)
     {
         if (localTxn.rawPtr()) {
@@ -475,7 +516,7 @@ boost::optional<std::string> LMDB::read(IDB::Index dbindex, const std::string& k
                                        " with an unknown error of code " + std::to_string(ret) +
                                        "; and error: " + std::string(mdb_strerror(ret)));
         }
-        return boost::none;
+        return false;
     }
     assert(vS.mv_data != nullptr);
     // offset is never larger than the size
@@ -485,8 +526,82 @@ boost::optional<std::string> LMDB::read(IDB::Index dbindex, const std::string& k
     pSize = pSize > vS.mv_size ? vS.mv_size : pSize;
     // the remaining size after the offset can't be larger the remaining string after the offset
     const std::size_t fSize = pSize > vS.mv_size - of ? vS.mv_size - of : pSize;
-    std::string       result(static_cast<const char*>(vS.mv_data) + of, fSize);
-    return boost::make_optional(std::move(result));
+    return func(static_cast<const char*>(vS.mv_data) + of, fSize);
+}
+
+bool LMDB::readBatch(IDB::Index dbindex, const std::vector<std::string>& keys,
+                     const BatchValueViewFunc& func) const
+{
+    if (keys.empty()) {
+        return true;
+    }
+
+    const MDB_dbi* dbPtr = getDbByIndex(dbindex);
+
+    LMDBTransaction localTxn(false);
+    if (!activeBatch) {
+        localTxn = LMDBTransaction();
+        if (auto res = lmdb_txn_begin(dbEnv.get(), nullptr, MDB_RDONLY, localTxn)) {
+            NLog.write(b_sev::err, "readBatch: Failed to begin transaction at read with error code " +
+                                       std::to_string(res) +
+                                       "; and error code: " + std::string(mdb_strerror(res)));
+            return false;
+        }
+    }
+    // only one of them should be active
+    assert(localTxn.rawPtr() == nullptr || activeBatch == nullptr);
+
+    BOOST_SCOPE_EXIT(&localTxn)
+    {
+        if (localTxn.rawPtr()) {
+            localTxn.abort();
+        }
+    }
+    BOOST_SCOPE_EXIT_END
+
+    MDB_cursor* cursorRawPtr = nullptr;
+    if (auto rc = mdb_cursor_open((!activeBatch ? localTxn : *activeBatch), *dbPtr, &cursorRawPtr)) {
+        NLog.write(b_sev::err, "readBatch: Failed to open lmdb cursor with error code " +
+                                   std::to_string(rc) + "; and error: " + std::string(mdb_strerror(rc)));
+        return false;
+    }
+
+    std::unique_ptr<MDB_cursor, void (*)(MDB_cursor*)> cursorPtr(cursorRawPtr, [](MDB_cursor* p) {
+        if (p)
+            mdb_cursor_close(p);
+    });
+
+    // lmdb compares keys with memcmp, which is how std::string compares them too; looking them up in
+    // order makes the cursor walk the b-tree forward, mostly within pages that were just visited
+    std::vector<std::size_t> order(keys.size());
+    for (std::size_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(),
+              [&keys](std::size_t a, std::size_t b) { return keys[a] < keys[b]; });
+
+    for (const std::size_t i : order) {
+        const std::string& key = keys[i];
+
+        MDB_val kS = {key.size(), (void*)(key.c_str())};
+        MDB_val vS = {0, nullptr};
+        if (auto ret = mdb_cursor_get(cursorPtr.get(), &kS, &vS, MDB_SET_KEY)) {
+            if (ret == MDB_NOTFOUND) {
+                continue;
+            }
+            const std::string dbgKey = KeyAsString(key, key);
+            NLog.write(b_sev::err, "readBatch: Failed to read lmdb key " + dbgKey +
+                                       " with an unknown error of code " + std::to_string(ret) +
+                                       "; and error: " + std::string(mdb_strerror(ret)));
+            return false;
+        }
+        assert(vS.mv_data != nullptr);
+        if (!func(i, static_cast<const char*>(vS.mv_data), vS.mv_size)) {
+            return false;
+        }
+    }
+
+    return true;
 }
 
 boost::optional<std::vector<std::string>> LMDB::readMultiple(IDB::Index         dbindex,
@@ -710,6 +825,72 @@ boost::optional<std::map<std::string, std::string>> LMDB::readAllUnique(IDB::Ind
     return result;
 }
 
+boost::optional<std::map<std::string, std::string>>
+LMDB::readAllUniqueWithPrefix(IDB::Index dbindex, const std::string& keyPrefix) const
+{
+    const MDB_dbi* dbPtr = getDbByIndex(dbindex);
+
+    LMDBTransaction localTxn(false);
+    if (!activeBatch) {
+        localTxn = LMDBTransaction();
+        if (auto res = lmdb_txn_begin(dbEnv.get(), nullptr, MDB_RDONLY, localTxn)) {
+            NLog.write(b_sev::err,
+                       "LMDB::readAllWithPrefix: Failed to begin transaction at read with error code " +
+                           std::to_string(res) + "; and error code: " + std::string(mdb_strerror(res)));
+        }
+    }
+    // only one of them should be active
+    assert(localTxn.rawPtr() == nullptr || activeBatch == nullptr);
+
+    BOOST_SCOPE_EXIT(&localTxn)
+    {
+        if (localTxn.rawPtr()) {
+            localTxn.abort();
+        }
+    }
+    BOOST_SCOPE_EXIT_END
+
+    MDB_val     kS           = {keyPrefix.size(), (void*)(keyPrefix.c_str())};
+    MDB_val     vS           = {0, nullptr};
+    MDB_cursor* cursorRawPtr = nullptr;
+    if (auto rc = mdb_cursor_open((!activeBatch ? localTxn : *activeBatch), *dbPtr, &cursorRawPtr)) {
+        NLog.write(b_sev::err, "LMDB::readAllWithPrefix: Failed to open lmdb cursor with error code " +
+                                   std::to_string(rc) + "; and error: " + std::string(mdb_strerror(rc)));
+        return boost::none;
+    }
+
+    std::unique_ptr<MDB_cursor, void (*)(MDB_cursor*)> cursorPtr(cursorRawPtr, [](MDB_cursor* p) {
+        if (p)
+            mdb_cursor_close(p);
+    });
+
+    // keys are sorted, so the ones with the prefix start at the first key that's not less than it
+    int itemRes = mdb_cursor_get(cursorPtr.get(), &kS, &vS, MDB_SET_RANGE);
+    if (itemRes != 0 && itemRes != MDB_NOTFOUND) {
+        NLog.write(b_sev::err,
+                   "LMDB::readAllWithPrefix: Cursor does not exist while reading entries; with an error "
+                   "of code " +
+                       std::to_string(itemRes) + "; and error: " + std::string(mdb_strerror(itemRes)));
+        return boost::none;
+    }
+    std::map<std::string, std::string> result;
+    while (itemRes == 0) {
+        assert(vS.mv_data != nullptr);
+
+        std::string keyFound(static_cast<const char*>(kS.mv_data), kS.mv_size);
+        if (keyFound.compare(0, keyPrefix.size(), keyPrefix) != 0) {
+            break;
+        }
+        std::string value(static_cast<const char*>(vS.mv_data), vS.mv_size);
+        result[keyFound] = value;
+
+        itemRes = mdb_cursor_get(cursorRawPtr, &kS, &vS, MDB_NEXT);
+    }
+
+    cursorPtr.reset();
+    return result;
+}
+
 bool LMDB::write(IDB::Index dbindex, const std::string& key, const std::string& value)
 {
     const MDB_dbi* dbPtr = getDbByIndex(dbindex);
@@ -873,6 +1054,46 @@ bool LMDB::eraseAll(IDB::Index dbindex, const std::string& key)
     return true;
 }
 
+bool LMDB::clear(IDB::Index dbindex)
+{
+    const MDB_dbi* dbPtr = getDbByIndex(dbindex);
+    if (!dbPtr)
+        return false;
+
+    LMDBTransaction localTxn(false);
+    if (!activeBatch) {
+        localTxn = LMDBTransaction();
+        if (auto res = lmdb_txn_begin(dbEnv.get(), nullptr, 0, localTxn)) {
+            NLog.write(b_sev::err, "Failed to begin transaction at clear with error code " +
+                                       std::to_string(res) +
+                                       "; and error: " + std::string(mdb_strerror(res)));
+        }
+    }
+
+    // only one of them should be active
+    assert(localTxn.rawPtr() == nullptr || activeBatch == nullptr);
+
+    BOOST_SCOPE_EXIT(&localTxn)
+    {
+        if (localTxn.rawPtr()) {
+            localTxn.abort();
+        }
+    }
+    BOOST_SCOPE_EXIT_END
+
+    // 0 empties the database and keeps its handle open
+    if (auto ret = mdb_drop((!activeBatch ? localTxn : *activeBatch), *dbPtr, 0)) {
+        NLog.write(b_sev::err, "Failed to clear database with index " +
+                                   std::to_string(static_cast<int>(dbindex)) + " with lmdb; Code " +
+                                   std::to_string(ret) +
+                                   "; Error message: " + std::string(mdb_strerror(ret)));
+        return false;
+    }
+
+    localTxn.commitIfValid("Tx while clearing");
+    return true;
+}
+
 bool LMDB::exists(IDB::Index dbindex, const std::string& key) const
 {
     const MDB_dbi* dbPtr = getDbByIndex(dbindex);
@@ -997,6 +1218,9 @@ MDB_dbi* LMDB::getDbByIndex(const IDB::Index index) const
         case IDB::Index::DB_BLOCKMETADATA_INDEX:  return dbPointers->db_blockMetadata.get();
         case IDB::Index::DB_BLOCKHEIGHTS_INDEX:   return dbPointers->db_blockHeights.get();
         case IDB::Index::DB_STAKES_INDEX:         return dbPointers->db_stakes.get();
+        case IDB::Index::DB_NTP1ADDRESSOUTPUTS_INDEX: return dbPointers->db_ntp1AddressOutputs.get();
+        case IDB::Index::DB_NTP1TOKENS_INDEX:         return dbPointers->db_ntp1Tokens.get();
+        case IDB::Index::DB_NTP1TOKENHOLDERS_INDEX:   return dbPointers->db_ntp1TokenHolders.get();
     }
     // clang-format on
     throw std::runtime_error("Invalid db index provided in getDbByIndex");
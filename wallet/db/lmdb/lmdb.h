@@ -24,13 +24,18 @@ struct __lmdb_db_pointers
     DbSmartPtrType db_blockMetadata;
     DbSmartPtrType db_blockHeights;
     DbSmartPtrType db_stakes;
+    DbSmartPtrType db_ntp1AddressOutputs;
+    DbSmartPtrType db_ntp1Tokens;
+    DbSmartPtrType db_ntp1TokenHolders;
 
     __lmdb_db_pointers()
         : db_main(nullptr, [](MDB_dbi*) {}), db_blockIndex(nullptr, [](MDB_dbi*) {}),
           db_blocks(nullptr, [](MDB_dbi*) {}), db_tx(nullptr, [](MDB_dbi*) {}),
           db_ntp1Tx(nullptr, [](MDB_dbi*) {}), db_ntp1tokenNames(nullptr, [](MDB_dbi*) {}),
           db_addrsVsPubKeys(nullptr, [](MDB_dbi*) {}), db_blockMetadata(nullptr, [](MDB_dbi*) {}),
-          db_blockHeights(nullptr, [](MDB_dbi*) {}), db_stakes(nullptr, [](MDB_dbi*) {})
+          db_blockHeights(nullptr, [](MDB_dbi*) {}), db_stakes(nullptr, [](MDB_dbi*) {}),
+          db_ntp1AddressOutputs(nullptr, [](MDB_dbi*) {}), db_ntp1Tokens(nullptr, [](MDB_dbi*) {}),
+          db_ntp1TokenHolders(nullptr, [](MDB_dbi*) {})
     {
     }
 
@@ -46,6 +51,9 @@ struct __lmdb_db_pointers
         db_blockMetadata.reset();
         db_blockHeights.reset();
         db_stakes.reset();
+        db_ntp1AddressOutputs.reset();
+        db_ntp1Tokens.reset();
+        db_ntp1TokenHolders.reset();
     }
 };
 
@@ -84,14 +92,21 @@ public:
 
     boost::optional<std::string> read(IDB::Index dbindex, const std::string& key, std::size_t offset,
                                       const boost::optional<std::size_t>& size) const override;
+    bool readView(IDB::Index dbindex, const std::string& key, const ValueViewFunc& func,
+                  std::size_t offset, const boost::optional<std::size_t>& size) const override;
+    bool readBatch(IDB::Index dbindex, const std::vector<std::string>& keys,
+                   const BatchValueViewFunc& func) const override;
     boost::optional<std::vector<std::string>> readMultiple(IDB::Index         dbindex,
                                                            const std::string& key) const override;
     boost::optional<std::map<std::string, std::vector<std::string>>>
                                                         readAll(IDB::Index dbindex) const override;
     boost::optional<std::map<std::string, std::string>> readAllUnique(IDB::Index dbindex) const override;
+    boost::optional<std::map<std::string, std::string>>
+         readAllUniqueWithPrefix(IDB::Index dbindex, const std::string& keyPrefix) const override;
     bool write(IDB::Index dbindex, const std::string& key, const std::string& value) override;
     bool erase(IDB::Index dbindex, const std::string& key) override;
     bool eraseAll(IDB::Index dbindex, const std::string& key) override;
+    bool clear(IDB::Index dbindex) override;
     bool exists(IDB::Index dbindex, const std::string& key) const override;
     bool beginDBTransaction(std::size_t expectedDataSize) override;
     bool commitDBTransaction() override;
@@ -1,12 +1,28 @@
 #include "globals.h"
 
+#include "bestchainstate.h"
+#include "blockindexcatalog.h"
+#include "checkqueue.h"
+#include "script.h"
+#include "stakemodifiercache.h"
+#include "txindexwritecache.h"
 #include "txmempool.h"
 
+BestChainState bestChain;
+
 CTxMemPool mempool;
 
 // BlockIndexMapType   mapBlockIndex;
 boost::shared_ptr<CBlockIndex> pindexGenesisBlock = nullptr;
 
+BlockIndexCatalog blockIndexCatalog;
+
+TxIndexWriteCache txIndexWriteCache;
+
+StakeModifierCache stakeModifierCache(100000);
+
+CCheckQueue<CScriptCheck> scriptCheckQueue(128);
+
 boost::atomic_int64_t nTimeLastBestBlockReceived{0};
 
 boost::atomic<uint32_t> nTransactionsUpdated{0};
@@ -13,11 +13,19 @@
 class CTxMemPool;
 class CBlockIndex;
 class BestChainState;
+class BlockIndexCatalog;
+class CScriptCheck;
+class StakeModifierCache;
+class TxIndexWriteCache;
+
+template <typename T>
+class CCheckQueue;
 
 // using CBlockIndexSmartPtr      = boost::shared_ptr<CBlockIndex>;
 // using ConstCBlockIndexSmartPtr = boost::shared_ptr<const CBlockIndex>;
 using BlockIndexMapType = ThreadSafeMap<uint256, CBlockIndex>;
 
+/** Snapshot of the tip of the main chain, kept in sync by CTxDB */
 extern BestChainState bestChain;
 
 extern CTxMemPool mempool;
@@ -26,6 +34,17 @@ extern CCriticalSection cs_main;
 // extern BlockIndexMapType   mapBlockIndex;
 extern boost::shared_ptr<CBlockIndex> pindexGenesisBlock;
 
+extern BlockIndexCatalog blockIndexCatalog;
+
+/** Tx index changes that are not written to the database yet (see -dbcache) */
+extern TxIndexWriteCache txIndexWriteCache;
+
+/** Kernel stake modifiers by the hash of the block of the staked coin (see GetKernelStakeModifier()) */
+extern StakeModifierCache stakeModifierCache;
+
+/** Queue of the script checks of the block being connected, verified in parallel (see -par) */
+extern CCheckQueue<CScriptCheck> scriptCheckQueue;
+
 extern boost::atomic_int64_t nTimeLastBestBlockReceived;
 
 extern boost::atomic<uint256> nBestInvalidTrust;
@@ -52,6 +71,24 @@ static const int64_t MIN_RELAY_TX_FEE = MIN_TX_FEE;
 /** Threshold for nLockTime: below this value it is interpreted as block number, otherwise as UNIX
  * timestamp. */
 static const unsigned int LOCKTIME_THRESHOLD = 500000000; // Tue Nov  5 00:53:20 1985 UTC
+/** Maximum number of script-checking threads allowed, including the thread connecting the block */
+static const int MAX_SCRIPTCHECK_THREADS = 16;
+/** -par default (number of script-checking threads, 0 = auto) */
+static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
+/** Maximum number of threads searching for a stake kernel, including the staking thread */
+static const int MAX_STAKE_THREADS = 16;
+/** -stakethreads default (number of threads searching for a stake kernel, 0 = auto) */
+static const int DEFAULT_STAKE_THREADS = 1;
+/** Maximum number of threads reading and matching blocks in a wallet rescan */
+static const int MAX_RESCAN_THREADS = 16;
+/** -rescanthreads default (number of threads reading blocks in a wallet rescan, 0 = auto) */
+static const int DEFAULT_RESCAN_THREADS = 0;
+/** -maxsigcachemb default, the memory of the signature cache in megabytes */
+static const int64_t DEFAULT_MAX_SIG_CACHE_SIZE = 32;
+/** Maximum of -maxsigcachemb, in megabytes */
+static const int64_t MAX_MAX_SIG_CACHE_SIZE = 16384;
+/** Maximum of the deprecated -maxsigcachesize, which is a number of signatures (about 41 MB) */
+static const int64_t MAX_LEGACY_SIG_CACHE_ENTRIES = 1000000;
 /** Maximum length of reject messages. */
 static const unsigned int MAX_REJECT_MESSAGE_LENGTH = 111;
 /** Maximum length of the user agent string in `version` message */
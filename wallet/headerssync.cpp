@@ -0,0 +1,453 @@
+#include "headerssync.h"
+
+#include "bignum.h"
+#include "blockindex.h"
+#include "chainparams.h"
+#include "checkpoints.h"
+#include "itxdb.h"
+#include "main.h"
+#include "util.h"
+
+#include <algorithm>
+#include <boost/thread/lock_guard.hpp>
+
+constexpr std::size_t HeadersSync::MaxHeadersPerMessage;
+constexpr int         HeadersSync::WindowSize;
+constexpr int         HeadersSync::MaxBlocksInFlightPerPeer;
+constexpr int64_t     HeadersSync::HeadersTimeout;
+constexpr int64_t     HeadersSync::BlockDownloadTimeout;
+constexpr int64_t     HeadersSync::WindowStallTimeout;
+constexpr int         HeadersSync::MaxBlockFetchFailures;
+
+std::atomic<bool> HeadersSync::Enabled{true};
+
+HeadersSync& HeadersSync::Global()
+{
+    static HeadersSync sync;
+    return sync;
+}
+
+void HeadersSync::releaseRequest_unsafe(const uint256& hash)
+{
+    const auto it = inFlight.find(hash);
+    if (it == inFlight.end()) {
+        return;
+    }
+    const auto peerIt = inFlightPerPeer.find(it->second.nodeid);
+    if (peerIt != inFlightPerPeer.end() && --peerIt->second <= 0) {
+        inFlightPerPeer.erase(peerIt);
+    }
+    inFlight.erase(it);
+}
+
+void HeadersSync::countFetchFailure_unsafe(const uint256& hash)
+{
+    if (++fetchFailures[hash] >= MaxBlockFetchFailures) {
+        unfetchable = true;
+    }
+}
+
+void HeadersSync::releasePeer_unsafe(int64_t nodeid)
+{
+    for (auto it = inFlight.begin(); it != inFlight.end();) {
+        if (it->second.nodeid == nodeid) {
+            it = inFlight.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    inFlightPerPeer.erase(nodeid);
+}
+
+void HeadersSync::popFront_unsafe()
+{
+    releaseRequest_unsafe(headers.front());
+    heights.erase(headers.front());
+    fetchFailures.erase(headers.front());
+    received.erase(firstHeight);
+    headers.pop_front();
+    firstHeight++;
+}
+
+void HeadersSync::reset_unsafe()
+{
+    syncPeer           = boost::none;
+    headersPeer        = boost::none;
+    headersRequestTime = 0;
+    headersDone        = false;
+    headers.clear();
+    firstHeight = 0;
+    heights.clear();
+    recentTimes.clear();
+    inFlight.clear();
+    inFlightPerPeer.clear();
+    fetchFailures.clear();
+    unfetchable = false;
+    peerBackoffUntil.clear();
+    peerMaxHeight.clear();
+    received.clear();
+}
+
+boost::optional<int64_t> HeadersSync::rejectHeadersPeer_unsafe()
+{
+    const boost::optional<int64_t> peer = headersPeer;
+    if (peer) {
+        rejectedSyncPeers.insert(*peer);
+    }
+    reset_unsafe();
+    return peer;
+}
+
+bool HeadersSync::requestHeaders(int64_t nodeid, int64_t now)
+{
+    boost::lock_guard<boost::mutex> lg(mtx);
+    if (syncPeer && *syncPeer != nodeid) {
+        return false;
+    }
+    if (!syncPeer && rejectedSyncPeers.count(nodeid)) {
+        return false;
+    }
+    if (!syncPeer) {
+        headersDone = false;
+    }
+    syncPeer           = nodeid;
+    headersRequestTime = now;
+    return true;
+}
+
+boost::optional<uint256> HeadersSync::lastHeaderHash() const
+{
+    boost::lock_guard<boost::mutex> lg(mtx);
+    if (headers.empty()) {
+        return boost::none;
+    }
+    return headers.back();
+}
+
+bool HeadersSync::checkHeader_unsafe(int64_t nodeid, const CBlock& header, const uint256& hash,
+                                     int height, int64_t now) const
+{
+    if (!Checkpoints::CheckHardened(height, hash)) {
+        NLog.write(b_sev::warn,
+                   "Headers sync: header {} of peer={} at height {} breaks a checkpoint",
+                   hash.ToString(), nodeid, height);
+        return false;
+    }
+
+    // whether a block is proof-of-work or proof-of-stake is in its txs, so the proof can't be checked
+    // before the checkpoints; after the last proof-of-work block, the target is a proof-of-stake one
+    const CBigNum& limit = height > Params().LastPoWBlock()
+                               ? Params().PoSLimit()
+                               : std::max(Params().PoWLimit(), Params().PoSLimit());
+    CBigNum target;
+    target.SetCompact(header.nBits);
+    if (target <= 0 || target > limit) {
+        NLog.write(b_sev::warn, "Headers sync: header {} of peer={} has a target out of range",
+                   hash.ToString(), nodeid);
+        return false;
+    }
+
+    if (header.GetBlockTime() > FutureDrift(now)) {
+        NLog.write(b_sev::warn, "Headers sync: header {} of peer={} is too far in the future",
+                   hash.ToString(), nodeid);
+        return false;
+    }
+    if (!recentTimes.empty()) {
+        std::vector<int64_t> times(recentTimes.cbegin(), recentTimes.cend());
+        std::sort(times.begin(), times.end());
+        if (header.GetBlockTime() <= times[times.size() / 2]) {
+            NLog.write(b_sev::warn,
+                       "Headers sync: header {} of peer={} is before the median time past",
+                       hash.ToString(), nodeid);
+            return false;
+        }
+    }
+    return true;
+}
+
+HeadersSync::HeadersResult HeadersSync::acceptHeaders(int64_t                    nodeid,
+                                                      const std::vector<CBlock>& newHeaders,
+                                                      const ITxDB& txdb, int64_t now)
+{
+    boost::lock_guard<boost::mutex> lg(mtx);
+    if (!syncPeer || *syncPeer != nodeid) {
+        return HeadersResult::Unrequested;
+    }
+    headersRequestTime = 0;
+
+    for (const CBlock& header : newHeaders) {
+        const uint256 hash = header.GetHash();
+
+        int height;
+        if (headers.empty()) {
+            // the headers of the blocks we have come before the new ones
+            if (txdb.ReadBlockIndex(hash)) {
+                continue;
+            }
+            boost::optional<CBlockIndex> prev = txdb.ReadBlockIndex(header.hashPrevBlock);
+            if (!prev) {
+                syncPeer = boost::none;
+                return HeadersResult::Unconnected;
+            }
+            height      = prev->nHeight + 1;
+            firstHeight = height;
+
+            // the times of the blocks before the header chain
+            recentTimes.clear();
+            for (int i = 0; prev && i < CBlockIndex::nMedianTimeSpan; i++) {
+                recentTimes.push_front(prev->GetBlockTime());
+                prev = prev->getPrev(txdb);
+            }
+        } else if (header.hashPrevBlock == headers.back()) {
+            height = firstHeight + static_cast<int>(headers.size());
+        } else if (heights.count(hash)) {
+            // a header that we have already, which happens if the peer was asked twice
+            continue;
+        } else {
+            syncPeer = boost::none;
+            return HeadersResult::Unconnected;
+        }
+
+        if (!checkHeader_unsafe(nodeid, header, hash, height, now)) {
+            reset_unsafe();
+            return HeadersResult::Invalid;
+        }
+
+        headers.push_back(hash);
+        heights[hash] = height;
+        recentTimes.push_back(header.GetBlockTime());
+        while (recentTimes.size() > static_cast<std::size_t>(CBlockIndex::nMedianTimeSpan)) {
+            recentTimes.pop_front();
+        }
+        headersPeer = nodeid;
+    }
+
+    headersDone = newHeaders.size() < MaxHeadersPerMessage;
+    return HeadersResult::Accepted;
+}
+
+std::vector<uint256> HeadersSync::blocksToRequest(int64_t nodeid, int peerHeight, int64_t now)
+{
+    boost::lock_guard<boost::mutex> lg(mtx);
+
+    std::vector<uint256> result;
+
+    {
+        const auto it = peerBackoffUntil.find(nodeid);
+        if (it != peerBackoffUntil.end()) {
+            if (now < it->second) {
+                return result;
+            }
+            peerBackoffUntil.erase(it);
+        }
+    }
+    {
+        const auto it = peerMaxHeight.find(nodeid);
+        if (it != peerMaxHeight.end()) {
+            peerHeight = std::min(peerHeight, it->second);
+        }
+    }
+
+    const int end = std::min({firstHeight + WindowSize, firstHeight + static_cast<int>(headers.size()),
+                              peerHeight + 1});
+    int       inFlightCount = 0;
+    {
+        const auto it = inFlightPerPeer.find(nodeid);
+        if (it != inFlightPerPeer.end()) {
+            inFlightCount = it->second;
+        }
+    }
+    for (int height = firstHeight; height < end && inFlightCount < MaxBlocksInFlightPerPeer; height++) {
+        const uint256& hash = headers[height - firstHeight];
+        if (received.count(height) || inFlight.count(hash)) {
+            continue;
+        }
+        inFlight[hash] = BlockRequest{nodeid, now};
+        inFlightCount++;
+        result.push_back(hash);
+    }
+    if (inFlightCount > 0) {
+        inFlightPerPeer[nodeid] = inFlightCount;
+    }
+    return result;
+}
+
+bool HeadersSync::takeBlock(int64_t nodeid, const uint256& hash, const CBlock& block)
+{
+    boost::lock_guard<boost::mutex> lg(mtx);
+
+    const auto it = heights.find(hash);
+    if (it == heights.end() || it->second >= firstHeight + WindowSize) {
+        return false;
+    }
+    const int height = it->second;
+
+    // whoever it was requested from, it's not in flight anymore
+    releaseRequest_unsafe(hash);
+    if (!received.count(height)) {
+        if (fDebugNet) {
+            NLog.write(b_sev::debug, "Headers sync: block {} at height {} received from peer={}",
+                       hash.ToString(), height, nodeid);
+        }
+        received.emplace(height, ReceivedBlock{nodeid, block});
+    }
+    return true;
+}
+
+boost::optional<HeadersSync::ReceivedBlock> HeadersSync::popNextBlock(const ITxDB& txdb)
+{
+    boost::lock_guard<boost::mutex> lg(mtx);
+
+    while (!headers.empty()) {
+        // a block that came through the normal relay, which may have arrived here as well
+        if (txdb.ReadBlockIndex(headers.front())) {
+            popFront_unsafe();
+            continue;
+        }
+        const auto it = received.find(firstHeight);
+        if (it == received.end()) {
+            break;
+        }
+        ReceivedBlock block = std::move(it->second);
+        popFront_unsafe();
+        return block;
+    }
+    return boost::none;
+}
+
+boost::optional<int64_t> HeadersSync::blockFailed()
+{
+    boost::lock_guard<boost::mutex> lg(mtx);
+    return rejectHeadersPeer_unsafe();
+}
+
+bool HeadersSync::timeOutBlockRequests(int64_t nodeid, int64_t now)
+{
+    boost::lock_guard<boost::mutex> lg(mtx);
+
+    if (!inFlightPerPeer.count(nodeid)) {
+        return false;
+    }
+
+    const bool windowBlocked = received.size() >= static_cast<std::size_t>(WindowSize / 2);
+
+    std::vector<uint256> timedOut;
+    for (const auto& p : inFlight) {
+        if (p.second.nodeid != nodeid) {
+            continue;
+        }
+        const bool blocksWindow = windowBlocked && !headers.empty() && p.first == headers.front();
+        if (now - p.second.time > (blocksWindow ? WindowStallTimeout : BlockDownloadTimeout)) {
+            timedOut.push_back(p.first);
+        }
+    }
+    if (timedOut.empty()) {
+        return false;
+    }
+    // the peer may just be slow, or may not have the blocks, which is blamed on the headers only if the
+    // other peers don't have them either
+    for (const uint256& hash : timedOut) {
+        countFetchFailure_unsafe(hash);
+    }
+    releasePeer_unsafe(nodeid);
+    peerBackoffUntil[nodeid] = now + BlockDownloadTimeout;
+    return true;
+}
+
+bool HeadersSync::blockNotFound(int64_t nodeid, const uint256& hash)
+{
+    boost::lock_guard<boost::mutex> lg(mtx);
+
+    const auto it = inFlight.find(hash);
+    if (it == inFlight.end() || it->second.nodeid != nodeid) {
+        return false;
+    }
+    releaseRequest_unsafe(hash);
+    countFetchFailure_unsafe(hash);
+
+    // the peer doesn't have the blocks of the header chain from this one on
+    const int height = heights.at(hash);
+    const auto limitIt = peerMaxHeight.find(nodeid);
+    if (limitIt == peerMaxHeight.end() || limitIt->second >= height) {
+        peerMaxHeight[nodeid] = height - 1;
+    }
+    return true;
+}
+
+boost::optional<int64_t> HeadersSync::takeUnfetchableHeadersPeer()
+{
+    boost::lock_guard<boost::mutex> lg(mtx);
+
+    if (!unfetchable) {
+        return boost::none;
+    }
+    return rejectHeadersPeer_unsafe();
+}
+
+bool HeadersSync::timeOutHeadersRequest(int64_t nodeid, int64_t now)
+{
+    boost::lock_guard<boost::mutex> lg(mtx);
+
+    if (!syncPeer || *syncPeer != nodeid || headersRequestTime == 0 ||
+        now - headersRequestTime <= HeadersTimeout) {
+        return false;
+    }
+    syncPeer           = boost::none;
+    headersRequestTime = 0;
+    return true;
+}
+
+void HeadersSync::peerDisconnected(int64_t nodeid)
+{
+    boost::lock_guard<boost::mutex> lg(mtx);
+    releasePeer_unsafe(nodeid);
+    rejectedSyncPeers.erase(nodeid);
+    peerBackoffUntil.erase(nodeid);
+    peerMaxHeight.erase(nodeid);
+    if (syncPeer && *syncPeer == nodeid) {
+        syncPeer           = boost::none;
+        headersRequestTime = 0;
+    }
+}
+
+bool HeadersSync::isActive() const
+{
+    boost::lock_guard<boost::mutex> lg(mtx);
+    return syncPeer.is_initialized() || !headers.empty();
+}
+
+bool HeadersSync::isCompleteWith(int64_t nodeid) const
+{
+    boost::lock_guard<boost::mutex> lg(mtx);
+    return syncPeer && *syncPeer == nodeid && headersDone && headers.empty();
+}
+
+void HeadersSync::reset()
+{
+    boost::lock_guard<boost::mutex> lg(mtx);
+    reset_unsafe();
+}
+
+boost::optional<int64_t> HeadersSync::getSyncPeer() const
+{
+    boost::lock_guard<boost::mutex> lg(mtx);
+    return syncPeer;
+}
+
+int HeadersSync::headersHeight() const
+{
+    boost::lock_guard<boost::mutex> lg(mtx);
+    return headers.empty() ? -1 : firstHeight + static_cast<int>(headers.size()) - 1;
+}
+
+std::size_t HeadersSync::blocksInFlight() const
+{
+    boost::lock_guard<boost::mutex> lg(mtx);
+    return inFlight.size();
+}
+
+std::size_t HeadersSync::blocksWaiting() const
+{
+    boost::lock_guard<boost::mutex> lg(mtx);
+    return received.size();
+}
@@ -0,0 +1,199 @@
+#ifndef HEADERSSYNC_H
+#define HEADERSSYNC_H
+
+#include "block.h"
+#include "uint256.h"
+#include <atomic>
+#include <boost/optional.hpp>
+#include <boost/thread/mutex.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+class ITxDB;
+
+/**
+ * @brief The HeadersSync class drives the headers-first block download (-headersfirst).
+ *
+ * The chain of headers after the blocks we have is downloaded first, with getheaders, from one peer
+ * (the sync peer). The blocks of that chain are then requested from all the peers that may have them, in
+ * a window that starts at the next block to connect, with a limit of blocks in flight per peer. Blocks
+ * arrive in any order and are held until the blocks before them are connected, so they're never
+ * orphans. A peer that doesn't deliver a block in time, or says it doesn't have it (notfound), gets its
+ * requests given to other peers and isn't asked for a while, or for blocks after that one.
+ *
+ * The headers of a proof-of-stake chain can't be fully validated without the blocks, so the header
+ * chain is only a download schedule: it has to connect to a block we have, match the checkpoints, have
+ * a target within the limits and timestamps after the median of the previous blocks and not too far in
+ * the future. Every block is still fully validated when it's connected. A header chain whose blocks
+ * can't be downloaded from anyone, or whose block fails to connect, is blamed on the peer that sent it:
+ * the sync starts over, and that peer isn't used as the sync peer again. A block that fails is blamed
+ * on the peer that sent it as well.
+ *
+ * Node ids and times (in seconds) are given by the caller; all the functions are thread-safe.
+ */
+class HeadersSync
+{
+public:
+    /// the most headers that a getheaders response has; fewer means the peer has no more
+    static constexpr std::size_t MaxHeadersPerMessage = 2000;
+    /// the blocks after the next one to connect that can be requested
+    static constexpr int WindowSize = 1024;
+    static constexpr int MaxBlocksInFlightPerPeer = 16;
+    /// seconds to wait for headers before the sync peer is dropped
+    static constexpr int64_t HeadersTimeout = 2 * 60;
+    /// seconds to wait for a block
+    static constexpr int64_t BlockDownloadTimeout = 60;
+    /// seconds to wait for the next block to connect, while half the window waits for it
+    static constexpr int64_t WindowStallTimeout = 10;
+    /// the failed requests of a block after which the headers are blamed for it
+    static constexpr int MaxBlockFetchFailures = 3;
+
+    enum class HeadersResult
+    {
+        Accepted,
+        // the headers aren't from the sync peer
+        Unrequested,
+        // the headers don't connect to the header chain, or to a block we have
+        Unconnected,
+        // the headers break a checkpoint, have a bad target or a bad timestamp; the sync is reset
+        Invalid,
+    };
+
+    /// a block of the header chain, and the peer that sent it
+    struct ReceivedBlock
+    {
+        int64_t nodeid;
+        CBlock  block;
+    };
+
+private:
+    struct BlockRequest
+    {
+        int64_t nodeid;
+        int64_t time;
+    };
+
+    mutable boost::mutex mtx;
+
+    boost::optional<int64_t> syncPeer;
+    // the peer that sent the last headers, which is blamed if their blocks can't be downloaded
+    boost::optional<int64_t> headersPeer;
+    // the peers that sent headers whose blocks couldn't be downloaded
+    std::set<int64_t> rejectedSyncPeers;
+    // when the headers were requested from the sync peer, or 0 if they were received
+    int64_t headersRequestTime = 0;
+    // true after a response with fewer than MaxHeadersPerMessage headers
+    bool headersDone = false;
+
+    // the hashes of the headers from the next block to connect, which is at height firstHeight
+    std::deque<uint256>              headers;
+    int                              firstHeight = 0;
+    std::unordered_map<uint256, int> heights;
+    // the times of the last blocks of the header chain, for the median time past of the next header
+    std::deque<int64_t> recentTimes;
+
+    std::unordered_map<uint256, BlockRequest> inFlight;
+    std::map<int64_t, int>                    inFlightPerPeer;
+    std::unordered_map<uint256, int>          fetchFailures;
+    // true if a block failed MaxBlockFetchFailures times
+    bool unfetchable = false;
+    // the time until which a peer whose requests timed out isn't asked for blocks
+    std::map<int64_t, int64_t> peerBackoffUntil;
+    // the heights after which peers said they don't have the blocks of the header chain
+    std::map<int64_t, int> peerMaxHeight;
+    // the blocks that arrived and wait for the blocks before them, by height
+    std::map<int, ReceivedBlock> received;
+
+    void releaseRequest_unsafe(const uint256& hash);
+    void countFetchFailure_unsafe(const uint256& hash);
+    bool checkHeader_unsafe(int64_t nodeid, const CBlock& header, const uint256& hash, int height,
+                            int64_t now) const;
+    void releasePeer_unsafe(int64_t nodeid);
+    void popFront_unsafe();
+    void reset_unsafe();
+    boost::optional<int64_t> rejectHeadersPeer_unsafe();
+
+public:
+    /// true if the headers-first sync is used (-headersfirst)
+    static std::atomic<bool> Enabled;
+
+    /// the sync that's used by the node
+    static HeadersSync& Global();
+
+    HeadersSync() = default;
+
+    HeadersSync(const HeadersSync&) = delete;
+    HeadersSync& operator=(const HeadersSync&) = delete;
+
+    /**
+     * true if the headers can be requested from the peer, which is the case if it's the sync peer, or
+     * if there's no sync peer and the peer's headers weren't rejected, in which case it becomes the sync
+     * peer
+     */
+    bool requestHeaders(int64_t nodeid, int64_t now);
+
+    /// the hash of the last header, from which the next headers are requested
+    boost::optional<uint256> lastHeaderHash() const;
+
+    HeadersResult acceptHeaders(int64_t nodeid, const std::vector<CBlock>& newHeaders, const ITxDB& txdb,
+                                int64_t now);
+
+    /// picks the blocks to request from the peer, whose best block is at peerHeight, and marks them;
+    /// a peer that's backing off, or said it doesn't have a block, isn't asked for it
+    std::vector<uint256> blocksToRequest(int64_t nodeid, int peerHeight, int64_t now);
+
+    /// takes the block if it's in the window of the header chain; false if the sync doesn't need it
+    bool takeBlock(int64_t nodeid, const uint256& hash, const CBlock& block);
+
+    /// the next block to connect, if it arrived; the blocks that were connected otherwise are skipped,
+    /// even if they arrived
+    boost::optional<ReceivedBlock> popNextBlock(const ITxDB& txdb);
+
+    /**
+     * the last block returned by popNextBlock() failed to connect: resets the sync and returns the peer
+     * that sent the headers, which won't be the sync peer again
+     */
+    boost::optional<int64_t> blockFailed();
+
+    /**
+     * releases the requests of the peer and returns true if one of them timed out; the peer isn't asked
+     * for blocks for BlockDownloadTimeout seconds
+     */
+    bool timeOutBlockRequests(int64_t nodeid, int64_t now);
+
+    /// releases the request of the block from the peer, which doesn't have it; false if not requested
+    bool blockNotFound(int64_t nodeid, const uint256& hash);
+
+    /**
+     * if a block of the header chain can't be downloaded, resets the sync and returns the peer that
+     * sent its header, which won't be the sync peer again
+     */
+    boost::optional<int64_t> takeUnfetchableHeadersPeer();
+
+    /// drops the peer as the sync peer, and returns true, if it didn't send the headers in time
+    bool timeOutHeadersRequest(int64_t nodeid, int64_t now);
+
+    void peerDisconnected(int64_t nodeid);
+
+    /// true while headers are being downloaded or blocks of the header chain aren't connected
+    bool isActive() const;
+
+    /// true if the peer is the sync peer and all its headers were received and connected
+    bool isCompleteWith(int64_t nodeid) const;
+
+    /// drops the header chain, the requests and the blocks that arrived, and the sync peer
+    void reset();
+
+    boost::optional<int64_t> getSyncPeer() const;
+    /// the height of the last header, or -1 if there are no headers to connect
+    int         headersHeight() const;
+    std::size_t blocksInFlight() const;
+    std::size_t blocksWaiting() const;
+};
+
+#endif // HEADERSSYNC_H
@@ -5,10 +5,14 @@
 #include "init.h"
 #include "bitcoinrpc.h"
 #include "checkpoints.h"
+#include "checkqueue.h"
 #include "globals.h"
+#include "headerssync.h"
 #include "logging/defaultlogger.h"
 #include "main.h"
 #include "net.h"
+#include "ntp1/ntp1index.h"
+#include "sigcache.h"
 #include "stringmanip.h"
 #include "txdb.h"
 #include "ui_interface.h"
@@ -28,6 +32,9 @@
 using namespace std;
 using namespace boost;
 
+/** file descriptors reserved for everything other than the peer connections (databases, logs, rpc) */
+static const int MIN_CORE_FILEDESCRIPTORS = 150;
+
 std::shared_ptr<CWallet> pwalletMain;
 CClientUIInterface       uiInterface;
 bool                     fConfChange;
@@ -117,6 +124,10 @@ void Shutdown()
         //        CTxDB().Close();
         FlushDBWalletTransient(false);
         StopNode();
+        scriptCheckQueue.StopWorkerThreads();
+        if (!txIndexWriteCache.empty() && !CTxDB().FlushTxIndexWriteCache()) {
+            NLog.write(b_sev::err, "Failed to flush the tx index write cache on shutdown");
+        }
         FlushDBWalletTransient(true);
         boost::filesystem::remove(GetPidFile());
         UnregisterWallet(pwalletMain);
@@ -320,7 +331,10 @@ std::string HelpMessage()
         "  -pid=<file>            " + _("Specify pid file (default: nebliod.pid)") + "\n" +
         "  -datadir=<dir>         " + _("Specify data directory") + "\n" +
         "  -wallet=<dir>          " + _("Specify wallet file (within data directory)") + "\n" +
-        "  -dbcache=<n>           " + _("Set database cache size in megabytes (default: 25)") + "\n" +
+        "  -dbcache=<n>           " + _("Set database cache size in megabytes, which also limits the transaction index cache during the initial sync (default: 25)") + "\n" +
+        "  -par=<n>               " + _("Set the number of script verification threads (up to 16, 0 = auto, <0 = leave that many cores free, default: 0)") + "\n" +
+        "  -maxsigcachemb=<n>     " + _("Limit the cache of verified signatures to <n> megabytes (default: 32). It replaces the deprecated -maxsigcachesize, a number of signatures, which is converted to megabytes when it's given alone, and is ignored otherwise") + "\n" +
+        "  -ntp1index             " + _("Maintain an index of the NTP1 tokens of every address, and the supply and holders of every token, for the getntp1addressbalances and getntp1tokeninfo RPCs (default: 0)") + "\n" +
         "  -maxorphanblocks=<n>   " + _("Keep at most <n> unconnectable blocks in memory (default: 750)") + "\n" +
         "  -maxorphantx=<n>       " + _("Keep at most <n> unconnectable transactions in memory (default: 100)") + "\n" +
         "  -dblogsize=<n>         " + _("Set database disk log size in megabytes (default: 100)") + "\n" +
@@ -341,6 +355,8 @@ std::string HelpMessage()
         "  -bind=<addr>           " + _("Bind to given address. Use [host]:port notation for IPv6") + "\n" +
         "  -dnsseed               " + _("Find peers using DNS lookup (default: 1)") + "\n" +
         "  -staking               " + _("Stake your coins to support network and gain reward (default: 1)") + "\n" +
+        "  -stakethreads=<n>      " + _("Set the number of threads searching for stake kernels (up to 16, 0 = auto, <0 = leave that many cores free, default: 1)") + "\n" +
+        "  -headersfirst          " + _("Download the block headers first when syncing, then the blocks from many peers at once (default: 1)") + "\n" +
         "  -synctime              " + _("Sync time with other nodes. Disable if time on your system is precise e.g. syncing with NTP (default: 1)") + "\n" +
         "  -cppolicy              " + _("Sync checkpoints policy (default: strict)") + "\n" +
         "  -banscore=<n>          " + _("Threshold for disconnecting misbehaving peers (default: 100)") + "\n" +
@@ -391,6 +407,7 @@ std::string HelpMessage()
         "  -upgradewallet         " + _("Upgrade wallet to latest format") + "\n" +
         "  -keypool=<n>           " + _("Set key pool size to <n> (default: 100)") + "\n" +
         "  -rescan                " + _("Rescan the block chain for missing wallet transactions") + "\n" +
+        "  -rescanthreads=<n>     " + _("Set the number of threads reading blocks in wallet rescans (up to 16, 0 = auto, <0 = leave that many cores free, default: 0)") + "\n" +
         "  -salvagewallet         " + _("Attempt to recover private keys from a corrupt wallet.dat") + "\n" +
         "  -checkblocks=<n>       " + _("How many blocks to check at startup (default: 2500, 0 = all)") + "\n" +
         "  -checklevel=<n>        " + _("How thorough the block verification is (0-6, default: 1)") + "\n" +
@@ -524,6 +541,43 @@ bool AppInit2()
         SoftSetBoolArg("-rescan", true);
     }
 
+    if (mapArgs.exists("-maxsigcachesize")) {
+        // the deprecated number of signatures is converted to megabytes, so that -maxsigcachemb is the
+        // only limit of the signature cache; it's ignored when -maxsigcachemb is given too
+        if (mapArgs.exists("-maxsigcachemb")) {
+            InitWarning(_("Warning: -maxsigcachesize is deprecated and ignored, since -maxsigcachemb is "
+                          "given."));
+        } else {
+            const int64_t nEntries = std::min(std::max<int64_t>(GetArg("-maxsigcachesize", 0), 0),
+                                              MAX_LEGACY_SIG_CACHE_ENTRIES);
+            const int64_t nSizeMB =
+                (SignatureCache::SizeForEntries(static_cast<std::size_t>(nEntries)) + (1 << 20) - 1) >>
+                20;
+            NLog.write(b_sev::warn,
+                       "-maxsigcachesize is deprecated, use -maxsigcachemb; caching up to {} signatures "
+                       "with -maxsigcachemb={}",
+                       nEntries, nSizeMB);
+            SoftSetArg("-maxsigcachemb", std::to_string(nSizeMB));
+        }
+    }
+
+#ifndef WIN32
+    // Make sure enough file descriptors are available for the connections. Without epoll, the socket
+    // handler uses select(), which can't handle sockets beyond FD_SETSIZE
+    int nMaxConnections = static_cast<int>(GetArg("-maxconnections", 125));
+#ifndef __linux__
+    nMaxConnections = std::min(nMaxConnections, static_cast<int>(FD_SETSIZE) - MIN_CORE_FILEDESCRIPTORS);
+#endif
+    const int nFD = RaiseFileDescriptorLimit(nMaxConnections + MIN_CORE_FILEDESCRIPTORS);
+    nMaxConnections = std::max(std::min(nMaxConnections, nFD - MIN_CORE_FILEDESCRIPTORS), 0);
+    if (nMaxConnections < GetArg("-maxconnections", 125)) {
+        InitWarning(fmt::format(_("Warning: Reducing -maxconnections from {} to {}, because of system "
+                                  "limitations."),
+                                GetArg("-maxconnections", 125), nMaxConnections));
+        mapArgs.set("-maxconnections", std::to_string(nMaxConnections));
+    }
+#endif
+
     // ********************************************************* Step 3: parameter-to-internal-flags
 
     fDebug = GetBoolArg("-debug");
@@ -534,6 +588,8 @@ bool AppInit2()
     else
         fDebugNet = GetBoolArg("-debugnet");
 
+    HeadersSync::Enabled = GetBoolArg("-headersfirst", true);
+
 #if !defined(WIN32) && !defined(QT_GUI)
     fDaemon = GetBoolArg("-daemon");
 #else
@@ -559,6 +615,28 @@ bool AppInit2()
             nConnectTimeout = nNewTimeout;
     }
 
+    // -par=0 means autodetect, and a negative value leaves that many cores free; at the end,
+    // nScriptCheckThreads == 0 means no concurrency
+    int nScriptCheckThreads = static_cast<int>(GetArg("-par", DEFAULT_SCRIPTCHECK_THREADS));
+    if (nScriptCheckThreads <= 0)
+        nScriptCheckThreads += static_cast<int>(boost::thread::hardware_concurrency());
+    if (nScriptCheckThreads <= 1)
+        nScriptCheckThreads = 0;
+    else if (nScriptCheckThreads > MAX_SCRIPTCHECK_THREADS)
+        nScriptCheckThreads = MAX_SCRIPTCHECK_THREADS;
+
+    // -stakethreads works like -par, except that the staking thread is always there
+    int nStakeThreads = static_cast<int>(GetArg("-stakethreads", DEFAULT_STAKE_THREADS));
+    if (nStakeThreads <= 0)
+        nStakeThreads += static_cast<int>(boost::thread::hardware_concurrency());
+    nStakeThreads = std::max(1, std::min(nStakeThreads, MAX_STAKE_THREADS));
+    stakeMaker.setKernelSearchThreads(nStakeThreads);
+
+    // -dbcache is also the limit of the tx index write cache used during the initial sync
+    const int64_t nDBCacheMB = GetArg("-dbcache", 25);
+    txIndexWriteCache.setMaxMemoryUsage(
+        nDBCacheMB > 0 ? static_cast<std::size_t>(nDBCacheMB) * static_cast<std::size_t>(ONE_MB) : 0);
+
     const boost::optional<std::string> payTxFee = mapArgs.get("-paytxfee");
     if (payTxFee) {
         if (!ParseMoney(*payTxFee, nTransactionFee))
@@ -650,6 +728,11 @@ bool AppInit2()
     if (fDaemon)
         std::cout << "neblio server starting" << std::endl;
 
+    // the thread connecting a block verifies scripts too, so it's not counted in the workers
+    if (nScriptCheckThreads > 0) {
+        scriptCheckQueue.StartWorkerThreads(nScriptCheckThreads - 1);
+    }
+
     int64_t nStart;
 
     // ********************************************************* Step 5: verify database integrity
@@ -878,6 +961,15 @@ bool AppInit2()
     }
     NLog.write(b_sev::info, " block index {} ms", GetTimeMillis() - nStart);
 
+    NTP1Index::Enabled = GetBoolArg("-ntp1index", false);
+    if (!PrepareNTP1Index()) {
+        return InitError(_("Error preparing the NTP1 index; check the log"));
+    }
+    if (fRequestShutdown) {
+        NLog.write(b_sev::info, "Shutdown requested. Exiting.");
+        return false;
+    }
+
     if (GetBoolArg("-printblockindex") || GetBoolArg("-printblocktree")) {
         PrintBlockTree();
         return false;
@@ -975,6 +1067,13 @@ bool AppInit2()
 
     RegisterWallet(pwalletMain);
 
+    // -rescanthreads works like -par
+    int nRescanThreads = static_cast<int>(GetArg("-rescanthreads", DEFAULT_RESCAN_THREADS));
+    if (nRescanThreads <= 0)
+        nRescanThreads += static_cast<int>(boost::thread::hardware_concurrency());
+    nRescanThreads = std::max(1, std::min(nRescanThreads, MAX_RESCAN_THREADS));
+    pwalletMain->SetRescanThreads(nRescanThreads);
+
     const CTxDB txdb;
 
     boost::optional<CBlockIndex> pindexRescan = txdb.GetBestBlockIndex();
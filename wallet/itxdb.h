@@ -3,6 +3,8 @@
 
 #include "blockmetadata.h"
 #include <boost/optional.hpp>
+#include <cstddef>
+#include <functional>
 #include <string>
 #include <vector>
 
@@ -16,17 +18,32 @@ class COutPoint;
 class CBlock;
 class CBigNum;
 class CBlockIndex;
+struct NTP1IndexedOutput;
+struct NTP1IndexedToken;
+struct NTP1IndexedHolding;
 
 class ITxDB
 {
 public:
+    /// a function that gets a view of a value in the db; the view is valid only inside the function
+    using BytesViewFunc = std::function<bool(const char* data, std::size_t size)>;
+
     virtual ~ITxDB() = default;
 
     virtual bool WriteVersion(int nVersion)                                                         = 0;
     virtual bool ReadTxIndex(const uint256& hash, CTxIndex& txindex) const                          = 0;
+    /// reads many tx index entries at once; txindices has an element per hash, none if not found
+    virtual bool ReadTxIndexBatch(const std::vector<uint256>&             hashes,
+                                  std::vector<boost::optional<CTxIndex>>& txindices) const          = 0;
     virtual bool UpdateTxIndex(const uint256& hash, const CTxIndex& txindex)                        = 0;
     virtual bool ReadTx(const CDiskTxPos& txPos, CTransaction& tx) const                            = 0;
+    /// reads many txs at once; txs has an element per position, none if not found
+    virtual bool ReadTxBatch(const std::vector<CDiskTxPos>&              txPositions,
+                             std::vector<boost::optional<CTransaction>>& txs) const                 = 0;
     virtual bool ReadNTP1Tx(const uint256& hash, NTP1Transaction& ntp1tx) const                     = 0;
+    /// reads many NTP1 txs at once; ntp1txs has an element per hash, none if not found
+    virtual bool ReadNTP1TxBatch(const std::vector<uint256>&                    hashes,
+                                 std::vector<boost::optional<NTP1Transaction>>& ntp1txs) const      = 0;
     virtual bool WriteNTP1Tx(const uint256& hash, const NTP1Transaction& ntp1tx)                    = 0;
     virtual bool ReadAllIssuanceTxs(std::vector<uint256>& txs) const                                = 0;
     virtual bool ReadNTP1TxsWithTokenSymbol(std::string tokenName, std::vector<uint256>& txs) const = 0;
@@ -44,6 +61,8 @@ public:
     virtual bool ReadDiskTx(const COutPoint& outpoint, CTransaction& tx) const                      = 0;
     virtual bool ReadBlock(const uint256& hash, CBlock& blk, bool fReadTransactions = true) const   = 0;
     virtual bool WriteBlock(const uint256& hash, const CBlock& blk)                                 = 0;
+    /// calls func with the serialized block, as it's sent to peers, without deserializing it
+    virtual bool ReadBlockBytes(const uint256& hash, const BytesViewFunc& func) const               = 0;
     virtual boost::optional<CBlockIndex> ReadBlockIndex(const uint256& blockHash) const             = 0;
     virtual bool                         WriteBlockIndex(const CBlockIndex& blockindex)             = 0;
     virtual boost::optional<uint256>     ReadBlockHashOfHeight(int32_t height) const                = 0;
@@ -59,6 +78,21 @@ public:
     virtual bool WriteStakeSeen(const std::pair<COutPoint, unsigned int>& stake)                    = 0;
     virtual boost::optional<bool>
                                  WasStakeSeen(const std::pair<COutPoint, unsigned int>& stake) const = 0;
+    /// the unspent outputs of an address that have NTP1 tokens; only with -ntp1index
+    virtual bool ReadNTP1AddressOutputs(const std::string&              address,
+                                        std::vector<NTP1IndexedOutput>& outputs) const               = 0;
+    virtual bool WriteNTP1AddressOutput(const std::string& address, const NTP1IndexedOutput& output) = 0;
+    virtual bool EraseNTP1AddressOutput(const std::string& address, const COutPoint& outpoint)       = 0;
+    virtual boost::optional<NTP1IndexedToken> ReadNTP1IndexedToken(const std::string& tokenId) const = 0;
+    virtual bool WriteNTP1IndexedToken(const NTP1IndexedToken& token)                                = 0;
+    virtual bool EraseNTP1IndexedToken(const std::string& tokenId)                                   = 0;
+    virtual boost::optional<NTP1IndexedHolding>
+                 ReadNTP1TokenHolding(const std::string& tokenId, const std::string& address) const = 0;
+    virtual bool WriteNTP1TokenHolding(const NTP1IndexedHolding& holding)                           = 0;
+    virtual bool EraseNTP1TokenHolding(const std::string& tokenId, const std::string& address)      = 0;
+    /// the block up to which the NTP1 index has the main chain; zero if the index has to be rebuilt
+    virtual uint256 ReadNTP1IndexBestBlock() const                                                   = 0;
+    virtual bool    WriteNTP1IndexBestBlock(const uint256& blockHash)                                = 0;
     virtual bool                 LoadBlockIndex()                                                    = 0;
     virtual boost::optional<int> GetBestChainHeight() const                                          = 0;
     virtual boost::optional<uint256>     GetBestChainTrust() const                                   = 0;
@@ -6,6 +6,7 @@
 #include "block.h"
 #include "chainparams.h"
 #include "main.h"
+#include "stakemodifiercache.h"
 #include "txdb.h"
 
 using namespace std;
@@ -227,10 +228,19 @@ bool ComputeNextStakeModifier(const ITxDB& txdb, const CBlockIndex* const pindex
 
 // The stake modifier used to hash for a stake kernel is chosen as the stake
 // modifier about a selection interval later than the coin generating the kernel
-static bool GetKernelStakeModifier(const ITxDB& txdb, uint256 hashBlockFrom, uint64_t& nStakeModifier,
-                                   int& nStakeModifierHeight, int64_t& nStakeModifierTime,
-                                   bool fPrintProofOfStake)
+bool GetKernelStakeModifier(const ITxDB& txdb, uint256 hashBlockFrom, uint64_t& nStakeModifier,
+                            int& nStakeModifierHeight, int64_t& nStakeModifierTime,
+                            bool fPrintProofOfStake)
 {
+    // the walk below is done once per block, not once per staked coin and per try
+    if (const boost::optional<StakeModifierCache::Entry> cached =
+            stakeModifierCache.get(hashBlockFrom, txdb)) {
+        nStakeModifier       = cached->nStakeModifier;
+        nStakeModifierHeight = cached->nStakeModifierHeight;
+        nStakeModifierTime   = cached->nStakeModifierTime;
+        return true;
+    }
+
     nStakeModifier = 0;
     const auto bi  = txdb.ReadBlockIndex(hashBlockFrom);
     if (!bi)
@@ -266,9 +276,42 @@ static bool GetKernelStakeModifier(const ITxDB& txdb, uint256 hashBlockFrom, uin
         }
     }
     nStakeModifier = pindex->nStakeModifier;
+
+    StakeModifierCache::Entry entry;
+    entry.nStakeModifier       = nStakeModifier;
+    entry.nStakeModifierHeight = nStakeModifierHeight;
+    entry.nStakeModifierTime   = nStakeModifierTime;
+    entry.lastBlockHash        = pindex->GetBlockHash();
+    entry.lastBlockHeight      = pindex->nHeight;
+    stakeModifierCache.add(hashBlockFrom, entry);
+
     return true;
 }
 
+StakeKernelHashInput MakeStakeKernelHashInput(uint64_t nStakeModifier, unsigned int nTimeBlockFrom,
+                                              unsigned int nTxPrevOffset, unsigned int nTimeTxPrev,
+                                              unsigned int nPrevout)
+{
+    CDataStream ss(SER_GETHASH, 0);
+    ss << nStakeModifier << nTimeBlockFrom << nTxPrevOffset << nTimeTxPrev << nPrevout;
+
+    StakeKernelHashInput result;
+    assert(ss.size() + 4 == result.size());
+    std::copy(ss.begin(), ss.end(), result.begin());
+    std::fill(result.end() - 4, result.end(), 0);
+    return result;
+}
+
+uint256 StakeKernelHash(StakeKernelHashInput& input, unsigned int nTimeTx)
+{
+    // little endian, as it's serialized
+    input[24] = static_cast<unsigned char>(nTimeTx);
+    input[25] = static_cast<unsigned char>(nTimeTx >> 8);
+    input[26] = static_cast<unsigned char>(nTimeTx >> 16);
+    input[27] = static_cast<unsigned char>(nTimeTx >> 24);
+    return Hash(input.cbegin(), input.cend());
+}
+
 // ppcoin kernel protocol
 // coinstake must meet hash target according to the protocol:
 // kernel (input 0) must meet the formula
@@ -316,18 +359,17 @@ bool CheckStakeKernelHash(const ITxDB& txdb, unsigned int nBits, const CBlock& b
     targetProofOfStake = (bnCoinDayWeight * bnTargetPerCoinDay).getuint256();
 
     // Calculate hash
-    CDataStream ss(SER_GETHASH, 0);
-    uint64_t    nStakeModifier       = 0;
-    int         nStakeModifierHeight = 0;
-    int64_t     nStakeModifierTime   = 0;
+    uint64_t nStakeModifier       = 0;
+    int      nStakeModifierHeight = 0;
+    int64_t  nStakeModifierTime   = 0;
 
     if (!GetKernelStakeModifier(txdb, blockFromHash, nStakeModifier, nStakeModifierHeight,
                                 nStakeModifierTime, fPrintProofOfStake))
         return false;
-    ss << nStakeModifier;
 
-    ss << nTimeBlockFrom << nTxPrevOffset << txPrev.nTime << prevout.n << nTimeTx;
-    hashProofOfStake = Hash(ss.begin(), ss.end());
+    StakeKernelHashInput hashInput =
+        MakeStakeKernelHashInput(nStakeModifier, nTimeBlockFrom, nTxPrevOffset, txPrev.nTime, prevout.n);
+    hashProofOfStake = StakeKernelHash(hashInput, nTimeTx);
     if (fDebug && fPrintProofOfStake) {
         const auto bi = txdb.ReadBlockIndex(blockFromHash);
         NLog.write(b_sev::info,
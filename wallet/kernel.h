@@ -5,6 +5,7 @@
 #define PPCOIN_KERNEL_H
 
 #include "transaction.h"
+#include <array>
 #include <cstdint>
 
 class CBlock;
@@ -18,6 +19,22 @@ static const int MODIFIER_INTERVAL_RATIO = 3;
 bool ComputeNextStakeModifier(const ITxDB& txdb, const CBlockIndex* const pindexPrev,
                               uint64_t& nStakeModifier, bool& fGeneratedStakeModifier);
 
+// The serialized input of the kernel hash (see CheckStakeKernelHash()), of which only the last 4 bytes
+// (the time of the coinstake) change while searching for a kernel
+using StakeKernelHashInput = std::array<unsigned char, 28>;
+
+StakeKernelHashInput MakeStakeKernelHashInput(uint64_t nStakeModifier, unsigned int nTimeBlockFrom,
+                                              unsigned int nTxPrevOffset, unsigned int nTimeTxPrev,
+                                              unsigned int nPrevout);
+
+// Sets the time of the coinstake in the input and returns the kernel hash
+uint256 StakeKernelHash(StakeKernelHashInput& input, unsigned int nTimeTx);
+
+// Get the stake modifier of the kernel of a coin from the given block
+bool GetKernelStakeModifier(const ITxDB& txdb, uint256 hashBlockFrom, uint64_t& nStakeModifier,
+                            int& nStakeModifierHeight, int64_t& nStakeModifierTime,
+                            bool fPrintProofOfStake);
+
 // Check whether stake kernel meets hash target
 // Sets hashProofOfStake on success return
 bool CheckStakeKernelHash(const ITxDB& txdb, unsigned int nBits, const CBlock& blockFrom,
@@ -632,7 +632,11 @@ bool CKey::SetCompactSignature(uint256 hash, const std::vector<unsigned char>& v
     return false;
 }
 
-bool CKey::Verify(uint256 hash, const std::vector<unsigned char>& vchSigParam)
+namespace {
+
+// Parses a DER signature; returns nullptr if it's invalid. The returned signature must be freed with
+// ECDSA_SIG_free()
+ECDSA_SIG* ParseECDSASignature(const std::vector<unsigned char>& vchSigParam)
 {
     // https://lists.linuxfoundation.org/pipermail/bitcoin-dev/2015-July/009697.html
     std::vector<unsigned char> vchSig(vchSigParam.begin(), vchSigParam.end());
@@ -640,37 +644,75 @@ bool CKey::Verify(uint256 hash, const std::vector<unsigned char>& vchSigParam)
         unsigned char nLengthBytes = vchSig[1] & 0x7f;
 
         if (vchSig.size() < (unsigned)2 + nLengthBytes)
-            return false;
+            return nullptr;
 
         if (nLengthBytes > 4) {
             unsigned char nExtraBytes = nLengthBytes - 4;
             for (unsigned char i = 0; i < nExtraBytes; i++)
                 if (vchSig[2 + i])
-                    return false;
+                    return nullptr;
             vchSig.erase(vchSig.begin() + (unsigned)2, vchSig.begin() + 2 + nExtraBytes);
             vchSig[1] = 0x80 | (nLengthBytes - nExtraBytes);
         }
     }
 
     if (vchSig.empty())
-        return false;
+        return nullptr;
 
-    // New versions of OpenSSL will reject non-canonical DER signatures. de/re-serialize first.
-    unsigned char*       norm_der = NULL;
-    ECDSA_SIG*           norm_sig = ECDSA_SIG_new();
-    const unsigned char* sigptr   = &vchSig[0];
-    assert(norm_sig);
-    if (d2i_ECDSA_SIG(&norm_sig, &sigptr, vchSig.size()) == NULL) {
+    ECDSA_SIG*           sig    = ECDSA_SIG_new();
+    const unsigned char* sigptr = &vchSig[0];
+    assert(sig);
+    if (d2i_ECDSA_SIG(&sig, &sigptr, vchSig.size()) == NULL) {
         /* As of OpenSSL 1.0.0p d2i_ECDSA_SIG frees and nulls the pointer on
          * error. But OpenSSL's own use of this function redundantly frees the
          * result. As ECDSA_SIG_free(NULL) is a no-op, and in the absence of a
          * clear contract for the function behaving the same way is more
          * conservative.
          */
-        ECDSA_SIG_free(norm_sig);
-        return false;
+        ECDSA_SIG_free(sig);
+        return nullptr;
     }
-    int derlen = i2d_ECDSA_SIG(norm_sig, &norm_der);
+    return sig;
+}
+
+// The key that VerifyWithPubKey() loads public keys into. Creating an EC_KEY creates the curve with it,
+// which is expensive, so every thread creates one only once, with the multiples of the generator
+// precomputed, and reuses it for all its verifications
+class ThreadVerificationKey
+{
+    EC_KEY* pkey;
+
+public:
+    ThreadVerificationKey() : pkey(EC_KEY_new_by_curve_name(NID_secp256k1))
+    {
+        if (pkey != NULL && !EC_KEY_precompute_mult(pkey, NULL)) {
+            NLog.write(b_sev::warn, "EC_KEY_precompute_mult failed; verifications will be slower");
+        }
+    }
+
+    ThreadVerificationKey(const ThreadVerificationKey&) = delete;
+    ThreadVerificationKey& operator=(const ThreadVerificationKey&) = delete;
+
+    ~ThreadVerificationKey()
+    {
+        if (pkey != NULL)
+            EC_KEY_free(pkey);
+    }
+
+    EC_KEY* get() const { return pkey; }
+};
+
+} // namespace
+
+bool CKey::Verify(uint256 hash, const std::vector<unsigned char>& vchSigParam)
+{
+    ECDSA_SIG* norm_sig = ParseECDSASignature(vchSigParam);
+    if (norm_sig == nullptr)
+        return false;
+
+    // New versions of OpenSSL will reject non-canonical DER signatures. de/re-serialize first.
+    unsigned char* norm_der = NULL;
+    int            derlen   = i2d_ECDSA_SIG(norm_sig, &norm_der);
     ECDSA_SIG_free(norm_sig);
     if (derlen <= 0)
         return false;
@@ -681,6 +723,31 @@ bool CKey::Verify(uint256 hash, const std::vector<unsigned char>& vchSigParam)
     return ret;
 }
 
+bool CKey::VerifyWithPubKey(const std::vector<unsigned char>& vchPubKey, const uint256& hash,
+                            const std::vector<unsigned char>& vchSig)
+{
+    static thread_local ThreadVerificationKey verificationKey;
+
+    EC_KEY* pkey = verificationKey.get();
+    if (pkey == NULL || vchPubKey.empty())
+        return false;
+
+    // this replaces the public key that was loaded by the previous verification on this thread
+    const unsigned char* pbegin = &vchPubKey[0];
+    if (!o2i_ECPublicKey(&pkey, &pbegin, vchPubKey.size()))
+        return false;
+
+    ECDSA_SIG* sig = ParseECDSASignature(vchSig);
+    if (sig == nullptr)
+        return false;
+
+    // the signature is already parsed, so there's no need for the DER round trip of Verify() here
+    // -1 = error, 0 = bad sig, 1 = good
+    const bool ret = ECDSA_do_verify((const unsigned char*)&hash, sizeof(hash), sig, pkey) == 1;
+    ECDSA_SIG_free(sig);
+    return ret;
+}
+
 bool CKey::IsValid()
 {
     if (!fSet)
@@ -148,6 +148,12 @@ public:
 
     bool Verify(uint256 hash, const std::vector<unsigned char>& vchSig);
 
+    // verify a signature with a serialized public key, which gives the same result as SetPubKey()
+    // followed by Verify(), without creating a CKey (and with it a new EC_KEY) for every verification.
+    // This is still OpenSSL's verification; libsecp256k1, which is several times faster, isn't used
+    static bool VerifyWithPubKey(const std::vector<unsigned char>& vchPubKey, const uint256& hash,
+                                 const std::vector<unsigned char>& vchSig);
+
     bool IsValid();
 
     // Check whether an element of a signature (r or s) is valid.
@@ -9,10 +9,12 @@
 #include "checkpoints.h"
 #include "db.h"
 #include "disktxpos.h"
+#include "headerssync.h"
 #include "init.h"
 #include "kernel.h"
 #include "merkletx.h"
 #include "net.h"
+#include "ntp1/ntp1index.h"
 #include "ntp1/ntp1script.h"
 #include "ntp1/ntp1script_burn.h"
 #include "ntp1/ntp1script_issuance.h"
@@ -133,6 +135,28 @@ void SetBestChain(const CBlockLocator& loc)
         pwallet->SetBestChain(loc);
 }
 
+// notify wallets about a block that was added to the main chain
+void BlockConnected(const uint256& blockHash, int height)
+{
+    for (const std::shared_ptr<CWallet>& pwallet : setpwalletRegistered)
+        pwallet->BlockConnected(blockHash, height);
+}
+
+// notify wallets about a block that was removed from the main chain
+void BlockDisconnected(const uint256& blockHash)
+{
+    for (const std::shared_ptr<CWallet>& pwallet : setpwalletRegistered)
+        pwallet->BlockDisconnected(blockHash);
+}
+
+std::vector<std::unique_ptr<CWalletDBBatch>> BeginWalletDBBatches()
+{
+    std::vector<std::unique_ptr<CWalletDBBatch>> result;
+    for (const std::shared_ptr<CWallet>& pwallet : setpwalletRegistered)
+        result.push_back(MakeUnique<CWalletDBBatch>(*pwallet, false));
+    return result;
+}
+
 // notify wallets about an updated transaction
 void UpdatedTransaction(const uint256& hashTx)
 {
@@ -1067,7 +1091,7 @@ void AssertIssuanceUniquenessInBlock(
 {
     std::string opRet;
     if (NTP1Transaction::IsTxNTP1(&tx, &opRet)) {
-        auto script = NTP1Script::ParseScript(opRet);
+        auto script = NTP1Script::ParseScriptCached(tx.GetHash(), opRet);
         if (script->getTxType() == NTP1Script::TxType_Issuance) {
             std::vector<std::pair<CTransaction, NTP1Transaction>> inputsTxs =
                 NTP1Transaction::GetAllNTP1InputsOfTx(tx, txdb, false, mapQueuedNTP1Inputs,
@@ -1075,23 +1099,29 @@ void AssertIssuanceUniquenessInBlock(
 
             NTP1Transaction ntp1tx;
             ntp1tx.readNTP1DataFromTx(txdb, tx, inputsTxs);
-            AssertNTP1TokenNameIsNotAlreadyInMainChain(ntp1tx, txdb);
-            if (ntp1tx.getTxType() == NTP1TxType_ISSUANCE) {
-                std::string currSymbol = ntp1tx.getTokenSymbolIfIssuance();
-                // make sure that case doesn't matter by converting to upper case
-                std::transform(currSymbol.begin(), currSymbol.end(), currSymbol.begin(), ::toupper);
-                if (issuedTokensSymbolsInThisBlock.find(currSymbol) !=
-                    issuedTokensSymbolsInThisBlock.end()) {
-                    throw std::runtime_error(
-                        "The token name " + currSymbol +
-                        " already exists in the block: " /* + this->GetHash().ToString()*/);
-                }
-                issuedTokensSymbolsInThisBlock.insert(std::make_pair(currSymbol, ntp1tx.getTxHash()));
-            }
+            AssertIssuanceUniquenessInBlock(issuedTokensSymbolsInThisBlock, txdb, ntp1tx);
         }
     }
 }
 
+void AssertIssuanceUniquenessInBlock(
+    std::unordered_map<std::string, uint256>& issuedTokensSymbolsInThisBlock, const ITxDB& txdb,
+    const NTP1Transaction& ntp1tx)
+{
+    if (ntp1tx.getTxType() != NTP1TxType_ISSUANCE) {
+        return;
+    }
+    AssertNTP1TokenNameIsNotAlreadyInMainChain(ntp1tx, txdb);
+    std::string currSymbol = ntp1tx.getTokenSymbolIfIssuance();
+    // make sure that case doesn't matter by converting to upper case
+    std::transform(currSymbol.begin(), currSymbol.end(), currSymbol.begin(), ::toupper);
+    if (issuedTokensSymbolsInThisBlock.find(currSymbol) != issuedTokensSymbolsInThisBlock.end()) {
+        throw std::runtime_error("The token name " + currSymbol +
+                                 " already exists in the block: " /* + this->GetHash().ToString()*/);
+    }
+    issuedTokensSymbolsInThisBlock.insert(std::make_pair(currSymbol, ntp1tx.getTxHash()));
+}
+
 void static PruneOrphanBlocks()
 {
     static const size_t MAX_SIZE_P =
@@ -1124,11 +1154,18 @@ void static PruneOrphanBlocks()
     mapOrphanBlocks.erase(hash);
 }
 
-void WriteNTP1BlockTransactionsToDisk(const std::vector<CTransaction>& vtx, ITxDB& txdb)
+void WriteNTP1BlockTransactionsToDisk(const std::vector<CTransaction>&                    vtx,
+                                      const std::vector<boost::optional<NTP1Transaction>>& parsedNTP1Txs,
+                                      ITxDB&                                               txdb)
 {
+    assert(parsedNTP1Txs.empty() || parsedNTP1Txs.size() == vtx.size());
     if (Params().PassedFirstValidNTP1Tx(&txdb)) {
-        for (const CTransaction& tx : vtx) {
-            WriteNTP1TxToDiskFromRawTx(tx, txdb);
+        for (unsigned i = 0; i < vtx.size(); i++) {
+            if (!parsedNTP1Txs.empty() && parsedNTP1Txs[i]) {
+                WriteNTP1TxToDbAndDisk(*parsedNTP1Txs[i], txdb);
+            } else {
+                WriteNTP1TxToDiskFromRawTx(vtx[i], txdb);
+            }
         }
     }
 }
@@ -1476,6 +1513,71 @@ bool LoadBlockIndex(bool fAllowNew)
     return true;
 }
 
+bool PrepareNTP1Index()
+{
+    LOCK(cs_main);
+
+    // the index is built in steps of this many blocks, with a db transaction each
+    static const int BLOCKS_PER_TRANSACTION = 1000;
+
+    CTxDB         txdb;
+    const uint256 indexBestBlock = txdb.ReadNTP1IndexBestBlock();
+    if (!NTP1Index::Enabled) {
+        if (indexBestBlock != 0) {
+            NLog.write(b_sev::info, "The NTP1 index is disabled; erasing it...");
+            if (!txdb.ClearNTP1Index())
+                return NLog.error("PrepareNTP1Index() : failed to erase the NTP1 index");
+        }
+        return true;
+    }
+    if (indexBestBlock != 0 && indexBestBlock == txdb.GetBestBlockHash()) {
+        return true;
+    }
+
+    // what's there is from a build that didn't finish, from before the index was disabled, or it
+    // failed to be updated with a block
+    if (!txdb.ClearNTP1Index())
+        return NLog.error("PrepareNTP1Index() : failed to erase the NTP1 index");
+
+    const int bestHeight = txdb.GetBestChainHeight().value_or(0);
+    NLog.write(b_sev::info, "Building the NTP1 index for {} blocks...", bestHeight + 1);
+    for (int height = 0; height <= bestHeight; height += BLOCKS_PER_TRANSACTION) {
+        if (fRequestShutdown) {
+            NLog.write(b_sev::info, "Building the NTP1 index was interrupted at height {}", height);
+            return true;
+        }
+
+        uiInterface.InitMessage(fmt::format(_("Building the NTP1 index... ({}/{})"), height, bestHeight),
+                                static_cast<double>(height) / static_cast<double>(bestHeight + 1));
+
+        if (!txdb.TxnBegin())
+            return NLog.error("PrepareNTP1Index() : TxnBegin failed");
+        const int endHeight = std::min(height + BLOCKS_PER_TRANSACTION - 1, bestHeight);
+        for (int h = height; h <= endHeight; h++) {
+            const boost::optional<uint256> blockHash = txdb.ReadBlockHashOfHeight(h);
+            CBlock                         block;
+            if (!blockHash || !txdb.ReadBlock(*blockHash, block)) {
+                txdb.TxnAbort();
+                return NLog.error("PrepareNTP1Index() : failed to read the block at height {}", h);
+            }
+            if (!NTP1Index::ConnectBlockTxs(txdb, block.vtx, {})) {
+                txdb.TxnAbort();
+                return NLog.error("PrepareNTP1Index() : failed to index the block at height {}", h);
+            }
+        }
+        const boost::optional<uint256> endBlockHash = txdb.ReadBlockHashOfHeight(endHeight);
+        if (!endBlockHash || !txdb.WriteNTP1IndexBestBlock(*endBlockHash)) {
+            txdb.TxnAbort();
+            return NLog.error("PrepareNTP1Index() : failed to write the best block of the NTP1 index");
+        }
+        if (!txdb.TxnCommit())
+            return NLog.error("PrepareNTP1Index() : TxnCommit failed");
+    }
+    NLog.write(b_sev::info, "Done building the NTP1 index");
+
+    return true;
+}
+
 void PrintBlockTree()
 {
     AssertLockHeld(cs_main);
@@ -1716,6 +1818,138 @@ bool static AlreadyHave(const CTxDB& txdb, const CInv& inv)
     return true;
 }
 
+// asks the peer for the headers after the last header of the headers-first sync, or after our best
+// block if there are no headers to connect
+void static PushGetHeaders(CNode* pnode, const ITxDB& txdb)
+{
+    const boost::optional<CBlockIndex> best = txdb.GetBestBlockIndex();
+    const CBlockLocator                bestLocator(&*best, txdb);
+    std::vector<uint256>               haves;
+    if (const boost::optional<uint256> lastHeader = HeadersSync::Global().lastHeaderHash()) {
+        haves.push_back(*lastHeader);
+    }
+    haves.insert(haves.end(), bestLocator.GetHashes().cbegin(), bestLocator.GetHashes().cend());
+    pnode->PushMessage("getheaders", CBlockLocator(haves), uint256(0));
+}
+
+// connects the blocks of the headers-first sync that can be connected, in order
+void static ConnectHeadersSyncBlocks()
+{
+    AssertLockHeld(cs_main);
+    HeadersSync& headersSync = HeadersSync::Global();
+    while (true) {
+        boost::optional<HeadersSync::ReceivedBlock> received;
+        {
+            const CTxDB txdb;
+            received = headersSync.popNextBlock(txdb);
+        }
+        if (!received) {
+            break;
+        }
+        CBlock&       block = received->block;
+        const uint256 hash  = block.GetHash();
+        // it came through the normal relay too, and is connected from there
+        if (mapOrphanBlocks.count(hash)) {
+            continue;
+        }
+
+        // the peer that sent the block is blamed if it fails, like for a relayed block
+        CNode* pfrom = nullptr;
+        {
+            LOCK(cs_vNodes);
+            pfrom = FindNode(received->nodeid);
+            if (pfrom)
+                pfrom->AddRef();
+        }
+        const bool processed = ProcessBlock(pfrom, &block);
+        if (pfrom) {
+            if (!processed && block.reject) {
+                pfrom->PushMessage("reject", std::string("block"), block.reject->chRejectCode,
+                                   block.reject->strRejectReason, block.reject->hashBlock);
+            }
+            if (block.nDoS) {
+                pfrom->Misbehaving(block.nDoS);
+            }
+            pfrom->Release();
+        }
+
+        if (!processed) {
+            // and so are the headers, or the same block would be downloaded and fail again
+            const boost::optional<int64_t> headersPeer = headersSync.blockFailed();
+            NLog.write(b_sev::err,
+                       "Headers sync: block {} of peer={} failed; the sync starts over without the "
+                       "headers of peer={}",
+                       hash.ToString(), received->nodeid, headersPeer.value_or(-1));
+            break;
+        }
+    }
+}
+
+// the headers-first sync with a peer: timeouts, the start of the sync and the block requests
+void static SendHeadersSyncMessages(CNode* pto, const ITxDB& txdb)
+{
+    HeadersSync&  headersSync = HeadersSync::Global();
+    const int64_t now         = GetTime();
+
+    if (headersSync.timeOutHeadersRequest(pto->nodeid, now)) {
+        // the peer may not serve headers; the blocks are asked for the old way
+        NLog.write(b_sev::info, "Headers sync: peer={} didn't send headers in time", pto->nodeid);
+        const boost::optional<CBlockIndex> best = txdb.GetBestBlockIndex();
+        pto->PushGetBlocks(&*best, uint256(0));
+        return;
+    }
+    if (const boost::optional<int64_t> blamed = headersSync.takeUnfetchableHeadersPeer()) {
+        // the header chain is fake or a stale fork; peers aren't blamed for not having its blocks
+        NLog.write(b_sev::warn,
+                   "Headers sync: the blocks of the headers of peer={} can't be downloaded; the sync "
+                   "starts over with another peer",
+                   *blamed);
+    }
+    if (headersSync.timeOutBlockRequests(pto->nodeid, now)) {
+        NLog.write(b_sev::info, "Headers sync: peer={} didn't send blocks in time; they're requested "
+                                "from other peers",
+                   pto->nodeid);
+    }
+    if (headersSync.isCompleteWith(pto->nodeid)) {
+        // blocks found during the sync are asked for the old way, as every block after the sync is
+        NLog.write(b_sev::info, "Headers sync: done at height {}",
+                   txdb.GetBestChainHeight().value_or(0));
+        headersSync.reset();
+        const boost::optional<CBlockIndex> best = txdb.GetBestBlockIndex();
+        pto->PushGetBlocks(&*best, uint256(0));
+        return;
+    }
+
+    if (pto->fClient || pto->fOneShot || fImporting || !pto->fSuccessfullyConnected) {
+        return;
+    }
+
+    const int bestHeight = txdb.GetBestChainHeight().value_or(0);
+    if (!headersSync.getSyncPeer() && pto->nStartingHeight > bestHeight &&
+        IsInitialBlockDownload(txdb) && headersSync.requestHeaders(pto->nodeid, now)) {
+        NLog.write(b_sev::info, "Headers sync: downloading headers from peer={}, at height {}",
+                   pto->nodeid, pto->nStartingHeight);
+        PushGetHeaders(pto, txdb);
+    }
+
+    // the sync peer has all the headers it sent; the others have the blocks up to the height they had
+    // when they connected
+    const int peerHeight = headersSync.getSyncPeer() == boost::make_optional(pto->nodeid)
+                               ? std::numeric_limits<int>::max()
+                               : pto->nStartingHeight;
+
+    vector<CInv> vGetData;
+    for (const uint256& hash : headersSync.blocksToRequest(pto->nodeid, peerHeight, now)) {
+        vGetData.push_back(CInv(MSG_BLOCK, hash));
+    }
+    if (!vGetData.empty()) {
+        if (fDebugNet)
+            NLog.write(b_sev::debug, "Headers sync: requesting {} blocks from peer={}", vGetData.size(),
+                       pto->nodeid);
+        pto->PushMessage("getdata", vGetData);
+    }
+}
+
 bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
 {
     static map<CService, CPubKey> mapReuseKey;
@@ -1817,12 +2051,14 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
         // Ask the first connected node for block updates
         // For regtest, we need to sync immediately after connection; this is important for tests that
         // split and reconnect the network
+        // With the headers-first sync, the initial download starts from SendMessages() instead
         CTxDB      txdb;
         static int nAskedForBlocks = 0;
+        const bool headersFirst    = HeadersSync::Enabled && IsInitialBlockDownload(txdb);
         if ((!pfrom->fClient && !pfrom->fOneShot && !fImporting) &&
             (((pfrom->nStartingHeight > (txdb.GetBestChainHeight().value_or(0) - 144)) &&
               (pfrom->nVersion < NOBLKS_VERSION_START || pfrom->nVersion >= NOBLKS_VERSION_END) &&
-              (nAskedForBlocks < 1 || vNodes.size() <= 1)) ||
+              (nAskedForBlocks < 1 || vNodes.size() <= 1) && !headersFirst) ||
              Params().NetType() == NetworkType::Regtest)) {
             nAskedForBlocks++;
             const boost::optional<CBlockIndex> best = txdb.GetBestBlockIndex();
@@ -1930,6 +2166,7 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
             }
         }
         const CTxDB txdb;
+        const bool  headersSyncActive = HeadersSync::Enabled && HeadersSync::Global().isActive();
         for (unsigned int nInv = 0; nInv < vInv.size(); nInv++) {
             const CInv& inv = vInv[nInv];
 
@@ -1937,6 +2174,10 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
                 return true;
             pfrom->AddInventoryKnown(inv);
 
+            // while the headers-first sync runs, the blocks come from its header chain
+            if (headersSyncActive && inv.type == MSG_BLOCK)
+                continue;
+
             {
                 bool fAlreadyHave = AlreadyHave(txdb, inv);
                 if (fDebug)
@@ -1982,6 +2223,8 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
         if (fDebugNet || (vInv.size() != 1))
             NLog.write(b_sev::debug, "received getdata ({} invsz)", vInv.size());
 
+        // the blocks we don't have, so that the peer can ask someone else right away
+        vector<CInv> vNotFound;
         for (const CInv& inv : vInv) {
             if (fShutdown)
                 return true;
@@ -1992,12 +2235,20 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
                 // Send block from disk
                 auto mi = txdb.ReadBlockIndex(inv.hash);
                 if (mi) {
-                    CBlock block;
-                    block.ReadFromDisk(&*mi, txdb);
-                    if (inv.type == MSG_BLOCK)
-                        pfrom->PushMessage("block", block);
-                    else // MSG_FILTERED_BLOCK)
+                    if (inv.type == MSG_BLOCK) {
+                        // the block is sent as it's stored, without deserializing and serializing it
+                        const bool pushed = txdb.ReadBlockBytes(
+                            inv.hash, [pfrom](const char* data, std::size_t size) {
+                                pfrom->PushMessageBytes("block", data, size);
+                                return true;
+                            });
+                        if (!pushed)
+                            NLog.write(b_sev::err, "getdata: failed to read block {}",
+                                       inv.hash.ToString());
+                    } else // MSG_FILTERED_BLOCK)
                     {
+                        CBlock block;
+                        block.ReadFromDisk(&*mi, txdb);
                         LOCK(pfrom->cs_filter);
                         if (pfrom->pfilter) {
                             CMerkleBlock merkleBlock(block, *pfrom->pfilter);
@@ -2030,6 +2281,8 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
                         pfrom->PushMessage("inv", vInvP);
                         pfrom->hashContinue = 0;
                     }
+                } else if (inv.type == MSG_BLOCK) {
+                    vNotFound.push_back(inv);
                 }
             } else if (inv.IsKnownType()) {
                 // Send stream from relay memory
@@ -2056,6 +2309,24 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
             // Track requests for our stuff
             Inventory(inv.hash);
         }
+        if (!vNotFound.empty())
+            pfrom->PushMessage("notfound", vNotFound);
+    }
+
+    else if (strCommand == "notfound") {
+        vector<CInv> vInv;
+        vRecv >> vInv;
+        if (vInv.size() > MAX_INV_SZ) {
+            pfrom->Misbehaving(20);
+            return NLog.error("message notfound size() = {}", vInv.size());
+        }
+        if (HeadersSync::Enabled) {
+            HeadersSync& headersSync = HeadersSync::Global();
+            for (const CInv& inv : vInv) {
+                if (inv.type == MSG_BLOCK && headersSync.blockNotFound(pfrom->nodeid, inv.hash))
+                    mapAlreadyAskedFor.erase(inv);
+            }
+        }
     }
 
     else if (strCommand == "getblocks") {
@@ -2149,6 +2420,40 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
         pfrom->PushMessage("headers", vHeaders);
     }
 
+    else if (strCommand == "headers") {
+        vector<CBlock> vHeaders;
+        vRecv >> vHeaders;
+        if (vHeaders.size() > HeadersSync::MaxHeadersPerMessage) {
+            pfrom->Misbehaving(20);
+            return NLog.error("message headers size() = {}", vHeaders.size());
+        }
+        if (!HeadersSync::Enabled)
+            return true;
+
+        const CTxDB                      txdb;
+        HeadersSync&                     headersSync = HeadersSync::Global();
+        const HeadersSync::HeadersResult result =
+            headersSync.acceptHeaders(pfrom->nodeid, vHeaders, txdb, GetAdjustedTime());
+        switch (result) {
+        case HeadersSync::HeadersResult::Accepted:
+            NLog.write(b_sev::info, "Headers sync: {} headers from peer={}, up to height {}",
+                       vHeaders.size(), pfrom->nodeid, headersSync.headersHeight());
+            if (vHeaders.size() == HeadersSync::MaxHeadersPerMessage &&
+                headersSync.requestHeaders(pfrom->nodeid, GetTime()))
+                PushGetHeaders(pfrom, txdb);
+            break;
+        case HeadersSync::HeadersResult::Unrequested:
+            break;
+        case HeadersSync::HeadersResult::Unconnected:
+            NLog.write(b_sev::info, "Headers sync: the headers of peer={} don't connect to ours",
+                       pfrom->nodeid);
+            break;
+        case HeadersSync::HeadersResult::Invalid:
+            pfrom->Misbehaving(20);
+            return NLog.error("Headers sync: invalid headers from peer={}", pfrom->nodeid);
+        }
+    }
+
     else if (strCommand == "tx") {
         vector<uint256> vWorkQueue;
         vector<uint256> vEraseQueue;
@@ -2229,7 +2534,11 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
         CInv inv(MSG_BLOCK, hashBlock);
         pfrom->AddInventoryKnown(inv);
 
-        if (ProcessBlock(pfrom, &block)) {
+        if (HeadersSync::Enabled && HeadersSync::Global().takeBlock(pfrom->nodeid, hashBlock, block)) {
+            // it's connected when the blocks before it are
+            mapAlreadyAskedFor.erase(inv);
+            ConnectHeadersSyncBlocks();
+        } else if (ProcessBlock(pfrom, &block)) {
             mapAlreadyAskedFor.erase(inv);
         } else if (block.reject) {
             pfrom->PushMessage("reject", std::string("block"), block.reject->chRejectCode,
@@ -2589,6 +2898,12 @@ bool SendMessages(CNode* pto, bool fSendTrickle)
         }
         if (!vGetData.empty())
             pto->PushMessage("getdata", vGetData);
+
+        //
+        // Message: getheaders, getdata (headers-first sync)
+        //
+        if (HeadersSync::Enabled)
+            SendHeadersSyncMessages(pto, txdb);
     }
     return true;
 }
@@ -43,6 +43,7 @@ enum GraphTraverseType
 };
 
 class CWallet;
+class CWalletDBBatch;
 class CBlock;
 class CBlockIndex;
 class CKeyItem;
@@ -99,6 +100,8 @@ void         SyncWithWallets(const ITxDB& txdb, const CTransaction& tx, const CB
 bool         ProcessBlock(CNode* pfrom, CBlock* pblock);
 bool         CheckDiskSpace(uintmax_t nAdditionalBytes = 0);
 bool         LoadBlockIndex(bool fAllowNew = true);
+/// builds the NTP1 index from the main chain if it's enabled and not built, or erases it if disabled
+bool         PrepareNTP1Index();
 void         PrintBlockTree();
 bool         ProcessMessages(CNode* pfrom);
 bool         SendMessages(CNode* pto, bool fSendTrickle);
@@ -118,7 +121,11 @@ void        StakeMiner(std::shared_ptr<CWallet> pwallet);
 void        ResendWalletTransactions(bool fForce = false);
 
 void SetBestChain(const CBlockLocator& loc);
+void BlockConnected(const uint256& blockHash, int height);
+void BlockDisconnected(const uint256& blockHash);
 void UpdatedTransaction(const uint256& hashTx);
+/// groups the database writes of the calling thread to every wallet, until the batches are destroyed
+std::vector<std::unique_ptr<CWalletDBBatch>> BeginWalletDBBatches();
 
 /** given a neblio tx, get the corresponding NTP1 tx */
 void FetchNTP1TxFromDisk(std::pair<CTransaction, NTP1Transaction>& txPair, const ITxDB& txdb,
@@ -133,7 +140,19 @@ void AssertIssuanceUniquenessInBlock(
     const std::map<uint256, std::vector<std::pair<CTransaction, NTP1Transaction>>>& mapQueuedNTP1Inputs,
     const std::map<uint256, CTxIndex>&                                              queuedAcceptedTxs);
 
-void WriteNTP1BlockTransactionsToDisk(const std::vector<CTransaction>& vtx, ITxDB& txdb);
+/// the same, for an NTP1 transaction that's parsed already
+void AssertIssuanceUniquenessInBlock(
+    std::unordered_map<std::string, uint256>& issuedTokensSymbolsInThisBlock, const ITxDB& txdb,
+    const NTP1Transaction& ntp1tx);
+
+/**
+ * writes the NTP1 data of the transactions of a block; parsedNTP1Txs is either empty or has an element
+ * for every transaction, which is the NTP1 transaction if it was parsed already (by ConnectBlock()), to
+ * avoid fetching its inputs and parsing its script again
+ */
+void WriteNTP1BlockTransactionsToDisk(const std::vector<CTransaction>&                    vtx,
+                                      const std::vector<boost::optional<NTP1Transaction>>& parsedNTP1Txs,
+                                      ITxDB&                                               txdb);
 
 /// create a fake tx position that helps in marking an output as spent
 CDiskTxPos CreateFakeSpentTxPos(const uint256& blockhash);
@@ -1,7 +1,6 @@
 #include "merkletx.h"
 
 #include "block.h"
-#include "blockindexlrucache.h"
 #include "init.h"
 #include "main.h"
 #include "txdb.h"
@@ -34,66 +33,28 @@ static int GetBestBlockHeight(const ITxDB& txdb, const uint256& bestBlockHash)
 
 ////////////////////////////////
 
-using BlockIndexHeightIfMainChainCacheType = BlockIndexLRUCache<boost::optional<int>>;
-
-struct ExtractorFunctor
-{
-    const uint256 bestBlockHash;
-
-    ExtractorFunctor(const uint256& bestBlockHashIn) : bestBlockHash(bestBlockHashIn) {}
-
-    boost::optional<int> operator()(const CBlockIndex& bi)
-    {
-        return bi.IsInMainChain(bestBlockHash) ? boost::make_optional(bi.nHeight) : boost::none;
-    }
-};
-
-static thread_local BlockIndexHeightIfMainChainCacheType
-    blockIndexMainChainCache(2 * pwalletMain->getWalletTxsCount(), ExtractorFunctor(0));
-
-thread_local uint256 cachedBestHash = 0;
 /**
- * @brief GetBlockHeightIfMainChain
- * The BlockIndexLRUCache class is designed to only store values that are constants of blocks. However,
- * we abuse it here and store the "IsMainChain" status. This is valid because we reset the cache
- * whenever the bestBlockHash changed
- *
- * To avoid resetting the cache often, we abuse the system further by checking whether the new
- * bestBlockhash is next block right after the previous block. If that's the case, that just means the
- * IsMainChain state hasn't chained, so we skip resetting the cache.
+ * @brief GetDepthOfBlockIfMainChain
+ * The depth of the block in the main chain of bestBlockHash, or none if it's not in it. The main
+ * chain heights are cached in the wallet, which is updated about connected and disconnected blocks.
  */
-static boost::optional<int> GetBlockHeightIfMainChain(const ITxDB& txdb, const uint256& blockHash,
-                                                      const uint256& bestBlockHash)
+static boost::optional<int> GetDepthOfBlockIfMainChain(const ITxDB& txdb, const uint256& blockHash,
+                                                       const uint256& bestBlockHash)
 {
-    if (cachedBestHash != bestBlockHash) {
-        // read the current best to update the cache
-        const auto bi = txdb.ReadBlockIndex(bestBlockHash);
-        if (!bi) {
-            NLog.write(b_sev::critical,
-                       "CRITICAL ERROR: Failed to read best block index indicated with hash: {}!",
-                       bestBlockHash.ToString());
-            return boost::none;
-        }
-
-        // if the next block is just built upon the last best, then the state of "mainchain" is
-        // unchanged in the cache
-        if (bi->hashPrev != cachedBestHash) {
-            // we clear the cache
-            blockIndexMainChainCache.clear();
-            blockIndexMainChainCache.updateCacheSize(2 * pwalletMain->getWalletTxsCount());
-        }
-        // we just the new best height in the extractor
-        blockIndexMainChainCache.setExtractor(ExtractorFunctor(bestBlockHash));
-        cachedBestHash = bestBlockHash;
+    if (pwalletMain) {
+        return pwalletMain->blockHeights.getDepth(txdb, blockHash, bestBlockHash);
     }
-    const boost::optional<BlockIndexHeightIfMainChainCacheType::BICacheEntry> entry =
-        blockIndexMainChainCache.get(txdb, blockHash);
-    if (!entry) {
+
+    const boost::optional<CBlockIndex> bi = txdb.ReadBlockIndex(blockHash);
+    if (!bi) {
         NLog.write(b_sev::critical, "CRITICAL ERROR: A WalletTx pointed to a non-existing block: {}!",
                    blockHash.ToString());
         return boost::none;
     }
-    return entry->value;
+    if (!bi->IsInMainChain(bestBlockHash)) {
+        return boost::none;
+    }
+    return GetBestBlockHeight(txdb, bestBlockHash) - bi->nHeight + 1;
 }
 
 ////////////////////////////////
@@ -127,10 +88,9 @@ int CMerkleTx::GetDepthInMainChain(const ITxDB& txdb, const uint256& bestBlockHa
         return 0;
     int nResult = 0;
 
-    const boost::optional<int> blockHeight = GetBlockHeightIfMainChain(txdb, hashBlock, bestBlockHash);
-    if (blockHeight) {
-        const int bestHeight = GetBestBlockHeight(txdb, bestBlockHash);
-        nResult              = ((nIndex == -1) ? (-1) : 1) * (bestHeight - *blockHeight + 1);
+    const boost::optional<int> depth = GetDepthOfBlockIfMainChain(txdb, hashBlock, bestBlockHash);
+    if (depth) {
+        nResult = ((nIndex == -1) ? (-1) : 1) * *depth;
     }
 
     return nResult;
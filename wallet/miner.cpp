@@ -343,7 +343,7 @@ std::unique_ptr<CBlock> CreateNewBlock(CWallet* pwallet, bool fProofOfStake, int
             try {
                 std::string opRet;
                 if (NTP1Transaction::IsTxNTP1(&tx, &opRet)) {
-                    auto script = NTP1Script::ParseScript(opRet);
+                    auto script = NTP1Script::ParseScriptCached(tx.GetHash(), opRet);
                     if (script->getTxType() == NTP1Script::TxType_Issuance) {
 
                         inputsTxs = NTP1Transaction::StdFetchedInputTxsToNTP1(
@@ -7,12 +7,25 @@
 #include "addrman.h"
 #include "db.h"
 #include "globals.h"
+#include "headerssync.h"
 #include "init.h"
 #include "main.h"
 #include "ui_interface.h"
 
+#include <atomic>
+#include <boost/scope_exit.hpp>
 #include <chrono>
+#include <functional>
+#include <limits>
 #include <thread>
+#include <unordered_map>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#define USE_EPOLL
+#endif
 
 #ifdef WIN32
 #include <string.h>
@@ -483,6 +496,7 @@ CNode* ConnectNode(CAddress addrConnect, const char* pszDest)
             LOCK(cs_vNodes);
             vNodes.push_back(pnode);
         }
+        WakeSocketHandler();
 
         pnode->nTimeConnected = GetTime();
         return pnode;
@@ -498,6 +512,7 @@ void CNode::CloseSocketDisconnect()
         NLog.write(b_sev::info, "disconnecting node {}", addrName.get());
         closesocket(hSocket);
         hSocket = INVALID_SOCKET;
+        WakeSocketHandler();
 
         // in case this fails, we'll empty the recv buffer when the CNode is deleted
         TRY_LOCK(cs_vRecvMsg, lockRecv);
@@ -721,68 +736,468 @@ void ThreadSocketHandler()
     NLog.write(b_sev::info, "ThreadSocketHandler exited");
 }
 
-void ThreadSocketHandler2()
+/**
+ * Disconnects the nodes that were flagged for it (or that aren't used anymore), and deletes the
+ * disconnected nodes that no thread is using anymore. onDelete is called right before a node is
+ * deleted.
+ */
+static void DisconnectNodes(list<CNode*>&                     vNodesDisconnected,
+                            const std::function<void(CNode*)>& onDelete = nullptr)
 {
-    NLog.write(b_sev::info, "ThreadSocketHandler started");
-    list<CNode*> vNodesDisconnected;
-    unsigned int nPrevNodeCount = 0;
+    LOCK(cs_vNodes);
+    // Disconnect unused nodes
+    vector<CNode*> vNodesCopy = vNodes;
+    BOOST_FOREACH (CNode* pnode, vNodesCopy) {
+        if (pnode->fDisconnect || (pnode->GetRefCount() <= 0 && pnode->vRecvMsg.empty() &&
+                                   pnode->nSendSize == 0 && pnode->ssSend.empty())) {
+            // remove from vNodes
+            vNodes.erase(remove(vNodes.begin(), vNodes.end(), pnode), vNodes.end());
+
+            // release outbound grant (if any)
+            pnode->grantOutbound.Release();
+
+            // close socket and cleanup
+            pnode->CloseSocketDisconnect();
+
+            // the blocks it was asked for by the headers-first sync are asked from other peers
+            HeadersSync::Global().peerDisconnected(pnode->nodeid);
+
+            // hold in disconnected pool until all refs are released
+            if (pnode->fNetworkNode || pnode->fInbound)
+                pnode->Release();
+            vNodesDisconnected.push_back(pnode);
+        }
+    }
+
+    // Delete disconnected nodes
+    list<CNode*> vNodesDisconnectedCopy = vNodesDisconnected;
+    BOOST_FOREACH (CNode* pnode, vNodesDisconnectedCopy) {
+        // wait until threads are done using it
+        if (pnode->GetRefCount() <= 0) {
+            bool fDelete = false;
+            {
+                TRY_LOCK4(pnode->cs_vSend, pnode->cs_vRecvMsg, pnode->cs_mapRequests,
+                          pnode->cs_inventory, lock);
+                if (lock) {
+                    fDelete = true;
+                }
+            }
+            if (fDelete) {
+                vNodesDisconnected.remove(pnode);
+                if (onDelete) {
+                    onDelete(pnode);
+                }
+                delete pnode;
+            }
+        }
+    }
+}
+
+static void NotifyNodeCountChange(unsigned int& nPrevNodeCount)
+{
+    std::size_t vNodesSize = 0;
+    {
+        LOCK(cs_vNodes);
+        vNodesSize = vNodes.size();
+    }
+    if (vNodesSize != nPrevNodeCount) {
+        nPrevNodeCount = vNodesSize;
+        uiInterface.NotifyNumConnectionsChanged(vNodesSize);
+    }
+}
+
+enum class AcceptResult
+{
+    Accepted, // a connection was taken from the queue (even if it was then dropped)
+    WouldBlock,
+    Error,
+};
+
+static AcceptResult AcceptConnection(SOCKET hListenSocket)
+{
+    struct sockaddr_storage sockaddr;
+    socklen_t               len = sizeof(sockaddr);
+    SOCKET   hSocket            = accept(hListenSocket, (struct sockaddr*)&sockaddr, &len);
+    CAddress addr;
+    int      nInbound = 0;
+
+    if (hSocket != INVALID_SOCKET)
+        if (!addr.SetSockAddr((const struct sockaddr*)&sockaddr))
+            NLog.write(b_sev::warn, "Warning: Unknown socket family");
+
+    {
+        LOCK(cs_vNodes);
+        BOOST_FOREACH (CNode* pnode, vNodes)
+            if (pnode->fInbound)
+                nInbound++;
+    }
+
+    if (hSocket == INVALID_SOCKET) {
+        int nErr = WSAGetLastError();
+        if (nErr == WSAEWOULDBLOCK)
+            return AcceptResult::WouldBlock;
+        NLog.write(b_sev::err, "socket error accept failed: {}", nErr);
+        return AcceptResult::Error;
+    } else if (nInbound >= GetArg("-maxconnections", 125) - MAX_OUTBOUND_CONNECTIONS) {
+        closesocket(hSocket);
+    } else if (CNode::IsBanned(addr)) {
+        NLog.write(b_sev::warn, "connection from {} dropped (banned)", addr.ToString());
+        closesocket(hSocket);
+    } else {
+        NLog.write(b_sev::info, "accepted connection {}", addr.ToString());
+        CNode* pnode = new CNode(NodeIDCounter++, hSocket, addr, "", true);
+        pnode->AddRef();
+        {
+            LOCK(cs_vNodes);
+            vNodes.push_back(pnode);
+        }
+    }
+    return AcceptResult::Accepted;
+}
+
+enum class ReceiveResult
+{
+    Done,       // there's nothing more to read until the socket is readable again
+    MoreToRead, // the buffer was filled, so there may be more to read right away
+    Busy,       // the node's received messages were locked, so nothing was read
+};
+
+/**
+ * Reads once from the socket of the node.
+ */
+static ReceiveResult ReceiveFromNode(CNode* pnode)
+{
+    TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
+    if (!lockRecv)
+        return ReceiveResult::Busy;
+
+    if (pnode->GetTotalRecvSize() > ReceiveFloodSize()) {
+        if (!pnode->fDisconnect)
+            NLog.write(b_sev::warn, "socket recv flood control disconnect ({} bytes)",
+                       pnode->GetTotalRecvSize());
+        pnode->CloseSocketDisconnect();
+        return ReceiveResult::Done;
+    }
+
+    // typical socket buffer is 8K-64K
+    char pchBuf[0x10000];
+    int  nBytes = recv(pnode->hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
+    if (nBytes > 0) {
+        if (!pnode->ReceiveMsgBytes(pchBuf, nBytes))
+            pnode->CloseSocketDisconnect();
+        pnode->nLastRecv = GetTime();
+        return nBytes == static_cast<int>(sizeof(pchBuf)) ? ReceiveResult::MoreToRead
+                                                          : ReceiveResult::Done;
+    } else if (nBytes == 0) {
+        // socket closed gracefully
+        if (!pnode->fDisconnect)
+            NLog.write(b_sev::info, "socket closed");
+        pnode->CloseSocketDisconnect();
+    } else if (nBytes < 0) {
+        // error
+        int nErr = WSAGetLastError();
+        if (nErr == WSAEINTR)
+            return ReceiveResult::MoreToRead;
+        if (nErr != WSAEWOULDBLOCK && nErr != WSAEMSGSIZE && nErr != WSAEINPROGRESS) {
+            if (!pnode->fDisconnect)
+                NLog.write(b_sev::err, "socket recv error {}", nErr);
+            pnode->CloseSocketDisconnect();
+        }
+    }
+    return ReceiveResult::Done;
+}
+
+static void CheckNodeInactivity(CNode* pnode)
+{
+    {
+        LOCK(pnode->cs_vSend);
+        if (pnode->vSendMsg.empty())
+            pnode->nLastSendEmpty = GetTime();
+    }
+    if (GetTime() - pnode->nTimeConnected > 60) {
+        if (pnode->nLastRecv == 0 || pnode->nLastSend == 0) {
+            NLog.write(b_sev::warn, "socket no message in first 60 seconds, {} {}",
+                       pnode->nLastRecv != 0, pnode->nLastSend != 0);
+            pnode->fDisconnect = true;
+        } else if (GetTime() - pnode->nLastSend > 90 * 60 &&
+                   GetTime() - pnode->nLastSendEmpty > 90 * 60) {
+            NLog.write(b_sev::warn, "socket not sending");
+            pnode->fDisconnect = true;
+        } else if (GetTime() - pnode->nLastRecv > 90 * 60) {
+            NLog.write(b_sev::err, "socket inactivity timeout");
+            pnode->fDisconnect = true;
+        }
+    }
+}
+
+#ifdef USE_EPOLL
+/** the eventfd that wakes up the socket handler; created once and never closed, since other threads
+ * may write to it at any time */
+static std::atomic<int> hSocketHandlerWakeup{-1};
+
+/** the timeout of epoll_wait when there's nothing else to do; this is only for housekeeping, as
+ * reads, writes and new connections wake up the socket handler */
+static const int EPOLL_HOUSEKEEPING_TIMEOUT_MS = 250;
+/** the timeout when some node couldn't be serviced because it was busy */
+static const int EPOLL_RETRY_TIMEOUT_MS = 10;
+static const int EPOLL_MAX_EVENTS       = 1024;
+
+static const uint64_t EPOLL_TAG_WAKEUP = std::numeric_limits<uint64_t>::max();
+/** listening sockets are tagged with this bit and their index in vhListenSocket; nodes with their id */
+static const uint64_t EPOLL_TAG_LISTEN = uint64_t(1) << 63;
+
+/** since the events are edge-triggered, whether a socket is ready is remembered until it's drained */
+struct EpollNodeState
+{
+    bool fReadable;
+    bool fWritable;
+};
+
+/**
+ * The socket handler loop based on epoll. Returns false if epoll couldn't be set up, in which case
+ * the select() loop is used.
+ */
+static bool ThreadSocketHandlerEpoll()
+{
+    const int hEpoll = epoll_create1(EPOLL_CLOEXEC);
+    if (hEpoll < 0) {
+        NLog.write(b_sev::err, "epoll_create1 failed with error {}; falling back to select()", errno);
+        return false;
+    }
+    BOOST_SCOPE_EXIT(hEpoll) { close(hEpoll); }
+    BOOST_SCOPE_EXIT_END
+
+    if (hSocketHandlerWakeup.load() < 0) {
+        const int hWakeup = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (hWakeup < 0) {
+            NLog.write(b_sev::err, "eventfd failed with error {}; falling back to select()", errno);
+            return false;
+        }
+        hSocketHandlerWakeup.store(hWakeup);
+    }
+
+    struct epoll_event ev;
+    ev.events   = EPOLLIN | EPOLLET;
+    ev.data.u64 = EPOLL_TAG_WAKEUP;
+    if (epoll_ctl(hEpoll, EPOLL_CTL_ADD, hSocketHandlerWakeup.load(), &ev) != 0) {
+        NLog.write(b_sev::err, "epoll_ctl failed with error {}; falling back to select()", errno);
+        return false;
+    }
+
+    std::vector<bool> vListenReadable(vhListenSocket.size(), false);
+    for (std::size_t i = 0; i < vhListenSocket.size(); i++) {
+        if (vhListenSocket[i] == INVALID_SOCKET)
+            continue;
+        ev.events   = EPOLLIN | EPOLLET;
+        ev.data.u64 = EPOLL_TAG_LISTEN | i;
+        if (epoll_ctl(hEpoll, EPOLL_CTL_ADD, vhListenSocket[i], &ev) != 0) {
+            NLog.write(b_sev::err, "epoll_ctl failed for listening socket with error {}", errno);
+        }
+    }
+
+    NLog.write(b_sev::info, "ThreadSocketHandler using epoll");
+
+    std::unordered_map<int64_t, EpollNodeState> nodeStates;
+    std::vector<struct epoll_event>             events(EPOLL_MAX_EVENTS);
+    list<CNode*>                                vNodesDisconnected;
+    unsigned int                                nPrevNodeCount = 0;
+    bool                                        fMoreToRead    = false;
+    bool                                        fRetry         = false;
 
     while (true) {
+        DisconnectNodes(vNodesDisconnected,
+                        [&nodeStates](CNode* pnode) { nodeStates.erase(pnode->nodeid); });
+        NotifyNodeCountChange(nPrevNodeCount);
+
         //
-        // Disconnect nodes
+        // Register the sockets of new nodes
         //
         {
             LOCK(cs_vNodes);
-            // Disconnect unused nodes
-            vector<CNode*> vNodesCopy = vNodes;
-            BOOST_FOREACH (CNode* pnode, vNodesCopy) {
-                if (pnode->fDisconnect || (pnode->GetRefCount() <= 0 && pnode->vRecvMsg.empty() &&
-                                           pnode->nSendSize == 0 && pnode->ssSend.empty())) {
-                    // remove from vNodes
-                    vNodes.erase(remove(vNodes.begin(), vNodes.end(), pnode), vNodes.end());
-
-                    // release outbound grant (if any)
-                    pnode->grantOutbound.Release();
-
-                    // close socket and cleanup
-                    pnode->CloseSocketDisconnect();
+            for (CNode* pnode : vNodes) {
+                if (pnode->hSocket == INVALID_SOCKET || nodeStates.count(pnode->nodeid) > 0)
+                    continue;
+                ev.events   = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+                ev.data.u64 = static_cast<uint64_t>(pnode->nodeid);
+                if (epoll_ctl(hEpoll, EPOLL_CTL_ADD, pnode->hSocket, &ev) != 0) {
+                    NLog.write(b_sev::err, "epoll_ctl failed for node {} with error {}",
+                               pnode->addrName.get(), errno);
+                    pnode->fDisconnect = true;
+                    continue;
+                }
+                // the state of the socket before registering is unknown
+                nodeStates[pnode->nodeid] = EpollNodeState{true, true};
+                fMoreToRead               = true;
+            }
+        }
 
-                    // hold in disconnected pool until all refs are released
-                    if (pnode->fNetworkNode || pnode->fInbound)
-                        pnode->Release();
-                    vNodesDisconnected.push_back(pnode);
+        const int timeout =
+            fMoreToRead ? 0 : (fRetry ? EPOLL_RETRY_TIMEOUT_MS : EPOLL_HOUSEKEEPING_TIMEOUT_MS);
+
+        vnThreadsRunning[THREAD_SOCKETHANDLER]--;
+        const int nEvents = epoll_wait(hEpoll, events.data(), static_cast<int>(events.size()), timeout);
+        vnThreadsRunning[THREAD_SOCKETHANDLER]++;
+        if (fShutdown)
+            return true;
+        if (nEvents < 0 && errno != EINTR) {
+            NLog.write(b_sev::err, "epoll_wait error {}", errno);
+            MilliSleep(EPOLL_RETRY_TIMEOUT_MS);
+        }
+
+        for (int i = 0; i < nEvents; i++) {
+            const uint64_t tag = events[i].data.u64;
+            if (tag == EPOLL_TAG_WAKEUP) {
+                uint64_t counter;
+                while (read(hSocketHandlerWakeup.load(), &counter, sizeof(counter)) > 0) {
                 }
+            } else if (tag & EPOLL_TAG_LISTEN) {
+                vListenReadable[tag & ~EPOLL_TAG_LISTEN] = true;
+            } else {
+                auto it = nodeStates.find(static_cast<int64_t>(tag));
+                if (it == nodeStates.end())
+                    continue;
+                if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+                    it->second.fReadable = true;
+                if (events[i].events & EPOLLOUT)
+                    it->second.fWritable = true;
             }
+        }
+        if (nEvents == 0) {
+            // nothing happened for a while; retry sending, in case a write readiness was missed
+            for (auto& p : nodeStates)
+                p.second.fWritable = true;
+        }
+        fMoreToRead = false;
+        fRetry      = false;
 
-            // Delete disconnected nodes
-            list<CNode*> vNodesDisconnectedCopy = vNodesDisconnected;
-            BOOST_FOREACH (CNode* pnode, vNodesDisconnectedCopy) {
-                // wait until threads are done using it
-                if (pnode->GetRefCount() <= 0) {
-                    bool fDelete = false;
+        //
+        // Accept new connections
+        //
+        for (std::size_t i = 0; i < vhListenSocket.size(); i++) {
+            if (!vListenReadable[i])
+                continue;
+            AcceptResult res;
+            while ((res = AcceptConnection(vhListenSocket[i])) == AcceptResult::Accepted) {
+            }
+            if (res == AcceptResult::WouldBlock)
+                vListenReadable[i] = false;
+            else
+                fRetry = true;
+        }
+
+        //
+        // Service each socket
+        //
+        vector<CNode*> vNodesCopy;
+        {
+            LOCK(cs_vNodes);
+            vNodesCopy = vNodes;
+            BOOST_FOREACH (CNode* pnode, vNodesCopy)
+                pnode->AddRef();
+        }
+        BOOST_FOREACH (CNode* pnode, vNodesCopy) {
+            if (fShutdown)
+                return true;
+
+            auto it = nodeStates.find(pnode->nodeid);
+            if (it != nodeStates.end()) {
+                EpollNodeState& state = it->second;
+
+                //
+                // Receive
+                //
+                if (state.fReadable && pnode->hSocket != INVALID_SOCKET) {
+                    bool fDraining = true;
                     {
-                        TRY_LOCK4(pnode->cs_vSend, pnode->cs_vRecvMsg, pnode->cs_mapRequests,
-                                  pnode->cs_inventory, lock);
-                        if (lock) {
-                            fDelete = true;
+                        TRY_LOCK(pnode->cs_vSend, lockSend);
+                        if (lockSend)
+                            fDraining = !pnode->vSendMsg.empty();
+                        else
+                            fRetry = true;
+                    }
+                    // do not read, if draining write queue; the read is resumed once it's drained
+                    if (!fDraining) {
+                        switch (ReceiveFromNode(pnode)) {
+                        case ReceiveResult::Done:
+                            state.fReadable = false;
+                            break;
+                        case ReceiveResult::MoreToRead:
+                            fMoreToRead = true;
+                            break;
+                        case ReceiveResult::Busy:
+                            // the message handler has the node; the socket is still readable, and it's
+                            // read again after a short wait instead of spinning on the lock
+                            fRetry = true;
+                            break;
                         }
+                    } else if (state.fWritable) {
+                        fRetry = true;
                     }
-                    if (fDelete) {
-                        vNodesDisconnected.remove(pnode);
-                        delete pnode;
+                }
+
+                //
+                // Send
+                //
+                if (state.fWritable && pnode->hSocket != INVALID_SOCKET) {
+                    TRY_LOCK(pnode->cs_vSend, lockSend);
+                    if (lockSend) {
+                        if (!pnode->vSendMsg.empty()) {
+                            SocketSendData(pnode);
+                            // whatever wasn't sent is waiting for the socket to become writable
+                            if (!pnode->vSendMsg.empty())
+                                state.fWritable = false;
+                        }
+                    } else {
+                        fRetry = true;
                     }
                 }
             }
+
+            //
+            // Inactivity checking
+            //
+            CheckNodeInactivity(pnode);
         }
-        std::size_t vNodesSize = 0;
         {
             LOCK(cs_vNodes);
-            vNodesSize = vNodes.size();
+            for (CNode* pnode : vNodesCopy)
+                pnode->Release();
         }
-        if (vNodesSize != nPrevNodeCount) {
-            nPrevNodeCount = vNodesSize;
-            uiInterface.NotifyNumConnectionsChanged(vNodesSize);
+    }
+}
+#endif
+
+void WakeSocketHandler()
+{
+#ifdef USE_EPOLL
+    const int hWakeup = hSocketHandlerWakeup.load();
+    if (hWakeup >= 0) {
+        const uint64_t one = 1;
+        if (write(hWakeup, &one, sizeof(one)) < 0) {
+            // the counter is saturated, so the socket handler will wake up anyway
         }
+    }
+#endif
+}
+
+void ThreadSocketHandler2()
+{
+    NLog.write(b_sev::info, "ThreadSocketHandler started");
+
+#ifdef USE_EPOLL
+    if (ThreadSocketHandlerEpoll())
+        return;
+#endif
+
+    list<CNode*> vNodesDisconnected;
+    unsigned int nPrevNodeCount = 0;
+
+    while (true) {
+        //
+        // Disconnect nodes
+        //
+        DisconnectNodes(vNodesDisconnected);
+        NotifyNodeCountChange(nPrevNodeCount);
 
         //
         // Find which sockets have data to receive
@@ -849,41 +1264,7 @@ void ThreadSocketHandler2()
         //
         for (SOCKET hListenSocket : vhListenSocket)
             if (hListenSocket != INVALID_SOCKET && FD_ISSET(hListenSocket, &fdsetRecv)) {
-                struct sockaddr_storage sockaddr;
-                socklen_t               len = sizeof(sockaddr);
-                SOCKET   hSocket            = accept(hListenSocket, (struct sockaddr*)&sockaddr, &len);
-                CAddress addr;
-                int      nInbound = 0;
-
-                if (hSocket != INVALID_SOCKET)
-                    if (!addr.SetSockAddr((const struct sockaddr*)&sockaddr))
-                        NLog.write(b_sev::warn, "Warning: Unknown socket family");
-
-                {
-                    LOCK(cs_vNodes);
-                    BOOST_FOREACH (CNode* pnode, vNodes)
-                        if (pnode->fInbound)
-                            nInbound++;
-                }
-
-                if (hSocket == INVALID_SOCKET) {
-                    int nErr = WSAGetLastError();
-                    if (nErr != WSAEWOULDBLOCK)
-                        NLog.write(b_sev::err, "socket error accept failed: {}", nErr);
-                } else if (nInbound >= GetArg("-maxconnections", 125) - MAX_OUTBOUND_CONNECTIONS) {
-                    closesocket(hSocket);
-                } else if (CNode::IsBanned(addr)) {
-                    NLog.write(b_sev::warn, "connection from {} dropped (banned)", addr.ToString());
-                    closesocket(hSocket);
-                } else {
-                    NLog.write(b_sev::info, "accepted connection {}", addr.ToString());
-                    CNode* pnode = new CNode(NodeIDCounter++, hSocket, addr, "", true);
-                    pnode->AddRef();
-                    {
-                        LOCK(cs_vNodes);
-                        vNodes.push_back(pnode);
-                    }
-                }
+                AcceptConnection(hListenSocket);
             }
 
         //
@@ -906,38 +1287,7 @@ void ThreadSocketHandler2()
             if (pnode->hSocket == INVALID_SOCKET)
                 continue;
             if (FD_ISSET(pnode->hSocket, &fdsetRecv) || FD_ISSET(pnode->hSocket, &fdsetError)) {
-                TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
-                if (lockRecv) {
-                    if (pnode->GetTotalRecvSize() > ReceiveFloodSize()) {
-                        if (!pnode->fDisconnect)
-                            NLog.write(b_sev::warn, "socket recv flood control disconnect ({} bytes)",
-                                       pnode->GetTotalRecvSize());
-                        pnode->CloseSocketDisconnect();
-                    } else {
-                        // typical socket buffer is 8K-64K
-                        char pchBuf[0x10000];
-                        int  nBytes = recv(pnode->hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
-                        if (nBytes > 0) {
-                            if (!pnode->ReceiveMsgBytes(pchBuf, nBytes))
-                                pnode->CloseSocketDisconnect();
-                            pnode->nLastRecv = GetTime();
-                        } else if (nBytes == 0) {
-                            // socket closed gracefully
-                            if (!pnode->fDisconnect)
-                                NLog.write(b_sev::info, "socket closed");
-                            pnode->CloseSocketDisconnect();
-                        } else if (nBytes < 0) {
-                            // error
-                            int nErr = WSAGetLastError();
-                            if (nErr != WSAEWOULDBLOCK && nErr != WSAEMSGSIZE && nErr != WSAEINTR &&
-                                nErr != WSAEINPROGRESS) {
-                                if (!pnode->fDisconnect)
-                                    NLog.write(b_sev::err, "socket recv error {}", nErr);
-                                pnode->CloseSocketDisconnect();
-                            }
-                        }
-                    }
-                }
+                ReceiveFromNode(pnode);
             }
 
             //
@@ -954,25 +1304,7 @@ void ThreadSocketHandler2()
             //
             // Inactivity checking
             //
-            {
-                LOCK(pnode->cs_vSend);
-                if (pnode->vSendMsg.empty())
-                    pnode->nLastSendEmpty = GetTime();
-            }
-            if (GetTime() - pnode->nTimeConnected > 60) {
-                if (pnode->nLastRecv == 0 || pnode->nLastSend == 0) {
-                    NLog.write(b_sev::warn, "socket no message in first 60 seconds, {} {}",
-                               pnode->nLastRecv != 0, pnode->nLastSend != 0);
-                    pnode->fDisconnect = true;
-                } else if (GetTime() - pnode->nLastSend > 90 * 60 &&
-                           GetTime() - pnode->nLastSendEmpty > 90 * 60) {
-                    NLog.write(b_sev::warn, "socket not sending");
-                    pnode->fDisconnect = true;
-                } else if (GetTime() - pnode->nLastRecv > 90 * 60) {
-                    NLog.write(b_sev::err, "socket inactivity timeout");
-                    pnode->fDisconnect = true;
-                }
-            }
+            CheckNodeInactivity(pnode);
         }
         {
             LOCK(cs_vNodes);
@@ -49,6 +49,8 @@ bool           BindListenPort(const CService& bindAddr, std::string& strError =
 void           StartNode();
 bool           StopNode();
 void           SocketSendData(CNode* pnode);
+/** wakes up the socket handler, e.g. when there's something new to send (no-op without epoll) */
+void WakeSocketHandler();
 
 enum
 {
@@ -458,6 +460,10 @@ public:
         if (it == vSendMsg.begin())
             SocketSendData(this);
 
+        // let the socket handler send the rest
+        if (!vSendMsg.empty())
+            WakeSocketHandler();
+
         LEAVE_CRITICAL_SECTION(cs_vSend);
     }
 
@@ -474,6 +480,19 @@ public:
         }
     }
 
+    // pushes a message whose payload is already serialized
+    void PushMessageBytes(const char* pszCommand, const char* data, std::size_t size)
+    {
+        try {
+            BeginMessage(pszCommand);
+            ssSend.write(data, static_cast<int>(size));
+            EndMessage();
+        } catch (...) {
+            AbortMessage();
+            throw;
+        }
+    }
+
     template <typename T1>
     void PushMessage(const char* pszCommand, const T1& a1)
     {
@@ -0,0 +1,307 @@
+#include "ntp1/ntp1index.h"
+
+#include "itxdb.h"
+#include "ntp1/ntp1transaction.h"
+#include "transaction.h"
+#include "util.h"
+
+#include <boost/range/adaptor/reversed.hpp>
+#include <map>
+
+std::atomic<bool> NTP1Index::Enabled{false};
+
+bool NTP1Index::GetNTP1Tx(const ITxDB& txdb, const uint256& txHash,
+                          boost::optional<NTP1Transaction>& ntp1tx)
+{
+    ntp1tx = boost::none;
+    if (!txdb.ContainsNTP1Tx(txHash)) {
+        return true;
+    }
+    NTP1Transaction result;
+    if (!txdb.ReadNTP1Tx(txHash, result)) {
+        return NLog.error("NTP1Index: failed to read the NTP1 tx {}", txHash.ToString());
+    }
+    ntp1tx = std::move(result);
+    return true;
+}
+
+bool NTP1Index::AddToHolding(ITxDB& txdb, const NTP1TokenTxData& token, const std::string& address,
+                             const NTP1Int& amount, bool subtract)
+{
+    const std::string tokenId = token.getTokenId();
+
+    boost::optional<NTP1IndexedToken> indexedToken = txdb.ReadNTP1IndexedToken(tokenId);
+    if (!indexedToken) {
+        // the first time the token is seen, which is in its issuance
+        indexedToken               = NTP1IndexedToken();
+        indexedToken->tokenId      = tokenId;
+        indexedToken->issuanceTxid = token.getIssueTxId();
+        indexedToken->tokenSymbol  = token.getTokenSymbol();
+    }
+
+    NTP1IndexedHolding holding =
+        txdb.ReadNTP1TokenHolding(tokenId, address).value_or(NTP1IndexedHolding());
+    holding.tokenId       = tokenId;
+    holding.address       = address;
+    const bool wasHolding = holding.balance > 0;
+
+    if (subtract) {
+        if (holding.balance < amount || indexedToken->supply < amount) {
+            return NLog.error("NTP1Index: the balance of token {} in address {} is less than the {} "
+                              "tokens spent; the index is corrupted and has to be rebuilt",
+                              tokenId, address, amount.str());
+        }
+        holding.balance -= amount;
+        indexedToken->supply -= amount;
+    } else {
+        holding.balance += amount;
+        indexedToken->supply += amount;
+    }
+
+    if (wasHolding && holding.balance == 0) {
+        indexedToken->holdersCount--;
+        if (!txdb.EraseNTP1TokenHolding(tokenId, address)) {
+            return NLog.error("NTP1Index: failed to erase the holding of token {} in address {}",
+                              tokenId, address);
+        }
+    } else if (holding.balance > 0) {
+        if (!wasHolding) {
+            indexedToken->holdersCount++;
+        }
+        if (!txdb.WriteNTP1TokenHolding(holding)) {
+            return NLog.error("NTP1Index: failed to write the holding of token {} in address {}",
+                              tokenId, address);
+        }
+    }
+
+    if (!txdb.WriteNTP1IndexedToken(*indexedToken)) {
+        return NLog.error("NTP1Index: failed to write token {}", tokenId);
+    }
+    return true;
+}
+
+bool NTP1Index::AddOutput(ITxDB& txdb, const NTP1Transaction& ntp1tx, unsigned outputIndex)
+{
+    const NTP1TxOut&  out     = ntp1tx.getTxOut(outputIndex);
+    const std::string address = out.getAddress();
+    if (out.tokenCount() == 0 || address.empty()) {
+        return true;
+    }
+
+    NTP1IndexedOutput indexedOutput;
+    indexedOutput.outpoint = COutPoint(ntp1tx.getTxHash(), outputIndex);
+    for (unsigned long i = 0; i < out.tokenCount(); i++) {
+        const NTP1TokenTxData& token = out.getToken(i);
+        indexedOutput.tokens.push_back(token);
+        if (!AddToHolding(txdb, token, address, token.getAmount(), false)) {
+            return false;
+        }
+    }
+
+    if (!txdb.WriteNTP1AddressOutput(address, indexedOutput)) {
+        return NLog.error("NTP1Index: failed to write output {} of address {}",
+                          indexedOutput.outpoint.ToString(), address);
+    }
+    return true;
+}
+
+bool NTP1Index::RemoveOutput(ITxDB& txdb, const NTP1Transaction& ntp1tx, unsigned outputIndex)
+{
+    if (outputIndex >= ntp1tx.getTxOutCount()) {
+        return NLog.error("NTP1Index: output {} of NTP1 tx {} is out of range", outputIndex,
+                          ntp1tx.getTxHash().ToString());
+    }
+
+    const NTP1TxOut&  out     = ntp1tx.getTxOut(outputIndex);
+    const std::string address = out.getAddress();
+    if (out.tokenCount() == 0 || address.empty()) {
+        return true;
+    }
+
+    for (unsigned long i = 0; i < out.tokenCount(); i++) {
+        const NTP1TokenTxData& token = out.getToken(i);
+        if (!AddToHolding(txdb, token, address, token.getAmount(), true)) {
+            return false;
+        }
+    }
+
+    const COutPoint outpoint(ntp1tx.getTxHash(), outputIndex);
+    if (!txdb.EraseNTP1AddressOutput(address, outpoint)) {
+        return NLog.error("NTP1Index: failed to erase output {} of address {}", outpoint.ToString(),
+                          address);
+    }
+    return true;
+}
+
+bool NTP1Index::AddToIssued(ITxDB& txdb, const NTP1Transaction& ntp1tx, bool subtract)
+{
+    if (ntp1tx.getTxType() != NTP1TxType_ISSUANCE) {
+        return true;
+    }
+
+    // the issued tokens are the ones in the outputs that have this tx as their issuance
+    std::map<std::string, NTP1Int> issued;
+    for (unsigned i = 0; i < ntp1tx.getTxOutCount(); i++) {
+        const NTP1TxOut& out = ntp1tx.getTxOut(i);
+        for (unsigned long j = 0; j < out.tokenCount(); j++) {
+            const NTP1TokenTxData& token = out.getToken(j);
+            if (token.getIssueTxId() == ntp1tx.getTxHash()) {
+                issued[token.getTokenId()] += token.getAmount();
+            }
+        }
+    }
+
+    for (const auto& p : issued) {
+        boost::optional<NTP1IndexedToken> indexedToken = txdb.ReadNTP1IndexedToken(p.first);
+        const bool                        wasIndexed   = indexedToken.is_initialized();
+        if (!indexedToken) {
+            // the issued tokens went to outputs without an address
+            indexedToken               = NTP1IndexedToken();
+            indexedToken->tokenId      = p.first;
+            indexedToken->issuanceTxid = ntp1tx.getTxHash();
+            indexedToken->tokenSymbol  = ntp1tx.getTokenSymbolIfIssuance();
+        }
+
+        if (subtract) {
+            indexedToken->totalIssued -= std::min(indexedToken->totalIssued, p.second);
+        } else {
+            indexedToken->totalIssued += p.second;
+        }
+
+        if (indexedToken->totalIssued == 0 && indexedToken->supply == 0) {
+            // the issuance is disconnected
+            if (wasIndexed && !txdb.EraseNTP1IndexedToken(p.first)) {
+                return NLog.error("NTP1Index: failed to erase token {}", p.first);
+            }
+        } else if (!txdb.WriteNTP1IndexedToken(*indexedToken)) {
+            return NLog.error("NTP1Index: failed to write token {}", p.first);
+        }
+    }
+    return true;
+}
+
+bool NTP1Index::ConnectBlockTxs(ITxDB& txdb, const std::vector<CTransaction>& vtx,
+                                const std::vector<boost::optional<NTP1Transaction>>& parsedNTP1Txs)
+{
+    assert(parsedNTP1Txs.empty() || parsedNTP1Txs.size() == vtx.size());
+    try {
+        for (unsigned txIndex = 0; txIndex < vtx.size(); txIndex++) {
+            const CTransaction& tx = vtx[txIndex];
+
+            // the inputs first, since a tx can spend the outputs of the txs before it in the block
+            if (!tx.IsCoinBase()) {
+                for (const CTxIn& txin : tx.vin) {
+                    boost::optional<NTP1Transaction> prevNTP1Tx;
+                    if (!GetNTP1Tx(txdb, txin.prevout.hash, prevNTP1Tx)) {
+                        return false;
+                    }
+                    if (prevNTP1Tx && !RemoveOutput(txdb, *prevNTP1Tx, txin.prevout.n)) {
+                        return false;
+                    }
+                }
+            }
+
+            boost::optional<NTP1Transaction> ntp1tx;
+            if (!parsedNTP1Txs.empty() && parsedNTP1Txs[txIndex]) {
+                ntp1tx = parsedNTP1Txs[txIndex];
+            } else if (!GetNTP1Tx(txdb, tx.GetHash(), ntp1tx)) {
+                return false;
+            }
+            if (!ntp1tx) {
+                continue;
+            }
+            for (unsigned i = 0; i < ntp1tx->getTxOutCount(); i++) {
+                if (!AddOutput(txdb, *ntp1tx, i)) {
+                    return false;
+                }
+            }
+            if (!AddToIssued(txdb, *ntp1tx, false)) {
+                return false;
+            }
+        }
+    } catch (std::exception& ex) {
+        return NLog.error("NTP1Index: failed to connect block txs to the NTP1 index. Error: {}",
+                          ex.what());
+    }
+    return true;
+}
+
+bool NTP1Index::DisconnectBlockTxs(ITxDB& txdb, const std::vector<CTransaction>& vtx)
+{
+    try {
+        for (const CTransaction& tx : boost::adaptors::reverse(vtx)) {
+            boost::optional<NTP1Transaction> ntp1tx;
+            if (!GetNTP1Tx(txdb, tx.GetHash(), ntp1tx)) {
+                return false;
+            }
+            if (ntp1tx) {
+                for (unsigned i = 0; i < ntp1tx->getTxOutCount(); i++) {
+                    if (!RemoveOutput(txdb, *ntp1tx, i)) {
+                        return false;
+                    }
+                }
+                if (!AddToIssued(txdb, *ntp1tx, true)) {
+                    return false;
+                }
+            }
+
+            if (tx.IsCoinBase()) {
+                continue;
+            }
+            // the spent outputs are unspent again
+            for (const CTxIn& txin : boost::adaptors::reverse(tx.vin)) {
+                boost::optional<NTP1Transaction> prevNTP1Tx;
+                if (!GetNTP1Tx(txdb, txin.prevout.hash, prevNTP1Tx)) {
+                    return false;
+                }
+                if (!prevNTP1Tx) {
+                    continue;
+                }
+                if (txin.prevout.n >= prevNTP1Tx->getTxOutCount()) {
+                    return NLog.error("NTP1Index: output {} of NTP1 tx {} is out of range",
+                                      txin.prevout.n, txin.prevout.hash.ToString());
+                }
+                if (!AddOutput(txdb, *prevNTP1Tx, txin.prevout.n)) {
+                    return false;
+                }
+            }
+        }
+    } catch (std::exception& ex) {
+        return NLog.error("NTP1Index: failed to disconnect block txs from the NTP1 index. Error: {}",
+                          ex.what());
+    }
+    return true;
+}
+
+bool NTP1Index::ConnectBlock(ITxDB& txdb, const uint256& blockHash, const uint256& prevBlockHash,
+                             const std::vector<CTransaction>&                     vtx,
+                             const std::vector<boost::optional<NTP1Transaction>>& parsedNTP1Txs)
+{
+    // otherwise, the index has to be rebuilt, or it has this block already
+    if (txdb.ReadNTP1IndexBestBlock() != prevBlockHash) {
+        return true;
+    }
+    if (!ConnectBlockTxs(txdb, vtx, parsedNTP1Txs)) {
+        NLog.write(b_sev::err,
+                   "NTP1Index: failed to connect block {}; the index will be rebuilt on the next start",
+                   blockHash.ToString());
+        return txdb.WriteNTP1IndexBestBlock(0);
+    }
+    return txdb.WriteNTP1IndexBestBlock(blockHash);
+}
+
+bool NTP1Index::DisconnectBlock(ITxDB& txdb, const uint256& blockHash, const uint256& prevBlockHash,
+                                const std::vector<CTransaction>& vtx)
+{
+    if (txdb.ReadNTP1IndexBestBlock() != blockHash) {
+        return true;
+    }
+    if (!DisconnectBlockTxs(txdb, vtx)) {
+        NLog.write(b_sev::err,
+                   "NTP1Index: failed to disconnect block {}; the index will be rebuilt on the next "
+                   "start",
+                   blockHash.ToString());
+        return txdb.WriteNTP1IndexBestBlock(0);
+    }
+    return txdb.WriteNTP1IndexBestBlock(prevBlockHash);
+}
@@ -0,0 +1,124 @@
+#ifndef NTP1INDEX_H
+#define NTP1INDEX_H
+
+#include "ntp1/ntp1tokentxdata.h"
+#include "outpoint.h"
+#include "serialize.h"
+#include "uint256.h"
+
+#include <atomic>
+#include <boost/optional.hpp>
+#include <string>
+#include <vector>
+
+class CTransaction;
+class ITxDB;
+class NTP1Transaction;
+
+/**
+ * @brief The NTP1IndexedOutput struct
+ * An unspent output of an address that holds NTP1 tokens
+ */
+struct NTP1IndexedOutput
+{
+    COutPoint                    outpoint;
+    std::vector<NTP1TokenTxData> tokens;
+
+    // clang-format off
+    IMPLEMENT_SERIALIZE(
+                        READWRITE(outpoint);
+                        READWRITE(tokens);
+                       )
+    // clang-format on
+};
+
+/**
+ * @brief The NTP1IndexedToken struct
+ * The totals of a token; the supply is what's held in the unspent outputs of addresses, which is what
+ * was issued minus what was burned
+ */
+struct NTP1IndexedToken
+{
+    std::string tokenId;
+    uint256     issuanceTxid;
+    std::string tokenSymbol;
+    NTP1Int     totalIssued  = 0;
+    NTP1Int     supply       = 0;
+    uint64_t    holdersCount = 0;
+
+    // clang-format off
+    IMPLEMENT_SERIALIZE(
+                        READWRITE(tokenId);
+                        READWRITE(issuanceTxid);
+                        READWRITE(tokenSymbol);
+                        READWRITE(totalIssued);
+                        READWRITE(supply);
+                        READWRITE(holdersCount);
+                       )
+    // clang-format on
+};
+
+/**
+ * @brief The NTP1IndexedHolding struct
+ * The balance of a token in an address; it exists only while the balance isn't zero
+ */
+struct NTP1IndexedHolding
+{
+    std::string tokenId;
+    std::string address;
+    NTP1Int     balance = 0;
+
+    // clang-format off
+    IMPLEMENT_SERIALIZE(
+                        READWRITE(tokenId);
+                        READWRITE(address);
+                        READWRITE(balance);
+                       )
+    // clang-format on
+};
+
+/**
+ * @brief The NTP1Index class
+ * Keeps the optional NTP1 index (-ntp1index) of the tx db in sync with the main chain. It's made from
+ * the NTP1 txs that are stored when blocks are connected, so that the tokens of an address and the
+ * totals of a token can be found without going through the block chain.
+ */
+class NTP1Index
+{
+    static bool RemoveOutput(ITxDB& txdb, const NTP1Transaction& ntp1tx, unsigned outputIndex);
+    static bool AddOutput(ITxDB& txdb, const NTP1Transaction& ntp1tx, unsigned outputIndex);
+    static bool AddToHolding(ITxDB& txdb, const NTP1TokenTxData& token, const std::string& address,
+                             const NTP1Int& amount, bool subtract);
+    static bool AddToIssued(ITxDB& txdb, const NTP1Transaction& ntp1tx, bool subtract);
+    static bool GetNTP1Tx(const ITxDB& txdb, const uint256& txHash,
+                          boost::optional<NTP1Transaction>& ntp1tx);
+
+public:
+    /// true if the index is kept (-ntp1index)
+    static std::atomic<bool> Enabled;
+
+    /**
+     * updates the index with the txs of a block being connected, after their NTP1 data is stored;
+     * parsedNTP1Txs can be empty, or have an element per tx, which is the NTP1 tx if it was parsed
+     */
+    static bool ConnectBlockTxs(ITxDB& txdb, const std::vector<CTransaction>& vtx,
+                                const std::vector<boost::optional<NTP1Transaction>>& parsedNTP1Txs);
+
+    /// reverts ConnectBlockTxs() for a block being disconnected
+    static bool DisconnectBlockTxs(ITxDB& txdb, const std::vector<CTransaction>& vtx);
+
+    /**
+     * updates the index with a block being connected to the main chain, if the index is at the previous
+     * block; the index is optional, so failing to update it doesn't make the block invalid, and only
+     * marks the index to be rebuilt on the next start. Returns false if that can't be written.
+     */
+    static bool ConnectBlock(ITxDB& txdb, const uint256& blockHash, const uint256& prevBlockHash,
+                             const std::vector<CTransaction>&                     vtx,
+                             const std::vector<boost::optional<NTP1Transaction>>& parsedNTP1Txs);
+
+    /// like ConnectBlock(), for a block being disconnected from the main chain
+    static bool DisconnectBlock(ITxDB& txdb, const uint256& blockHash, const uint256& prevBlockHash,
+                                const std::vector<CTransaction>& vtx);
+};
+
+#endif // NTP1INDEX_H
@@ -10,6 +10,7 @@
 #include "base58.h"
 #include "key.h"
 #include "ntp1script_burn.h"
+#include "ntp1scriptcache.h"
 #include "ntp1script_issuance.h"
 #include "ntp1script_transfer.h"
 #include "ntp1sendtokensonerecipientdata.h"
@@ -421,6 +422,12 @@ std::shared_ptr<NTP1Script> NTP1Script::ParseScript(const std::string& scriptHex
     }
 }
 
+std::shared_ptr<const NTP1Script> NTP1Script::ParseScriptCached(const uint256&     txid,
+                                                                const std::string& scriptHex)
+{
+    return NTP1ScriptCache::Global().parse(txid, scriptHex);
+}
+
 NTP1Script::IssuanceFlags NTP1Script::IssuanceFlags::ParseIssuanceFlag(uint8_t flags)
 {
     IssuanceFlags  result;
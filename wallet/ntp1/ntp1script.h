@@ -4,6 +4,7 @@
 #include "boost/algorithm/string.hpp"
 #include "crypto_highlevel.h"
 #include "json_spirit.h"
+#include "uint256.h"
 #include <bitset>
 #include <boost/algorithm/hex.hpp>
 #include <boost/dynamic_bitset.hpp>
@@ -198,6 +199,9 @@ public:
     TxType      getTxType() const;
 
     static std::shared_ptr<NTP1Script> ParseScript(const std::string& scriptHex);
+    /// ParseScript() of the script of the tx with txid, through the cache of parsed scripts
+    static std::shared_ptr<const NTP1Script> ParseScriptCached(const uint256&     txid,
+                                                               const std::string& scriptHex);
     std::string                        getParsedScriptHex() const;
     int                                getProtocolVersion() const;
 
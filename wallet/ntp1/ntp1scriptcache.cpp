@@ -0,0 +1,89 @@
+#include "ntp1/ntp1scriptcache.h"
+
+#include "ntp1/ntp1script.h"
+
+#include <boost/thread/lock_guard.hpp>
+
+constexpr std::size_t NTP1ScriptCache::DefaultMaxSize;
+
+NTP1ScriptCache& NTP1ScriptCache::Global()
+{
+    static NTP1ScriptCache cache(DefaultMaxSize);
+    return cache;
+}
+
+NTP1ScriptCache::NTP1ScriptCache(std::size_t maxSizeInScripts) : maxSize(maxSizeInScripts) {}
+
+std::shared_ptr<const NTP1Script> NTP1ScriptCache::find(const uint256&     txid,
+                                                        const std::string& scriptHex)
+{
+    boost::lock_guard<boost::mutex> lg(mtx);
+
+    auto& byTxid = entries.get<TxidTag>();
+    auto  it     = byTxid.find(txid);
+    if (it == byTxid.end() || it->script->getParsedScriptHex() != scriptHex) {
+        return nullptr;
+    }
+    // move it to the back, as the most recently used
+    entries.relocate(entries.end(), entries.project<0>(it));
+    return it->script;
+}
+
+void NTP1ScriptCache::insert(const uint256& txid, const std::shared_ptr<const NTP1Script>& script)
+{
+    boost::lock_guard<boost::mutex> lg(mtx);
+
+    if (maxSize == 0) {
+        return;
+    }
+
+    auto& byTxid = entries.get<TxidTag>();
+    auto  it     = byTxid.find(txid);
+    if (it != byTxid.end()) {
+        byTxid.erase(it);
+    }
+    while (entries.size() >= maxSize) {
+        entries.pop_front();
+    }
+    entries.push_back(Entry{txid, script});
+}
+
+std::shared_ptr<const NTP1Script> NTP1ScriptCache::parse(const uint256&     txid,
+                                                         const std::string& scriptHex)
+{
+    std::shared_ptr<const NTP1Script> result = find(txid, scriptHex);
+    if (result) {
+        hitsCount++;
+        return result;
+    }
+    missesCount++;
+
+    // parsing is done without the lock; two threads that miss the same script both parse it
+    result = NTP1Script::ParseScript(scriptHex);
+    insert(txid, result);
+    return result;
+}
+
+uint64_t NTP1ScriptCache::hits() const { return hitsCount.load(); }
+
+uint64_t NTP1ScriptCache::misses() const { return missesCount.load(); }
+
+std::size_t NTP1ScriptCache::size() const
+{
+    boost::lock_guard<boost::mutex> lg(mtx);
+    return entries.size();
+}
+
+std::size_t NTP1ScriptCache::capacity() const
+{
+    boost::lock_guard<boost::mutex> lg(mtx);
+    return maxSize;
+}
+
+void NTP1ScriptCache::clear()
+{
+    boost::lock_guard<boost::mutex> lg(mtx);
+    entries.clear();
+    hitsCount   = 0;
+    missesCount = 0;
+}
@@ -0,0 +1,82 @@
+#ifndef NTP1SCRIPTCACHE_H
+#define NTP1SCRIPTCACHE_H
+
+#include "uint256.h"
+
+#include <atomic>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
+#include <boost/multi_index_container.hpp>
+#include <boost/thread/mutex.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+class NTP1Script;
+
+/**
+ * @brief The NTP1ScriptCache class keeps the NTP1 scripts parsed from the OP_RETURN outputs of
+ * transactions, so that a transaction's script is parsed once, instead of every time the transaction is
+ * checked for the memory pool, for a block template and for the block chain.
+ *
+ * The key is the txid, which commits to the script; a hit whose script isn't the one given is treated as
+ * a miss and replaced. The scripts are shared and immutable, so they can be used after they're evicted.
+ * The least recently used script is evicted when the cache is full. Scripts that fail to parse aren't
+ * kept.
+ */
+class NTP1ScriptCache
+{
+    struct Entry
+    {
+        uint256                           txid;
+        std::shared_ptr<const NTP1Script> script;
+    };
+
+    struct TxidTag
+    {
+    };
+
+    using EntriesContainer = boost::multi_index_container<
+        Entry,
+        boost::multi_index::indexed_by<
+            // clang-format off
+            // the least recently used first
+            boost::multi_index::sequenced<>,
+            boost::multi_index::ordered_unique<boost::multi_index::tag<TxidTag>,
+                                               BOOST_MULTI_INDEX_MEMBER(Entry, uint256, txid)>
+            // clang-format on
+            >>;
+
+    mutable boost::mutex  mtx;
+    EntriesContainer      entries;
+    std::size_t           maxSize;
+    std::atomic<uint64_t> hitsCount{0};
+    std::atomic<uint64_t> missesCount{0};
+
+    std::shared_ptr<const NTP1Script> find(const uint256& txid, const std::string& scriptHex);
+    void insert(const uint256& txid, const std::shared_ptr<const NTP1Script>& script);
+
+public:
+    static constexpr std::size_t DefaultMaxSize = 10000;
+
+    /// the cache that's used by NTP1Script::ParseScriptCached()
+    static NTP1ScriptCache& Global();
+
+    explicit NTP1ScriptCache(std::size_t maxSizeInScripts);
+
+    NTP1ScriptCache(const NTP1ScriptCache&) = delete;
+    NTP1ScriptCache& operator=(const NTP1ScriptCache&) = delete;
+
+    /// parses the script of the tx with NTP1Script::ParseScript(), if it's not cached; throws the same
+    std::shared_ptr<const NTP1Script> parse(const uint256& txid, const std::string& scriptHex);
+
+    uint64_t    hits() const;
+    uint64_t    misses() const;
+    std::size_t size() const;
+    std::size_t capacity() const;
+    void        clear();
+};
+
+#endif // NTP1SCRIPTCACHE_H
@@ -150,15 +150,15 @@ NTP1TransactionType NTP1Transaction::getTxType() const { return ntp1TransactionT
 
 std::string NTP1Transaction::getTokenSymbolIfIssuance() const
 {
-    std::string                 script    = getNTP1OpReturnScriptHex();
-    std::shared_ptr<NTP1Script> scriptPtr = NTP1Script::ParseScript(script);
+    std::string                       script    = getNTP1OpReturnScriptHex();
+    std::shared_ptr<const NTP1Script> scriptPtr = NTP1Script::ParseScriptCached(txHash, script);
     if (scriptPtr->getTxType() != NTP1Script::TxType_Issuance) {
         throw std::runtime_error(
             "Attempted to get the token symbol of a non-issuance transaction. Txid: " +
             this->getTxHash().ToString() + "; and current tx type: " + ToString(scriptPtr->getTxType()));
     }
-    std::shared_ptr<NTP1Script_Issuance> scriptPtrD =
-        std::dynamic_pointer_cast<NTP1Script_Issuance>(scriptPtr);
+    std::shared_ptr<const NTP1Script_Issuance> scriptPtrD =
+        std::dynamic_pointer_cast<const NTP1Script_Issuance>(scriptPtr);
 
     if (!scriptPtrD) {
         throw std::runtime_error("While getting token symbol for issuance tx, casting script pointer to "
@@ -170,15 +170,15 @@ std::string NTP1Transaction::getTokenSymbolIfIssuance() const
 
 std::string NTP1Transaction::getTokenIdIfIssuance(std::string input0txid, unsigned int input0index) const
 {
-    std::string                 script    = getNTP1OpReturnScriptHex();
-    std::shared_ptr<NTP1Script> scriptPtr = NTP1Script::ParseScript(script);
+    std::string                       script    = getNTP1OpReturnScriptHex();
+    std::shared_ptr<const NTP1Script> scriptPtr = NTP1Script::ParseScriptCached(txHash, script);
     if (scriptPtr->getTxType() != NTP1Script::TxType_Issuance) {
         throw std::runtime_error("Attempted to get the token id of a non-issuance transaction. Txid: " +
                                  this->getTxHash().ToString() +
                                  "; and current tx type: " + ToString(scriptPtr->getTxType()));
     }
-    std::shared_ptr<NTP1Script_Issuance> scriptPtrD =
-        std::dynamic_pointer_cast<NTP1Script_Issuance>(scriptPtr);
+    std::shared_ptr<const NTP1Script_Issuance> scriptPtrD =
+        std::dynamic_pointer_cast<const NTP1Script_Issuance>(scriptPtr);
 
     if (!scriptPtrD) {
         throw std::runtime_error("While getting token id for issuance tx, casting script pointer to "
@@ -620,12 +620,12 @@ void NTP1Transaction::readNTP1DataFromTx(
     this->nTime     = tx.nTime;
     this->nLockTime = tx.nLockTime;
 
-    std::shared_ptr<NTP1Script> scriptPtr = NTP1Script::ParseScript(opReturnArg);
+    std::shared_ptr<const NTP1Script> scriptPtr = NTP1Script::ParseScriptCached(txHash, opReturnArg);
     if (scriptPtr->getTxType() == NTP1Script::TxType::TxType_Issuance) {
         ntp1TransactionType = NTP1TxType_ISSUANCE;
 
-        std::shared_ptr<NTP1Script_Issuance> scriptPtrD =
-            std::dynamic_pointer_cast<NTP1Script_Issuance>(scriptPtr);
+        std::shared_ptr<const NTP1Script_Issuance> scriptPtrD =
+            std::dynamic_pointer_cast<const NTP1Script_Issuance>(scriptPtr);
 
         if (!scriptPtrD) {
             throw std::runtime_error(
@@ -717,8 +717,8 @@ void NTP1Transaction::readNTP1DataFromTx(
         }
     } else if (scriptPtr->getTxType() == NTP1Script::TxType::TxType_Transfer) {
         ntp1TransactionType = NTP1TxType_TRANSFER;
-        std::shared_ptr<NTP1Script_Transfer> scriptPtrD =
-            std::dynamic_pointer_cast<NTP1Script_Transfer>(scriptPtr);
+        std::shared_ptr<const NTP1Script_Transfer> scriptPtrD =
+            std::dynamic_pointer_cast<const NTP1Script_Transfer>(scriptPtr);
 
         if (!scriptPtrD) {
             throw std::runtime_error(
@@ -730,8 +730,8 @@ void NTP1Transaction::readNTP1DataFromTx(
 
     } else if (scriptPtr->getTxType() == NTP1Script::TxType::TxType_Burn) {
         ntp1TransactionType = NTP1TxType_BURN;
-        std::shared_ptr<NTP1Script_Burn> scriptPtrD =
-            std::dynamic_pointer_cast<NTP1Script_Burn>(scriptPtr);
+        std::shared_ptr<const NTP1Script_Burn> scriptPtrD =
+            std::dynamic_pointer_cast<const NTP1Script_Burn>(scriptPtr);
 
         if (!scriptPtrD) {
             throw std::runtime_error(
@@ -946,25 +946,40 @@ std::vector<std::pair<CTransaction, NTP1Transaction>> NTP1Transaction::StdFetche
     // NTP1 transaction data is either in the test pool OR in the database; no third option here
     auto it = mapQueuedNTP1Inputs.find(tx.GetHash());
     if (it == mapQueuedNTP1Inputs.end()) {
-        for (auto&& inTx : inputsWithNTP1) {
-            if (IsTxNTP1(&inTx.first)) {
-                if (txdb.ContainsNTP1Tx(inTx.first.GetHash())) {
-                    // if the transaction is in the database, get it
-                    FetchNTP1TxFromDisk(inTx, txdb, recoverProtection);
-                } else if (queuedAcceptedTxs.find(inTx.first.GetHash()) != queuedAcceptedTxs.end()) {
-                    // otherwise, if the transaction is already in the test pool, use it to read it
-
-                    std::vector<std::pair<CTransaction, NTP1Transaction>> inputsOfInput =
-                        GetAllNTP1InputsOfTx(inTx.first, txdb, recoverProtection, mapQueuedNTP1Inputs,
-                                             queuedAcceptedTxs, recursionCount + 1);
-
-                    NTP1Transaction ntp1tx;
-                    inTx.second.readNTP1DataFromTx(txdb, inTx.first, inputsOfInput);
-                } else {
-                    // read NTP1 transaction inputs. If they fail, that's OK, because they will
-                    // fail later if they're necessary
-                    FetchNTP1TxFromDisk(inTx, txdb, recoverProtection);
-                }
+        // the NTP1 inputs that are in the database are read in one batch
+        std::vector<std::size_t> ntp1InputsIndices;
+        std::vector<uint256>     ntp1InputsHashes;
+        for (std::size_t i = 0; i < inputsWithNTP1.size(); i++) {
+            if (IsTxNTP1(&inputsWithNTP1[i].first)) {
+                ntp1InputsIndices.push_back(i);
+                ntp1InputsHashes.push_back(inputsWithNTP1[i].first.GetHash());
+            }
+        }
+        std::vector<boost::optional<NTP1Transaction>> storedNTP1Inputs;
+        if (!txdb.ReadNTP1TxBatch(ntp1InputsHashes, storedNTP1Inputs)) {
+            // failing to read them is handled like not finding them
+            storedNTP1Inputs.assign(ntp1InputsHashes.size(), boost::none);
+        }
+
+        for (std::size_t i = 0; i < ntp1InputsIndices.size(); i++) {
+            auto& inTx = inputsWithNTP1[ntp1InputsIndices[i]];
+            if (storedNTP1Inputs[i]) {
+                // if the transaction is in the database, get it
+                inTx.second = std::move(*storedNTP1Inputs[i]);
+                inTx.second.updateDebugStrHash();
+            } else if (queuedAcceptedTxs.find(ntp1InputsHashes[i]) != queuedAcceptedTxs.end()) {
+                // otherwise, if the transaction is already in the test pool, use it to read it
+
+                std::vector<std::pair<CTransaction, NTP1Transaction>> inputsOfInput =
+                    GetAllNTP1InputsOfTx(inTx.first, txdb, recoverProtection, mapQueuedNTP1Inputs,
+                                         queuedAcceptedTxs, recursionCount + 1);
+
+                inTx.second.readNTP1DataFromTx(txdb, inTx.first, inputsOfInput);
+            } else {
+                // read NTP1 transaction inputs. If they fail, that's OK, because they will
+                // fail later if they're necessary
+                NLog.write(b_sev::err, "Failed to fetch NTP1 transaction {}",
+                           ntp1InputsHashes[i].ToString());
             }
         }
     } else {
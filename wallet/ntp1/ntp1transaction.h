@@ -53,7 +53,7 @@ class NTP1Transaction
     NTP1TransactionType        ntp1TransactionType = NTP1TxType_NOT_NTP1;
 
     template <typename ScriptType>
-    void __TransferTokens(const ITxDB& txdb, const std::shared_ptr<ScriptType>& scriptPtrD,
+    void __TransferTokens(const ITxDB& txdb, const std::shared_ptr<const ScriptType>& scriptPtrD,
                           const CTransaction&                                          tx,
                           const std::vector<std::pair<CTransaction, NTP1Transaction>>& inputsTxs,
                           bool                                                         burnOutput31);
@@ -210,7 +210,7 @@ bool operator==(const NTP1Transaction& lhs, const NTP1Transaction& rhs)
 
 template <typename ScriptType>
 void NTP1Transaction::__TransferTokens(
-    const ITxDB& txdb, const std::shared_ptr<ScriptType>& scriptPtrD, const CTransaction& tx,
+    const ITxDB& txdb, const std::shared_ptr<const ScriptType>& scriptPtrD, const CTransaction& tx,
     const std::vector<std::pair<CTransaction, NTP1Transaction>>& inputsTxs, bool burnOutput31)
 {
     static_assert(std::is_same<ScriptType, NTP1Script_Transfer>::value ||
@@ -4,10 +4,13 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "amount.h"
+#include "base58.h"
 #include "bitcoinrpc.h"
 #include "blockmetadata.h"
 #include "main.h"
 #include "merkletx.h"
+#include "ntp1/ntp1index.h"
+#include "ntp1/ntp1scriptcache.h"
 #include "txdb.h"
 #include "txmempool.h"
 #include <algorithm>
@@ -299,16 +302,21 @@ Value getblock(const Array& params, bool fHelp)
     if (!bi)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
 
-    CBlock block;
-    block.ReadFromDisk(&*bi, txdb, true);
-
     if (!fVerbose) {
-        CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
-        ssBlock << block;
-        std::string strHex = HexStr(ssBlock.begin(), ssBlock.end());
+        // the stored block is the serialized block, so it doesn't have to be deserialized
+        std::string strHex;
+        const bool  read = txdb.ReadBlockBytes(hash, [&strHex](const char* data, std::size_t size) {
+            strHex = HexStr(data, data + size);
+            return true;
+        });
+        if (!read)
+            throw JSONRPCError(RPC_DATABASE_ERROR, "Failed to read block " + strHash);
         return strHex;
     }
 
+    CBlock block;
+    block.ReadFromDisk(&*bi, txdb, true);
+
     bool fIgnoreNTP1 = false;
     if (params.size() > 3)
         fIgnoreNTP1 = params[3].get_bool();
@@ -757,6 +765,165 @@ Value gettxout(const Array& params, bool fHelp)
     return ret;
 }
 
+// the NTP1 index doesn't have the best block if updating it with a block failed, and it's then rebuilt
+// on the next start
+static void ThrowIfNTP1IndexIsStale(const CTxDB& txdb)
+{
+    if (txdb.ReadNTP1IndexBestBlock() != txdb.GetBestBlockHash())
+        throw JSONRPCError(RPC_MISC_ERROR,
+                           "The NTP1 index is out of date; restart the node to rebuild it");
+}
+
+Value getntp1addressbalances(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw std::runtime_error(
+            "getntp1addressbalances \"address\"\n"
+            "\nReturns the NTP1 tokens of any address, from the NTP1 index (requires -ntp1index).\n"
+            "\nArguments:\n"
+            "1. \"address\"          (string, required) The neblio address\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"balances\" : {         (json object) The balance of every token, by token id\n"
+            "    \"tokenid\" : {\n"
+            "      \"Name\" : \"name\",   (string) The token symbol\n"
+            "      \"TokenId\" : \"id\",  (string) The token id\n"
+            "      \"Balance\" : \"n\"    (string) The balance\n"
+            "    }, ...\n"
+            "  },\n"
+            "  \"outputs\" : [          (array of json objects) The unspent outputs that hold tokens\n"
+            "    {\n"
+            "      \"txid\" : \"id\",     (string) The transaction id\n"
+            "      \"vout\" : n,        (numeric) The output number\n"
+            "      \"tokens\" : [...]   (array of json objects) The tokens of the output\n"
+            "    }, ...\n"
+            "  ]\n"
+            "}\n"
+            "\nExamples:\n"
+            "getntp1addressbalances \"NTh1...\"");
+
+    if (!NTP1Index::Enabled)
+        throw JSONRPCError(RPC_MISC_ERROR, "The NTP1 index is disabled; restart with -ntp1index");
+
+    const std::string address = params[0].get_str();
+    if (!CBitcoinAddress(address).IsValid())
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid neblio address: " + address);
+
+    std::vector<NTP1IndexedOutput> outputs;
+    {
+        LOCK(cs_main);
+        const CTxDB txdb;
+        ThrowIfNTP1IndexIsStale(txdb);
+        if (!txdb.ReadNTP1AddressOutputs(address, outputs))
+            throw JSONRPCError(RPC_DATABASE_ERROR, "Failed to read the NTP1 index");
+    }
+
+    // the balances are sorted by token id, like the outputs by outpoint
+    std::map<std::string, TokenMinimalData> balances;
+    Array                                   outputsJson;
+    for (const NTP1IndexedOutput& output : outputs) {
+        Array tokensJson;
+        for (const NTP1TokenTxData& token : output.tokens) {
+            TokenMinimalData& balance = balances[token.getTokenId()];
+            balance.tokenId           = token.getTokenId();
+            balance.tokenName         = token.getTokenSymbol();
+            balance.amount += token.getAmount();
+            tokensJson.push_back(token.exportDatabaseJsonData());
+        }
+        Object outputJson;
+        outputJson.push_back(Pair("txid", output.outpoint.hash.GetHex()));
+        outputJson.push_back(Pair("vout", static_cast<int64_t>(output.outpoint.n)));
+        outputJson.push_back(Pair("tokens", tokensJson));
+        outputsJson.push_back(outputJson);
+    }
+
+    Object balancesJson;
+    for (const auto& p : balances) {
+        Object tokenJson;
+        tokenJson.push_back(Pair("Name", p.second.tokenName));
+        tokenJson.push_back(Pair("TokenId", p.second.tokenId));
+        tokenJson.push_back(Pair("Balance", ToString(p.second.amount)));
+        balancesJson.push_back(Pair(p.first, tokenJson));
+    }
+
+    Object result;
+    result.push_back(Pair("balances", balancesJson));
+    result.push_back(Pair("outputs", outputsJson));
+    return result;
+}
+
+Value getntp1tokeninfo(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw std::runtime_error(
+            "getntp1tokeninfo \"tokenid\"\n"
+            "\nReturns the totals of an NTP1 token, from the NTP1 index (requires -ntp1index).\n"
+            "\nArguments:\n"
+            "1. \"tokenid\"          (string, required) The token id\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"TokenId\" : \"id\",       (string) The token id\n"
+            "  \"Name\" : \"name\",        (string) The token symbol\n"
+            "  \"IssuanceTxid\" : \"id\",  (string) The transaction that issued the token\n"
+            "  \"TotalIssued\" : \"n\",    (string) The amount issued\n"
+            "  \"Supply\" : \"n\",         (string) The amount in unspent outputs, which excludes "
+            "burned tokens\n"
+            "  \"Holders\" : n           (numeric) The number of addresses that hold the token\n"
+            "}\n"
+            "\nExamples:\n"
+            "getntp1tokeninfo \"La...\"");
+
+    if (!NTP1Index::Enabled)
+        throw JSONRPCError(RPC_MISC_ERROR, "The NTP1 index is disabled; restart with -ntp1index");
+
+    const std::string tokenId = params[0].get_str();
+
+    boost::optional<NTP1IndexedToken> token;
+    {
+        LOCK(cs_main);
+        const CTxDB txdb;
+        ThrowIfNTP1IndexIsStale(txdb);
+        token = txdb.ReadNTP1IndexedToken(tokenId);
+    }
+    if (!token)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Token not found: " + tokenId);
+
+    Object result;
+    result.push_back(Pair("TokenId", token->tokenId));
+    result.push_back(Pair("Name", token->tokenSymbol));
+    result.push_back(Pair("IssuanceTxid", token->issuanceTxid.GetHex()));
+    result.push_back(Pair("TotalIssued", ToString(token->totalIssued)));
+    result.push_back(Pair("Supply", ToString(token->supply)));
+    result.push_back(Pair("Holders", static_cast<int64_t>(token->holdersCount)));
+    return result;
+}
+
+Value getntp1scriptcacheinfo(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw std::runtime_error(
+            "getntp1scriptcacheinfo\n"
+            "\nReturns the state of the cache of parsed NTP1 scripts.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"size\" : n,      (numeric) The number of scripts in the cache\n"
+            "  \"maxsize\" : n,   (numeric) The number of scripts that the cache can hold\n"
+            "  \"hits\" : n,      (numeric) The lookups that found the script in the cache\n"
+            "  \"misses\" : n     (numeric) The lookups that parsed the script\n"
+            "}\n"
+            "\nExamples:\n"
+            "getntp1scriptcacheinfo");
+
+    const NTP1ScriptCache& cache = NTP1ScriptCache::Global();
+
+    Object result;
+    result.push_back(Pair("size", static_cast<uint64_t>(cache.size())));
+    result.push_back(Pair("maxsize", static_cast<uint64_t>(cache.capacity())));
+    result.push_back(Pair("hits", cache.hits()));
+    result.push_back(Pair("misses", cache.misses()));
+    return result;
+}
+
 Value listvotes(const Array& params, bool fHelp)
 {
     if (fHelp || params.size() != 0)
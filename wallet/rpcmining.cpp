@@ -55,6 +55,7 @@ Value getmininginfo(const Array& params, bool fHelp)
     obj.push_back(Pair("netstakeweight", GetPoSKernelPS()));
     obj.push_back(Pair("errors", GetWarnings("statusbar")));
     obj.push_back(Pair("pooledtx", (uint64_t)mempool.size()));
+    obj.push_back(Pair("scryptblockhashes", scrypt_blockhash_invocations_count()));
 
     weight.push_back(Pair("minimum", (uint64_t)nMinWeight));
     weight.push_back(Pair("maximum", (uint64_t)nMaxWeight));
@@ -123,6 +124,20 @@ Value getstakinginfo(const Array& params, bool fHelp)
     obj.push_back(Pair("difficulty", GetDifficulty(&bi)));
     obj.push_back(Pair("search-interval", (int)stakeMaker.getLastCoinStakeSearchInterval()));
 
+    const KernelSearchStats kernelSearch = stakeMaker.getLastKernelSearchStats();
+    const double            durationSecs = kernelSearch.durationMicros / 1000000.;
+    Object                  kernelSearchObj;
+    kernelSearchObj.push_back(Pair("threads", stakeMaker.getKernelSearchThreads()));
+    kernelSearchObj.push_back(Pair("last-round-threads", kernelSearch.threads));
+    kernelSearchObj.push_back(Pair("last-round-coins", (uint64_t)kernelSearch.coins));
+    kernelSearchObj.push_back(Pair("last-round-hashes", (uint64_t)kernelSearch.hashes));
+    kernelSearchObj.push_back(Pair("last-round-duration-ms", kernelSearch.durationMicros / 1000.));
+    kernelSearchObj.push_back(
+        Pair("coins-per-second", durationSecs > 0 ? kernelSearch.coins / durationSecs : 0.));
+    kernelSearchObj.push_back(
+        Pair("hashes-per-second", durationSecs > 0 ? kernelSearch.hashes / durationSecs : 0.));
+    obj.push_back(Pair("kernel-search", kernelSearchObj));
+
     obj.push_back(Pair("weight", (uint64_t)nWeight));
     obj.push_back(Pair("netstakeweight", (uint64_t)nNetworkWeight));
 
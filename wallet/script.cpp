@@ -4,8 +4,6 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <boost/foreach.hpp>
-#include <boost/tuple/tuple.hpp>
-#include <boost/tuple/tuple_comparison.hpp>
 
 using namespace std;
 using namespace boost;
@@ -15,6 +13,7 @@ using namespace boost;
 #include "keystore.h"
 #include "main.h"
 #include "script.h"
+#include "sigcache.h"
 #include "sync.h"
 #include "util.h"
 
@@ -1264,67 +1263,18 @@ uint256 SignatureHash(CScript scriptCode, const CTransaction& txTo, unsigned int
     return ss.GetHash();
 }
 
-// Valid signature cache, to avoid doing expensive ECDSA signature checking
-// twice for every transaction (once when accepted into memory pool, and
-// again when accepted into the block chain)
-
-class CSignatureCache
+// -maxsigcachemb is in megabytes; the deprecated -maxsigcachesize is converted to it by AppInit2()
+static std::size_t GetMaxSigCacheSize()
 {
-private:
-    // sigdata_type is (signature hash, signature, public key):
-    typedef boost::tuple<uint256, std::vector<unsigned char>, std::vector<unsigned char>> sigdata_type;
-    std::set<sigdata_type>                                                                setValid;
-    CCriticalSection                                                                      cs_sigcache;
-
-public:
-    bool Get(uint256 hash, const std::vector<unsigned char>& vchSig,
-             const std::vector<unsigned char>& pubKey)
-    {
-        LOCK(cs_sigcache);
-
-        sigdata_type                     k(hash, vchSig, pubKey);
-        std::set<sigdata_type>::iterator mi = setValid.find(k);
-        if (mi != setValid.end())
-            return true;
-        return false;
-    }
-
-    void Set(uint256 hash, const std::vector<unsigned char>& vchSig,
-             const std::vector<unsigned char>& pubKey)
-    {
-        // DoS prevention: limit cache size to less than 10MB
-        // (~200 bytes per cache entry times 50,000 entries)
-        // Since there are a maximum of 20,000 signature operations per block
-        // 50,000 is a reasonable default.
-        int64_t nMaxCacheSize = GetArg("-maxsigcachesize", 50000);
-        if (nMaxCacheSize <= 0)
-            return;
-
-        LOCK(cs_sigcache);
-
-        while (static_cast<int64_t>(setValid.size()) > nMaxCacheSize) {
-            // Evict a random entry. Random because that helps
-            // foil would-be DoS attackers who might try to pre-generate
-            // and re-use a set of valid signatures just-slightly-greater
-            // than our cache size.
-            uint256                          randomHash = GetRandHash();
-            std::vector<unsigned char>       unused;
-            std::set<sigdata_type>::iterator it =
-                setValid.lower_bound(sigdata_type(randomHash, unused, unused));
-            if (it == setValid.end())
-                it = setValid.begin();
-            setValid.erase(*it);
-        }
-
-        sigdata_type k(hash, vchSig, pubKey);
-        setValid.insert(k);
-    }
-};
+    int64_t nSizeMB = GetArg("-maxsigcachemb", DEFAULT_MAX_SIG_CACHE_SIZE);
+    nSizeMB         = std::min(std::max<int64_t>(nSizeMB, 0), MAX_MAX_SIG_CACHE_SIZE);
+    return static_cast<std::size_t>(nSizeMB) << 20;
+}
 
 bool CheckSig(vector<unsigned char> vchSig, vector<unsigned char> vchPubKey, CScript scriptCode,
               const CTransaction& txTo, unsigned int nIn, int nHashType)
 {
-    static CSignatureCache signatureCache;
+    static SignatureCache signatureCache(GetMaxSigCacheSize());
 
     // Hash type is one byte tacked on to the end of the signature
     if (vchSig.empty())
@@ -1337,17 +1287,14 @@ bool CheckSig(vector<unsigned char> vchSig, vector<unsigned char> vchPubKey, CSc
 
     uint256 sighash = SignatureHash(scriptCode, txTo, nIn, nHashType);
 
-    if (signatureCache.Get(sighash, vchSig, vchPubKey))
+    const uint256 sigDigest = signatureCache.computeDigest(sighash, vchSig, vchPubKey);
+    if (signatureCache.contains(sigDigest))
         return true;
 
-    CKey key;
-    if (!key.SetPubKey(vchPubKey))
+    if (!CKey::VerifyWithPubKey(vchPubKey, sighash, vchSig))
         return false;
 
-    if (!key.Verify(sighash, vchSig))
-        return false;
-
-    signatureCache.Set(sighash, vchSig, vchPubKey);
+    signatureCache.insert(sigDigest);
     return true;
 }
 
@@ -1916,6 +1863,65 @@ Result<void, ScriptError> VerifySignature(const CTransaction& txFrom, const CTra
     return Ok();
 }
 
+CScriptCheck::CScriptCheck()
+    : ptxTo(nullptr), nIn(0), fValidatePayToScriptHash(false), fStrictEncodings(false), nHashType(0),
+      error(ScriptError::SCRIPT_ERR_UNKNOWN_ERROR)
+{
+}
+
+CScriptCheck::CScriptCheck(const CTransaction& txFrom, const CTransaction& txTo, unsigned int nInIn,
+                           bool fValidatePayToScriptHashIn, bool fStrictEncodingsIn, int nHashTypeIn)
+    : ptxTo(&txTo), nIn(nInIn), fValidatePayToScriptHash(fValidatePayToScriptHashIn),
+      fStrictEncodings(fStrictEncodingsIn), nHashType(nHashTypeIn),
+      error(ScriptError::SCRIPT_ERR_UNKNOWN_ERROR)
+{
+    // same sanity checks as in VerifySignature(); a check whose prevout doesn't match is left with
+    // a null ptxTo, and always fails
+    assert(nIn < txTo.vin.size());
+    const CTxIn& txin = txTo.vin[nIn];
+    if (txin.prevout.n >= txFrom.vout.size() || txin.prevout.hash != txFrom.GetHash()) {
+        ptxTo = nullptr;
+        return;
+    }
+    scriptPubKey = txFrom.vout[txin.prevout.n].scriptPubKey;
+}
+
+bool CScriptCheck::operator()()
+{
+    if (ptxTo == nullptr) {
+        error = ScriptError::SCRIPT_ERR_UNKNOWN_ERROR;
+        return false;
+    }
+    const Result<void, ScriptError> res =
+        VerifyScript(ptxTo->vin[nIn].scriptSig, scriptPubKey, *ptxTo, nIn, fValidatePayToScriptHash,
+                     fStrictEncodings, nHashType);
+    if (res.isErr()) {
+        error = res.unwrapErr(RESULT_PRE);
+        return false;
+    }
+    error = ScriptError::SCRIPT_ERR_OK;
+    return true;
+}
+
+Result<void, ScriptError> CScriptCheck::CheckMandatoryFlagsOnly() const
+{
+    if (ptxTo == nullptr) {
+        return Err(ScriptError::SCRIPT_ERR_UNKNOWN_ERROR);
+    }
+    return VerifyScript(ptxTo->vin[nIn].scriptSig, scriptPubKey, *ptxTo, nIn, false, false, nHashType);
+}
+
+void CScriptCheck::swap(CScriptCheck& check)
+{
+    scriptPubKey.swap(check.scriptPubKey);
+    std::swap(ptxTo, check.ptxTo);
+    std::swap(nIn, check.nIn);
+    std::swap(fValidatePayToScriptHash, check.fValidatePayToScriptHash);
+    std::swap(fStrictEncodings, check.fStrictEncodings);
+    std::swap(nHashType, check.nHashType);
+    std::swap(error, check.error);
+}
+
 static CScript PushAll(const vector<valtype>& values)
 {
     CScript result;
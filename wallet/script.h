@@ -708,6 +708,43 @@ Result<void, ScriptError> VerifySignature(const CTransaction& txFrom, const CTra
                                           unsigned int nIn, bool fValidatePayToScriptHash,
                                           bool fStrictEncodings, int nHashType);
 
+/**
+ * A deferred VerifySignature() call on one input, to be run later (possibly in parallel) by the
+ * script check queue. The spent output script is copied, while the spending transaction is referred
+ * to, so it must outlive the check.
+ */
+class CScriptCheck
+{
+    CScript             scriptPubKey;
+    const CTransaction* ptxTo;
+    unsigned int        nIn;
+    bool                fValidatePayToScriptHash;
+    bool                fStrictEncodings;
+    int                 nHashType;
+    ScriptError         error;
+
+public:
+    CScriptCheck();
+    CScriptCheck(const CTransaction& txFrom, const CTransaction& txTo, unsigned int nInIn,
+                 bool fValidatePayToScriptHashIn, bool fStrictEncodingsIn, int nHashTypeIn);
+
+    bool operator()();
+
+    /**
+     * Verifies the input again without P2SH and strict encodings, the way ConnectInputs() does after a
+     * failure, so that an input that fails only because of them isn't treated as a consensus failure
+     */
+    Result<void, ScriptError> CheckMandatoryFlagsOnly() const;
+
+    void swap(CScriptCheck& check);
+
+    ScriptError         GetScriptError() const { return error; }
+    const CTransaction* GetTxTo() const { return ptxTo; }
+    unsigned int        GetInputIndex() const { return nIn; }
+};
+
+inline void swap(CScriptCheck& a, CScriptCheck& b) { a.swap(b); }
+
 // Given two sets of signatures for scriptPubKey, possibly with OP_0 placeholders,
 // combine them intelligently and return the result.
 CScript CombineSignatures(CScript scriptPubKey, const CTransaction& txTo, unsigned int nIn,
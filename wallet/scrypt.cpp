@@ -29,6 +29,7 @@
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <atomic>
 
 #include "scrypt.h"
 #include "pbkdf2.h"
@@ -190,8 +191,13 @@ uint256 scrypt_salted_multiround_hash(const void* input, size_t inputlen, const
     return resultHash;
 }
 
+static std::atomic<uint64_t> scryptBlockHashInvocations{0};
+
+uint64_t scrypt_blockhash_invocations_count() { return scryptBlockHashInvocations.load(); }
+
 uint256 scrypt_blockhash(const void* input)
 {
+    scryptBlockHashInvocations++;
     unsigned char scratchpad[SCRYPT_BUFFER_SIZE];
     return scrypt_nosalt(input, 80, scratchpad);
 }
@@ -12,4 +12,7 @@ uint256 scrypt_salted_hash(const void* input, size_t inputlen, const void* salt,
 uint256 scrypt_hash(const void* input, size_t inputlen);
 uint256 scrypt_blockhash(const void* input);
 
+/** Number of times scrypt_blockhash() was called since the program started */
+uint64_t scrypt_blockhash_invocations_count();
+
 #endif // SCRYPT_MINE_H
@@ -1159,6 +1159,76 @@ public:
 
 
 
+/** Stream that reads serialized data from a buffer it doesn't own, like a view into a memory
+ * mapped database, without copying it first like CDataStream does.
+ *
+ * The buffer has to outlive the reader.
+ */
+class CBufferReader
+{
+private:
+    const char* pbegin;
+    const char* pend;
+    const char* pcur;
+
+public:
+    int nType;
+    int nVersion;
+
+    CBufferReader(const char* pbeginIn, const char* pendIn, int nTypeIn, int nVersionIn)
+        : pbegin(pbeginIn), pend(pendIn), pcur(pbeginIn), nType(nTypeIn), nVersion(nVersionIn)
+    {
+        assert(pbegin <= pend);
+    }
+
+    std::size_t size() const     { return pend - pcur; }
+    bool empty() const           { return pcur == pend; }
+    bool eof() const             { return empty(); }
+    std::size_t tell() const     { return pcur - pbegin; }
+
+    int GetType()                { return nType; }
+    int GetVersion()             { return nVersion; }
+
+    CBufferReader& read(char* pch, int nSize)
+    {
+        assert(nSize >= 0);
+        if (static_cast<std::size_t>(nSize) > size())
+        {
+            memset(pch, 0, nSize);
+            throw std::ios_base::failure("CBufferReader::read() : end of data");
+        }
+        memcpy(pch, pcur, nSize);
+        pcur += nSize;
+        return (*this);
+    }
+
+    CBufferReader& ignore(int nSize)
+    {
+        assert(nSize >= 0);
+        if (static_cast<std::size_t>(nSize) > size())
+            throw std::ios_base::failure("CBufferReader::ignore() : end of data");
+        pcur += nSize;
+        return (*this);
+    }
+
+    template<typename T>
+    CBufferReader& operator>>(T& obj)
+    {
+        // Unserialize from this stream
+        ::Unserialize(*this, obj, nType, nVersion);
+        return (*this);
+    }
+};
+
+
+
+
+
+
+
+
+
+
 /** RAII wrapper for FILE*.
  *
  * Will automatically close the file when it goes out of scope if not null.
@@ -0,0 +1,157 @@
+#include "sigcache.h"
+
+#include "hash.h"
+#include "util.h"
+#include <new>
+
+SignatureCache::Bucket::Bucket() : version(0)
+{
+    for (std::atomic<uint64_t>& tag : tags) {
+        tag.store(0, std::memory_order_relaxed);
+    }
+}
+
+SignatureCache::Entry::Entry()
+{
+    for (std::atomic<uint64_t>& word : words) {
+        word.store(0, std::memory_order_relaxed);
+    }
+}
+
+SignatureCache::SignatureCache(std::size_t maxSizeInBytes)
+    : salt(GetRandHash()), bucketsCount(0), buckets(nullptr)
+{
+    if (maxSizeInBytes > AlignmentSlack) {
+        bucketsCount = (maxSizeInBytes - AlignmentSlack) / BucketSize;
+    }
+    if (bucketsCount == 0) {
+        return;
+    }
+
+    bucketsStorage.reset(new unsigned char[bucketsCount * sizeof(Bucket) + AlignmentSlack]);
+    const uintptr_t storageAddress = reinterpret_cast<uintptr_t>(bucketsStorage.get());
+    unsigned char*  alignedStorage =
+        bucketsStorage.get() + (alignof(Bucket) - storageAddress % alignof(Bucket)) % alignof(Bucket);
+    buckets = reinterpret_cast<Bucket*>(alignedStorage);
+    for (std::size_t i = 0; i < bucketsCount; i++) {
+        new (&buckets[i]) Bucket;
+    }
+
+    entries.reset(new Entry[bucketsCount * WaysPerBucket]);
+}
+
+SignatureCache::~SignatureCache()
+{
+    for (std::size_t i = 0; i < bucketsCount; i++) {
+        buckets[i].~Bucket();
+    }
+}
+
+uint256 SignatureCache::computeDigest(const uint256& sighash, const std::vector<unsigned char>& vchSig,
+                                      const std::vector<unsigned char>& vchPubKey) const
+{
+    // the lengths are serialized too, so moving bytes from the signature to the key changes the digest
+    CHashWriter ss(SER_GETHASH, 0);
+    ss << salt << sighash << vchSig << vchPubKey;
+    return ss.GetHash();
+}
+
+std::size_t SignatureCache::bucketIndex(const uint256& digest) const
+{
+    return static_cast<std::size_t>(digest.Get64(0) % bucketsCount);
+}
+
+uint64_t SignatureCache::MakeTag(const uint256& digest) { return digest.Get64(1) | 1; }
+
+bool SignatureCache::entryEquals(std::size_t entryIndex, const uint256& digest) const
+{
+    const Entry& entry = entries[entryIndex];
+    for (int i = 0; i < 4; i++) {
+        if (entry.words[i].load(std::memory_order_relaxed) != digest.Get64(i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SignatureCache::contains(const uint256& digest) const
+{
+    if (bucketsCount == 0) {
+        return false;
+    }
+
+    const std::size_t index   = bucketIndex(digest);
+    const Bucket&     bucket  = buckets[index];
+    const uint64_t    tag     = MakeTag(digest);
+    const uint64_t    version = bucket.version.load(std::memory_order_acquire);
+    if (version % 2 != 0) {
+        return false;
+    }
+
+    bool found = false;
+    for (std::size_t way = 0; way < WaysPerBucket; way++) {
+        if (bucket.tags[way].load(std::memory_order_relaxed) == tag &&
+            entryEquals(index * WaysPerBucket + way, digest)) {
+            found = true;
+            break;
+        }
+    }
+
+    // what was read is only valid if no writer touched the bucket meanwhile
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return found && bucket.version.load(std::memory_order_relaxed) == version;
+}
+
+void SignatureCache::insert(const uint256& digest)
+{
+    if (bucketsCount == 0) {
+        return;
+    }
+
+    const std::size_t index   = bucketIndex(digest);
+    Bucket&           bucket  = buckets[index];
+    const uint64_t    tag     = MakeTag(digest);
+    uint64_t          version = bucket.version.load(std::memory_order_relaxed);
+    if (version % 2 != 0 || !bucket.version.compare_exchange_strong(version, version + 1,
+                                                                    std::memory_order_acquire,
+                                                                    std::memory_order_relaxed)) {
+        // another thread is writing to the bucket
+        return;
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+
+    std::size_t chosenWay = WaysPerBucket;
+    for (std::size_t way = 0; way < WaysPerBucket; way++) {
+        const uint64_t wayTag = bucket.tags[way].load(std::memory_order_relaxed);
+        if (wayTag == tag && entryEquals(index * WaysPerBucket + way, digest)) {
+            // already there
+            bucket.version.store(version, std::memory_order_release);
+            return;
+        }
+        if (wayTag == 0 && chosenWay == WaysPerBucket) {
+            chosenWay = way;
+        }
+    }
+    if (chosenWay == WaysPerBucket) {
+        // the bucket is full; the salt makes the digest a random pick for whoever makes signatures
+        chosenWay = static_cast<std::size_t>(digest.Get64(2) % WaysPerBucket);
+    }
+
+    bucket.tags[chosenWay].store(tag, std::memory_order_relaxed);
+    Entry& entry = entries[index * WaysPerBucket + chosenWay];
+    for (int i = 0; i < 4; i++) {
+        entry.words[i].store(digest.Get64(i), std::memory_order_relaxed);
+    }
+    bucket.version.store(version + 2, std::memory_order_release);
+}
+
+std::size_t SignatureCache::capacity() const { return bucketsCount * WaysPerBucket; }
+
+std::size_t SignatureCache::memoryUsage() const { return bucketsCount * BucketSize; }
+
+std::size_t SignatureCache::SizeForEntries(std::size_t entriesCount)
+{
+    if (entriesCount == 0)
+        return 0;
+    return (entriesCount + WaysPerBucket - 1) / WaysPerBucket * BucketSize + AlignmentSlack;
+}
@@ -0,0 +1,92 @@
+#ifndef SIGCACHE_H
+#define SIGCACHE_H
+
+#include "uint256.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief The SignatureCache class keeps the signatures that were verified already, to avoid doing
+ * the expensive ECDSA check twice for every transaction (once when it's accepted into the memory
+ * pool, and again when it's accepted into the block chain).
+ *
+ * An entry is a salted 256-bit digest of (signature hash, signature, public key), so the entries have
+ * a fixed size, and their place in the table can't be chosen by whoever makes the signatures. The
+ * table is allocated once with the size given in bytes. It's made of buckets of one cache line each,
+ * holding a version counter and the tags (a part of the digest) of its entries, next to an array with
+ * the full digests.
+ *
+ * Lookups don't lock: they read a bucket between two loads of its version, which a writer makes odd
+ * while it changes the bucket, and count as a miss if the version changed. Writers take a bucket by
+ * making its version odd, and skip the insert if another writer has it. Either way, the worst a race
+ * does is a miss, which only means verifying the signature again. A full bucket drops one of its
+ * entries, picked by the digest of the new one, which is as unpredictable as a random pick.
+ */
+class SignatureCache
+{
+public:
+    static constexpr std::size_t WaysPerBucket = 7;
+
+private:
+    struct alignas(64) Bucket
+    {
+        Bucket();
+
+        // odd while a writer changes the bucket
+        std::atomic<uint64_t> version;
+        // a tag is never zero; zero is an empty way
+        std::atomic<uint64_t> tags[WaysPerBucket];
+    };
+
+    struct Entry
+    {
+        Entry();
+
+        std::atomic<uint64_t> words[4];
+    };
+
+    static_assert(sizeof(Bucket) == 64, "A bucket must fit in a cache line");
+
+    // the memory of a bucket with its entries
+    static constexpr std::size_t BucketSize = sizeof(Bucket) + WaysPerBucket * sizeof(Entry);
+    // new[] doesn't align to a cache line, so the buckets are placed in a buffer with room to align
+    static constexpr std::size_t AlignmentSlack = alignof(Bucket) - 1;
+
+    const uint256                    salt;
+    std::size_t                      bucketsCount;
+    std::unique_ptr<unsigned char[]> bucketsStorage;
+    Bucket*                          buckets;
+    std::unique_ptr<Entry[]>         entries;
+
+    std::size_t     bucketIndex(const uint256& digest) const;
+    static uint64_t MakeTag(const uint256& digest);
+    bool            entryEquals(std::size_t entryIndex, const uint256& digest) const;
+
+public:
+    /// the memory used is at most maxSizeInBytes; with a size too small for one bucket, nothing is kept
+    explicit SignatureCache(std::size_t maxSizeInBytes);
+
+    SignatureCache(const SignatureCache&) = delete;
+    SignatureCache& operator=(const SignatureCache&) = delete;
+
+    ~SignatureCache();
+
+    /// the salted digest that's the key of the signature in the cache
+    uint256 computeDigest(const uint256& sighash, const std::vector<unsigned char>& vchSig,
+                          const std::vector<unsigned char>& vchPubKey) const;
+
+    bool contains(const uint256& digest) const;
+    void insert(const uint256& digest);
+
+    /// the number of entries that the cache can hold
+    std::size_t capacity() const;
+    std::size_t memoryUsage() const;
+
+    /// the smallest size for which the cache holds at least the given number of entries
+    static std::size_t SizeForEntries(std::size_t entriesCount);
+};
+
+#endif // SIGCACHE_H
@@ -5,6 +5,11 @@
 #include "wallet.h"
 #include "work.h"
 
+#include <atomic>
+#include <chrono>
+#include <system_error>
+#include <thread>
+
 int64_t StakeMaker::getLastCoinStakeSearchInterval() const { return nLastCoinStakeSearchInterval; }
 
 int64_t StakeMaker::getLastCoinStakeSearchTime() const { return nLastCoinStakeSearchTime; }
@@ -32,6 +37,40 @@ bool IsStakeTxSizeValid(const CTransaction& stakeTx)
     return true;
 }
 
+boost::optional<StakeKernelData>
+MakeStakeKernelData(const ITxDB& txdb, const StakeMaker::KeyGetterFunctorType& keyGetter,
+                    const std::pair<const CTransaction*, unsigned int>& pcoin,
+                    const int64_t kernelBlockTime, const int64_t txCoinstakeTime)
+{
+    // Found a kernel
+    if (fDebug)
+        NLog.write(b_sev::debug, "FindStakeKernel : kernel found");
+
+    const CScript& kernelScriptPubKey = pcoin.first->vout[pcoin.second].scriptPubKey;
+
+    const boost::optional<CScript> spkKernel =
+        StakeMaker::CalculateScriptPubKeyForStakeOutput(txdb, keyGetter, kernelScriptPubKey);
+
+    if (!spkKernel) {
+        if (fDebug)
+            NLog.write(b_sev::debug, "FindStakeKernel : failed to get scriptPubKey for kernel");
+        return boost::none;
+    }
+
+    StakeKernelData coinStake;
+
+    // Fill coin stake transaction
+    coinStake.kernelScriptPubKey      = kernelScriptPubKey;
+    coinStake.credit                  = pcoin.first->vout[pcoin.second].nValue;
+    coinStake.kernelTx                = pcoin.first;
+    coinStake.kernelBlockTime         = kernelBlockTime;
+    coinStake.kernelInput             = CTxIn(pcoin.first->GetHash(), pcoin.second);
+    coinStake.stakeTxTime             = txCoinstakeTime;
+    coinStake.stakeOutputScriptPubKey = *spkKernel;
+
+    return coinStake;
+}
+
 boost::optional<StakeKernelData>
 TestAndCreateStakeKernel(const CTxDB& txdb, const StakeMaker::KeyGetterFunctorType& keyGetter,
                          const unsigned int nBits, const int64_t nCoinstakeInitialTxTime,
@@ -73,35 +112,48 @@ TestAndCreateStakeKernel(const CTxDB& txdb, const StakeMaker::KeyGetterFunctorTy
             continue;
         }
 
-        // Found a kernel
-        if (fDebug)
-            NLog.write(b_sev::debug, "FindStakeKernel : kernel found");
-
-        const CScript& kernelScriptPubKey = pcoin.first->vout[pcoin.second].scriptPubKey;
-
-        const boost::optional<CScript> spkKernel =
-            StakeMaker::CalculateScriptPubKeyForStakeOutput(txdb, keyGetter, kernelScriptPubKey);
-
-        if (!spkKernel) {
-            if (fDebug)
-                NLog.write(b_sev::debug, "FindStakeKernel : failed to get scriptPubKey for kernel");
-            continue;
+        if (boost::optional<StakeKernelData> coinStake = MakeStakeKernelData(
+                txdb, keyGetter, pcoin, kernelBlock.GetBlockTime(), txCoinstakeTime)) {
+            return coinStake;
         }
+    }
+    return boost::none;
+}
+
+boost::optional<StakeKernelCandidate>
+MakeStakeKernelCandidate(const ITxDB& txdb, const std::pair<const CWalletTx*, unsigned int>& pcoin)
+{
+    CTxIndex txindex;
+    if (!txdb.ReadTxIndex(pcoin.first->GetHash(), txindex))
+        return boost::none;
 
-        StakeKernelData coinStake;
+    const boost::optional<CBlockIndex> blockFrom = txdb.ReadBlockIndex(txindex.pos.nBlockPos);
+    if (!blockFrom)
+        return boost::none;
 
-        // Fill coin stake transaction
-        coinStake.kernelScriptPubKey      = kernelScriptPubKey;
-        coinStake.credit                  = pcoin.first->vout[pcoin.second].nValue;
-        coinStake.kernelTx                = pcoin.first;
-        coinStake.kernelBlockTime         = kernelBlock.GetBlockTime();
-        coinStake.kernelInput             = CTxIn(pcoin.first->GetHash(), pcoin.second);
-        coinStake.stakeTxTime             = txCoinstakeTime;
-        coinStake.stakeOutputScriptPubKey = *spkKernel;
+    StakeKernelCandidate result;
+    result.tx              = pcoin.first;
+    result.n               = pcoin.second;
+    result.value           = pcoin.first->vout[pcoin.second].nValue;
+    result.blockFromHash   = txindex.pos.nBlockPos;
+    result.blockFromHeight = blockFrom->nHeight;
+    result.blockFromTime   = blockFrom->GetBlockTime();
+    result.txPrevOffset    = txindex.pos.nTxPos;
+    return result;
+}
 
-        return coinStake;
+boost::optional<StakeKernelHashInput> MakeStakeKernelCandidateHashInput(const ITxDB&                txdb,
+                                                                        const StakeKernelCandidate& c)
+{
+    uint64_t nStakeModifier       = 0;
+    int      nStakeModifierHeight = 0;
+    int64_t  nStakeModifierTime   = 0;
+    if (!GetKernelStakeModifier(txdb, c.blockFromHash, nStakeModifier, nStakeModifierHeight,
+                                nStakeModifierTime, false)) {
+        return boost::none;
     }
-    return boost::none;
+    return MakeStakeKernelHashInput(nStakeModifier, static_cast<unsigned int>(c.blockFromTime),
+                                    c.txPrevOffset, c.tx->nTime, c.n);
 }
 
 boost::optional<CAmount> CalculateStakeReward(const ITxDB& txdb, const CTransaction& stakeTx,
@@ -475,23 +527,244 @@ bool StakeMaker::SignAndVerify(const CKeyStore& keystore, const CoinStakeInputsR
     return true;
 }
 
+std::vector<StakeKernelCandidate>
+StakeMaker::updateStakeCandidates(const ITxDB& txdb, const uint256& bestBlockHash,
+                                  const std::set<std::pair<const CWalletTx*, unsigned int>>& setCoins)
+{
+    std::lock_guard<std::mutex> lg(stakeCandidatesMtx);
+
+    const bool sameBestBlock = (bestBlockHash == stakeCandidatesBestBlock);
+
+    std::map<COutPoint, StakeKernelCandidate> updated;
+    std::vector<StakeKernelCandidate>         result;
+    result.reserve(setCoins.size());
+    for (const auto& pcoin : setCoins) {
+        const COutPoint outpoint(pcoin.first->GetHash(), pcoin.second);
+
+        boost::optional<StakeKernelCandidate> candidate;
+        bool                                  updateHashInput = !sameBestBlock;
+
+        // the position of a coin in the chain only changes if its block is disconnected
+        const auto it = stakeCandidates.find(outpoint);
+        if (it != stakeCandidates.cend() &&
+            (sameBestBlock ||
+             txdb.ReadBlockHashOfHeight(it->second.blockFromHeight) == it->second.blockFromHash)) {
+            candidate     = it->second;
+            candidate->tx = pcoin.first;
+        } else {
+            candidate       = MakeStakeKernelCandidate(txdb, pcoin);
+            updateHashInput = true;
+        }
+        if (!candidate) {
+            continue;
+        }
+
+        // the modifier depends on the blocks after the coin's block, so it's found again (from the
+        // stake modifier cache) on every new block
+        if (updateHashInput) {
+            candidate->hashInput = MakeStakeKernelCandidateHashInput(txdb, *candidate);
+        }
+
+        result.push_back(*candidate);
+        updated.emplace(outpoint, std::move(*candidate));
+    }
+
+    // outputs that weren't selected again are spent or not ready to stake; they're dropped
+    stakeCandidates          = std::move(updated);
+    stakeCandidatesBestBlock = bestBlockHash;
+
+    return result;
+}
+
+// what's the same for all the candidates of a kernel search
+struct KernelSearchRound
+{
+    unsigned int nBits = 0;
+    CBigNum      bnTargetPerCoinDay;
+    int64_t      nCoinstakeInitialTxTime = 0;
+    int64_t      nSearchCount            = 0;
+    int          nMaxStakeSearchInterval = 0;
+    unsigned int nSMA                    = 0;
+    uint256      prevBlockHash;
+};
+
+boost::optional<StakeKernelData>
+SearchStakeKernelCandidate(const CTxDB& txdb, const StakeMaker::KeyGetterFunctorType& keyGetter,
+                           const KernelSearchRound& round, const StakeKernelCandidate& candidate,
+                           std::atomic_bool& stop, uint64_t& hashesCount)
+{
+    if (!candidate.hashInput)
+        return boost::none; // the stake modifier of the coin isn't known yet
+
+    if (candidate.blockFromTime + round.nSMA >
+        round.nCoinstakeInitialTxTime - round.nMaxStakeSearchInterval)
+        return boost::none; // only count coins meeting min age requirement
+
+    // the coin day weight only grows with the time of the coinstake, so the target of the first
+    // (latest) time searched is the highest target of this search; hashes above it are skipped
+    // without computing the target of every second
+    const CBigNum bnMaxTarget =
+        CBigNum(candidate.value) *
+        GetWeight(txdb, (int64_t)candidate.tx->nTime, round.nCoinstakeInitialTxTime) / COIN /
+        (24 * 60 * 60) * round.bnTargetPerCoinDay;
+    if (bnMaxTarget < CBigNum(0))
+        return boost::none;
+    const bool    targetFits = bnMaxTarget.bitSize() <= 256;
+    const uint256 maxTarget  = targetFits ? bnMaxTarget.getuint256() : uint256(0);
+
+    StakeKernelHashInput hashInput = *candidate.hashInput;
+    const COutPoint      prevoutStake(candidate.tx->GetHash(), candidate.n);
+
+    for (int64_t n = 0; n < round.nSearchCount && !stop && !fShutdown; n++) {
+        if (round.prevBlockHash != txdb.GetBestBlockHash()) {
+            // a new block makes this search useless for all the threads
+            stop = true;
+            break;
+        }
+
+        // Search backward in time from the given tx timestamp
+        // Search nSearchInterval seconds back up to nMaxStakeSearchInterval
+        const int64_t txCoinstakeTime = round.nCoinstakeInitialTxTime - n;
+        hashesCount++;
+        if (targetFits &&
+            StakeKernelHash(hashInput, static_cast<unsigned int>(txCoinstakeTime)) > maxTarget) {
+            continue;
+        }
+
+        // a possible kernel; it's checked fully, the same way the block will be validated
+        CBlock kernelBlock;
+        if (!kernelBlock.ReadFromDisk(candidate.blockFromHash, txdb, false))
+            break;
+
+        uint256 hashProofOfStake = 0, targetProofOfStake = 0;
+        if (!CheckStakeKernelHash(txdb, round.nBits, kernelBlock, candidate.blockFromHash,
+                                  candidate.txPrevOffset, *candidate.tx, prevoutStake, txCoinstakeTime,
+                                  hashProofOfStake, targetProofOfStake)) {
+            continue;
+        }
+
+        if (boost::optional<StakeKernelData> res =
+                MakeStakeKernelData(txdb, keyGetter, std::make_pair(candidate.tx, candidate.n),
+                                    kernelBlock.GetBlockTime(), txCoinstakeTime)) {
+            return res;
+        }
+    }
+    return boost::none;
+}
+
 boost::optional<StakeKernelData>
 StakeMaker::FindStakeKernel(const CKeyStore& keystore, const unsigned int nBits,
                             const int64_t nCoinstakeInitialTxTime,
                             const std::set<std::pair<const CWalletTx*, unsigned int>>& setCoins)
 {
+    const auto startTime = std::chrono::steady_clock::now();
+
     const CTxDB txdb;
 
     const boost::optional<CBlockIndex> pindexPrev = txdb.GetBestBlockIndex();
+    if (!pindexPrev) {
+        return boost::none;
+    }
 
-    for (const auto& pcoin : setCoins) {
-        if (boost::optional<StakeKernelData> res = TestAndCreateStakeKernel(
-                txdb, StakeMaker::DefaultKeyGetter(keystore), nBits, nCoinstakeInitialTxTime,
-                nLastCoinStakeSearchTime, pindexPrev, pcoin)) {
-            return res;
+    const std::vector<StakeKernelCandidate> candidates =
+        updateStakeCandidates(txdb, pindexPrev->GetBlockHash(), setCoins);
+
+    KernelSearchRound round;
+    round.nBits = nBits;
+    round.bnTargetPerCoinDay.SetCompact(nBits);
+    round.nCoinstakeInitialTxTime = nCoinstakeInitialTxTime;
+    round.nMaxStakeSearchInterval = Params().MaxStakeSearchInterval();
+    round.nSearchCount            = std::min(nCoinstakeInitialTxTime - nLastCoinStakeSearchTime,
+                                             (int64_t)round.nMaxStakeSearchInterval);
+    round.nSMA                    = Params().StakeMinAge(txdb);
+    round.prevBlockHash           = pindexPrev->GetBlockHash();
+
+    // the candidates are taken one by one by the threads, and all of them stop once a kernel is found
+    // or the best block changes
+    std::atomic_size_t               nextCandidate{0};
+    std::atomic_bool                 stop{false};
+    std::atomic<uint64_t>            coinsCount{0};
+    std::atomic<uint64_t>            hashesCount{0};
+    std::mutex                       resultMtx;
+    boost::optional<StakeKernelData> result;
+
+    const auto searchCandidates = [&](const CTxDB& threadTxdb) {
+        const StakeMaker::KeyGetterFunctorType keyGetter = StakeMaker::DefaultKeyGetter(keystore);
+
+        uint64_t coins  = 0;
+        uint64_t hashes = 0;
+        try {
+            while (!stop) {
+                const std::size_t i = nextCandidate++;
+                if (i >= candidates.size()) {
+                    break;
+                }
+                coins++;
+                boost::optional<StakeKernelData> res =
+                    SearchStakeKernelCandidate(threadTxdb, keyGetter, round, candidates[i], stop, hashes);
+                if (res) {
+                    std::lock_guard<std::mutex> lg(resultMtx);
+                    if (!result) {
+                        result = std::move(res);
+                    }
+                    stop = true;
+                }
+            }
+        } catch (const std::exception& ex) {
+            NLog.write(b_sev::err, "FindStakeKernel : kernel search failed: {}", ex.what());
+            stop = true;
+        }
+        coinsCount += coins;
+        hashesCount += hashes;
+    };
+
+    const int threadsCount = static_cast<int>(
+        std::max<std::size_t>(1, std::min<std::size_t>(kernelSearchThreads, candidates.size())));
+
+    std::vector<std::thread> workers;
+    workers.reserve(threadsCount - 1);
+    for (int i = 1; i < threadsCount; i++) {
+        try {
+            workers.emplace_back([&]() {
+                SetThreadPriority(THREAD_PRIORITY_LOWEST);
+                const CTxDB workerTxdb;
+                searchCandidates(workerTxdb);
+            });
+        } catch (const std::system_error& ex) {
+            NLog.write(b_sev::warn, "FindStakeKernel : failed to start a kernel search thread: {}",
+                       ex.what());
+            break;
         }
     }
-    return boost::none;
+    // the staking thread searches too
+    searchCandidates(txdb);
+    for (std::thread& t : workers) {
+        t.join();
+    }
+
+    KernelSearchStats stats;
+    stats.threads        = static_cast<int>(workers.size()) + 1;
+    stats.coins          = coinsCount;
+    stats.hashes         = hashesCount;
+    stats.durationMicros = std::chrono::duration_cast<std::chrono::microseconds>(
+                               std::chrono::steady_clock::now() - startTime)
+                               .count();
+    {
+        std::lock_guard<std::mutex> lg(kernelSearchStatsMtx);
+        lastKernelSearchStats = stats;
+    }
+
+    return result;
+}
+
+void StakeMaker::setKernelSearchThreads(int threads) { kernelSearchThreads = std::max(1, threads); }
+
+int StakeMaker::getKernelSearchThreads() const { return kernelSearchThreads; }
+
+KernelSearchStats StakeMaker::getLastKernelSearchStats() const
+{
+    std::lock_guard<std::mutex> lg(kernelSearchStatsMtx);
+    return lastKernelSearchStats;
 }
 
 CoinStakeInputsResult
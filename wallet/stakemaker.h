@@ -2,12 +2,15 @@
 #define STAKEMAKER_H
 
 #include "amount.h"
+#include "kernel.h"
 #include "key.h"
 #include "script.h"
 #include "transaction.h"
 #include "txin.h"
 #include <boost/optional.hpp>
+#include <map>
 #include <mutex>
+#include <vector>
 
 class CWallet;
 class CWalletTx;
@@ -25,6 +28,29 @@ struct StakeKernelData
     int64_t             stakeTxTime     = 0;
 };
 
+// a selected output with what's needed to test it as a kernel without reading from the db
+struct StakeKernelCandidate
+{
+    const CTransaction* tx    = nullptr;
+    unsigned int        n     = 0;
+    CAmount             value = 0;
+    uint256             blockFromHash;
+    int32_t             blockFromHeight = 0;
+    int64_t             blockFromTime   = 0;
+    unsigned int        txPrevOffset    = 0;
+    // none until the stake modifier of the block is known (a selection interval after the block)
+    boost::optional<StakeKernelHashInput> hashInput;
+};
+
+// what the last kernel search did, for getstakinginfo
+struct KernelSearchStats
+{
+    int      threads        = 0;
+    uint64_t coins          = 0;
+    uint64_t hashes         = 0;
+    int64_t  durationMicros = 0;
+};
+
 struct CoinStakeInputsResult
 {
     std::vector<CTxIn>               inputs;
@@ -45,9 +71,22 @@ class StakeMaker
                                              cachedSelectedOutputs;
     boost::atomic<boost::optional<uint64_t>> cachedStakeWeight;
 
+    // the kernel candidates of the last selected outputs, and the best block they were updated for
+    std::mutex                                stakeCandidatesMtx;
+    std::map<COutPoint, StakeKernelCandidate> stakeCandidates;
+    uint256                                   stakeCandidatesBestBlock;
+
+    boost::atomic_int  kernelSearchThreads{1};
+    mutable std::mutex kernelSearchStatsMtx;
+    KernelSearchStats  lastKernelSearchStats;
+
     void updateStakeWeight(const ITxDB&                                               txdb,
                            const std::set<std::pair<const CWalletTx*, unsigned int>>& setCoins);
 
+    std::vector<StakeKernelCandidate>
+    updateStakeCandidates(const ITxDB& txdb, const uint256& bestBlockHash,
+                          const std::set<std::pair<const CWalletTx*, unsigned int>>& setCoins);
+
 public:
     StakeMaker() = default;
 
@@ -97,6 +136,9 @@ public:
     int64_t                    getLastCoinStakeSearchInterval() const;
     int64_t                    getLastCoinStakeSearchTime() const;
     boost::optional<uint64_t>  getLatestStakeWeight() const;
+    void                       setKernelSearchThreads(int threads);
+    int                        getKernelSearchThreads() const;
+    KernelSearchStats          getLastKernelSearchStats() const;
     bool                       IsStakingActive();
 };
 
@@ -0,0 +1,62 @@
+#include "stakemodifiercache.h"
+
+#include "itxdb.h"
+
+StakeModifierCache::StakeModifierCache(std::size_t maxSizeIn) : maxSize(maxSizeIn) {}
+
+boost::optional<StakeModifierCache::Entry> StakeModifierCache::get(const uint256& hashBlockFrom,
+                                                                   const ITxDB&   txdb) const
+{
+    boost::optional<Entry> result;
+    {
+        boost::shared_lock<boost::shared_mutex> lg(mtx);
+        const auto                              it = entries.find(hashBlockFrom);
+        if (it == entries.cend()) {
+            return boost::none;
+        }
+        result = it->second;
+    }
+    // the entry is stale if its walk was disconnected (even if that wasn't committed yet)
+    const boost::optional<uint256> mainChainHash = txdb.ReadBlockHashOfHeight(result->lastBlockHeight);
+    if (!mainChainHash || *mainChainHash != result->lastBlockHash) {
+        return boost::none;
+    }
+    return result;
+}
+
+void StakeModifierCache::add(const uint256& hashBlockFrom, const Entry& entry)
+{
+    if (maxSize == 0) {
+        return;
+    }
+    boost::unique_lock<boost::shared_mutex> lg(mtx);
+    if (entries.size() >= maxSize && entries.find(hashBlockFrom) == entries.end()) {
+        // the staked coins are spread over many blocks; dropping any of them is as good as another
+        entries.erase(entries.begin());
+    }
+    entries[hashBlockFrom] = entry;
+}
+
+void StakeModifierCache::invalidateFromHeight(int32_t height)
+{
+    boost::unique_lock<boost::shared_mutex> lg(mtx);
+    for (auto it = entries.begin(); it != entries.end();) {
+        if (it->second.lastBlockHeight >= height) {
+            it = entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void StakeModifierCache::clear()
+{
+    boost::unique_lock<boost::shared_mutex> lg(mtx);
+    entries.clear();
+}
+
+std::size_t StakeModifierCache::size() const
+{
+    boost::shared_lock<boost::shared_mutex> lg(mtx);
+    return entries.size();
+}
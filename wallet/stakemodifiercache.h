@@ -0,0 +1,61 @@
+#ifndef STAKEMODIFIERCACHE_H
+#define STAKEMODIFIERCACHE_H
+
+#include "uint256.h"
+#include <boost/optional.hpp>
+#include <boost/thread.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+
+class ITxDB;
+
+/**
+ * @brief The StakeModifierCache class keeps the kernel stake modifiers that GetKernelStakeModifier()
+ * found, by the hash of the block the staked coin is from.
+ *
+ * Finding the modifier of a block is a walk forward on the main chain, block by block, until a full
+ * selection interval has passed; and a staking wallet does that for every coin it tries, every time
+ * it tries it. The result depends only on the blocks of that walk, so it's valid as long as the last
+ * block of the walk is in the main chain (and with it, all the blocks before it). That's checked on
+ * every lookup, which makes the cache safe with reorgs and aborted db transactions. Entries are also
+ * dropped when the blocks they depend on are disconnected.
+ */
+class StakeModifierCache
+{
+public:
+    struct Entry
+    {
+        uint64_t nStakeModifier       = 0;
+        int32_t  nStakeModifierHeight = 0;
+        int64_t  nStakeModifierTime   = 0;
+        // the last block of the walk
+        uint256 lastBlockHash;
+        int32_t lastBlockHeight = 0;
+    };
+
+private:
+    mutable boost::shared_mutex        mtx;
+    std::unordered_map<uint256, Entry> entries;
+    const std::size_t                  maxSize;
+
+public:
+    explicit StakeModifierCache(std::size_t maxSizeIn);
+
+    StakeModifierCache(const StakeModifierCache&) = delete;
+    StakeModifierCache& operator=(const StakeModifierCache&) = delete;
+
+    /// returns none if there's no entry for the block, or if its walk isn't in the main chain anymore
+    boost::optional<Entry> get(const uint256& hashBlockFrom, const ITxDB& txdb) const;
+
+    void add(const uint256& hashBlockFrom, const Entry& entry);
+
+    /// drops the entries that depend on the main chain block at this height or any block after it
+    void invalidateFromHeight(int32_t height);
+
+    void clear();
+
+    std::size_t size() const;
+};
+
+#endif // STAKEMODIFIERCACHE_H
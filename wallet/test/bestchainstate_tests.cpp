@@ -0,0 +1,84 @@
+#include "googletest/googletest/include/gtest/gtest.h"
+
+#include "bestchainstate.h"
+#include "block.h"
+#include "blockindex.h"
+#include "mocks/mtxdb.h"
+#include "ntp1/ntp1transaction.h"
+
+#include <map>
+
+using ::testing::_;
+using ::testing::Invoke;
+
+namespace {
+
+uint256 MakeHash(const int i) { return uint256(static_cast<uint64_t>(i) + 1); }
+
+} // namespace
+
+TEST(bestchainstate_tests, set_get_clear)
+{
+    BestChainState state;
+    EXPECT_FALSE(state.get());
+    EXPECT_FALSE(state.getBestHeight());
+
+    BestChainState::Snapshot s;
+    s.blockHash  = MakeHash(5);
+    s.height     = 5;
+    s.chainTrust = 1234;
+    state.set(std::make_shared<const BestChainState::Snapshot>(s));
+
+    const BestChainState::SnapshotPtr first = state.get();
+    ASSERT_TRUE(first);
+    EXPECT_EQ(first->blockHash, MakeHash(5));
+    EXPECT_EQ(first->chainTrust, uint256(1234));
+    ASSERT_TRUE(state.getBestHeight());
+    EXPECT_EQ(*state.getBestHeight(), 5);
+
+    // a replaced snapshot stays valid for whoever holds it
+    s.blockHash = MakeHash(6);
+    s.height    = 6;
+    state.set(std::make_shared<const BestChainState::Snapshot>(s));
+    EXPECT_EQ(first->height, 5);
+    EXPECT_EQ(*state.getBestHeight(), 6);
+
+    state.clear();
+    EXPECT_FALSE(state.get());
+    EXPECT_FALSE(state.getBestHeight());
+}
+
+TEST(bestchainstate_tests, make_snapshot)
+{
+    // a chain of blocks with times that are not in order, to exercise the median
+    std::map<uint256, CBlockIndex> chain;
+    for (int h = 100; h < 120; h++) {
+        CBlockIndex bi;
+        bi.blockHash   = MakeHash(h);
+        bi.hashPrev    = MakeHash(h - 1);
+        bi.nHeight     = h;
+        bi.nTime       = static_cast<uint32_t>(1000000 + (h % 2 == 0 ? h * 10 : h * 10 - 100));
+        bi.nChainTrust = static_cast<uint64_t>(h * 3);
+
+        chain[bi.blockHash] = bi;
+    }
+
+    std::unique_ptr<mTxDB> dbMock = MakeUnique<mTxDB>();
+    EXPECT_CALL(*dbMock, ReadBlockIndex(_))
+        .WillRepeatedly(Invoke([&chain](const uint256& h) -> boost::optional<CBlockIndex> {
+            const auto it = chain.find(h);
+            if (it == chain.cend()) {
+                return boost::none;
+            }
+            return it->second;
+        }));
+
+    const CBlockIndex&                tip = chain.at(MakeHash(119));
+    const BestChainState::SnapshotPtr s   = BestChainState::MakeSnapshot(tip, *dbMock);
+    ASSERT_TRUE(s);
+    EXPECT_EQ(s->blockHash, tip.GetBlockHash());
+    EXPECT_EQ(s->height, 119);
+    EXPECT_EQ(s->chainTrust, tip.nChainTrust);
+    EXPECT_EQ(s->blockTime, tip.GetBlockTime());
+    EXPECT_EQ(s->medianTimePast, tip.GetMedianTimePast(*dbMock));
+}
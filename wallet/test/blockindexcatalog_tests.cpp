@@ -0,0 +1,171 @@
+#include "googletest/googletest/include/gtest/gtest.h"
+
+#include "environment.h"
+
+#include "block.h"
+#include "blockindex.h"
+#include "blockindexcatalog.h"
+#include "hash.h"
+#include "mocks/mtxdb.h"
+#include "ntp1/ntp1transaction.h"
+#include <boost/algorithm/hex.hpp>
+
+namespace {
+
+uint256 HashFromHeightAndBranch(const int height, const int branch)
+{
+    // deterministic block hashes derived from the heights and an id for the branch of the fork
+    Sha256Calculator sha256calculator;
+    sha256calculator.push_data(std::to_string(height) + "/" + std::to_string(branch));
+    const std::string hash = sha256calculator.getHashAndReset();
+    return uint256(boost::algorithm::hex(hash));
+}
+
+CBlockIndex MakeBlockIndex(const int height, const int branch, const uint256& hashPrev)
+{
+    CBlockIndex bi;
+    bi.blockHash      = HashFromHeightAndBranch(height, branch);
+    bi.hashPrev       = hashPrev;
+    bi.nHeight        = height;
+    bi.nTime          = static_cast<uint32_t>(height * 10);
+    bi.nStakeModifier = static_cast<uint64_t>(height) * 1000 + branch;
+    bi.nChainTrust    = height;
+    return bi;
+}
+
+/**
+ * creates a main chain of mainLength blocks (branch 0), and a fork (branch 1) that starts after
+ * forkHeight with forkLength blocks
+ */
+std::map<uint256, CBlockIndex> MakeChainWithFork(int mainLength, int forkHeight, int forkLength)
+{
+    std::map<uint256, CBlockIndex> result;
+    uint256                        prev = 0;
+    for (int h = 0; h < mainLength; h++) {
+        CBlockIndex bi = MakeBlockIndex(h, 0, prev);
+        if (h + 1 < mainLength) {
+            bi.hashNext = HashFromHeightAndBranch(h + 1, 0);
+        }
+        result[bi.blockHash] = bi;
+        prev                 = bi.blockHash;
+    }
+    prev = HashFromHeightAndBranch(forkHeight, 0);
+    for (int h = forkHeight + 1; h <= forkHeight + forkLength; h++) {
+        const CBlockIndex bi = MakeBlockIndex(h, 1, prev);
+        result[bi.blockHash] = bi;
+        prev                 = bi.blockHash;
+    }
+    return result;
+}
+
+} // namespace
+
+TEST(BlockIndexCatalog, load_and_walk)
+{
+    const int                            mainLength = 1000;
+    const std::map<uint256, CBlockIndex> allEntries = MakeChainWithFork(mainLength, 500, 20);
+
+    mTxDB dbMock;
+    EXPECT_CALL(dbMock, ReadAllBlockIndexEntries()).WillOnce(testing::Return(allEntries));
+    EXPECT_CALL(dbMock, GetBestBlockHash())
+        .WillOnce(testing::Return(HashFromHeightAndBranch(mainLength - 1, 0)));
+
+    BlockIndexCatalog catalog;
+    EXPECT_FALSE(catalog.isLoaded());
+    ASSERT_TRUE(catalog.loadFromDB(dbMock));
+    EXPECT_TRUE(catalog.isLoaded());
+    EXPECT_EQ(catalog.size(), allEntries.size());
+
+    // every entry is retrieved exactly as it was written
+    for (const auto& p : allEntries) {
+        const boost::optional<CBlockIndex> bi = catalog.get(p.first);
+        ASSERT_TRUE(bi);
+        EXPECT_EQ(bi->blockHash, p.second.blockHash);
+        EXPECT_EQ(bi->hashPrev, p.second.hashPrev);
+        EXPECT_EQ(bi->hashNext, p.second.hashNext);
+        EXPECT_EQ(bi->nHeight, p.second.nHeight);
+        EXPECT_EQ(bi->nTime, p.second.nTime);
+        EXPECT_EQ(bi->nStakeModifier, p.second.nStakeModifier);
+        EXPECT_EQ(bi->nChainTrust, p.second.nChainTrust);
+    }
+    EXPECT_FALSE(catalog.get(HashFromHeightAndBranch(mainLength, 0)));
+
+    // the main chain is rebuilt from the tip
+    for (int h = 0; h < mainLength; h++) {
+        const boost::optional<uint256> hash = catalog.getMainChainHash(h);
+        ASSERT_TRUE(hash);
+        EXPECT_EQ(*hash, HashFromHeightAndBranch(h, 0));
+    }
+    EXPECT_FALSE(catalog.getMainChainHash(mainLength));
+
+    // ancestors
+    const uint256 tip = HashFromHeightAndBranch(mainLength - 1, 0);
+    for (int h = 0; h < mainLength; h += 7) {
+        const boost::optional<CBlockIndex> ancestor = catalog.getAncestor(tip, h);
+        ASSERT_TRUE(ancestor);
+        EXPECT_EQ(ancestor->blockHash, HashFromHeightAndBranch(h, 0));
+    }
+    EXPECT_FALSE(catalog.getAncestor(tip, mainLength));
+
+    const uint256 forkTip = HashFromHeightAndBranch(520, 1);
+    EXPECT_EQ(catalog.getAncestor(forkTip, 510)->blockHash, HashFromHeightAndBranch(510, 1));
+    EXPECT_EQ(catalog.getAncestor(forkTip, 500)->blockHash, HashFromHeightAndBranch(500, 0));
+    EXPECT_EQ(catalog.getAncestor(forkTip, 3)->blockHash, HashFromHeightAndBranch(3, 0));
+
+    // fork point
+    EXPECT_EQ(catalog.findFork(tip, forkTip)->blockHash, HashFromHeightAndBranch(500, 0));
+    EXPECT_EQ(catalog.findFork(forkTip, tip)->blockHash, HashFromHeightAndBranch(500, 0));
+    EXPECT_EQ(catalog.findFork(tip, tip)->blockHash, tip);
+
+    catalog.clear();
+    EXPECT_FALSE(catalog.isLoaded());
+    EXPECT_EQ(catalog.size(), 0u);
+}
+
+TEST(BlockIndexCatalog, pending_changes)
+{
+    const std::map<uint256, CBlockIndex> allEntries = MakeChainWithFork(10, 5, 0);
+
+    mTxDB dbMock;
+    EXPECT_CALL(dbMock, ReadAllBlockIndexEntries()).WillOnce(testing::Return(allEntries));
+    EXPECT_CALL(dbMock, GetBestBlockHash()).WillOnce(testing::Return(HashFromHeightAndBranch(9, 0)));
+
+    BlockIndexCatalog catalog;
+    ASSERT_TRUE(catalog.loadFromDB(dbMock));
+
+    // connect a new block, like ConnectBlock() would do in a db transaction
+    BlockIndexCatalog::PendingChanges changes;
+    CBlockIndex newTip = MakeBlockIndex(10, 0, HashFromHeightAndBranch(9, 0));
+    CBlockIndex oldTip = *catalog.get(HashFromHeightAndBranch(9, 0));
+    oldTip.hashNext    = newTip.blockHash;
+    changes.addBlockIndex(newTip);
+    changes.addBlockIndex(oldTip);
+    changes.setMainChainHash(10, newTip.blockHash);
+
+    EXPECT_TRUE(changes.getBlockIndex(newTip.blockHash));
+    EXPECT_EQ(*changes.getMainChainHash(10), newTip.blockHash);
+    EXPECT_FALSE(changes.getMainChainHash(9));
+
+    // nothing is visible before the changes are applied
+    EXPECT_FALSE(catalog.get(newTip.blockHash));
+    EXPECT_FALSE(catalog.getMainChainHash(10));
+    EXPECT_EQ(catalog.get(oldTip.blockHash)->hashNext, uint256(0));
+
+    changes.applyTo(catalog);
+    ASSERT_TRUE(catalog.get(newTip.blockHash));
+    EXPECT_EQ(catalog.get(newTip.blockHash)->hashPrev, oldTip.blockHash);
+    EXPECT_EQ(catalog.get(oldTip.blockHash)->hashNext, newTip.blockHash);
+    EXPECT_EQ(*catalog.getMainChainHash(10), newTip.blockHash);
+    EXPECT_EQ(catalog.getAncestor(newTip.blockHash, 2)->blockHash, HashFromHeightAndBranch(2, 0));
+
+    // disconnect it again
+    BlockIndexCatalog::PendingChanges disconnectChanges;
+    oldTip.hashNext = 0;
+    disconnectChanges.addBlockIndex(oldTip);
+    disconnectChanges.eraseMainChainHeight(10);
+    EXPECT_EQ(*disconnectChanges.getMainChainHash(10), uint256(0));
+    disconnectChanges.applyTo(catalog);
+    EXPECT_EQ(catalog.get(oldTip.blockHash)->hashNext, uint256(0));
+    EXPECT_FALSE(catalog.getMainChainHash(10));
+    EXPECT_EQ(*catalog.getMainChainHash(9), oldTip.blockHash);
+}
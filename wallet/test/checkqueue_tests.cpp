@@ -0,0 +1,149 @@
+#include "googletest/googletest/include/gtest/gtest.h"
+
+#include "checkqueue.h"
+
+#include <atomic>
+#include <vector>
+
+namespace {
+
+std::atomic<int> checksDone{0};
+
+struct FakeCheck
+{
+    bool fOk = true;
+    int  id  = -1;
+
+    FakeCheck() = default;
+    FakeCheck(bool ok, int idIn) : fOk(ok), id(idIn) {}
+
+    bool operator()()
+    {
+        checksDone++;
+        return fOk;
+    }
+
+    void swap(FakeCheck& other)
+    {
+        std::swap(fOk, other.fOk);
+        std::swap(id, other.id);
+    }
+};
+
+void swap(FakeCheck& a, FakeCheck& b) { a.swap(b); }
+
+std::vector<FakeCheck> MakeChecks(int count, int failingId = -1)
+{
+    std::vector<FakeCheck> result;
+    for (int i = 0; i < count; i++) {
+        result.push_back(FakeCheck(i != failingId, i));
+    }
+    return result;
+}
+
+} // namespace
+
+TEST(checkqueue_tests, all_checks_pass)
+{
+    CCheckQueue<FakeCheck> queue(128);
+    queue.StartWorkerThreads(3);
+    EXPECT_EQ(queue.WorkerThreadsCount(), 3);
+
+    for (int round = 0; round < 20; round++) {
+        checksDone = 0;
+        CCheckQueueControl<FakeCheck> control(&queue);
+        EXPECT_TRUE(control.IsActive());
+        // add the checks in batches, like ConnectBlock() does per transaction
+        for (int i = 0; i < 100; i++) {
+            std::vector<FakeCheck> vChecks = MakeChecks(i % 7);
+            control.Add(vChecks);
+        }
+        boost::optional<FakeCheck> failedCheck;
+        EXPECT_TRUE(control.Wait(failedCheck));
+        EXPECT_FALSE(failedCheck);
+        int expectedCount = 0;
+        for (int i = 0; i < 100; i++) {
+            expectedCount += i % 7;
+        }
+        EXPECT_EQ(checksDone.load(), expectedCount);
+    }
+
+    queue.StopWorkerThreads();
+    EXPECT_EQ(queue.WorkerThreadsCount(), 0);
+}
+
+TEST(checkqueue_tests, failure_is_reported)
+{
+    CCheckQueue<FakeCheck> queue(16);
+    queue.StartWorkerThreads(4);
+
+    {
+        CCheckQueueControl<FakeCheck> control(&queue);
+        std::vector<FakeCheck>        vChecks = MakeChecks(1000, 537);
+        control.Add(vChecks);
+        boost::optional<FakeCheck> failedCheck;
+        EXPECT_FALSE(control.Wait(failedCheck));
+        ASSERT_TRUE(failedCheck);
+        EXPECT_EQ(failedCheck->id, 537);
+    }
+
+    // the failure doesn't leak into the next batch
+    {
+        CCheckQueueControl<FakeCheck> control(&queue);
+        std::vector<FakeCheck>        vChecks = MakeChecks(1000);
+        control.Add(vChecks);
+        boost::optional<FakeCheck> failedCheck;
+        EXPECT_TRUE(control.Wait(failedCheck));
+        EXPECT_FALSE(failedCheck);
+    }
+}
+
+TEST(checkqueue_tests, reused_vector)
+{
+    CCheckQueue<FakeCheck> queue(16);
+    queue.StartWorkerThreads(2);
+
+    checksDone = 0;
+    {
+        // the same vector for every batch; the checks of a batch must run once
+        CCheckQueueControl<FakeCheck> control(&queue);
+        std::vector<FakeCheck>        vChecks;
+        for (int i = 0; i < 10; i++) {
+            vChecks = MakeChecks(3);
+            vChecks.push_back(FakeCheck(true, i));
+            control.Add(vChecks);
+            EXPECT_TRUE(vChecks.empty());
+            vChecks.push_back(FakeCheck(true, 100 + i));
+            control.Add(vChecks);
+            EXPECT_TRUE(vChecks.empty());
+        }
+        boost::optional<FakeCheck> failedCheck;
+        EXPECT_TRUE(control.Wait(failedCheck));
+        EXPECT_FALSE(failedCheck);
+    }
+    EXPECT_EQ(checksDone.load(), 10 * 5);
+}
+
+TEST(checkqueue_tests, control_waits_on_destruction)
+{
+    CCheckQueue<FakeCheck> queue(16);
+    queue.StartWorkerThreads(2);
+
+    checksDone = 0;
+    {
+        // an early return from the caller must not leave checks running behind it
+        CCheckQueueControl<FakeCheck> control(&queue);
+        std::vector<FakeCheck>        vChecks = MakeChecks(5000);
+        control.Add(vChecks);
+    }
+    EXPECT_EQ(checksDone.load(), 5000);
+}
+
+TEST(checkqueue_tests, inactive_control)
+{
+    CCheckQueueControl<FakeCheck> control(nullptr);
+    EXPECT_FALSE(control.IsActive());
+    std::vector<FakeCheck> vChecks = MakeChecks(10, 3);
+    control.Add(vChecks);
+    EXPECT_TRUE(control.Wait());
+}
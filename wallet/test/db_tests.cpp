@@ -8,6 +8,7 @@
 #include "hash.h"
 #include "ntp1/ntp1tools.h"
 #include "txdb-lmdb.h"
+#include <algorithm>
 #include <boost/algorithm/string.hpp>
 #include <fstream>
 #include <unordered_map>
@@ -316,6 +317,49 @@ static void TestReadWriteUnique(IDB* db, const std::map<std::string, std::string
         EXPECT_EQ(v.second, *r);
     }
 
+    // views give the same data as reads, and the function's return value is passed on
+    for (const auto& v : data) {
+        const std::size_t offset = rand() % (v.second.size() + 1);
+        std::string       viewed;
+        EXPECT_TRUE(db->readView(IDB::Index::DB_MAIN_INDEX, v.first,
+                                 [&viewed](const char* d, std::size_t s) {
+                                     viewed.assign(d, s);
+                                     return true;
+                                 },
+                                 offset));
+        EXPECT_EQ(v.second.substr(offset), viewed);
+        EXPECT_FALSE(db->readView(IDB::Index::DB_MAIN_INDEX, v.first,
+                                  [](const char*, std::size_t) { return false; }));
+    }
+
+    {
+        // batch read, with a key that doesn't exist in the middle
+        std::vector<std::string> keys;
+        for (const auto& v : data) {
+            keys.push_back(v.first);
+        }
+        const std::string missingKey = "NonExistentKey" + GeneratePseudoRandomString(20);
+        keys.insert(keys.begin() + keys.size() / 2, missingKey);
+        std::reverse(keys.begin(), keys.end());
+
+        std::vector<boost::optional<std::string>> viewed(keys.size());
+        EXPECT_TRUE(db->readBatch(IDB::Index::DB_MAIN_INDEX, keys,
+                                  [&viewed](std::size_t i, const char* d, std::size_t s) {
+                                      viewed[i] = std::string(d, s);
+                                      return true;
+                                  }));
+        for (std::size_t i = 0; i < keys.size(); i++) {
+            if (keys[i] == missingKey) {
+                EXPECT_FALSE(viewed[i]);
+            } else {
+                ASSERT_TRUE(viewed[i]);
+                EXPECT_EQ(data.at(keys[i]), *viewed[i]);
+            }
+        }
+        EXPECT_FALSE(db->readBatch(IDB::Index::DB_MAIN_INDEX, keys,
+                                   [](std::size_t, const char*, std::size_t) { return false; }));
+    }
+
     static constexpr std::size_t MAX_OFFSET_TESTS = 100;
     static constexpr std::size_t MAX_SIZE_TESTS   = 100;
 
@@ -359,6 +403,8 @@ static void TestReadWriteUnique(IDB* db, const std::map<std::string, std::string
             // value doesn't exist anymore, let's verify that
             EXPECT_FALSE(db->exists(IDB::Index::DB_MAIN_INDEX, key));
             EXPECT_EQ(db->read(IDB::Index::DB_MAIN_INDEX, key), boost::none);
+            EXPECT_FALSE(db->readView(IDB::Index::DB_MAIN_INDEX, key,
+                                      [](const char*, std::size_t) { return true; }));
         }
     }
 
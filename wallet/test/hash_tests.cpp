@@ -43,3 +43,30 @@ TEST(hash_tests, murmurhash3)
 
 #undef T
 }
+
+TEST(hash_tests, block_pow_hash_memoization)
+{
+    CBlock block = Params().GenesisBlock();
+
+    const uint256  expected    = scrypt_blockhash(CVOIDBEGIN(block.nVersion));
+    const uint64_t countBefore = scrypt_blockhash_invocations_count();
+    EXPECT_EQ(block.GetHash(), expected);
+    EXPECT_EQ(block.GetHash(), expected);
+    EXPECT_EQ(block.GetPoWHash(), expected);
+    EXPECT_EQ(scrypt_blockhash_invocations_count(), countBefore + 1);
+
+    // copies carry the cached hash
+    const CBlock blockCopy = block;
+    EXPECT_EQ(blockCopy.GetHash(), expected);
+    EXPECT_EQ(scrypt_blockhash_invocations_count(), countBefore + 1);
+
+    // modifying the header invalidates the cached hash
+    block.nNonce++;
+    const uint256 expectedAfterNonce = scrypt_blockhash(CVOIDBEGIN(block.nVersion));
+    EXPECT_NE(expectedAfterNonce, expected);
+    EXPECT_EQ(block.GetHash(), expectedAfterNonce);
+    EXPECT_EQ(blockCopy.GetHash(), expected);
+
+    block.nNonce--;
+    EXPECT_EQ(block.GetHash(), expected);
+}
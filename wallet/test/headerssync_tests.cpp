@@ -0,0 +1,430 @@
+#include "googletest/googletest/include/gtest/gtest.h"
+
+#include "bignum.h"
+#include "block.h"
+#include "blockindex.h"
+#include "chainparams.h"
+#include "headerssync.h"
+#include "main.h"
+#include "mocks/mtxdb.h"
+#include "ntp1/ntp1transaction.h"
+
+#include <map>
+
+using ::testing::_;
+using ::testing::Invoke;
+using ::testing::NiceMock;
+
+namespace {
+
+// far after the checkpoints
+const int     BaseHeight = 50000000;
+const int64_t Now        = 1600000000;
+// the time of the first header of a chain; every next header is a second later
+const int64_t HeadersTime = Now - 100000;
+
+// a tx db with the blocks we have in a map
+class HeadersSyncDB
+{
+public:
+    std::map<uint256, CBlockIndex> blocks;
+
+    NiceMock<mTxDB> txdb;
+
+    HeadersSyncDB()
+    {
+        ON_CALL(txdb, ReadBlockIndex(_))
+            .WillByDefault(Invoke([this](const uint256& hash) -> boost::optional<CBlockIndex> {
+                const auto it = blocks.find(hash);
+                if (it == blocks.cend()) {
+                    return boost::none;
+                }
+                return it->second;
+            }));
+    }
+
+    void addBlock(const uint256& hash, int height)
+    {
+        CBlockIndex index;
+        index.nHeight = height;
+        blocks[hash]  = index;
+    }
+};
+
+// a chain of headers after prevHash, with increasing times from the given one
+std::vector<CBlock> MakeHeaders(const uint256& prevHash, unsigned count, int64_t time = HeadersTime)
+{
+    std::vector<CBlock> result;
+    uint256             prev = prevHash;
+    for (unsigned i = 0; i < count; i++) {
+        CBlock header;
+        header.hashPrevBlock  = prev;
+        header.hashMerkleRoot = GetRandHash();
+        header.nTime          = static_cast<uint32_t>(time + i);
+        header.nBits          = Params().PoSLimit().GetCompact();
+        result.push_back(header);
+        prev = header.GetHash();
+    }
+    return result;
+}
+
+} // namespace
+
+TEST(headerssync_tests, accept_headers)
+{
+    HeadersSyncDB db;
+    CBlock        tipHeader;
+    tipHeader.hashPrevBlock = GetRandHash();
+    const uint256 tip       = tipHeader.GetHash();
+    db.addBlock(tip, BaseHeight);
+
+    HeadersSync               sync;
+    const std::vector<CBlock> headers = MakeHeaders(tip, 10);
+
+    // headers that weren't asked for
+    EXPECT_EQ(sync.acceptHeaders(1, headers, db.txdb, Now), HeadersSync::HeadersResult::Unrequested);
+    EXPECT_FALSE(sync.isActive());
+
+    ASSERT_TRUE(sync.requestHeaders(1, Now));
+    // only one sync peer
+    EXPECT_FALSE(sync.requestHeaders(2, Now));
+    ASSERT_TRUE(sync.getSyncPeer());
+    EXPECT_EQ(*sync.getSyncPeer(), 1);
+
+    // the header of a block we have comes first, and is skipped
+    std::vector<CBlock> withTip = headers;
+    withTip.insert(withTip.begin(), tipHeader);
+
+    ASSERT_EQ(sync.acceptHeaders(1, withTip, db.txdb, Now), HeadersSync::HeadersResult::Accepted);
+    EXPECT_EQ(sync.headersHeight(), BaseHeight + 10);
+    ASSERT_TRUE(sync.lastHeaderHash());
+    EXPECT_EQ(*sync.lastHeaderHash(), headers.back().GetHash());
+    EXPECT_TRUE(sync.isActive());
+
+    // the same headers again are skipped
+    ASSERT_TRUE(sync.requestHeaders(1, Now));
+    ASSERT_EQ(sync.acceptHeaders(1, headers, db.txdb, Now), HeadersSync::HeadersResult::Accepted);
+    EXPECT_EQ(sync.headersHeight(), BaseHeight + 10);
+
+    // the next headers link to the last one
+    const std::vector<CBlock> more =
+        MakeHeaders(headers.back().GetHash(), 5, headers.back().GetBlockTime() + 1);
+    ASSERT_TRUE(sync.requestHeaders(1, Now));
+    ASSERT_EQ(sync.acceptHeaders(1, more, db.txdb, Now), HeadersSync::HeadersResult::Accepted);
+    EXPECT_EQ(sync.headersHeight(), BaseHeight + 15);
+}
+
+TEST(headerssync_tests, reject_headers)
+{
+    HeadersSyncDB db;
+    const uint256 tip = GetRandHash();
+    db.addBlock(tip, BaseHeight);
+
+    {
+        // headers that don't connect to a block we have drop the sync peer
+        HeadersSync sync;
+        ASSERT_TRUE(sync.requestHeaders(1, Now));
+        EXPECT_EQ(sync.acceptHeaders(1, MakeHeaders(GetRandHash(), 10), db.txdb, Now),
+                  HeadersSync::HeadersResult::Unconnected);
+        EXPECT_FALSE(sync.getSyncPeer());
+        EXPECT_EQ(sync.headersHeight(), -1);
+    }
+    {
+        // headers that don't connect to the header chain
+        HeadersSync sync;
+        ASSERT_TRUE(sync.requestHeaders(1, Now));
+        ASSERT_EQ(sync.acceptHeaders(1, MakeHeaders(tip, 10), db.txdb, Now),
+                  HeadersSync::HeadersResult::Accepted);
+        ASSERT_TRUE(sync.requestHeaders(1, Now));
+        EXPECT_EQ(sync.acceptHeaders(1, MakeHeaders(GetRandHash(), 10), db.txdb, Now),
+                  HeadersSync::HeadersResult::Unconnected);
+        // the header chain is kept for the next sync peer
+        EXPECT_EQ(sync.headersHeight(), BaseHeight + 10);
+    }
+    {
+        // headers too far in the future reset the sync
+        HeadersSync sync;
+        ASSERT_TRUE(sync.requestHeaders(1, Now));
+        ASSERT_EQ(sync.acceptHeaders(1, MakeHeaders(tip, 10), db.txdb, Now),
+                  HeadersSync::HeadersResult::Accepted);
+        ASSERT_TRUE(sync.requestHeaders(1, Now));
+        const uint256 last = *sync.lastHeaderHash();
+        EXPECT_EQ(sync.acceptHeaders(1, MakeHeaders(last, 10, FutureDrift(Now) + 1), db.txdb, Now),
+                  HeadersSync::HeadersResult::Invalid);
+        EXPECT_FALSE(sync.isActive());
+        EXPECT_EQ(sync.headersHeight(), -1);
+    }
+}
+
+TEST(headerssync_tests, reject_header_fields)
+{
+    HeadersSyncDB db;
+    const uint256 tip = GetRandHash();
+    db.addBlock(tip, BaseHeight);
+
+    const auto accept = [&db](std::vector<CBlock> headers) {
+        HeadersSync sync;
+        EXPECT_TRUE(sync.requestHeaders(1, Now));
+        const HeadersSync::HeadersResult result = sync.acceptHeaders(1, headers, db.txdb, Now);
+        if (result == HeadersSync::HeadersResult::Invalid) {
+            EXPECT_FALSE(sync.isActive());
+        }
+        return result;
+    };
+
+    std::vector<CBlock> headers = MakeHeaders(tip, 20);
+    ASSERT_EQ(accept(headers), HeadersSync::HeadersResult::Accepted);
+
+    // no target
+    headers = MakeHeaders(tip, 20);
+    headers[5].nBits = 0;
+    EXPECT_EQ(accept(headers), HeadersSync::HeadersResult::Invalid);
+
+    // a target above the proof-of-stake limit, after the last proof-of-work block
+    headers = MakeHeaders(tip, 20);
+    headers[5].nBits = (Params().PoSLimit() << 1).GetCompact();
+    EXPECT_EQ(accept(headers), HeadersSync::HeadersResult::Invalid);
+
+    // a time before the median time past of the previous headers
+    headers = MakeHeaders(tip, 20);
+    headers[15].nTime = headers[8].nTime;
+    EXPECT_EQ(accept(headers), HeadersSync::HeadersResult::Invalid);
+
+    // the median time past of the first header is that of the blocks we have
+    db.blocks[tip].nTime = static_cast<uint32_t>(HeadersTime + 1);
+    EXPECT_EQ(accept(MakeHeaders(tip, 20)), HeadersSync::HeadersResult::Invalid);
+}
+
+TEST(headerssync_tests, bogus_header_chain)
+{
+    HeadersSyncDB db;
+    const uint256 tip = GetRandHash();
+    db.addBlock(tip, BaseHeight);
+
+    // peer 1 sends headers whose blocks nobody has
+    HeadersSync sync;
+    ASSERT_TRUE(sync.requestHeaders(1, Now));
+    const std::vector<CBlock> headers = MakeHeaders(tip, 100);
+    ASSERT_EQ(sync.acceptHeaders(1, headers, db.txdb, Now), HeadersSync::HeadersResult::Accepted);
+
+    // peer 2 says it doesn't have the first block, so it's not asked for it again
+    ASSERT_FALSE(sync.blocksToRequest(2, BaseHeight + 10000, Now).empty());
+    EXPECT_FALSE(sync.blockNotFound(3, headers[0].GetHash()));
+    EXPECT_TRUE(sync.blockNotFound(2, headers[0].GetHash()));
+    EXPECT_FALSE(sync.blockNotFound(2, headers[0].GetHash()));
+    EXPECT_TRUE(sync.blocksToRequest(2, BaseHeight + 10000, Now).empty());
+    EXPECT_FALSE(sync.takeUnfetchableHeadersPeer());
+
+    // peers 3 and 4 don't deliver it in time; they aren't blamed, the headers are
+    std::vector<uint256> blocks = sync.blocksToRequest(3, BaseHeight + 10000, Now);
+    ASSERT_FALSE(blocks.empty());
+    EXPECT_EQ(blocks.front(), headers[0].GetHash());
+    EXPECT_TRUE(sync.timeOutBlockRequests(3, Now + HeadersSync::BlockDownloadTimeout + 1));
+    EXPECT_FALSE(sync.takeUnfetchableHeadersPeer());
+
+    blocks = sync.blocksToRequest(4, BaseHeight + 10000, Now);
+    ASSERT_FALSE(blocks.empty());
+    EXPECT_EQ(blocks.front(), headers[0].GetHash());
+    EXPECT_TRUE(sync.timeOutBlockRequests(4, Now + HeadersSync::BlockDownloadTimeout + 1));
+
+    const boost::optional<int64_t> blamed = sync.takeUnfetchableHeadersPeer();
+    ASSERT_TRUE(blamed);
+    EXPECT_EQ(*blamed, 1);
+    EXPECT_FALSE(sync.takeUnfetchableHeadersPeer());
+
+    // the sync starts over, without peer 1
+    EXPECT_FALSE(sync.isActive());
+    EXPECT_EQ(sync.blocksInFlight(), 0u);
+    EXPECT_FALSE(sync.requestHeaders(1, Now));
+    EXPECT_TRUE(sync.requestHeaders(2, Now));
+}
+
+TEST(headerssync_tests, download_window)
+{
+    HeadersSyncDB db;
+    const uint256 tip = GetRandHash();
+    db.addBlock(tip, BaseHeight);
+
+    HeadersSync sync;
+    ASSERT_TRUE(sync.requestHeaders(1, Now));
+    const std::vector<CBlock> headers = MakeHeaders(tip, HeadersSync::WindowSize + 100);
+    ASSERT_EQ(sync.acceptHeaders(1, headers, db.txdb, Now), HeadersSync::HeadersResult::Accepted);
+
+    // each peer gets different blocks, up to the limit per peer
+    const std::vector<uint256> blocks1 = sync.blocksToRequest(1, BaseHeight + 10000, Now);
+    ASSERT_EQ(blocks1.size(), static_cast<std::size_t>(HeadersSync::MaxBlocksInFlightPerPeer));
+    EXPECT_EQ(blocks1.front(), headers[0].GetHash());
+    EXPECT_TRUE(sync.blocksToRequest(1, BaseHeight + 10000, Now).empty());
+
+    const std::vector<uint256> blocks2 = sync.blocksToRequest(2, BaseHeight + 10000, Now);
+    ASSERT_EQ(blocks2.size(), static_cast<std::size_t>(HeadersSync::MaxBlocksInFlightPerPeer));
+    EXPECT_EQ(blocks2.front(), headers[HeadersSync::MaxBlocksInFlightPerPeer].GetHash());
+
+    // a peer isn't asked for blocks after its best block
+    EXPECT_TRUE(sync.blocksToRequest(3, BaseHeight, Now).empty());
+    EXPECT_TRUE(sync.blocksToRequest(3, BaseHeight + 2 * HeadersSync::MaxBlocksInFlightPerPeer, Now)
+                    .empty());
+    EXPECT_EQ(sync.blocksInFlight(), 2u * HeadersSync::MaxBlocksInFlightPerPeer);
+
+    // blocks after the window aren't requested nor taken
+    const CBlock& afterWindow = headers[HeadersSync::WindowSize];
+    EXPECT_FALSE(sync.takeBlock(1, afterWindow.GetHash(), afterWindow));
+    for (int i = 0; i < HeadersSync::WindowSize / HeadersSync::MaxBlocksInFlightPerPeer; i++) {
+        sync.blocksToRequest(100 + i, BaseHeight + 10000, Now);
+    }
+    EXPECT_EQ(sync.blocksInFlight(), static_cast<std::size_t>(HeadersSync::WindowSize));
+
+    // blocks that aren't in the header chain
+    EXPECT_FALSE(sync.takeBlock(1, GetRandHash(), CBlock()));
+}
+
+TEST(headerssync_tests, blocks_connect_in_order)
+{
+    HeadersSyncDB db;
+    const uint256 tip = GetRandHash();
+    db.addBlock(tip, BaseHeight);
+
+    HeadersSync sync;
+    ASSERT_TRUE(sync.requestHeaders(1, Now));
+    const std::vector<CBlock> headers = MakeHeaders(tip, 5);
+    ASSERT_EQ(sync.acceptHeaders(1, headers, db.txdb, Now), HeadersSync::HeadersResult::Accepted);
+    ASSERT_EQ(sync.blocksToRequest(1, BaseHeight + 5, Now).size(), 5u);
+
+    // the last blocks arrive first, and wait for the first one
+    EXPECT_TRUE(sync.takeBlock(1, headers[3].GetHash(), headers[3]));
+    EXPECT_TRUE(sync.takeBlock(1, headers[1].GetHash(), headers[1]));
+    EXPECT_FALSE(sync.popNextBlock(db.txdb));
+    EXPECT_EQ(sync.blocksWaiting(), 2u);
+    EXPECT_EQ(sync.blocksInFlight(), 3u);
+
+    EXPECT_TRUE(sync.takeBlock(2, headers[0].GetHash(), headers[0]));
+    boost::optional<HeadersSync::ReceivedBlock> block = sync.popNextBlock(db.txdb);
+    ASSERT_TRUE(block);
+    EXPECT_EQ(block->block.GetHash(), headers[0].GetHash());
+    EXPECT_EQ(block->nodeid, 2);
+    db.addBlock(headers[0].GetHash(), BaseHeight + 1);
+    block = sync.popNextBlock(db.txdb);
+    ASSERT_TRUE(block);
+    EXPECT_EQ(block->block.GetHash(), headers[1].GetHash());
+    EXPECT_EQ(block->nodeid, 1);
+    db.addBlock(headers[1].GetHash(), BaseHeight + 2);
+    EXPECT_FALSE(sync.popNextBlock(db.txdb));
+
+    // a block that was connected otherwise is skipped, and so is one that arrived here too, which
+    // doesn't count as a failure
+    db.addBlock(headers[2].GetHash(), BaseHeight + 3);
+    db.addBlock(headers[3].GetHash(), BaseHeight + 4);
+    EXPECT_FALSE(sync.popNextBlock(db.txdb));
+    EXPECT_EQ(sync.blocksWaiting(), 0u);
+
+    EXPECT_TRUE(sync.takeBlock(1, headers[4].GetHash(), headers[4]));
+    block = sync.popNextBlock(db.txdb);
+    ASSERT_TRUE(block);
+    EXPECT_EQ(block->block.GetHash(), headers[4].GetHash());
+    EXPECT_EQ(sync.headersHeight(), -1);
+    EXPECT_EQ(sync.blocksInFlight(), 0u);
+    EXPECT_EQ(sync.blocksWaiting(), 0u);
+
+    // all the headers were received, since there were fewer than the maximum
+    EXPECT_TRUE(sync.isCompleteWith(1));
+    EXPECT_FALSE(sync.isCompleteWith(2));
+}
+
+TEST(headerssync_tests, failed_block)
+{
+    HeadersSyncDB db;
+    const uint256 tip = GetRandHash();
+    db.addBlock(tip, BaseHeight);
+
+    // peer 1 sends the headers, and peer 2 the first block, which fails to connect
+    HeadersSync sync;
+    ASSERT_TRUE(sync.requestHeaders(1, Now));
+    const std::vector<CBlock> headers = MakeHeaders(tip, 10);
+    ASSERT_EQ(sync.acceptHeaders(1, headers, db.txdb, Now), HeadersSync::HeadersResult::Accepted);
+    ASSERT_FALSE(sync.blocksToRequest(2, BaseHeight + 10, Now).empty());
+    EXPECT_TRUE(sync.takeBlock(2, headers[1].GetHash(), headers[1]));
+    EXPECT_TRUE(sync.takeBlock(2, headers[0].GetHash(), headers[0]));
+
+    const boost::optional<HeadersSync::ReceivedBlock> block = sync.popNextBlock(db.txdb);
+    ASSERT_TRUE(block);
+    EXPECT_EQ(block->nodeid, 2);
+
+    // the sync starts over, and the headers of peer 1 aren't taken again, so that the same block isn't
+    // downloaded to fail again
+    const boost::optional<int64_t> blamed = sync.blockFailed();
+    ASSERT_TRUE(blamed);
+    EXPECT_EQ(*blamed, 1);
+    EXPECT_FALSE(sync.isActive());
+    EXPECT_EQ(sync.blocksInFlight(), 0u);
+    EXPECT_EQ(sync.blocksWaiting(), 0u);
+    EXPECT_EQ(sync.headersHeight(), -1);
+    EXPECT_FALSE(sync.popNextBlock(db.txdb));
+
+    EXPECT_FALSE(sync.requestHeaders(1, Now));
+    EXPECT_EQ(sync.acceptHeaders(1, headers, db.txdb, Now), HeadersSync::HeadersResult::Unrequested);
+    EXPECT_TRUE(sync.requestHeaders(3, Now));
+}
+
+TEST(headerssync_tests, stalling_peers)
+{
+    HeadersSyncDB db;
+    const uint256 tip = GetRandHash();
+    db.addBlock(tip, BaseHeight);
+
+    HeadersSync sync;
+    ASSERT_TRUE(sync.requestHeaders(1, Now));
+    const std::vector<CBlock> headers = MakeHeaders(tip, HeadersSync::WindowSize);
+    ASSERT_EQ(sync.acceptHeaders(1, headers, db.txdb, Now), HeadersSync::HeadersResult::Accepted);
+
+    ASSERT_FALSE(sync.blocksToRequest(1, BaseHeight + 10000, Now).empty());
+    EXPECT_FALSE(sync.timeOutBlockRequests(1, Now + HeadersSync::BlockDownloadTimeout));
+    EXPECT_TRUE(sync.timeOutBlockRequests(1, Now + HeadersSync::BlockDownloadTimeout + 1));
+    EXPECT_EQ(sync.blocksInFlight(), 0u);
+    // the peer isn't disconnected, but isn't asked for blocks for a while
+    EXPECT_TRUE(sync.blocksToRequest(1, BaseHeight + 10000, Now + HeadersSync::BlockDownloadTimeout + 2)
+                    .empty());
+    EXPECT_FALSE(
+        sync.blocksToRequest(1, BaseHeight + 10000, Now + 2 * HeadersSync::BlockDownloadTimeout + 1)
+            .empty());
+    sync.peerDisconnected(1);
+
+    // the blocks are given to another peer
+    const std::vector<uint256> blocks2 = sync.blocksToRequest(2, BaseHeight + 10000, Now);
+    ASSERT_FALSE(blocks2.empty());
+    EXPECT_EQ(blocks2.front(), headers[0].GetHash());
+
+    // while half the window waits for the first block, its peer has less time to deliver it
+    for (int i = 0; i < HeadersSync::WindowSize / HeadersSync::MaxBlocksInFlightPerPeer; i++) {
+        for (const uint256& hash : sync.blocksToRequest(100 + i, BaseHeight + 10000, Now)) {
+            for (const CBlock& header : headers) {
+                if (header.GetHash() == hash) {
+                    sync.takeBlock(100 + i, hash, header);
+                }
+            }
+        }
+    }
+    ASSERT_GE(sync.blocksWaiting(), static_cast<std::size_t>(HeadersSync::WindowSize / 2));
+    EXPECT_FALSE(sync.timeOutBlockRequests(2, Now + HeadersSync::WindowStallTimeout));
+    EXPECT_TRUE(sync.timeOutBlockRequests(2, Now + HeadersSync::WindowStallTimeout + 1));
+
+    // a disconnected peer releases its requests
+    ASSERT_FALSE(sync.blocksToRequest(3, BaseHeight + 10000, Now).empty());
+    sync.peerDisconnected(3);
+    EXPECT_EQ(sync.blocksInFlight(), 0u);
+}
+
+TEST(headerssync_tests, headers_timeout)
+{
+    HeadersSync sync;
+    ASSERT_TRUE(sync.requestHeaders(1, Now));
+    EXPECT_FALSE(sync.timeOutHeadersRequest(2, Now + HeadersSync::HeadersTimeout + 1));
+    EXPECT_FALSE(sync.timeOutHeadersRequest(1, Now + HeadersSync::HeadersTimeout));
+    EXPECT_TRUE(sync.timeOutHeadersRequest(1, Now + HeadersSync::HeadersTimeout + 1));
+    EXPECT_FALSE(sync.getSyncPeer());
+
+    // another peer can become the sync peer
+    ASSERT_TRUE(sync.requestHeaders(2, Now));
+    sync.peerDisconnected(2);
+    EXPECT_FALSE(sync.getSyncPeer());
+    EXPECT_TRUE(sync.requestHeaders(3, Now));
+}
@@ -6,6 +6,7 @@
 #include <vector>
 
 #include "base58.h"
+#include "json/json_spirit_value.h"
 #include "key.h"
 #include "uint256.h"
 #include "util.h"
@@ -106,3 +107,125 @@ TEST(key_tests, key_test1)
         EXPECT_TRUE(rkey2C.GetPubKey() == key2C.GetPubKey());
     }
 }
+
+namespace {
+
+// the reference path: a new CKey for every verification
+bool VerifyWithNewKey(const vector<unsigned char>& vchPubKey, const uint256& hash,
+                      const vector<unsigned char>& vchSig)
+{
+    CKey key;
+    if (vchPubKey.empty() || !key.SetPubKey(CPubKey(vchPubKey)))
+        return false;
+    return key.Verify(hash, vchSig);
+}
+
+void ExpectSameVerification(const vector<unsigned char>& vchPubKey, const uint256& hash,
+                            const vector<unsigned char>& vchSig)
+{
+    EXPECT_EQ(CKey::VerifyWithPubKey(vchPubKey, hash, vchSig),
+              VerifyWithNewKey(vchPubKey, hash, vchSig))
+        << "pubkey: " << HexStr(vchPubKey) << "; hash: " << hash.ToString()
+        << "; sig: " << HexStr(vchSig);
+}
+
+} // namespace
+
+// In script_tests.cpp
+extern json_spirit::Array read_json(const std::string& filename);
+
+TEST(key_tests, verify_with_pubkey_equivalence)
+{
+    vector<CKey> keys(8);
+    for (unsigned i = 0; i < keys.size(); i++) {
+        keys[i].MakeNewKey(i % 2 == 0);
+    }
+
+    for (int n = 0; n < 64; n++) {
+        const CKey&                 key       = keys[n % keys.size()];
+        const CKey&                 otherKey  = keys[(n + 1) % keys.size()];
+        const vector<unsigned char> vchPubKey = key.GetPubKey().Raw();
+        const uint256               hash      = GetRandHash();
+
+        vector<unsigned char> sig;
+        ASSERT_TRUE(key.Sign(hash, sig));
+
+        EXPECT_TRUE(CKey::VerifyWithPubKey(vchPubKey, hash, sig));
+        ExpectSameVerification(vchPubKey, hash, sig);
+        ExpectSameVerification(vchPubKey, GetRandHash(), sig);
+        ExpectSameVerification(otherKey.GetPubKey().Raw(), hash, sig);
+
+        // tampered signatures
+        for (unsigned i = 0; i < sig.size(); i += 7) {
+            vector<unsigned char> badSig = sig;
+            badSig[i] ^= static_cast<unsigned char>(1 + n);
+            ExpectSameVerification(vchPubKey, hash, badSig);
+        }
+        ExpectSameVerification(vchPubKey, hash, vector<unsigned char>(sig.begin(), sig.end() - 1));
+        vector<unsigned char> sigWithTrailingData = sig;
+        sigWithTrailingData.push_back(0x01);
+        ExpectSameVerification(vchPubKey, hash, sigWithTrailingData);
+
+        // the long form of the length of the sequence, which is fixed up before parsing
+        vector<unsigned char> laxSig = sig;
+        laxSig.insert(laxSig.begin() + 1, {0x85, 0x00, 0x00, 0x00, 0x00});
+        ExpectSameVerification(vchPubKey, hash, laxSig);
+
+        // tampered and invalid public keys
+        vector<unsigned char> badPubKey = vchPubKey;
+        badPubKey[1 + n % (badPubKey.size() - 1)] ^= 0x10;
+        ExpectSameVerification(badPubKey, hash, sig);
+        ExpectSameVerification(vector<unsigned char>(vchPubKey.begin(), vchPubKey.end() - 1), hash,
+                               sig);
+        ExpectSameVerification(vector<unsigned char>(), hash, sig);
+        ExpectSameVerification(vchPubKey, hash, vector<unsigned char>());
+
+        // the key loaded by a failed verification doesn't affect the next one
+        EXPECT_TRUE(CKey::VerifyWithPubKey(vchPubKey, hash, sig));
+    }
+
+    // the signature vectors; the hash type byte at the end is not part of the signature
+    const CKey& key = keys[0];
+    for (const std::string& filename : {"sig_canonical.json", "sig_noncanonical.json"}) {
+        const json_spirit::Array tests = read_json(filename);
+        for (const json_spirit::Value& tv : tests) {
+            const std::string test = tv.get_str();
+            if (!IsHex(test)) {
+                continue;
+            }
+            vector<unsigned char> sig = ParseHex(test);
+            ExpectSameVerification(key.GetPubKey().Raw(), GetRandHash(), sig);
+            if (!sig.empty()) {
+                sig.pop_back();
+                ExpectSameVerification(key.GetPubKey().Raw(), GetRandHash(), sig);
+            }
+        }
+    }
+}
+
+// compares the verifications with a new key per signature and with the thread's key; run it with
+// --gtest_also_run_disabled_tests
+TEST(key_tests, DISABLED_verify_with_pubkey_benchmark)
+{
+    static const int SigCount = 2000;
+
+    std::vector<vector<unsigned char>> pubKeys;
+    std::vector<uint256>               hashes;
+    std::vector<vector<unsigned char>> sigs;
+    for (int i = 0; i < SigCount; i++) {
+        CKey key;
+        key.MakeNewKey(i % 2 == 0);
+        pubKeys.push_back(key.GetPubKey().Raw());
+        hashes.push_back(GetRandHash());
+        sigs.emplace_back();
+        ASSERT_TRUE(key.Sign(hashes.back(), sigs.back()));
+    }
+
+    for (int i = 0; i < SigCount; i++) {
+        EXPECT_TRUE(VerifyWithNewKey(pubKeys[i], hashes[i], sigs[i]));
+    }
+
+    for (int i = 0; i < SigCount; i++) {
+        EXPECT_TRUE(CKey::VerifyWithPubKey(pubKeys[i], hashes[i], sigs[i]));
+    }
+}
@@ -1,19 +1,32 @@
 #include "gmock/gmock.h"
 
+#include "block.h"
+#include "blockindex.h"
 #include "itxdb.h"
+#include "ntp1/ntp1index.h"
+#include "ntp1/ntp1transaction.h"
 #include "uint256.h"
 #include <boost/shared_ptr.hpp>
 #include <utility>
 
-class CBlockIndex;
-
 struct mTxDB : public ITxDB
 {
     MOCK_METHOD(bool, WriteVersion, (int nVersion), (override));
     MOCK_METHOD(bool, ReadTxIndex, (const uint256& hash, CTxIndex& txindex), (const, override));
     MOCK_METHOD(bool, UpdateTxIndex, (const uint256& hash, const CTxIndex& txindex), (override));
+    MOCK_METHOD(bool, ReadTxIndexBatch,
+                (const std::vector<uint256>& hashes, std::vector<boost::optional<CTxIndex>>& txindices),
+                (const, override));
     MOCK_METHOD(bool, ReadTx, (const CDiskTxPos& txPos, CTransaction& tx), (const, override));
+    MOCK_METHOD(bool, ReadTxBatch,
+                (const std::vector<CDiskTxPos>& txPositions,
+                 std::vector<boost::optional<CTransaction>>& txs),
+                (const, override));
     MOCK_METHOD(bool, ReadNTP1Tx, (const uint256& hash, NTP1Transaction& ntp1tx), (const, override));
+    MOCK_METHOD(bool, ReadNTP1TxBatch,
+                (const std::vector<uint256>& hashes,
+                 std::vector<boost::optional<NTP1Transaction>>& ntp1txs),
+                (const, override));
     MOCK_METHOD(bool, WriteNTP1Tx, (const uint256& hash, const NTP1Transaction& ntp1tx), (override));
     MOCK_METHOD(bool, ReadAllIssuanceTxs, (std::vector<uint256> & txs), (const, override));
     MOCK_METHOD(bool, ReadNTP1TxsWithTokenSymbol, (std::string tokenName, std::vector<uint256>& txs),
@@ -36,6 +49,8 @@ struct mTxDB : public ITxDB
     MOCK_METHOD(bool, ReadBlock, (const uint256& hash, CBlock& blk, bool fReadTransactions),
                 (const, override));
     MOCK_METHOD(bool, WriteBlock, (const uint256& hash, const CBlock& blk), (override));
+    MOCK_METHOD(bool, ReadBlockBytes, (const uint256& hash, const BytesViewFunc& func),
+                (const, override));
     MOCK_METHOD(boost::optional<CBlockIndex>, ReadBlockIndex, (const uint256& blockHash),
                 (const, override));
     MOCK_METHOD(bool, WriteBlockIndex, (const CBlockIndex& blockindex), (override));
@@ -54,6 +69,24 @@ struct mTxDB : public ITxDB
     MOCK_METHOD(bool, WriteBestInvalidTrust, (const CBigNum& bnBestInvalidTrust), (override));
     MOCK_METHOD((boost::optional<std::map<uint256, CBlockIndex>>), ReadAllBlockIndexEntries, (),
                 (const, override));
+    MOCK_METHOD(bool, ReadNTP1AddressOutputs,
+                (const std::string& address, std::vector<NTP1IndexedOutput>& outputs),
+                (const, override));
+    MOCK_METHOD(bool, WriteNTP1AddressOutput,
+                (const std::string& address, const NTP1IndexedOutput& output), (override));
+    MOCK_METHOD(bool, EraseNTP1AddressOutput, (const std::string& address, const COutPoint& outpoint),
+                (override));
+    MOCK_METHOD(boost::optional<NTP1IndexedToken>, ReadNTP1IndexedToken, (const std::string& tokenId),
+                (const, override));
+    MOCK_METHOD(bool, WriteNTP1IndexedToken, (const NTP1IndexedToken& token), (override));
+    MOCK_METHOD(bool, EraseNTP1IndexedToken, (const std::string& tokenId), (override));
+    MOCK_METHOD(boost::optional<NTP1IndexedHolding>, ReadNTP1TokenHolding,
+                (const std::string& tokenId, const std::string& address), (const, override));
+    MOCK_METHOD(bool, WriteNTP1TokenHolding, (const NTP1IndexedHolding& holding), (override));
+    MOCK_METHOD(bool, EraseNTP1TokenHolding, (const std::string& tokenId, const std::string& address),
+                (override));
+    MOCK_METHOD(uint256, ReadNTP1IndexBestBlock, (), (const, override));
+    MOCK_METHOD(bool, WriteNTP1IndexBestBlock, (const uint256& blockHash), (override));
 
     MOCK_METHOD(bool, LoadBlockIndex, (), (override));
     MOCK_METHOD(boost::optional<int>, GetBestChainHeight, (), (const, override));
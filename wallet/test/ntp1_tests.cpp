@@ -5,12 +5,14 @@
 #include "block.h"
 #include "chainparams.h"
 #include "curltools.h"
+#include "main.h"
 #include "mocks/mtxdb.h"
 #include "ntp1/ntp1apicalls.h"
 #include "ntp1/ntp1script.h"
 #include "ntp1/ntp1script_burn.h"
 #include "ntp1/ntp1script_issuance.h"
 #include "ntp1/ntp1script_transfer.h"
+#include "ntp1/ntp1scriptcache.h"
 #include "ntp1/ntp1sendtokensonerecipientdata.h"
 #include "ntp1/ntp1tokenmetadata.h"
 #include "ntp1/ntp1tokentxdata.h"
@@ -19,10 +21,12 @@
 #include "ntp1/ntp1txout.h"
 #include "ntp1/ntp1v1_issuance_static_data.h"
 #include "ntp1/ntp1wallet.h"
+#include <atomic>
 #include <boost/algorithm/string.hpp>
 #include <boost/container/flat_map.hpp>
 #include <fstream>
 #include <random>
+#include <thread>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -775,6 +779,128 @@ TEST(ntp1_tests, parsig_ntp1_from_ctransaction_issuance)
     EXPECT_EQ(ntp1tx.getTxIn(0).getPrevout().getIndex(), 1u);
 }
 
+TEST(ntp1_tests, parsed_ntp1_txs_of_block_are_used_like_reparsed_ones)
+{
+    // the issuance of NIBBL, and the tx it spends
+    const CTransaction issuanceTx = TxFromHex(
+        "010000001af29a5a012081139a3e0d764e9fb415bf1601c5bc24eba093c3f6a735aaa9d81d27d55dc5010000006"
+        "b483045022100ea2baf384bb518ed939a1dfc02df634be2186c5e35d79a09fc7c1f1379987bc102200e286cc382"
+        "9fbe574bda0cacfe8e918755574685bcb8af8a67b2d24f0087122d012103bd4c76349aae4b81011eddce127f36c"
+        "ffd6b7beaf84c80d5d4e6cf06e5c8596cffffffff0310270000000000001976a9144e2a50f7e8c58ff9a0175f95"
+        "616a1657b49a06a888ac1027000000000000456a434e5401014e4942424cab10c04e20e0aec73d58c8fbf2a9c26"
+        "a6dc3ed666c7b80fef215620c817703b1e5d8b1870211ce7cdf50718b4789245fb80f58992019002019f0e073eb"
+        "0b000000001976a9144e2a50f7e8c58ff9a0175f95616a1657b49a06a888ac00000000");
+    const CTransaction inputTx = TxFromHex(
+        "0100000089f3995a013458f5fa9bc91103a1dcdd6f1e582bc35e3ca513a924bad1e3098dd540fb4e03010000004"
+        "9483045022100e8dedce5f1950a07dbbd60dfb959e21113523b9d98df2fc1973e530beafd53b3022047450cd1a1"
+        "6d74f83c2ba769cb0a0ba28c848e440cc915d268218e7b8d0e541701ffffffff02306a04c2210000001976a9149"
+        "4229f861ecf642374f132de7cc739f314ee4ada88ac008c8647000000001976a9144e2a50f7e8c58ff9a0175f95"
+        "616a1657b49a06a888ac00000000");
+    ASSERT_EQ(issuanceTx.vin[0].prevout.hash, inputTx.GetHash());
+
+    // another issuance of the same symbol, with a different hash
+    CTransaction duplicateIssuanceTx = issuanceTx;
+    duplicateIssuanceTx.nTime++;
+    ASSERT_NE(duplicateIssuanceTx.GetHash(), issuanceTx.GetHash());
+
+    const CDiskTxPos inputPos(uint256(5), 100);
+
+    boost::shared_ptr<mTxDB> dbMock = boost::make_shared<mTxDB>();
+    EXPECT_CALL(*dbMock, GetBestChainHeight())
+        .WillRepeatedly(testing::Return(boost::make_optional<int>(1000000)));
+    EXPECT_CALL(*dbMock, ReadTxIndexBatch(testing::_, testing::_))
+        .WillRepeatedly(testing::Invoke(
+            [&](const std::vector<uint256>& hashes, std::vector<boost::optional<CTxIndex>>& txindices) {
+                txindices.clear();
+                for (const uint256& h : hashes) {
+                    if (h == inputTx.GetHash()) {
+                        txindices.push_back(CTxIndex(inputPos, inputTx.vout.size()));
+                    } else {
+                        txindices.push_back(boost::none);
+                    }
+                }
+                return true;
+            }));
+    EXPECT_CALL(*dbMock, ReadTxBatch(testing::_, testing::_))
+        .WillRepeatedly(testing::Invoke([&](const std::vector<CDiskTxPos>&              positions,
+                                            std::vector<boost::optional<CTransaction>>& txs) {
+            txs.assign(positions.size(), inputTx);
+            return true;
+        }));
+    EXPECT_CALL(*dbMock, ReadNTP1TxBatch(testing::_, testing::_))
+        .WillRepeatedly(testing::Invoke([](const std::vector<uint256>&                    hashes,
+                                           std::vector<boost::optional<NTP1Transaction>>& txs) {
+            txs.assign(hashes.size(), boost::none);
+            return true;
+        }));
+    EXPECT_CALL(*dbMock, ReadNTP1TxsWithTokenSymbol(testing::_, testing::_))
+        .WillRepeatedly(testing::Return(true));
+
+    std::vector<std::pair<uint256, NTP1Transaction>>     writtenTxs;
+    std::vector<std::pair<std::string, NTP1Transaction>> writtenSymbols;
+    EXPECT_CALL(*dbMock, WriteNTP1Tx(testing::_, testing::_))
+        .WillRepeatedly(testing::Invoke([&](const uint256& hash, const NTP1Transaction& ntp1tx) {
+            writtenTxs.emplace_back(hash, ntp1tx);
+            return true;
+        }));
+    EXPECT_CALL(*dbMock, WriteNTP1TxWithTokenSymbol(testing::_, testing::_))
+        .WillRepeatedly(testing::Invoke([&](std::string symbol, const NTP1Transaction& ntp1tx) {
+            writtenSymbols.emplace_back(symbol, ntp1tx);
+            return true;
+        }));
+
+    // parsed like ConnectBlock() does, which leaves the txs that aren't NTP1 unparsed
+    const std::vector<CTransaction> vtx{inputTx, issuanceTx, duplicateIssuanceTx};
+    const std::map<uint256, CTxIndex> queuedAcceptedTxs{
+        {inputTx.GetHash(), CTxIndex(inputPos, inputTx.vout.size())}};
+    const std::map<uint256, std::vector<std::pair<CTransaction, NTP1Transaction>>> queuedNTP1Inputs;
+    std::vector<boost::optional<NTP1Transaction>> parsedNTP1Txs(vtx.size());
+    for (unsigned i = 0; i < vtx.size(); i++) {
+        if (NTP1Transaction::IsTxNTP1(&vtx[i])) {
+            NTP1Transaction ntp1tx;
+            ntp1tx.readNTP1DataFromTx(*dbMock, vtx[i],
+                                      NTP1Transaction::GetAllNTP1InputsOfTx(
+                                          vtx[i], *dbMock, true, queuedNTP1Inputs, queuedAcceptedTxs));
+            parsedNTP1Txs[i] = std::move(ntp1tx);
+        }
+    }
+    ASSERT_FALSE(parsedNTP1Txs[0]);
+    ASSERT_TRUE(parsedNTP1Txs[1]);
+    ASSERT_TRUE(parsedNTP1Txs[2]);
+
+    // the first issuance of the symbol in the block is accepted, the second is a duplicate
+    {
+        std::unordered_map<std::string, uint256> symbolsParsed;
+        std::unordered_map<std::string, uint256> symbolsReparsed;
+        EXPECT_NO_THROW(AssertIssuanceUniquenessInBlock(symbolsParsed, *dbMock, *parsedNTP1Txs[1]));
+        EXPECT_NO_THROW(AssertIssuanceUniquenessInBlock(symbolsReparsed, *dbMock, vtx[1],
+                                                        queuedNTP1Inputs, queuedAcceptedTxs));
+        EXPECT_EQ(symbolsParsed, symbolsReparsed);
+        EXPECT_EQ(symbolsParsed.size(), 1u);
+        EXPECT_EQ(symbolsParsed.at("NIBBL"), issuanceTx.GetHash());
+
+        EXPECT_THROW(AssertIssuanceUniquenessInBlock(symbolsParsed, *dbMock, *parsedNTP1Txs[2]),
+                     std::runtime_error);
+        EXPECT_THROW(AssertIssuanceUniquenessInBlock(symbolsReparsed, *dbMock, vtx[2],
+                                                     queuedNTP1Inputs, queuedAcceptedTxs),
+                     std::runtime_error);
+        EXPECT_EQ(symbolsParsed, symbolsReparsed);
+    }
+
+    // the same NTP1 data is written whether the txs are parsed already or not
+    WriteNTP1BlockTransactionsToDisk(vtx, parsedNTP1Txs, *dbMock);
+    const std::vector<std::pair<uint256, NTP1Transaction>>     txsOfParsed     = writtenTxs;
+    const std::vector<std::pair<std::string, NTP1Transaction>> symbolsOfParsed = writtenSymbols;
+    writtenTxs.clear();
+    writtenSymbols.clear();
+    WriteNTP1BlockTransactionsToDisk(vtx, {}, *dbMock);
+    ASSERT_EQ(txsOfParsed.size(), 2u);
+    EXPECT_EQ(txsOfParsed[0].first, issuanceTx.GetHash());
+    EXPECT_EQ(txsOfParsed[1].first, duplicateIssuanceTx.GetHash());
+    EXPECT_TRUE(txsOfParsed == writtenTxs);
+    EXPECT_TRUE(symbolsOfParsed == writtenSymbols);
+}
+
 TEST(ntp1_tests, parsig_ntp1_from_ctransaction_transfer_1)
 {
     // transfer
@@ -3932,6 +4058,131 @@ TEST(ntp1_tests, ntp1_metadata_parsing_8)
     EXPECT_EQ(metadataObj.getTokenId(), "La37utZFe8P1fPc789szDp2QL7TMC7hyWERxr5");
 }
 
+TEST(ntp1_tests, script_cache)
+{
+    const std::string transferScript = "4e5401150069892a92";
+    const std::string burnScript     = "4e5401251f2013";
+    const uint256     txid1          = GetRandHash();
+    const uint256     txid2          = GetRandHash();
+    const uint256     txid3          = GetRandHash();
+
+    NTP1ScriptCache cache(2);
+    EXPECT_EQ(cache.capacity(), 2u);
+
+    std::shared_ptr<const NTP1Script> script = cache.parse(txid1, transferScript);
+    ASSERT_NE(script, nullptr);
+    EXPECT_EQ(script->getTxType(), NTP1Script::TxType_Transfer);
+    EXPECT_EQ(script->getParsedScriptHex(), transferScript);
+    EXPECT_EQ(cache.hits(), 0u);
+    EXPECT_EQ(cache.misses(), 1u);
+
+    // the same object is shared
+    EXPECT_EQ(cache.parse(txid1, transferScript), script);
+    EXPECT_EQ(cache.hits(), 1u);
+    EXPECT_EQ(cache.misses(), 1u);
+
+    // a txid with another script is parsed again, and the new script replaces the old one
+    std::shared_ptr<const NTP1Script> burn = cache.parse(txid1, burnScript);
+    EXPECT_EQ(burn->getTxType(), NTP1Script::TxType_Burn);
+    EXPECT_EQ(cache.misses(), 2u);
+    EXPECT_EQ(cache.size(), 1u);
+    EXPECT_EQ(cache.parse(txid1, burnScript), burn);
+    EXPECT_EQ(cache.hits(), 2u);
+
+    // invalid scripts throw like NTP1Script::ParseScript() and aren't kept
+    EXPECT_THROW(cache.parse(txid2, "4e5499"), std::runtime_error);
+    EXPECT_THROW(cache.parse(txid2, "4e5499"), std::runtime_error);
+    EXPECT_EQ(cache.misses(), 4u);
+    EXPECT_EQ(cache.size(), 1u);
+
+    // the least recently used is evicted; txid1 was used after txid2 was added
+    cache.parse(txid2, transferScript);
+    cache.parse(txid1, burnScript);
+    cache.parse(txid3, transferScript);
+    EXPECT_EQ(cache.size(), 2u);
+    const uint64_t missesBefore = cache.misses();
+    cache.parse(txid1, burnScript);
+    EXPECT_EQ(cache.misses(), missesBefore);
+    cache.parse(txid2, transferScript);
+    EXPECT_EQ(cache.misses(), missesBefore + 1);
+
+    // the evicted scripts stay valid for whoever holds them
+    EXPECT_EQ(script->getParsedScriptHex(), transferScript);
+
+    cache.clear();
+    EXPECT_EQ(cache.size(), 0u);
+    EXPECT_EQ(cache.hits(), 0u);
+    EXPECT_EQ(cache.misses(), 0u);
+
+    NTP1ScriptCache disabledCache(0);
+    disabledCache.parse(txid1, transferScript);
+    disabledCache.parse(txid1, transferScript);
+    EXPECT_EQ(disabledCache.size(), 0u);
+    EXPECT_EQ(disabledCache.hits(), 0u);
+}
+
+// parses every script many times, with and without the cache and from many threads; run it with
+// --gtest_also_run_disabled_tests
+TEST(ntp1_tests, DISABLED_script_cache_benchmark)
+{
+    // the scripts of the tests above
+    const std::vector<std::string> scripts = {
+        "4e5401150069892a92",
+        "4e5401014e4942424cab10c04e20e0aec73d58c8fbf2a9c26a6dc3ed666c7b80fef2"
+        "15620c817703b1e5d8b1870211ce7cdf50718b4789245fb80f58992019002019f0",
+        "4e5401251f2013",
+        "4e540310050320510420418520e20638b18719",
+        "4e5403200200081f02",
+        "4e540310020022a00160f42160"};
+    std::vector<uint256> txids;
+    for (unsigned i = 0; i < scripts.size(); i++) {
+        txids.push_back(GetRandHash());
+    }
+
+    static const int Rounds = 20000;
+
+    // a tx is parsed a few times on its way to the block chain; here every script is parsed Rounds
+    // times, with and without the cache
+    for (int r = 0; r < Rounds; r++) {
+        for (unsigned i = 0; i < scripts.size(); i++) {
+            std::shared_ptr<NTP1Script> script = NTP1Script::ParseScript(scripts[i]);
+            ASSERT_EQ(script->getParsedScriptHex(), scripts[i]);
+        }
+    }
+
+    NTP1ScriptCache cache(NTP1ScriptCache::DefaultMaxSize);
+    for (int r = 0; r < Rounds; r++) {
+        for (unsigned i = 0; i < scripts.size(); i++) {
+            std::shared_ptr<const NTP1Script> script = cache.parse(txids[i], scripts[i]);
+            ASSERT_EQ(script->getParsedScriptHex(), scripts[i]);
+        }
+    }
+
+    EXPECT_EQ(cache.misses(), scripts.size());
+    EXPECT_EQ(cache.hits(), scripts.size() * (Rounds - 1));
+
+    // the same from many threads
+    static const int         ThreadsCount = 4;
+    std::atomic_int          wrongScripts{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < ThreadsCount; t++) {
+        threads.emplace_back([&]() {
+            for (int r = 0; r < Rounds / ThreadsCount; r++) {
+                for (unsigned i = 0; i < scripts.size(); i++) {
+                    if (cache.parse(txids[i], scripts[i])->getParsedScriptHex() != scripts[i]) {
+                        wrongScripts++;
+                    }
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(wrongScripts, 0);
+    EXPECT_EQ(cache.misses(), scripts.size());
+}
+
 // TEST(ntp1_tests, total_fee_calculator)
 //{
 //    std::string txStr =
@@ -0,0 +1,325 @@
+#include "googletest/googletest/include/gtest/gtest.h"
+
+#include "block.h"
+#include "blockindex.h"
+#include "mocks/mtxdb.h"
+#include "ntp1/ntp1index.h"
+#include "ntp1/ntp1transaction.h"
+#include "transaction.h"
+
+#include <map>
+
+using ::testing::_;
+using ::testing::Invoke;
+using ::testing::NiceMock;
+
+namespace {
+
+const std::string TokenId  = "La3QxvUgFwKz2jjQR2HSrwaKcRgotf4tGVkMJx";
+const std::string Address1 = "NVWeRKWuwYfkCn7wUtPjjPpPtsyhFVoHZ1";
+const std::string Address2 = "NXoxhvSnAaEaTdXUqmhjQUWJ3yk4hVZ5ue";
+
+// a tx db with the NTP1 txs and the NTP1 index in maps
+class NTP1IndexDB
+{
+public:
+    std::map<uint256, NTP1Transaction>                                 ntp1txs;
+    std::map<std::string, std::map<COutPoint, NTP1IndexedOutput>>      outputs;
+    std::map<std::string, NTP1IndexedToken>                            tokens;
+    std::map<std::pair<std::string, std::string>, NTP1IndexedHolding> holdings;
+    uint256                                                            indexBestBlock = 0;
+
+    NiceMock<mTxDB> txdb;
+
+    NTP1IndexDB()
+    {
+        ON_CALL(txdb, ReadNTP1IndexBestBlock()).WillByDefault(Invoke([this]() {
+            return indexBestBlock;
+        }));
+        ON_CALL(txdb, WriteNTP1IndexBestBlock(_)).WillByDefault(Invoke([this](const uint256& hash) {
+            indexBestBlock = hash;
+            return true;
+        }));
+        ON_CALL(txdb, ContainsNTP1Tx(_)).WillByDefault(Invoke([this](const uint256& hash) {
+            return ntp1txs.count(hash) > 0;
+        }));
+        ON_CALL(txdb, ReadNTP1Tx(_, _))
+            .WillByDefault(Invoke([this](const uint256& hash, NTP1Transaction& ntp1tx) {
+                const auto it = ntp1txs.find(hash);
+                if (it == ntp1txs.cend()) {
+                    return false;
+                }
+                ntp1tx = it->second;
+                return true;
+            }));
+        ON_CALL(txdb, WriteNTP1AddressOutput(_, _))
+            .WillByDefault(Invoke([this](const std::string& address, const NTP1IndexedOutput& output) {
+                outputs[address][output.outpoint] = output;
+                return true;
+            }));
+        ON_CALL(txdb, EraseNTP1AddressOutput(_, _))
+            .WillByDefault(Invoke([this](const std::string& address, const COutPoint& outpoint) {
+                if (outputs[address].erase(outpoint) == 0) {
+                    return false;
+                }
+                if (outputs[address].empty()) {
+                    outputs.erase(address);
+                }
+                return true;
+            }));
+        ON_CALL(txdb, ReadNTP1IndexedToken(_))
+            .WillByDefault(
+                Invoke([this](const std::string& tokenId) -> boost::optional<NTP1IndexedToken> {
+                    const auto it = tokens.find(tokenId);
+                    if (it == tokens.cend()) {
+                        return boost::none;
+                    }
+                    return it->second;
+                }));
+        ON_CALL(txdb, WriteNTP1IndexedToken(_))
+            .WillByDefault(Invoke([this](const NTP1IndexedToken& token) {
+                tokens[token.tokenId] = token;
+                return true;
+            }));
+        ON_CALL(txdb, EraseNTP1IndexedToken(_)).WillByDefault(Invoke([this](const std::string& id) {
+            return tokens.erase(id) > 0;
+        }));
+        ON_CALL(txdb, ReadNTP1TokenHolding(_, _))
+            .WillByDefault(Invoke([this](const std::string& tokenId, const std::string& address)
+                                      -> boost::optional<NTP1IndexedHolding> {
+                const auto it = holdings.find(std::make_pair(tokenId, address));
+                if (it == holdings.cend()) {
+                    return boost::none;
+                }
+                return it->second;
+            }));
+        ON_CALL(txdb, WriteNTP1TokenHolding(_))
+            .WillByDefault(Invoke([this](const NTP1IndexedHolding& holding) {
+                holdings[std::make_pair(holding.tokenId, holding.address)] = holding;
+                return true;
+            }));
+        ON_CALL(txdb, EraseNTP1TokenHolding(_, _))
+            .WillByDefault(Invoke([this](const std::string& tokenId, const std::string& address) {
+                return holdings.erase(std::make_pair(tokenId, address)) > 0;
+            }));
+    }
+
+    NTP1Int balance(const std::string& address) const
+    {
+        const auto it = holdings.find(std::make_pair(TokenId, address));
+        return it == holdings.cend() ? NTP1Int(0) : it->second.balance;
+    }
+};
+
+CTransaction MakeTx(const std::vector<COutPoint>& inputs, unsigned outputsCount)
+{
+    CTransaction tx;
+    for (const COutPoint& input : inputs) {
+        tx.vin.push_back(CTxIn(input));
+    }
+    for (unsigned i = 0; i < outputsCount; i++) {
+        tx.vout.push_back(CTxOut(10000 + i, CScript()));
+    }
+    return tx;
+}
+
+NTP1TxOut MakeTokenOutput(const std::string& address, const uint256& issuanceTxid,
+                          const NTP1Int& amount)
+{
+    NTP1TokenTxData token;
+    token.setTokenId(TokenId);
+    token.setIssueTxIdHex(issuanceTxid.GetHex());
+    token.setTokenSymbol("TOK");
+    token.setAmount(amount);
+
+    NTP1TxOut out;
+    out.__manualSet(10000, "", "", {token}, address);
+    return out;
+}
+
+NTP1Transaction MakeNTP1Tx(const CTransaction& tx, const std::vector<NTP1TxOut>& vout,
+                           NTP1TransactionType type)
+{
+    NTP1Transaction ntp1tx;
+    ntp1tx.__manualSet(1, tx.GetHash(), {}, {}, vout, 0, 0, type);
+    return ntp1tx;
+}
+
+} // namespace
+
+TEST(ntp1index_tests, connect_and_disconnect)
+{
+    NTP1IndexDB db;
+
+    // block 1: an issuance to two addresses, and a transfer in the same block that spends one of them
+    // and burns 100 tokens
+    const CTransaction issuanceTx = MakeTx({COutPoint(GetRandHash(), 0)}, 2);
+    const uint256      issuanceId = issuanceTx.GetHash();
+    const CTransaction transferTx = MakeTx({COutPoint(issuanceId, 0)}, 2);
+    const std::vector<CTransaction>                     block1Txs = {issuanceTx, transferTx};
+    const std::vector<boost::optional<NTP1Transaction>> block1NTP1Txs = {
+        MakeNTP1Tx(issuanceTx,
+                   {MakeTokenOutput(Address1, issuanceId, 1000),
+                    MakeTokenOutput(Address2, issuanceId, 500)},
+                   NTP1TxType_ISSUANCE),
+        MakeNTP1Tx(transferTx,
+                   {MakeTokenOutput(Address2, issuanceId, 300),
+                    MakeTokenOutput(Address1, issuanceId, 600)},
+                   NTP1TxType_TRANSFER)};
+    // the NTP1 txs are stored before the index is updated
+    for (const auto& ntp1tx : block1NTP1Txs) {
+        db.ntp1txs[ntp1tx->getTxHash()] = *ntp1tx;
+    }
+
+    ASSERT_TRUE(NTP1Index::ConnectBlockTxs(db.txdb, block1Txs, block1NTP1Txs));
+
+    ASSERT_EQ(db.tokens.count(TokenId), 1u);
+    EXPECT_EQ(db.tokens.at(TokenId).issuanceTxid, issuanceId);
+    EXPECT_EQ(db.tokens.at(TokenId).tokenSymbol, "TOK");
+    EXPECT_EQ(db.tokens.at(TokenId).totalIssued, 1500);
+    EXPECT_EQ(db.tokens.at(TokenId).supply, 1400);
+    EXPECT_EQ(db.tokens.at(TokenId).holdersCount, 2u);
+    EXPECT_EQ(db.balance(Address1), 600);
+    EXPECT_EQ(db.balance(Address2), 800);
+    ASSERT_EQ(db.outputs[Address1].size(), 1u);
+    EXPECT_EQ(db.outputs[Address1].begin()->first, COutPoint(transferTx.GetHash(), 1));
+    ASSERT_EQ(db.outputs[Address2].size(), 2u);
+    EXPECT_EQ(db.outputs[Address2].count(COutPoint(issuanceId, 1)), 1u);
+    EXPECT_EQ(db.outputs[Address2].count(COutPoint(transferTx.GetHash(), 0)), 1u);
+
+    const auto tokensAfterBlock1   = db.tokens;
+    const auto outputsAfterBlock1  = db.outputs;
+    const auto holdingsAfterBlock1 = db.holdings;
+
+    // block 2: everything of the second address goes to the first one; the NTP1 tx isn't given, and
+    // has to be read from the db
+    const CTransaction sendAllTx =
+        MakeTx({COutPoint(issuanceId, 1), COutPoint(transferTx.GetHash(), 0)}, 1);
+    db.ntp1txs[sendAllTx.GetHash()] = MakeNTP1Tx(
+        sendAllTx, {MakeTokenOutput(Address1, issuanceId, 800)}, NTP1TxType_TRANSFER);
+    // a tx without NTP1 data changes nothing
+    const CTransaction              plainTx   = MakeTx({COutPoint(GetRandHash(), 3)}, 1);
+    const std::vector<CTransaction> block2Txs = {plainTx, sendAllTx};
+
+    ASSERT_TRUE(NTP1Index::ConnectBlockTxs(db.txdb, block2Txs, {}));
+
+    EXPECT_EQ(db.tokens.at(TokenId).totalIssued, 1500);
+    EXPECT_EQ(db.tokens.at(TokenId).supply, 1400);
+    EXPECT_EQ(db.tokens.at(TokenId).holdersCount, 1u);
+    EXPECT_EQ(db.balance(Address1), 1400);
+    EXPECT_EQ(db.balance(Address2), 0);
+    EXPECT_EQ(db.holdings.count(std::make_pair(TokenId, Address2)), 0u);
+    EXPECT_EQ(db.outputs.count(Address2), 0u);
+    EXPECT_EQ(db.outputs[Address1].size(), 2u);
+
+    // disconnecting restores the index as it was before each block
+    ASSERT_TRUE(NTP1Index::DisconnectBlockTxs(db.txdb, block2Txs));
+    EXPECT_EQ(db.tokens.at(TokenId).supply, tokensAfterBlock1.at(TokenId).supply);
+    EXPECT_EQ(db.tokens.at(TokenId).holdersCount, tokensAfterBlock1.at(TokenId).holdersCount);
+    EXPECT_EQ(db.tokens.at(TokenId).totalIssued, tokensAfterBlock1.at(TokenId).totalIssued);
+    EXPECT_EQ(db.balance(Address1), 600);
+    EXPECT_EQ(db.balance(Address2), 800);
+    EXPECT_EQ(db.holdings.size(), holdingsAfterBlock1.size());
+    ASSERT_EQ(db.outputs.size(), outputsAfterBlock1.size());
+    for (const auto& p : outputsAfterBlock1) {
+        ASSERT_EQ(db.outputs[p.first].size(), p.second.size());
+        for (const auto& o : p.second) {
+            EXPECT_EQ(db.outputs[p.first].count(o.first), 1u);
+        }
+    }
+
+    ASSERT_TRUE(NTP1Index::DisconnectBlockTxs(db.txdb, block1Txs));
+    EXPECT_TRUE(db.tokens.empty());
+    EXPECT_TRUE(db.outputs.empty());
+    EXPECT_TRUE(db.holdings.empty());
+}
+
+TEST(ntp1index_tests, spending_more_than_indexed_fails)
+{
+    NTP1IndexDB db;
+
+    // an NTP1 tx that was stored but never indexed, which happens only if the index is corrupted
+    const CTransaction issuanceTx = MakeTx({COutPoint(GetRandHash(), 0)}, 1);
+    db.ntp1txs[issuanceTx.GetHash()] =
+        MakeNTP1Tx(issuanceTx, {MakeTokenOutput(Address1, issuanceTx.GetHash(), 1000)},
+                   NTP1TxType_ISSUANCE);
+
+    const CTransaction spendTx = MakeTx({COutPoint(issuanceTx.GetHash(), 0)}, 1);
+    EXPECT_FALSE(NTP1Index::ConnectBlockTxs(db.txdb, {spendTx}, {}));
+}
+
+TEST(ntp1index_tests, blocks_are_applied_once_and_failures_dont_fail_blocks)
+{
+    NTP1IndexDB db;
+
+    const uint256 prevBlockHash = GetRandHash();
+    const uint256 block1Hash    = GetRandHash();
+    const uint256 block2Hash    = GetRandHash();
+    db.indexBestBlock           = prevBlockHash;
+
+    const CTransaction issuanceTx = MakeTx({COutPoint(GetRandHash(), 0)}, 1);
+    const uint256      issuanceId = issuanceTx.GetHash();
+    db.ntp1txs[issuanceId] =
+        MakeNTP1Tx(issuanceTx, {MakeTokenOutput(Address1, issuanceId, 1000)}, NTP1TxType_ISSUANCE);
+
+    ASSERT_TRUE(NTP1Index::ConnectBlock(db.txdb, block1Hash, prevBlockHash, {issuanceTx}, {}));
+    EXPECT_EQ(db.indexBestBlock, block1Hash);
+    EXPECT_EQ(db.balance(Address1), 1000);
+
+    // a block that the index has already is skipped, instead of being added twice
+    ASSERT_TRUE(NTP1Index::ConnectBlock(db.txdb, block1Hash, prevBlockHash, {issuanceTx}, {}));
+    EXPECT_EQ(db.indexBestBlock, block1Hash);
+    EXPECT_EQ(db.balance(Address1), 1000);
+    EXPECT_EQ(db.tokens.at(TokenId).supply, 1000);
+
+    // spending more than the index has fails to update it, which doesn't fail the block but marks the
+    // index to be rebuilt
+    db.holdings.clear();
+    const CTransaction spendTx = MakeTx({COutPoint(issuanceId, 0)}, 1);
+    EXPECT_TRUE(NTP1Index::ConnectBlock(db.txdb, block2Hash, block1Hash, {spendTx}, {}));
+    EXPECT_EQ(db.indexBestBlock, 0);
+
+    // and the index isn't updated anymore
+    const auto         outputsBefore = db.outputs;
+    const CTransaction issuanceTx2   = MakeTx({COutPoint(GetRandHash(), 0)}, 1);
+    db.ntp1txs[issuanceTx2.GetHash()] =
+        MakeNTP1Tx(issuanceTx2, {MakeTokenOutput(Address2, issuanceTx2.GetHash(), 5)},
+                   NTP1TxType_ISSUANCE);
+    EXPECT_TRUE(NTP1Index::ConnectBlock(db.txdb, GetRandHash(), block2Hash, {issuanceTx2}, {}));
+    EXPECT_TRUE(NTP1Index::DisconnectBlock(db.txdb, block2Hash, block1Hash, {spendTx}));
+    EXPECT_EQ(db.indexBestBlock, 0);
+    EXPECT_EQ(db.outputs.size(), outputsBefore.size());
+    EXPECT_EQ(db.balance(Address2), 0);
+
+    // only failing to mark the index fails the block
+    db.indexBestBlock = block1Hash;
+    ON_CALL(db.txdb, WriteNTP1IndexBestBlock(_)).WillByDefault(::testing::Return(false));
+    EXPECT_FALSE(NTP1Index::ConnectBlock(db.txdb, block2Hash, block1Hash, {spendTx}, {}));
+}
+
+TEST(ntp1index_tests, disconnect_block)
+{
+    NTP1IndexDB db;
+
+    const uint256 prevBlockHash = GetRandHash();
+    const uint256 blockHash     = GetRandHash();
+    db.indexBestBlock           = prevBlockHash;
+
+    const CTransaction issuanceTx = MakeTx({COutPoint(GetRandHash(), 0)}, 1);
+    db.ntp1txs[issuanceTx.GetHash()] =
+        MakeNTP1Tx(issuanceTx, {MakeTokenOutput(Address1, issuanceTx.GetHash(), 1000)},
+                   NTP1TxType_ISSUANCE);
+
+    ASSERT_TRUE(NTP1Index::ConnectBlock(db.txdb, blockHash, prevBlockHash, {issuanceTx}, {}));
+
+    // a block that isn't the best block of the index isn't disconnected from it
+    ASSERT_TRUE(NTP1Index::DisconnectBlock(db.txdb, prevBlockHash, GetRandHash(), {issuanceTx}));
+    EXPECT_EQ(db.indexBestBlock, blockHash);
+    EXPECT_EQ(db.balance(Address1), 1000);
+
+    ASSERT_TRUE(NTP1Index::DisconnectBlock(db.txdb, blockHash, prevBlockHash, {issuanceTx}));
+    EXPECT_EQ(db.indexBestBlock, prevBlockHash);
+    EXPECT_TRUE(db.tokens.empty());
+    EXPECT_TRUE(db.outputs.empty());
+    EXPECT_TRUE(db.holdings.empty());
+}
@@ -682,3 +682,27 @@ TEST(PoS_tests, scripts_p2cs_scriptSig_test)
         EXPECT_EQ(pubKeyReturned, boost::none);
     }
 }
+
+TEST(PoS_tests, kernel_hash_input_matches_serialization)
+{
+    for (int i = 0; i < 1000; i++) {
+        const uint64_t     nStakeModifier = GetRand(std::numeric_limits<uint64_t>::max());
+        const unsigned int nTimeBlockFrom = static_cast<unsigned int>(GetRand(0xFFFFFFFF));
+        const unsigned int nTxPrevOffset  = static_cast<unsigned int>(GetRand(0xFFFFFFFF));
+        const unsigned int nTimeTxPrev    = static_cast<unsigned int>(GetRand(0xFFFFFFFF));
+        const unsigned int nPrevout       = static_cast<unsigned int>(GetRand(0xFFFF));
+
+        StakeKernelHashInput hashInput = MakeStakeKernelHashInput(
+            nStakeModifier, nTimeBlockFrom, nTxPrevOffset, nTimeTxPrev, nPrevout);
+
+        // the same input is reused with many times, like in a kernel search
+        for (int j = 0; j < 10; j++) {
+            const unsigned int nTimeTx = static_cast<unsigned int>(GetRand(0xFFFFFFFF));
+
+            CDataStream ss(SER_GETHASH, 0);
+            ss << nStakeModifier << nTimeBlockFrom << nTxPrevOffset << nTimeTxPrev << nPrevout
+               << nTimeTx;
+            EXPECT_EQ(StakeKernelHash(hashInput, nTimeTx), Hash(ss.begin(), ss.end()));
+        }
+    }
+}
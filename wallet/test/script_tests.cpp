@@ -454,6 +454,40 @@ TEST(script_tests, script_combineSigs)
     EXPECT_TRUE(combined == partial3c);
 }
 
+TEST(script_tests, script_check_mandatory_flags_only)
+{
+    // a P2SH output whose redeem script always fails; the spending input is valid only when P2SH
+    // isn't validated
+    const CScript redeemScript = CScript() << OP_0;
+    CTransaction  txFrom;
+    txFrom.vout.resize(1);
+    txFrom.vout[0].scriptPubKey.SetDestination(redeemScript.GetID());
+
+    CTransaction txTo;
+    txTo.vin.resize(1);
+    txTo.vout.resize(1);
+    txTo.vin[0].prevout.n    = 0;
+    txTo.vin[0].prevout.hash = txFrom.GetHash();
+    txTo.vin[0].scriptSig    = CScript() << valtype(redeemScript.begin(), redeemScript.end());
+    txTo.vout[0].nValue      = 1;
+
+    CScriptCheck p2shCheck(txFrom, txTo, 0, true, false, 0);
+    EXPECT_FALSE(p2shCheck());
+    EXPECT_TRUE(p2shCheck.CheckMandatoryFlagsOnly().isOk());
+
+    // a script that doesn't even match the script hash fails both ways
+    txTo.vin[0].scriptSig = CScript() << valtype(redeemScript.size(), 0xff);
+    CScriptCheck badCheck(txFrom, txTo, 0, true, false, 0);
+    EXPECT_FALSE(badCheck());
+    EXPECT_TRUE(badCheck.CheckMandatoryFlagsOnly().isErr());
+
+    // a check whose prevout doesn't match fails both ways too
+    txTo.vin[0].prevout.n = 1;
+    CScriptCheck mismatchedCheck(txFrom, txTo, 0, true, false, 0);
+    EXPECT_FALSE(mismatchedCheck());
+    EXPECT_TRUE(mismatchedCheck.CheckMandatoryFlagsOnly().isErr());
+}
+
 TEST(script_tests, CastToBool)
 {
     {
@@ -5,7 +5,10 @@
 #include <vector>
 
 #include "SerializationTester.h"
+#include "block.h"
+#include "chainparams.h"
 #include "serialize.h"
+#include "version.h"
 
 TEST(serialize_tests, varints)
 {
@@ -260,3 +263,52 @@ TEST(serialize_tests, insert_delete)
     ss.GetAndClear(d);
     EXPECT_EQ(ss.size(), 0U);
 }
+
+TEST(serialize_tests, buffer_reader)
+{
+    CDataStream ss(SER_DISK, 0);
+    ss << VARINT(12345) << std::string("some string") << std::vector<int>({1, 2, 3})
+       << static_cast<uint64_t>(7);
+    const std::string serialized = ss.str();
+
+    // reading from the buffer gives the same as reading from the stream
+    CBufferReader reader(serialized.data(), serialized.data() + serialized.size(), SER_DISK, 0);
+    int              i = 0;
+    std::string      str;
+    std::vector<int> vec;
+    reader >> VARINT(i) >> str >> vec;
+    EXPECT_EQ(i, 12345);
+    EXPECT_EQ(str, "some string");
+    EXPECT_EQ(vec, std::vector<int>({1, 2, 3}));
+    EXPECT_EQ(reader.size(), sizeof(uint64_t));
+    EXPECT_EQ(reader.tell(), serialized.size() - sizeof(uint64_t));
+
+    reader.ignore(sizeof(uint64_t) - 1);
+    EXPECT_EQ(reader.size(), 1u);
+    EXPECT_FALSE(reader.eof());
+
+    // reading past the end throws, like CDataStream
+    uint32_t n = 0;
+    EXPECT_THROW(reader >> n, std::ios_base::failure);
+    EXPECT_THROW(reader.ignore(2), std::ios_base::failure);
+    reader.ignore(1);
+    EXPECT_TRUE(reader.eof());
+}
+
+TEST(serialize_tests, block_disk_and_network_serialization_match)
+{
+    // stored blocks are sent to peers and returned by getblock as they are
+    const CBlock block = Params().GenesisBlock();
+
+    CDataStream ssDisk(SER_DISK, CLIENT_VERSION);
+    ssDisk << block;
+    CDataStream ssNetwork(SER_NETWORK, PROTOCOL_VERSION);
+    ssNetwork << block;
+    EXPECT_EQ(std::string(ssDisk.begin(), ssDisk.end()),
+              std::string(ssNetwork.begin(), ssNetwork.end()));
+
+    CBlock received;
+    ssDisk >> received;
+    EXPECT_EQ(received.GetHash(), block.GetHash());
+    EXPECT_EQ(received.vtx.size(), block.vtx.size());
+}
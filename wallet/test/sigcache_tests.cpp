@@ -0,0 +1,225 @@
+#include "googletest/googletest/include/gtest/gtest.h"
+
+#include "sigcache.h"
+#include "util.h"
+
+#include <atomic>
+#include <boost/thread.hpp>
+#include <set>
+#include <thread>
+
+namespace {
+
+std::vector<uint256> RandomDigests(std::size_t count)
+{
+    std::vector<uint256> result;
+    result.reserve(count);
+    for (std::size_t i = 0; i < count; i++) {
+        result.push_back(GetRandHash());
+    }
+    return result;
+}
+
+// the cache before SignatureCache, a set behind a mutex
+class LockedSetCache
+{
+    mutable boost::mutex mtx;
+    std::set<uint256>    digests;
+
+public:
+    bool contains(const uint256& digest) const
+    {
+        boost::lock_guard<boost::mutex> lg(mtx);
+        return digests.count(digest) > 0;
+    }
+    void insert(const uint256& digest)
+    {
+        boost::lock_guard<boost::mutex> lg(mtx);
+        digests.insert(digest);
+    }
+};
+
+// every thread looks up all the known digests, and inserts and looks up its own new ones, which are
+// a tenth of the operations
+template <typename Cache>
+void RunStress(Cache& cache, const std::vector<uint256>& known, int threadsCount,
+                  std::atomic_int& falsePositives, std::atomic_int& missedKnown)
+{
+    std::vector<std::vector<uint256>> newDigests;
+    for (int t = 0; t < threadsCount; t++) {
+        newDigests.push_back(RandomDigests(known.size() / 10));
+    }
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadsCount; t++) {
+        threads.emplace_back([&, t]() {
+            for (std::size_t i = 0; i < known.size(); i++) {
+                if (!cache.contains(known[(i + t * 997) % known.size()])) {
+                    missedKnown++;
+                }
+                if (i % 10 == 0) {
+                    const uint256& digest = newDigests[t][i / 10];
+                    if (cache.contains(digest)) {
+                        falsePositives++;
+                    }
+                    cache.insert(digest);
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+} // namespace
+
+TEST(sigcache_tests, inserted_signatures_are_found)
+{
+    SignatureCache cache(1 << 20);
+    EXPECT_GT(cache.capacity(), 0u);
+
+    const std::vector<uint256> inserted    = RandomDigests(1000);
+    const std::vector<uint256> notInserted = RandomDigests(1000);
+    for (const uint256& digest : inserted) {
+        cache.insert(digest);
+    }
+    // inserting twice doesn't take another entry
+    for (const uint256& digest : inserted) {
+        cache.insert(digest);
+    }
+    for (const uint256& digest : inserted) {
+        EXPECT_TRUE(cache.contains(digest));
+    }
+    for (const uint256& digest : notInserted) {
+        EXPECT_FALSE(cache.contains(digest));
+    }
+}
+
+TEST(sigcache_tests, digest)
+{
+    SignatureCache cache1(1 << 20);
+    SignatureCache cache2(1 << 20);
+
+    const uint256                    sighash = GetRandHash();
+    const std::vector<unsigned char> sig     = ParseHex("3044022001");
+    const std::vector<unsigned char> pubKey  = ParseHex("02aabbcc");
+
+    EXPECT_EQ(cache1.computeDigest(sighash, sig, pubKey), cache1.computeDigest(sighash, sig, pubKey));
+
+    // the salt is different for every cache
+    EXPECT_NE(cache1.computeDigest(sighash, sig, pubKey), cache2.computeDigest(sighash, sig, pubKey));
+
+    // every part of the triple counts, including where the signature ends and the key starts
+    EXPECT_NE(cache1.computeDigest(sighash, sig, pubKey),
+              cache1.computeDigest(GetRandHash(), sig, pubKey));
+    EXPECT_NE(cache1.computeDigest(sighash, sig, pubKey),
+              cache1.computeDigest(sighash, ParseHex("30440220"), ParseHex("0102aabbcc")));
+    EXPECT_NE(cache1.computeDigest(sighash, sig, pubKey), cache1.computeDigest(sighash, pubKey, sig));
+}
+
+TEST(sigcache_tests, size_is_bounded)
+{
+    static const std::size_t MaxSize = 1 << 20;
+
+    SignatureCache cache(MaxSize);
+    EXPECT_LE(cache.memoryUsage(), MaxSize);
+    // most of the memory is used
+    EXPECT_GT(cache.memoryUsage(), MaxSize * 9 / 10);
+
+    const std::vector<uint256> digests = RandomDigests(cache.capacity() * 3);
+    for (const uint256& digest : digests) {
+        cache.insert(digest);
+        // the last insert is never dropped
+        EXPECT_TRUE(cache.contains(digest));
+    }
+    std::size_t found = 0;
+    for (const uint256& digest : digests) {
+        found += cache.contains(digest) ? 1 : 0;
+    }
+    EXPECT_LE(found, cache.capacity());
+    EXPECT_GT(found, cache.capacity() / 2);
+}
+
+TEST(sigcache_tests, zero_size)
+{
+    SignatureCache cache(0);
+    EXPECT_EQ(cache.capacity(), 0u);
+    EXPECT_EQ(cache.memoryUsage(), 0u);
+
+    const uint256 digest = GetRandHash();
+    cache.insert(digest);
+    EXPECT_FALSE(cache.contains(digest));
+}
+
+TEST(sigcache_tests, size_for_entries)
+{
+    EXPECT_EQ(SignatureCache::SizeForEntries(0), 0u);
+
+    // what the deprecated -maxsigcachesize, a number of signatures, is converted to
+    for (std::size_t entries : {1u, 6u, 7u, 8u, 50000u, 1000000u}) {
+        SignatureCache cache(SignatureCache::SizeForEntries(entries));
+        EXPECT_GE(cache.capacity(), entries);
+        EXPECT_LT(cache.capacity(), entries + SignatureCache::WaysPerBucket);
+        EXPECT_LE(cache.memoryUsage(), SignatureCache::SizeForEntries(entries));
+    }
+}
+
+TEST(sigcache_tests, concurrent_lookups_and_inserts)
+{
+    static const std::size_t KnownCount = 20000;
+
+    const int threadsCount =
+        std::max(2, std::min(8, static_cast<int>(std::thread::hardware_concurrency())));
+
+    const std::vector<uint256> known = RandomDigests(KnownCount);
+
+    SignatureCache cache(8 << 20);
+    for (const uint256& digest : known) {
+        cache.insert(digest);
+    }
+
+    std::atomic_int falsePositives{0};
+    std::atomic_int missedKnown{0};
+    RunStress(cache, known, threadsCount, falsePositives, missedKnown);
+
+    // a digest that wasn't inserted is never found, even while other threads write to its bucket
+    EXPECT_EQ(falsePositives, 0);
+    // a lookup that races with a write, or a bucket that overflowed, is a miss; both are rare
+    EXPECT_LT(missedKnown, static_cast<int>(KnownCount * threadsCount / 100));
+}
+
+// the same load with more digests, also on a set behind a mutex, to compare them under a profiler; run
+// it with --gtest_also_run_disabled_tests
+TEST(sigcache_tests, DISABLED_concurrent_stress_benchmark)
+{
+    static const std::size_t KnownCount = 100000;
+
+    const int threadsCount =
+        std::max(2, std::min(8, static_cast<int>(std::thread::hardware_concurrency())));
+
+    const std::vector<uint256> known = RandomDigests(KnownCount);
+
+    // with 32 MB, the known digests and the new ones take less than a quarter of the cache
+    SignatureCache cache(32 << 20);
+    LockedSetCache lockedSetCache;
+    for (const uint256& digest : known) {
+        cache.insert(digest);
+        lockedSetCache.insert(digest);
+    }
+
+    std::atomic_int falsePositives{0};
+    std::atomic_int missedKnown{0};
+    RunStress(cache, known, 1, falsePositives, missedKnown);
+    RunStress(cache, known, threadsCount, falsePositives, missedKnown);
+
+    std::atomic_int lockedFalsePositives{0};
+    std::atomic_int lockedMissedKnown{0};
+    RunStress(lockedSetCache, known, 1, lockedFalsePositives, lockedMissedKnown);
+    RunStress(lockedSetCache, known, threadsCount, lockedFalsePositives, lockedMissedKnown);
+
+    EXPECT_EQ(falsePositives, 0);
+    EXPECT_EQ(lockedFalsePositives, 0);
+    EXPECT_EQ(lockedMissedKnown, 0);
+    EXPECT_LT(missedKnown, static_cast<int>(KnownCount * (1 + threadsCount) / 100));
+}
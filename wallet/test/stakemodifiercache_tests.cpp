@@ -0,0 +1,101 @@
+#include "googletest/googletest/include/gtest/gtest.h"
+
+#include "block.h"
+#include "mocks/mtxdb.h"
+#include "ntp1/ntp1transaction.h"
+#include "stakemodifiercache.h"
+
+#include <map>
+
+using ::testing::_;
+using ::testing::Invoke;
+
+namespace {
+
+uint256 MakeHash(const int i) { return uint256(static_cast<uint64_t>(i) + 1); }
+
+StakeModifierCache::Entry MakeEntry(const int fromHeight, const int lastHeight)
+{
+    StakeModifierCache::Entry entry;
+    entry.nStakeModifier       = static_cast<uint64_t>(fromHeight) * 1000;
+    entry.nStakeModifierHeight = lastHeight - 1;
+    entry.nStakeModifierTime   = 1000000 + lastHeight - 1;
+    entry.lastBlockHash        = MakeHash(lastHeight);
+    entry.lastBlockHeight      = lastHeight;
+    return entry;
+}
+
+} // namespace
+
+TEST(stakemodifiercache_tests, lookups_follow_the_main_chain)
+{
+    // the main chain, by height; block hashes are derived from the height unless replaced
+    std::map<int32_t, uint256> mainChain;
+    for (int h = 0; h < 100; h++) {
+        mainChain[h] = MakeHash(h);
+    }
+
+    std::unique_ptr<mTxDB> dbMock = MakeUnique<mTxDB>();
+    EXPECT_CALL(*dbMock, ReadBlockHashOfHeight(_))
+        .WillRepeatedly(Invoke([&mainChain](int32_t height) -> boost::optional<uint256> {
+            const auto it = mainChain.find(height);
+            if (it == mainChain.cend()) {
+                return boost::none;
+            }
+            return it->second;
+        }));
+
+    StakeModifierCache cache(1000);
+    EXPECT_FALSE(cache.get(MakeHash(10), *dbMock));
+
+    cache.add(MakeHash(10), MakeEntry(10, 50));
+    cache.add(MakeHash(20), MakeEntry(20, 60));
+    cache.add(MakeHash(30), MakeEntry(30, 70));
+    EXPECT_EQ(cache.size(), 3u);
+
+    const boost::optional<StakeModifierCache::Entry> entry = cache.get(MakeHash(10), *dbMock);
+    ASSERT_TRUE(entry);
+    EXPECT_EQ(entry->nStakeModifier, MakeEntry(10, 50).nStakeModifier);
+    EXPECT_EQ(entry->nStakeModifierHeight, 49);
+    EXPECT_EQ(entry->nStakeModifierTime, 1000000 + 49);
+
+    // a reorg that replaced block 65 makes the walk of the last entry stale, even without invalidation
+    mainChain[65] = MakeHash(1065);
+    mainChain[70] = MakeHash(1070);
+    EXPECT_TRUE(cache.get(MakeHash(10), *dbMock));
+    EXPECT_TRUE(cache.get(MakeHash(20), *dbMock));
+    EXPECT_FALSE(cache.get(MakeHash(30), *dbMock));
+
+    // disconnecting block 60 drops the entries that reached it
+    cache.invalidateFromHeight(60);
+    EXPECT_EQ(cache.size(), 1u);
+    EXPECT_TRUE(cache.get(MakeHash(10), *dbMock));
+    EXPECT_FALSE(cache.get(MakeHash(20), *dbMock));
+
+    // and once the chain is back, the dropped entries are filled again
+    mainChain[70] = MakeHash(70);
+    cache.add(MakeHash(30), MakeEntry(30, 70));
+    EXPECT_TRUE(cache.get(MakeHash(30), *dbMock));
+
+    cache.clear();
+    EXPECT_EQ(cache.size(), 0u);
+    EXPECT_FALSE(cache.get(MakeHash(10), *dbMock));
+}
+
+TEST(stakemodifiercache_tests, size_is_bounded)
+{
+    StakeModifierCache cache(10);
+    for (int i = 0; i < 100; i++) {
+        cache.add(MakeHash(i), MakeEntry(i, i + 40));
+        EXPECT_LE(cache.size(), 10u);
+    }
+    EXPECT_EQ(cache.size(), 10u);
+
+    // updating an entry doesn't evict another one
+    cache.add(MakeHash(99), MakeEntry(99, 140));
+    EXPECT_EQ(cache.size(), 10u);
+
+    StakeModifierCache disabled(0);
+    disabled.add(MakeHash(1), MakeEntry(1, 41));
+    EXPECT_EQ(disabled.size(), 0u);
+}
@@ -41,17 +41,21 @@ SOURCES += \
     base32_tests.cpp      \
     base58_tests.cpp      \
     base64_tests.cpp      \
+    bestchainstate_tests.cpp \
     bignum_tests.cpp      \
     bloom_tests.cpp       \
+    blockindexcatalog_tests.cpp \
     blockindexlru_tests.cpp \
     canonical_tests.cpp   \
     checkpoints_tests.cpp \
+    checkqueue_tests.cpp  \
     compress_tests.cpp    \
     crypter_tests.cpp     \
     db_tests.cpp          \
     fixedpoint_tests.cpp  \
     getarg_tests.cpp      \
     hash_tests.cpp        \
+    headerssync_tests.cpp \
     key_tests.cpp         \
     merkle_tests.cpp      \
     miner_tests.cpp       \
@@ -59,18 +63,27 @@ SOURCES += \
     netbase_tests.cpp     \
     ntp1_selection_tests.cpp \
     ntp1_tests.cpp        \
+    ntp1index_tests.cpp   \
     pmt_tests.cpp         \
     pos_tests.cpp         \
     rpc_tests.cpp         \
     result_tests.cpp      \
     script_tests.cpp      \
     serialize_tests.cpp   \
+    sigcache_tests.cpp    \
     sigopcount_tests.cpp  \
+    stakemodifiercache_tests.cpp \
     transaction_tests.cpp \
+    txindexwritecache_tests.cpp \
     uint160_tests.cpp     \
     uint256_tests.cpp     \
     util_tests.cpp        \
     wallet_tests.cpp      \
+    walletblockheights_tests.cpp \
+    walletdbbatch_tests.cpp \
+    walletrescan_tests.cpp \
+    walletscriptfilter_tests.cpp \
+    walletunspentindex_tests.cpp \
     environment.cpp
 
 DEFINES += BITCOIN_QT_TEST
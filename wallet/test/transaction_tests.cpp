@@ -509,6 +509,228 @@ TEST(transaction_tests, op_return_size_testnet_after_hf)
     test_op_return_size(*dbMock, NetworkType::Testnet, 4096);
 }
 
+TEST(transaction_tests, tx_hash_memoization)
+{
+    // Random real transaction (e2769b09e784f32f62ef849763d4f45b98e07ba658647343b915ff832b110436)
+    string transaction = "010000004d73435a01d3db1c519251eeecc76b3c68e550988290aa1d7c63d6b396b0ad069ebe98"
+                         "7335000000006b483045022100f06dc9beaca5ae1fceffdeb19cef066beb5cc8c3ef56061c16f5"
+                         "3a086c52be420220603639d99a1da9f258b2a7875608258728a8ee0369c1d7701ccd5999cce32d"
+                         "980121027a4fab48b61923e4c18b1697b1c61481f1843e865d059a178e1940a7a4d10dbfffffff"
+                         "ff02b592849f300000001976a91401854abf39d84762ebeeb332e3116be49f1c4dad88ac00e876"
+                         "48170000001976a91438f54f511df07214284de94d7cffda10b38004d988ac00000000";
+    CDataStream  stream(ParseHex(transaction), SER_NETWORK, PROTOCOL_VERSION);
+    CTransaction tx;
+    stream >> tx;
+
+    const uint256 expected =
+        uint256("e2769b09e784f32f62ef849763d4f45b98e07ba658647343b915ff832b110436");
+    EXPECT_EQ(tx.GetHash(), expected);
+    EXPECT_EQ(SerializeHash(tx), expected);
+
+    // the hash is computed when the transaction is read, and copies keep it until they're modified
+    const uint64_t hashesBefore = CTransaction::GetHashComputationsCount();
+    CTransaction   txCopy       = tx;
+    EXPECT_EQ(txCopy.GetHash(), expected);
+    EXPECT_EQ(CTransaction::GetHashComputationsCount(), hashesBefore);
+    txCopy.nTime++;
+    EXPECT_EQ(txCopy.GetHash(), SerializeHash(txCopy));
+    EXPECT_NE(txCopy.GetHash(), expected);
+    txCopy.nTime--;
+    EXPECT_EQ(txCopy.GetHash(), expected);
+    txCopy.nLockTime++;
+    EXPECT_NE(txCopy.GetHash(), expected);
+    txCopy = tx;
+    txCopy.vin[0].scriptSig[10] ^= 1;
+    EXPECT_EQ(txCopy.GetHash(), SerializeHash(txCopy));
+    EXPECT_NE(txCopy.GetHash(), expected);
+    txCopy = tx;
+    CTxOut& out = txCopy.vout[1];
+    EXPECT_EQ(txCopy.GetHash(), expected);
+    out.nValue++; // a reference obtained earlier is enough to invalidate the hash
+    EXPECT_EQ(txCopy.GetHash(), SerializeHash(txCopy));
+    txCopy = tx;
+    txCopy.vout.push_back(CTxOut());
+    EXPECT_EQ(txCopy.GetHash(), SerializeHash(txCopy));
+    EXPECT_EQ(tx.GetHash(), expected);
+
+    // deserializing into a transaction replaces its hash
+    CDataStream stream2(SER_NETWORK, PROTOCOL_VERSION);
+    stream2 << tx;
+    stream2 >> txCopy;
+    EXPECT_EQ(txCopy.GetHash(), expected);
+
+    tx.SetNull();
+    EXPECT_EQ(tx.GetHash(), SerializeHash(tx));
+
+    // signing a deserialized transaction invalidates its hash
+    CBasicKeyStore keystore;
+    CKey           key;
+    key.MakeNewKey(true);
+    keystore.AddKey(key);
+    CTransaction txFrom;
+    txFrom.vout.resize(1);
+    txFrom.vout[0].scriptPubKey.SetDestination(key.GetPubKey().GetID());
+    CTransaction txTo;
+    txTo.vin.resize(1);
+    txTo.vout.resize(1);
+    txTo.vin[0].prevout.n    = 0;
+    txTo.vin[0].prevout.hash = txFrom.GetHash();
+    txTo.vout[0].nValue      = 1;
+
+    CDataStream stream3(SER_NETWORK, PROTOCOL_VERSION);
+    stream3 << txTo;
+    CTransaction txToRead;
+    stream3 >> txToRead;
+    const uint256 unsignedHash = txToRead.GetHash();
+    EXPECT_EQ(SignSignature(keystore, txFrom, txToRead, 0), SignatureState::Verified);
+    EXPECT_EQ(txToRead.GetHash(), SerializeHash(txToRead));
+    EXPECT_NE(txToRead.GetHash(), unsignedHash);
+}
+
+TEST(transaction_tests, tx_hash_computations_per_block)
+{
+    // a block full of transactions with 2 inputs and 2 outputs
+    static const int          TxCount = 2000;
+    std::vector<CTransaction> vtx(TxCount);
+    for (int i = 0; i < TxCount; i++) {
+        CTransaction& tx = vtx[i];
+        tx.vin.resize(2);
+        tx.vout.resize(2);
+        for (CTxIn& in : tx.vin) {
+            in.prevout.hash = GetRandHash();
+            in.prevout.n    = 0;
+            in.scriptSig    = CScript() << std::vector<unsigned char>(72, 1)
+                                     << std::vector<unsigned char>(33, 2);
+        }
+        for (CTxOut& out : tx.vout) {
+            out.nValue       = i * COIN;
+            out.scriptPubKey = CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, 3)
+                                         << OP_EQUALVERIFY << OP_CHECKSIG;
+        }
+    }
+    CDataStream blockStream(SER_NETWORK, PROTOCOL_VERSION);
+    blockStream << vtx;
+
+    // the number of times a txid is requested per transaction while a block is received, checked,
+    // connected and then synced to the mempool and the wallet (CheckBlock's uniqueness check, the
+    // merkle root, ConnectBlock, mempool removal and SyncWithWallets)
+    static const int CallsPerTx = 6;
+
+    // before: transactions that weren't deserialized are hashed on every call
+    std::vector<uint256> hashes(TxCount);
+    uint64_t             hashesBefore = CTransaction::GetHashComputationsCount();
+    for (int c = 0; c < CallsPerTx; c++) {
+        for (int i = 0; i < TxCount; i++) {
+            hashes[i] = vtx[i].GetHash();
+        }
+    }
+    EXPECT_EQ(CTransaction::GetHashComputationsCount() - hashesBefore,
+              static_cast<uint64_t>(CallsPerTx * TxCount));
+
+    // after: reading the block hashes every transaction once, and the lookups don't hash again
+    std::vector<CTransaction> readVtx;
+    hashesBefore = CTransaction::GetHashComputationsCount();
+    blockStream >> readVtx;
+    ASSERT_EQ(readVtx.size(), vtx.size());
+    EXPECT_EQ(CTransaction::GetHashComputationsCount() - hashesBefore, static_cast<uint64_t>(TxCount));
+
+    std::vector<uint256> cachedHashes(TxCount);
+    hashesBefore = CTransaction::GetHashComputationsCount();
+    for (int c = 0; c < CallsPerTx; c++) {
+        for (int i = 0; i < TxCount; i++) {
+            cachedHashes[i] = readVtx[i].GetHash();
+        }
+    }
+    EXPECT_EQ(CTransaction::GetHashComputationsCount(), hashesBefore);
+    EXPECT_EQ(cachedHashes, hashes);
+
+    // modifying a transaction makes it hashed again
+    readVtx[0].vout[0].nValue++;
+    hashesBefore = CTransaction::GetHashComputationsCount();
+    EXPECT_NE(readVtx[0].GetHash(), hashes[0]);
+    EXPECT_EQ(CTransaction::GetHashComputationsCount() - hashesBefore, 1u);
+}
+
+TEST(transaction_tests, block_inputs_read_in_one_batch)
+{
+    // two txs on disk, spent by a block
+    CTransaction prevTx1;
+    prevTx1.vout.resize(2);
+    prevTx1.vout[0].nValue = 1;
+    prevTx1.vout[1].nValue = 2;
+    CTransaction prevTx2;
+    prevTx2.vout.resize(1);
+    prevTx2.vout[0].nValue = 3;
+    const std::map<uint256, std::pair<CDiskTxPos, CTransaction>> onDisk = {
+        {prevTx1.GetHash(), {CDiskTxPos(uint256(1), 10), prevTx1}},
+        {prevTx2.GetHash(), {CDiskTxPos(uint256(2), 20), prevTx2}}};
+
+    CBlock block;
+    block.vtx.resize(3);
+    block.vtx[0].vin.resize(1);
+    block.vtx[0].vin[0].prevout.SetNull();
+    block.vtx[0].vout.resize(1);
+    block.vtx[1].vin.push_back(CTxIn(prevTx1.GetHash(), 0));
+    block.vtx[1].vin.push_back(CTxIn(prevTx2.GetHash(), 0));
+    block.vtx[1].vout.resize(1);
+    // spends an output created in the block, which isn't read with the others
+    block.vtx[2].vin.push_back(CTxIn(block.vtx[1].GetHash(), 0));
+    block.vtx[2].vin.push_back(CTxIn(prevTx1.GetHash(), 1));
+    block.vtx[2].vout.resize(1);
+
+    std::vector<uint256> expectedHashes = {prevTx1.GetHash(), prevTx2.GetHash()};
+    std::sort(expectedHashes.begin(), expectedHashes.end());
+
+    boost::shared_ptr<mTxDB> dbMock = boost::make_shared<mTxDB>();
+    EXPECT_CALL(*dbMock, ReadTxIndexBatch(expectedHashes, testing::_))
+        .Times(1)
+        .WillOnce(testing::Invoke([&onDisk](const std::vector<uint256>&             hashes,
+                                            std::vector<boost::optional<CTxIndex>>& txindices) {
+            txindices.clear();
+            for (const uint256& hash : hashes) {
+                const auto& tx = onDisk.at(hash);
+                txindices.push_back(CTxIndex(tx.first, tx.second.vout.size()));
+            }
+            return true;
+        }));
+    EXPECT_CALL(*dbMock, ReadTxBatch(testing::_, testing::_))
+        .Times(1)
+        .WillOnce(testing::Invoke([&onDisk](const std::vector<CDiskTxPos>&              positions,
+                                            std::vector<boost::optional<CTransaction>>& txs) {
+            txs.clear();
+            for (const CDiskTxPos& pos : positions) {
+                for (const auto& tx : onDisk) {
+                    if (tx.second.first == pos)
+                        txs.push_back(tx.second.second);
+                }
+            }
+            return true;
+        }));
+
+    MapPrevTx blockInputs;
+    ASSERT_TRUE(block.ReadInputsFromDisk(*dbMock, blockInputs));
+    ASSERT_EQ(blockInputs.size(), 2u);
+    EXPECT_EQ(blockInputs[prevTx1.GetHash()].second.GetHash(), prevTx1.GetHash());
+    EXPECT_EQ(blockInputs[prevTx2.GetHash()].second.GetHash(), prevTx2.GetHash());
+
+    // the inputs are taken from what was read, without reading the db again, and the pending changes
+    // of the tx index still take precedence
+    std::map<uint256, CTxIndex> mapQueuedChanges;
+    CTxIndex                    spentPrevTx2(onDisk.at(prevTx2.GetHash()).first, 1);
+    spentPrevTx2.vSpent[0] = CDiskTxPos(uint256(3), 30);
+    mapQueuedChanges[prevTx2.GetHash()] = spentPrevTx2;
+
+    MapPrevTx mapInputs;
+    bool      fInvalid = false;
+    EXPECT_TRUE(block.vtx[1].FetchInputs(*dbMock, mapQueuedChanges, true, false, mapInputs, fInvalid,
+                                         &blockInputs));
+    EXPECT_FALSE(fInvalid);
+    ASSERT_EQ(mapInputs.size(), 2u);
+    EXPECT_EQ(mapInputs[prevTx1.GetHash()], blockInputs[prevTx1.GetHash()]);
+    EXPECT_EQ(mapInputs[prevTx2.GetHash()].first, spentPrevTx2);
+    EXPECT_EQ(mapInputs[prevTx2.GetHash()].second.GetHash(), prevTx2.GetHash());
+}
+
 TEST(genesis, genesis_block_tests_mainnet)
 {
     SwitchNetworkTypeTemporarily state_holder(NetworkType::Mainnet);
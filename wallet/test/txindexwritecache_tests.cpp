@@ -0,0 +1,239 @@
+#include "googletest/googletest/include/gtest/gtest.h"
+
+#include "block.h"
+#include "mocks/mtxdb.h"
+#include "txindexwritecache.h"
+
+namespace {
+
+uint256 MakeHash(const int i) { return uint256(static_cast<uint64_t>(i) + 1); }
+
+CTxIndex MakeTxIndex(const int i, const unsigned int nOutputs)
+{
+    return CTxIndex(CDiskTxPos(MakeHash(1000 + i), static_cast<unsigned int>(i)), nOutputs);
+}
+
+} // namespace
+
+TEST(txindexwritecache_tests, pending_changes)
+{
+    TxIndexWriteCache::PendingChanges changes;
+    EXPECT_TRUE(changes.empty());
+    EXPECT_FALSE(changes.get(MakeHash(1)));
+
+    changes.update(MakeHash(1), MakeTxIndex(1, 2));
+    changes.erase(MakeHash(2));
+    EXPECT_FALSE(changes.empty());
+    EXPECT_EQ(changes.getAll().size(), 2u);
+
+    ASSERT_TRUE(changes.get(MakeHash(1)));
+    ASSERT_TRUE(*changes.get(MakeHash(1)));
+    EXPECT_EQ(**changes.get(MakeHash(1)), MakeTxIndex(1, 2));
+
+    // an erased tx index is a tombstone, not a missing entry
+    ASSERT_TRUE(changes.get(MakeHash(2)));
+    EXPECT_FALSE(*changes.get(MakeHash(2)));
+
+    // the last change wins
+    changes.erase(MakeHash(1));
+    EXPECT_FALSE(*changes.get(MakeHash(1)));
+    changes.update(MakeHash(2), MakeTxIndex(2, 3));
+    EXPECT_EQ(**changes.get(MakeHash(2)), MakeTxIndex(2, 3));
+}
+
+TEST(txindexwritecache_tests, apply_and_clear)
+{
+    TxIndexWriteCache cache;
+    EXPECT_TRUE(cache.empty());
+    EXPECT_EQ(cache.getMemoryUsage(), 0u);
+
+    {
+        TxIndexWriteCache::PendingChanges changes;
+        for (int i = 0; i < 100; i++) {
+            changes.update(MakeHash(i), MakeTxIndex(i, 2));
+        }
+        cache.apply(changes);
+    }
+    EXPECT_EQ(cache.size(), 100u);
+    const std::size_t usage = cache.getMemoryUsage();
+    EXPECT_GT(usage, 0u);
+
+    // spending an output of a cached tx replaces the entry in place
+    {
+        CTxIndex spent  = MakeTxIndex(5, 2);
+        spent.vSpent[1] = CDiskTxPos(MakeHash(2000), 7);
+        TxIndexWriteCache::PendingChanges changes;
+        changes.update(MakeHash(5), spent);
+        changes.erase(MakeHash(6));
+        cache.apply(changes);
+        EXPECT_EQ(**cache.get(MakeHash(5)), spent);
+    }
+    EXPECT_EQ(cache.size(), 100u);
+    EXPECT_LE(cache.getMemoryUsage(), usage);
+
+    ASSERT_TRUE(cache.get(MakeHash(6)));
+    EXPECT_FALSE(*cache.get(MakeHash(6)));
+    EXPECT_FALSE(cache.get(MakeHash(100)));
+
+    // entries are sorted for writing
+    const std::map<uint256, TxIndexWriteCache::Entry> all = cache.getAll();
+    EXPECT_EQ(all.size(), 100u);
+
+    cache.clear();
+    EXPECT_TRUE(cache.empty());
+    EXPECT_EQ(cache.getMemoryUsage(), 0u);
+    EXPECT_FALSE(cache.get(MakeHash(5)));
+}
+
+TEST(txindexwritecache_tests, size_limit)
+{
+    TxIndexWriteCache cache;
+
+    // a zero limit disables caching writes
+    cache.setCachingWrites(true);
+    EXPECT_FALSE(cache.isCachingWrites());
+
+    cache.setMaxMemoryUsage(10000);
+    EXPECT_TRUE(cache.isCachingWrites());
+    cache.setCachingWrites(false);
+    EXPECT_FALSE(cache.isCachingWrites());
+
+    int i = 0;
+    while (!cache.isFull()) {
+        TxIndexWriteCache::PendingChanges changes;
+        changes.update(MakeHash(i), MakeTxIndex(i, 4));
+        cache.apply(changes);
+        i++;
+        ASSERT_LT(i, 10000);
+    }
+    EXPECT_GE(cache.getMemoryUsage(), 10000u);
+    EXPECT_EQ(cache.size(), static_cast<std::size_t>(i));
+}
+
+TEST(txindexwritecache_tests, unflushed_cache_recovery)
+{
+    using ::testing::_;
+
+    // a tx whose tx index was in the db at the marker block, when the node stopped with a cache
+    // holding the tx index changes of the two blocks after it
+    CTransaction prevTx;
+    prevTx.vout.resize(2);
+    prevTx.vout[0].nValue = 1;
+    prevTx.vout[1].nValue = 2;
+
+    const uint256 markerHash = MakeHash(500);
+
+    CBlock block1;
+    block1.hashPrevBlock = markerHash;
+    block1.vtx.resize(2);
+    block1.vtx[0].vin.resize(1);
+    block1.vtx[0].vin[0].prevout.SetNull();
+    block1.vtx[0].vout.resize(1);
+    block1.vtx[1].vin.push_back(CTxIn(prevTx.GetHash(), 0));
+    block1.vtx[1].vout.resize(1);
+    const uint256 block1Hash = block1.GetHash();
+
+    CBlock block2;
+    block2.hashPrevBlock = block1Hash;
+    block2.vtx.resize(2);
+    block2.vtx[0].vin.resize(1);
+    block2.vtx[0].vin[0].prevout.SetNull();
+    block2.vtx[0].vout.resize(2);
+    block2.vtx[1].vin.push_back(CTxIn(block1.vtx[1].GetHash(), 0));
+    block2.vtx[1].vin.push_back(CTxIn(prevTx.GetHash(), 1));
+    block2.vtx[1].vout.resize(1);
+    const uint256 block2Hash = block2.GetHash();
+
+    CBlockIndex markerIndex;
+    markerIndex.blockHash = markerHash;
+    markerIndex.nHeight   = 10;
+    CBlockIndex block1Index(block1Hash, block1);
+    block1Index.hashPrev = markerHash;
+    block1Index.nHeight  = 11;
+    CBlockIndex block2Index(block2Hash, block2);
+    block2Index.hashPrev = block1Hash;
+    block2Index.nHeight  = 12;
+
+    const std::map<uint256, CBlockIndex> blockIndices = {
+        {markerHash, markerIndex}, {block1Hash, block1Index}, {block2Hash, block2Index}};
+    const std::map<uint256, CBlock> blocks = {{block1Hash, block1}, {block2Hash, block2}};
+
+    std::map<uint256, CTxIndex> txIndex;
+    const CDiskTxPos            prevTxPos(markerHash, 100);
+    txIndex[prevTx.GetHash()] = CTxIndex(prevTxPos, prevTx.vout.size());
+
+    mTxDB txdb;
+    ON_CALL(txdb, ReadBlockIndex(_))
+        .WillByDefault(
+            ::testing::Invoke([&blockIndices](const uint256& hash) -> boost::optional<CBlockIndex> {
+                const auto it = blockIndices.find(hash);
+                return it != blockIndices.cend() ? boost::make_optional(it->second) : boost::none;
+            }));
+    ON_CALL(txdb, ReadBlock(_, _, _))
+        .WillByDefault(::testing::Invoke([&blocks](const uint256& hash, CBlock& blk, bool) {
+            const auto it = blocks.find(hash);
+            if (it == blocks.cend())
+                return false;
+            blk = it->second;
+            return true;
+        }));
+    ON_CALL(txdb, ReadTxIndex(_, _))
+        .WillByDefault(::testing::Invoke([&txIndex](const uint256& hash, CTxIndex& txindex) {
+            const auto it = txIndex.find(hash);
+            if (it == txIndex.cend())
+                return false;
+            txindex = it->second;
+            return true;
+        }));
+    ON_CALL(txdb, UpdateTxIndex(_, _))
+        .WillByDefault(::testing::Invoke([&txIndex](const uint256& hash, const CTxIndex& txindex) {
+            txIndex[hash] = txindex;
+            return true;
+        }));
+    EXPECT_CALL(txdb, ReadBlockIndex(_)).Times(::testing::AnyNumber());
+    EXPECT_CALL(txdb, ReadBlock(_, _, _)).Times(::testing::AnyNumber());
+    EXPECT_CALL(txdb, ReadTxIndex(_, _)).Times(::testing::AnyNumber());
+    EXPECT_CALL(txdb, UpdateTxIndex(_, _)).Times(::testing::AnyNumber());
+
+    // only the tx index is written; the best chain and the rest of the blocks stay as they are
+    EXPECT_CALL(txdb, WriteHashBestChain(_)).Times(0);
+    EXPECT_CALL(txdb, WriteBlockIndex(_)).Times(0);
+    EXPECT_CALL(txdb, EraseBlockHashOfHeight(_)).Times(0);
+    EXPECT_CALL(txdb, WriteBlockHashOfHeight(_, _)).Times(0);
+    EXPECT_CALL(txdb, WriteNTP1Tx(_, _)).Times(0);
+
+    ASSERT_TRUE(CBlock::ReconnectTxIndex(txdb, markerHash, block2Hash));
+
+    ASSERT_EQ(txIndex.size(), 5u);
+
+    // every tx index points to its tx in its block on disk
+    for (const CBlock& block : {block1, block2}) {
+        CDataStream ss(SER_DISK, CLIENT_VERSION);
+        ss << block;
+        const std::string blockBytes = ss.str();
+        for (const CTransaction& tx : block.vtx) {
+            ASSERT_EQ(txIndex.count(tx.GetHash()), 1u);
+            const CTxIndex& txindex = txIndex.at(tx.GetHash());
+            EXPECT_EQ(txindex.pos.nBlockPos, block.GetHash());
+            ASSERT_LT(txindex.pos.nTxPos, blockBytes.size());
+            CDataStream  txStream(blockBytes.data() + txindex.pos.nTxPos,
+                                  blockBytes.data() + blockBytes.size(), SER_DISK, CLIENT_VERSION);
+            CTransaction txOnDisk;
+            txStream >> txOnDisk;
+            EXPECT_EQ(txOnDisk.GetHash(), tx.GetHash());
+            EXPECT_EQ(txindex.vSpent.size(), tx.vout.size());
+        }
+    }
+
+    // the outputs are spent as connecting the blocks spent them
+    const CTxIndex& prevTxIndex = txIndex.at(prevTx.GetHash());
+    EXPECT_EQ(prevTxIndex.pos, prevTxPos);
+    EXPECT_EQ(prevTxIndex.vSpent[0], txIndex.at(block1.vtx[1].GetHash()).pos);
+    EXPECT_EQ(prevTxIndex.vSpent[1], txIndex.at(block2.vtx[1].GetHash()).pos);
+    EXPECT_EQ(txIndex.at(block1.vtx[1].GetHash()).vSpent[0], txIndex.at(block2.vtx[1].GetHash()).pos);
+    EXPECT_TRUE(txIndex.at(block1.vtx[0].GetHash()).vSpent[0].IsNull());
+    EXPECT_TRUE(txIndex.at(block2.vtx[1].GetHash()).vSpent[0].IsNull());
+
+    // a marker that isn't an ancestor of the best block is refused
+    EXPECT_FALSE(CBlock::ReconnectTxIndex(txdb, MakeHash(501), block2Hash));
+}
@@ -1,9 +1,12 @@
 #include "googletest/googletest/include/gtest/gtest.h"
 
+#include "coinselection.h"
 #include "main.h"
 #include "mocks/mtxdb.h"
 #include "wallet.h"
 
+#include <random>
+
 // how many times to run all the tests to have a chance to catch errors that only show up with particular
 // random shuffles
 #define RUN_TESTS 100
@@ -339,3 +342,153 @@ TEST(wallet_tests, coin_selection_tests)
         empty_wallet();
     }
 }
+
+TEST(wallet_tests, coin_selection_bnb)
+{
+    std::mt19937 gen(12345);
+
+    // compare with all the subsets of small sets
+    for (int run = 0; run < 1000; run++) {
+        std::vector<CAmount> values(1 + gen() % 12);
+        for (CAmount& v : values) {
+            v = 1 + gen() % 20;
+        }
+        std::sort(values.rbegin(), values.rend());
+        const CAmount target = 1 + gen() % 60;
+
+        bool exists = false;
+        for (unsigned mask = 0; mask < (1u << values.size()) && !exists; mask++) {
+            CAmount total = 0;
+            for (unsigned i = 0; i < values.size(); i++) {
+                if (mask & (1u << i)) {
+                    total += values[i];
+                }
+            }
+            exists = (total == target);
+        }
+
+        std::vector<char> vfSelected;
+        CAmount           nTotal = 0;
+        ASSERT_EQ(SelectCoinsBnB(values, target, 0, vfSelected, nTotal), exists);
+        if (exists) {
+            CAmount selected = 0;
+            for (unsigned i = 0; i < values.size(); i++) {
+                if (vfSelected[i]) {
+                    selected += values[i];
+                }
+            }
+            EXPECT_EQ(selected, target);
+            EXPECT_EQ(nTotal, target);
+        }
+    }
+
+    // with a cost of change, the smallest total in the range is chosen
+    std::vector<char> vfSelected;
+    CAmount           nTotal = 0;
+    EXPECT_TRUE(SelectCoinsBnB({10, 7, 5}, 11, 2, vfSelected, nTotal));
+    EXPECT_EQ(nTotal, 12);
+    EXPECT_EQ(vfSelected, std::vector<char>({false, true, true}));
+    EXPECT_FALSE(SelectCoinsBnB({10, 7, 5}, 11, 0, vfSelected, nTotal));
+    EXPECT_FALSE(SelectCoinsBnB({10, 7, 5}, 23, 10, vfSelected, nTotal));
+}
+
+TEST(wallet_tests, coin_selection_index)
+{
+    CTransaction tx;
+    CWalletTx    wtx(&wallet, tx);
+
+    EXPECT_EQ(CoinSelectionIndex::BucketOf(1), 0);
+    EXPECT_EQ(CoinSelectionIndex::BucketOf(2), 1);
+    EXPECT_EQ(CoinSelectionIndex::BucketOf(3), 1);
+    EXPECT_EQ(CoinSelectionIndex::BucketOf(COIN), 26);
+
+    CoinSelectionIndex index;
+    for (unsigned i = 0; i < 10000; i++) {
+        CoinSelectionIndex::Coin coin;
+        coin.value  = (1 + i % 100) * CENT;
+        coin.tx     = &wtx;
+        coin.i      = i;
+        coin.depth  = (i % 2 == 0 ? 10 : 1);
+        coin.fromMe = (i % 4 == 1);
+        index.add(coin);
+    }
+    EXPECT_EQ(index.size(), 10000u);
+
+    const CoinSelectionIndex::Coin* exact = index.findExact(50 * CENT, 1, 6);
+    ASSERT_NE(exact, nullptr);
+    EXPECT_EQ(exact->value, 50 * CENT);
+    EXPECT_EQ(index.findExact(50 * CENT + 1, 1, 1), nullptr);
+    // the coins of 50 cents have one confirmation
+    EXPECT_EQ(index.findExact(50 * CENT, 6, 6), nullptr);
+
+    const CoinSelectionIndex::Coin* larger = index.findLowestAtLeast(60 * CENT + 1, 1, 1);
+    ASSERT_NE(larger, nullptr);
+    EXPECT_EQ(larger->value, 61 * CENT);
+    EXPECT_EQ(index.findLowestAtLeast(100 * CENT + 1, 1, 1), nullptr);
+
+    const std::vector<const CoinSelectionIndex::Coin*> all =
+        index.getCoinsBelow(50 * CENT, 1, 1, 100000, 0);
+    EXPECT_EQ(all.size(), 4900u);
+    for (const CoinSelectionIndex::Coin* coin : all) {
+        EXPECT_LT(coin->value, 50 * CENT);
+    }
+
+    // a sample from all the buckets when there are too many
+    const std::vector<const CoinSelectionIndex::Coin*> sample =
+        index.getCoinsBelow(50 * CENT, 1, 1, 500, 100 * CENT);
+    EXPECT_GE(sample.size(), 500u);
+    EXPECT_LT(sample.size(), 500u + CoinSelectionIndex::BUCKETS_COUNT);
+    CAmount smallest = std::numeric_limits<CAmount>::max();
+    for (const CoinSelectionIndex::Coin* coin : sample) {
+        smallest = std::min(smallest, coin->value);
+    }
+    EXPECT_EQ(smallest, 1 * CENT);
+
+    // but all of them if the sample isn't enough
+    EXPECT_EQ(index.getCoinsBelow(50 * CENT, 1, 1, 500, 10000 * COIN).size(), 4900u);
+}
+
+// slow with a million coins; run it with --gtest_also_run_disabled_tests, e.g. under a profiler
+TEST(wallet_tests, DISABLED_coin_selection_benchmark)
+{
+    CTransaction tx;
+    CWalletTx    wtx(&wallet, tx);
+
+    struct Run
+    {
+        unsigned int coinsCount;
+        CAmount      target;
+    };
+    // payouts are usually round amounts; an amount that no subset adds up to is the worst case
+    const std::vector<Run> runs = {{10000, 1234 * COIN + 56 * CENT},
+                                   {100000, 1234 * COIN + 56 * CENT},
+                                   {1000000, 1234 * COIN + 56 * CENT},
+                                   {10000, 1234 * COIN + 56 * CENT + 7}};
+
+    for (const Run& run : runs) {
+        std::mt19937       gen(run.coinsCount);
+        CoinSelectionIndex index;
+        for (unsigned i = 0; i < run.coinsCount; i++) {
+            CoinSelectionIndex::Coin coin;
+            coin.value = (1 + gen() % 10000) * CENT;
+            coin.tx    = &wtx;
+            coin.i     = i;
+            coin.depth = 100;
+            index.add(coin);
+        }
+
+        // stochastic approximation over all coins
+        CoinSet setCoinsLegacy;
+        CAmount nValueLegacy = 0;
+        EXPECT_TRUE(SelectCoinsFromIndex(index, run.target, 1, 1, setCoinsLegacy, nValueLegacy, false,
+                                         std::numeric_limits<std::size_t>::max()));
+
+        // branch and bound with sampling
+        CoinSet setCoins;
+        CAmount nValue = 0;
+        EXPECT_TRUE(SelectCoinsFromIndex(index, run.target, 1, 1, setCoins, nValue));
+
+        EXPECT_GE(nValueLegacy, run.target);
+        EXPECT_GE(nValue, run.target);
+    }
+}
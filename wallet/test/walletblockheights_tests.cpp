@@ -0,0 +1,216 @@
+#include "googletest/googletest/include/gtest/gtest.h"
+
+#include "block.h"
+#include "blockindex.h"
+#include "mocks/mtxdb.h"
+#include "ntp1/ntp1transaction.h"
+#include "walletblockheights.h"
+
+#include <map>
+
+using ::testing::_;
+using ::testing::Invoke;
+
+namespace {
+
+uint256 MakeHash(const int i) { return uint256(static_cast<uint64_t>(i) + 1); }
+
+struct TestChain
+{
+    std::map<uint256, CBlockIndex> blocks;
+    std::map<int32_t, uint256>     mainChain;
+    uint256                        bestHash;
+
+    void addBlock(const uint256& hash, const uint256& prevHash, int height)
+    {
+        CBlockIndex bi;
+        bi.blockHash = hash;
+        bi.hashPrev  = prevHash;
+        bi.nHeight   = height;
+        blocks[hash] = bi;
+    }
+
+    void setBest(const uint256& hash)
+    {
+        for (auto& p : blocks) {
+            p.second.hashNext = 0;
+        }
+        mainChain.clear();
+        bestHash = hash;
+
+        uint256 current = hash;
+        while (current != 0) {
+            const CBlockIndex& bi  = blocks.at(current);
+            mainChain[bi.nHeight] = current;
+            if (bi.hashPrev != 0) {
+                blocks.at(bi.hashPrev).hashNext = current;
+            }
+            current = bi.hashPrev;
+        }
+    }
+
+    int bestHeight() const { return blocks.at(bestHash).nHeight; }
+
+    // how the depth is found without a cache
+    boost::optional<int> referenceDepth(const uint256& hash) const
+    {
+        const CBlockIndex& bi = blocks.at(hash);
+        if (!bi.IsInMainChain(bestHash)) {
+            return boost::none;
+        }
+        return bestHeight() - bi.nHeight + 1;
+    }
+};
+
+std::unique_ptr<mTxDB> MakeChainMock(const TestChain& chain)
+{
+    std::unique_ptr<mTxDB> dbMock = MakeUnique<mTxDB>();
+    EXPECT_CALL(*dbMock, ReadBlockIndex(_))
+        .WillRepeatedly(Invoke([&chain](const uint256& hash) -> boost::optional<CBlockIndex> {
+            const auto it = chain.blocks.find(hash);
+            if (it == chain.blocks.cend()) {
+                return boost::none;
+            }
+            return it->second;
+        }));
+    EXPECT_CALL(*dbMock, ReadBlockHashOfHeight(_))
+        .WillRepeatedly(Invoke([&chain](int32_t height) -> boost::optional<uint256> {
+            const auto it = chain.mainChain.find(height);
+            if (it == chain.mainChain.cend()) {
+                return boost::none;
+            }
+            return it->second;
+        }));
+    return dbMock;
+}
+
+void ExpectSameDepths(const TestChain& chain, const ITxDB& txdb, WalletBlockHeights& heights)
+{
+    for (const auto& p : chain.blocks) {
+        EXPECT_EQ(heights.getDepth(txdb, p.first, chain.bestHash), chain.referenceDepth(p.first))
+            << "For block at height " << p.second.nHeight;
+    }
+}
+
+void TestReorg(bool withNotifications)
+{
+    // a main chain of 100 blocks, and a fork from block 90 that gets longer and replaces it
+    TestChain chain;
+    for (int h = 0; h <= 100; h++) {
+        chain.addBlock(MakeHash(h), h > 0 ? MakeHash(h - 1) : uint256(0), h);
+    }
+    for (int h = 91; h <= 105; h++) {
+        chain.addBlock(MakeHash(1000 + h), h > 91 ? MakeHash(1000 + h - 1) : MakeHash(90), h);
+    }
+    chain.setBest(MakeHash(100));
+
+    std::unique_ptr<mTxDB> dbMock = MakeChainMock(chain);
+    WalletBlockHeights     heights;
+
+    ExpectSameDepths(chain, *dbMock, heights);
+    // twice, the second time from the cache
+    ExpectSameDepths(chain, *dbMock, heights);
+
+    // extend the main chain
+    chain.addBlock(MakeHash(101), MakeHash(100), 101);
+    chain.setBest(MakeHash(101));
+    if (withNotifications) {
+        heights.blockConnected(MakeHash(101), 101);
+    }
+    ExpectSameDepths(chain, *dbMock, heights);
+
+    // the fork becomes the main chain
+    chain.setBest(MakeHash(1105));
+    if (withNotifications) {
+        for (int h = 91; h <= 101; h++) {
+            heights.blockDisconnected(MakeHash(h));
+        }
+        for (int h = 91; h <= 105; h++) {
+            heights.blockConnected(MakeHash(1000 + h), h);
+        }
+    }
+    ExpectSameDepths(chain, *dbMock, heights);
+    ExpectSameDepths(chain, *dbMock, heights);
+
+    // and back to the old chain
+    for (int h = 102; h <= 110; h++) {
+        chain.addBlock(MakeHash(h), MakeHash(h - 1), h);
+    }
+    chain.setBest(MakeHash(110));
+    if (withNotifications) {
+        for (int h = 91; h <= 105; h++) {
+            heights.blockDisconnected(MakeHash(1000 + h));
+        }
+        for (int h = 91; h <= 110; h++) {
+            heights.blockConnected(MakeHash(h), h);
+        }
+    }
+    ExpectSameDepths(chain, *dbMock, heights);
+
+    // an older best block than the cache has seen
+    chain.setBest(MakeHash(100));
+    ExpectSameDepths(chain, *dbMock, heights);
+}
+
+} // namespace
+
+TEST(walletblockheights_tests, reorg_without_notifications) { TestReorg(false); }
+
+TEST(walletblockheights_tests, reorg_with_notifications) { TestReorg(true); }
+
+TEST(walletblockheights_tests, cached_heights_need_no_db)
+{
+    TestChain chain;
+    for (int h = 0; h <= 10; h++) {
+        chain.addBlock(MakeHash(h), h > 0 ? MakeHash(h - 1) : uint256(0), h);
+    }
+    chain.setBest(MakeHash(10));
+
+    std::unique_ptr<mTxDB> dbMock = MakeChainMock(chain);
+    WalletBlockHeights     heights;
+
+    EXPECT_EQ(heights.getDepth(*dbMock, MakeHash(5), chain.bestHash), boost::make_optional(6));
+    EXPECT_EQ(heights.size(), 1u);
+
+    // with the best block known, the cached heights don't touch the database
+    std::unique_ptr<mTxDB> emptyDbMock = MakeUnique<mTxDB>();
+    EXPECT_CALL(*emptyDbMock, ReadBlockIndex(_)).Times(0);
+    EXPECT_CALL(*emptyDbMock, ReadBlockHashOfHeight(_)).Times(0);
+    EXPECT_EQ(heights.getDepth(*emptyDbMock, MakeHash(5), chain.bestHash), boost::make_optional(6));
+    EXPECT_EQ(heights.getDepth(*dbMock, MakeHash(7), chain.bestHash), boost::make_optional(4));
+    heights.blockConnected(MakeHash(7), 7);
+    EXPECT_EQ(heights.getDepth(*emptyDbMock, MakeHash(7), chain.bestHash), boost::make_optional(4));
+    EXPECT_EQ(heights.size(), 2u);
+
+    heights.clear();
+    EXPECT_EQ(heights.size(), 0u);
+}
+
+TEST(walletblockheights_tests, unrelated_blocks_are_not_kept)
+{
+    TestChain chain;
+    for (int h = 0; h <= 1000; h++) {
+        chain.addBlock(MakeHash(h), h > 0 ? MakeHash(h - 1) : uint256(0), h);
+    }
+    chain.setBest(MakeHash(1000));
+
+    std::unique_ptr<mTxDB> dbMock = MakeChainMock(chain);
+    WalletBlockHeights     heights;
+
+    // the block of a wallet tx, and one that's not in the main chain yet
+    chain.addBlock(MakeHash(5000), MakeHash(1000), 1001);
+    EXPECT_EQ(heights.getDepth(*dbMock, MakeHash(500), chain.bestHash), boost::make_optional(501));
+    EXPECT_FALSE(heights.getDepth(*dbMock, MakeHash(5000), chain.bestHash));
+    EXPECT_EQ(heights.size(), 1u);
+
+    // connecting every block of the chain keeps only the blocks that were looked up
+    for (int h = 0; h <= 1000; h++) {
+        heights.blockConnected(MakeHash(h), h);
+    }
+    EXPECT_EQ(heights.size(), 1u);
+    chain.setBest(MakeHash(5000));
+    heights.blockConnected(MakeHash(5000), 1001);
+    EXPECT_EQ(heights.size(), 2u);
+    EXPECT_EQ(heights.getDepth(*dbMock, MakeHash(5000), chain.bestHash), boost::make_optional(1));
+    EXPECT_EQ(heights.getDepth(*dbMock, MakeHash(500), chain.bestHash), boost::make_optional(502));
+}
@@ -0,0 +1,146 @@
+#include "googletest/googletest/include/gtest/gtest.h"
+
+#include "init.h"
+#include "wallet.h"
+#include "walletdb.h"
+
+namespace {
+
+// a new wallet in the test data directory; not deleted, like in accounting_tests
+CWallet* MakeTestWallet(const std::string& fileName)
+{
+    const std::string walletPath = std::string(TEST_ROOT_PATH) + "/data/" + fileName;
+    if (boost::filesystem::exists(walletPath)) {
+        EXPECT_TRUE(boost::filesystem::remove(walletPath));
+    }
+    bool     fFirstRun = true;
+    CWallet* wallet    = new CWallet(walletPath);
+    EXPECT_EQ(wallet->LoadWallet(fFirstRun), DB_LOAD_OK);
+    return wallet;
+}
+
+CKeyPool MakeKeyPoolEntry()
+{
+    CKey key;
+    key.MakeNewKey(true);
+    return CKeyPool(key.GetPubKey());
+}
+
+// the log position of the last checkpoint of the environment, which every flush of a database writes
+DB_LSN LastCheckpoint()
+{
+    DB_TXN_STAT* stats = nullptr;
+    EXPECT_EQ(bitdb.dbenv.txn_stat(&stats, 0), 0);
+    const DB_LSN lsn = stats->st_last_ckp;
+    free(stats);
+    return lsn;
+}
+
+} // namespace
+
+TEST(walletdbbatch_tests, writes_join_the_batch_of_the_thread)
+{
+    CWallet* wallet = MakeTestWallet("walletbatch1.dat");
+
+    const CKeyPool entry1 = MakeKeyPoolEntry();
+    const CKeyPool entry2 = MakeKeyPoolEntry();
+    {
+        CDBBatch batch(wallet->strWalletFile);
+        EXPECT_TRUE(batch.IsOwner());
+
+        // a nested batch joins the first one
+        {
+            CDBBatch nestedBatch(wallet->strWalletFile);
+            EXPECT_FALSE(nestedBatch.IsOwner());
+            EXPECT_FALSE(nestedBatch.Commit());
+        }
+
+        // every database of the file opened in the thread sees the writes of the others
+        {
+            CWalletDB walletdb(wallet->strWalletFile);
+            EXPECT_TRUE(walletdb.WritePool(1, entry1));
+            EXPECT_FALSE(walletdb.TxnCommit());
+        }
+        {
+            CWalletDB walletdb(wallet->strWalletFile);
+            CKeyPool  entryRead;
+            EXPECT_TRUE(walletdb.ReadPool(1, entryRead));
+            EXPECT_EQ(entryRead.vchPubKey, entry1.vchPubKey);
+        }
+
+        EXPECT_TRUE(batch.Commit());
+        EXPECT_TRUE(batch.IsOwner());
+
+        {
+            CWalletDB walletdb(wallet->strWalletFile);
+            EXPECT_TRUE(walletdb.WritePool(2, entry2));
+        }
+    }
+
+    // committed when the batch is destroyed
+    CWalletDB walletdb(wallet->strWalletFile);
+    CKeyPool  entryRead;
+    EXPECT_TRUE(walletdb.ReadPool(1, entryRead));
+    EXPECT_EQ(entryRead.vchPubKey, entry1.vchPubKey);
+    EXPECT_TRUE(walletdb.ReadPool(2, entryRead));
+    EXPECT_EQ(entryRead.vchPubKey, entry2.vchPubKey);
+}
+
+TEST(walletdbbatch_tests, databases_in_a_batch_dont_flush_on_close)
+{
+    CWallet* wallet = MakeTestWallet("walletbatch3.dat");
+
+    // a flush outside of a batch checkpoints
+    DB_LSN checkpoint = LastCheckpoint();
+    EXPECT_TRUE(CWalletDB(wallet->strWalletFile).WritePool(1, MakeKeyPoolEntry()));
+    DB_LSN newCheckpoint = LastCheckpoint();
+    EXPECT_LT(log_compare(&checkpoint, &newCheckpoint), 0);
+
+    checkpoint = newCheckpoint;
+    {
+        CDBBatch batch(wallet->strWalletFile);
+        ASSERT_TRUE(batch.IsOwner());
+        for (int i = 0; i < 10; i++) {
+            EXPECT_TRUE(CWalletDB(wallet->strWalletFile).WritePool(2 + i, MakeKeyPoolEntry()));
+        }
+        newCheckpoint = LastCheckpoint();
+        EXPECT_EQ(log_compare(&checkpoint, &newCheckpoint), 0);
+    }
+
+    // the batch flushes once it's committed
+    newCheckpoint = LastCheckpoint();
+    EXPECT_LT(log_compare(&checkpoint, &newCheckpoint), 0);
+}
+
+// writes thousands of keys to compare a batched key pool refill with a database per write; run it with
+// --gtest_also_run_disabled_tests
+TEST(walletdbbatch_tests, DISABLED_keypool_refill_benchmark)
+{
+    static const unsigned int KeysCount          = 10000;
+    static const int          UnbatchedKeysCount = 500;
+
+    CWallet* wallet = MakeTestWallet("walletbatch2.dat");
+
+    // what keypoolrefill does; every key is written twice, as a key and as a key pool entry
+    ASSERT_TRUE(wallet->TopUpKeyPool(KeysCount));
+    {
+        LOCK(wallet->cs_wallet);
+        EXPECT_EQ(wallet->GetKeyPoolSize(), KeysCount + 1);
+    }
+
+    // the same writes with a database per write, which flushes when it's closed
+    std::vector<CKeyPool> entries;
+    for (int i = 0; i < UnbatchedKeysCount; i++) {
+        entries.push_back(MakeKeyPoolEntry());
+    }
+    for (int i = 0; i < UnbatchedKeysCount; i++) {
+        EXPECT_TRUE(CWalletDB(wallet->strWalletFile).WritePool(KeysCount + 10 + i, entries[i]));
+    }
+
+    // everything is on disk
+    CWallet* reloadedWallet = new CWallet(wallet->strWalletFile);
+    bool     fFirstRun      = false;
+    EXPECT_EQ(reloadedWallet->LoadWallet(fFirstRun), DB_LOAD_OK);
+    LOCK(reloadedWallet->cs_wallet);
+    EXPECT_EQ(reloadedWallet->GetKeyPoolSize(), KeysCount + 1 + UnbatchedKeysCount);
+}
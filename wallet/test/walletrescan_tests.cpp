@@ -0,0 +1,208 @@
+#include "googletest/googletest/include/gtest/gtest.h"
+
+#include "block.h"
+#include "keystore.h"
+#include "script.h"
+#include "walletrescan.h"
+
+#include <atomic>
+#include <stdexcept>
+
+namespace {
+
+CScript KeyToP2PKH(const CKey& key)
+{
+    CScript result;
+    result.SetDestination(key.GetPubKey().GetID());
+    return result;
+}
+
+CScript KeyToP2PK(const CKey& key) { return CScript() << key.GetPubKey() << OP_CHECKSIG; }
+
+// the same as CWallet::GetKeyStoreSnapshot(), for the redeem scripts that are given
+std::unique_ptr<KeyStoreSnapshot> MakeSnapshot(const CKeyStore&           keystore,
+                                               const std::vector<CScript>& redeemScripts = {})
+{
+    std::set<CKeyID> keys;
+    keystore.GetKeys(keys);
+    ScriptMap scripts;
+    for (const CScript& s : redeemScripts) {
+        CScript redeemScript;
+        if (keystore.GetCScript(s.GetID(), redeemScript)) {
+            scripts[s.GetID()] = redeemScript;
+        }
+    }
+    return MakeUnique<KeyStoreSnapshot>(std::move(keys), std::move(scripts));
+}
+
+CTransaction MakeTx(const CScript& scriptPubKey, CAmount value)
+{
+    CTransaction tx;
+    tx.vout.resize(1);
+    tx.vout[0].scriptPubKey = scriptPubKey;
+    tx.vout[0].nValue       = value;
+    return tx;
+}
+
+// the tx with index i of the block at height h pays to mine if (h + i) % 3 == 0
+CBlock MakeBlock(int height, const CScript& mine, const CScript& notMine)
+{
+    CBlock block;
+    for (int i = 0; i < 3; i++) {
+        block.vtx.push_back(MakeTx((height + i) % 3 == 0 ? mine : notMine, height + i + 1));
+    }
+    return block;
+}
+
+void TestRescan(int threads, int startHeight, int endHeight)
+{
+    CKey myKey, otherKey;
+    myKey.MakeNewKey(true);
+    otherKey.MakeNewKey(true);
+
+    CBasicKeyStore keystore;
+    keystore.AddKey(myKey);
+    const std::unique_ptr<KeyStoreSnapshot> snapshot = MakeSnapshot(keystore);
+
+    const CScript mine    = KeyToP2PKH(myKey);
+    const CScript notMine = KeyToP2PKH(otherKey);
+
+    // every 7th block is skipped
+    const WalletRescanner::ReadBlockFunc readBlock = [&](int height) -> boost::optional<CBlock> {
+        if (height % 7 == 0) {
+            return boost::none;
+        }
+        return MakeBlock(height, mine, notMine);
+    };
+
+    int                                     expectedHeight = startHeight;
+    const WalletRescanner::CommitBlockFunc commitBlock =
+        [&](const WalletRescanner::ScannedBlock& scanned) {
+            ASSERT_EQ(scanned.height, expectedHeight);
+            expectedHeight++;
+            if (scanned.height % 7 == 0) {
+                EXPECT_FALSE(scanned.block);
+                return;
+            }
+            ASSERT_TRUE(scanned.block);
+            ASSERT_EQ(scanned.txsWithMyOutputs.size(), 3u);
+            for (int i = 0; i < 3; i++) {
+                EXPECT_EQ(static_cast<bool>(scanned.txsWithMyOutputs[i]), (scanned.height + i) % 3 == 0)
+                    << "At height " << scanned.height << " for tx " << i;
+                EXPECT_EQ(scanned.block->vtx[i].vout[0].nValue, scanned.height + i + 1);
+            }
+        };
+
+    const WalletRescanner rescanner(*snapshot, threads);
+    const int             workers = rescanner.run(startHeight, endHeight, readBlock, commitBlock);
+    EXPECT_EQ(expectedHeight, std::max(startHeight, endHeight + 1));
+    EXPECT_LE(workers, threads);
+}
+
+} // namespace
+
+TEST(walletrescan_tests, snapshot_matches_keystore)
+{
+    CKey key1, key2, key3, notMine;
+    key1.MakeNewKey(true);
+    key2.MakeNewKey(false);
+    key3.MakeNewKey(true);
+    notMine.MakeNewKey(true);
+
+    CBasicKeyStore keystore;
+    keystore.AddKey(key1);
+    keystore.AddKey(key2);
+
+    CScript redeemScript;
+    redeemScript.SetMultisig(1, {key1, key2});
+    keystore.AddCScript(redeemScript);
+
+    CScript unknownRedeemScript;
+    unknownRedeemScript.SetMultisig(1, {key3, notMine});
+
+    CScript p2sh;
+    p2sh.SetDestination(redeemScript.GetID());
+    CScript unknownP2sh;
+    unknownP2sh.SetDestination(unknownRedeemScript.GetID());
+
+    const std::unique_ptr<KeyStoreSnapshot> snapshot =
+        MakeSnapshot(keystore, {redeemScript, unknownRedeemScript});
+
+    const std::vector<CScript> scripts = {KeyToP2PKH(key1), KeyToP2PK(key1),    KeyToP2PKH(key2),
+                                          KeyToP2PK(key2),  KeyToP2PKH(key3),   KeyToP2PK(notMine),
+                                          redeemScript,     unknownRedeemScript, p2sh,
+                                          unknownP2sh,      CScript()};
+    for (unsigned i = 0; i < scripts.size(); i++) {
+        EXPECT_EQ(IsMine(*snapshot, scripts[i]), IsMine(keystore, scripts[i])) << "For script " << i;
+    }
+    EXPECT_NE(IsMine(*snapshot, KeyToP2PKH(key1)), isminetype::ISMINE_NO);
+    EXPECT_NE(IsMine(*snapshot, p2sh), isminetype::ISMINE_NO);
+    EXPECT_EQ(IsMine(*snapshot, KeyToP2PKH(key3)), isminetype::ISMINE_NO);
+
+    // the snapshot has no secrets and doesn't change
+    CKey keyOut;
+    EXPECT_FALSE(snapshot->GetKey(key1.GetPubKey().GetID(), keyOut));
+    EXPECT_FALSE(snapshot->AddKey(key3));
+    EXPECT_FALSE(snapshot->HaveKey(key3.GetPubKey().GetID()));
+}
+
+TEST(walletrescan_tests, commits_in_order_on_the_calling_thread) { TestRescan(0, 1, 1050); }
+
+TEST(walletrescan_tests, commits_in_order_with_one_thread) { TestRescan(1, 1, 1050); }
+
+TEST(walletrescan_tests, commits_in_order_with_many_threads)
+{
+    TestRescan(4, 1, 1050);
+    TestRescan(4, 500, 523);
+    TestRescan(4, 10, 10);
+    TestRescan(4, 10, 9);
+}
+
+TEST(walletrescan_tests, failed_blocks_are_skipped)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    CBasicKeyStore keystore;
+    keystore.AddKey(key);
+    const std::unique_ptr<KeyStoreSnapshot> snapshot = MakeSnapshot(keystore);
+
+    const WalletRescanner::ReadBlockFunc readBlock = [&](int height) -> boost::optional<CBlock> {
+        if (height == 150) {
+            throw std::runtime_error("failed to read");
+        }
+        return MakeBlock(height, KeyToP2PKH(key), CScript());
+    };
+
+    std::atomic_int                         committed{0};
+    const WalletRescanner::CommitBlockFunc commitBlock =
+        [&](const WalletRescanner::ScannedBlock& scanned) {
+            EXPECT_EQ(static_cast<bool>(scanned.block), scanned.height != 150);
+            committed++;
+        };
+
+    const WalletRescanner rescanner(*snapshot, 3);
+    rescanner.run(1, 300, readBlock, commitBlock);
+    EXPECT_EQ(committed, 300);
+}
+
+TEST(walletrescan_tests, commit_exception_stops_the_scan)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    CBasicKeyStore keystore;
+    keystore.AddKey(key);
+    const std::unique_ptr<KeyStoreSnapshot> snapshot = MakeSnapshot(keystore);
+
+    const WalletRescanner::ReadBlockFunc readBlock = [&](int height) -> boost::optional<CBlock> {
+        return MakeBlock(height, KeyToP2PKH(key), CScript());
+    };
+    const WalletRescanner::CommitBlockFunc commitBlock =
+        [&](const WalletRescanner::ScannedBlock& scanned) {
+            if (scanned.height == 250) {
+                throw std::runtime_error("failed to commit");
+            }
+        };
+
+    const WalletRescanner rescanner(*snapshot, 4);
+    EXPECT_THROW(rescanner.run(1, 5000, readBlock, commitBlock), std::runtime_error);
+}
@@ -0,0 +1,200 @@
+#include "googletest/googletest/include/gtest/gtest.h"
+
+#include "hash.h"
+#include "keystore.h"
+#include "script.h"
+#include "walletscriptfilter.h"
+
+namespace {
+
+CScript KeyToP2PKH(const CKey& key)
+{
+    CScript result;
+    result.SetDestination(key.GetPubKey().GetID());
+    return result;
+}
+
+CScript KeyToP2PK(const CKey& key) { return CScript() << key.GetPubKey() << OP_CHECKSIG; }
+
+CScript ScriptToP2SH(const CScript& redeemScript)
+{
+    CScript result;
+    result.SetDestination(redeemScript.GetID());
+    return result;
+}
+
+CKeyID RandomKeyId()
+{
+    const uint256 hash = GetRandHash();
+    return CKeyID(Hash160(std::vector<unsigned char>(hash.begin(), hash.end())));
+}
+
+CKey MakeKey(bool compressed)
+{
+    CKey key;
+    key.MakeNewKey(compressed);
+    return key;
+}
+
+} // namespace
+
+TEST(walletscriptfilter_tests, match_template)
+{
+    const CKey key = MakeKey(true);
+
+    std::vector<uint160> ids;
+    EXPECT_EQ(WalletScriptFilter::MatchTemplate(KeyToP2PKH(key), ids),
+              WalletScriptFilter::ScriptType::PubKeyHash);
+    ASSERT_EQ(ids.size(), 1u);
+    EXPECT_EQ(ids[0], key.GetPubKey().GetID());
+
+    EXPECT_EQ(WalletScriptFilter::MatchTemplate(KeyToP2PK(key), ids),
+              WalletScriptFilter::ScriptType::PubKey);
+    ASSERT_EQ(ids.size(), 1u);
+    EXPECT_EQ(ids[0], key.GetPubKey().GetID());
+
+    const CKey uncompressedKey = MakeKey(false);
+    EXPECT_EQ(WalletScriptFilter::MatchTemplate(KeyToP2PK(uncompressedKey), ids),
+              WalletScriptFilter::ScriptType::PubKey);
+    ASSERT_EQ(ids.size(), 1u);
+    EXPECT_EQ(ids[0], uncompressedKey.GetPubKey().GetID());
+
+    const CScript redeemScript = KeyToP2PKH(key);
+    EXPECT_EQ(WalletScriptFilter::MatchTemplate(ScriptToP2SH(redeemScript), ids),
+              WalletScriptFilter::ScriptType::ScriptHash);
+    ASSERT_EQ(ids.size(), 1u);
+    EXPECT_EQ(ids[0], redeemScript.GetID());
+
+    const CKey    stakerKey = MakeKey(true);
+    const CScript p2cs =
+        GetScriptForStakeDelegation(stakerKey.GetPubKey().GetID(), key.GetPubKey().GetID());
+    EXPECT_EQ(WalletScriptFilter::MatchTemplate(p2cs, ids), WalletScriptFilter::ScriptType::ColdStake);
+    ASSERT_EQ(ids.size(), 2u);
+    EXPECT_EQ(ids[0], stakerKey.GetPubKey().GetID());
+    EXPECT_EQ(ids[1], key.GetPubKey().GetID());
+
+    EXPECT_EQ(WalletScriptFilter::MatchTemplate(CScript() << OP_RETURN << ParseHex("4e5401"), ids),
+              WalletScriptFilter::ScriptType::NullData);
+    EXPECT_TRUE(ids.empty());
+
+    CScript multisig;
+    multisig.SetMultisig(1, {key, stakerKey});
+    EXPECT_EQ(WalletScriptFilter::MatchTemplate(multisig, ids), WalletScriptFilter::ScriptType::Unknown);
+    EXPECT_TRUE(ids.empty());
+    EXPECT_EQ(WalletScriptFilter::MatchTemplate(CScript(), ids),
+              WalletScriptFilter::ScriptType::Unknown);
+    EXPECT_EQ(WalletScriptFilter::MatchTemplate(CScript() << OP_1 << OP_DROP, ids),
+              WalletScriptFilter::ScriptType::Unknown);
+
+    // a broken P2PKH, with the wrong last opcode
+    CScript brokenP2PKH = KeyToP2PKH(key);
+    brokenP2PKH.back()  = OP_CHECKSIGVERIFY;
+    EXPECT_EQ(WalletScriptFilter::MatchTemplate(brokenP2PKH, ids),
+              WalletScriptFilter::ScriptType::Unknown);
+}
+
+TEST(walletscriptfilter_tests, same_as_ismine)
+{
+    const CKey mine1 = MakeKey(true), mine2 = MakeKey(false), mine3 = MakeKey(true);
+    const CKey other1 = MakeKey(true), other2 = MakeKey(false);
+
+    CBasicKeyStore     keystore;
+    WalletScriptFilter filter;
+    for (const CKey& key : {mine1, mine2, mine3}) {
+        keystore.AddKey(key);
+        filter.addKey(key.GetPubKey().GetID());
+    }
+
+    CScript myMultisig;
+    myMultisig.SetMultisig(1, {mine1, mine2});
+    CScript mixedMultisig;
+    mixedMultisig.SetMultisig(1, {mine1, other1});
+    CScript otherMultisig;
+    otherMultisig.SetMultisig(1, {other1, other2});
+
+    const CScript myRedeemScript = KeyToP2PKH(mine3);
+    for (const CScript& redeemScript : {myRedeemScript, myMultisig}) {
+        keystore.AddCScript(redeemScript);
+        filter.addScript(redeemScript.GetID());
+    }
+    EXPECT_EQ(filter.size(), 5u);
+
+    const std::vector<CScript> scripts = {
+        KeyToP2PKH(mine1),
+        KeyToP2PKH(mine2),
+        KeyToP2PKH(other1),
+        KeyToP2PK(mine1),
+        KeyToP2PK(mine2),
+        KeyToP2PK(other1),
+        KeyToP2PK(other2),
+        ScriptToP2SH(myRedeemScript),
+        ScriptToP2SH(myMultisig),
+        ScriptToP2SH(otherMultisig),
+        ScriptToP2SH(KeyToP2PKH(other1)),
+        GetScriptForStakeDelegation(mine1.GetPubKey().GetID(), mine2.GetPubKey().GetID()),
+        GetScriptForStakeDelegation(mine1.GetPubKey().GetID(), other1.GetPubKey().GetID()),
+        GetScriptForStakeDelegation(other1.GetPubKey().GetID(), mine1.GetPubKey().GetID()),
+        GetScriptForStakeDelegation(other1.GetPubKey().GetID(), other2.GetPubKey().GetID()),
+        myMultisig,
+        mixedMultisig,
+        otherMultisig,
+        CScript() << OP_RETURN << ParseHex("4e5401"),
+        CScript() << OP_RETURN,
+        CScript(),
+        CScript() << OP_1,
+    };
+
+    for (unsigned i = 0; i < scripts.size(); i++) {
+        const isminetype expected = IsMine(keystore, scripts[i]);
+        if (!filter.mayBeMine(scripts[i])) {
+            EXPECT_EQ(expected, isminetype::ISMINE_NO) << "For script " << i;
+        }
+    }
+
+    // the standard scripts of others are always rejected, and the ones that are mine never are
+    EXPECT_FALSE(filter.mayBeMine(KeyToP2PKH(other1)));
+    EXPECT_FALSE(filter.mayBeMine(KeyToP2PK(other2)));
+    EXPECT_FALSE(filter.mayBeMine(ScriptToP2SH(otherMultisig)));
+    EXPECT_FALSE(filter.mayBeMine(
+        GetScriptForStakeDelegation(other1.GetPubKey().GetID(), other2.GetPubKey().GetID())));
+    EXPECT_FALSE(filter.mayBeMine(CScript() << OP_RETURN << ParseHex("4e5401")));
+    EXPECT_TRUE(filter.mayBeMine(KeyToP2PKH(mine1)));
+    EXPECT_TRUE(filter.mayBeMine(KeyToP2PK(mine2)));
+    EXPECT_TRUE(filter.mayBeMine(ScriptToP2SH(myMultisig)));
+    EXPECT_TRUE(filter.mayBeMine(
+        GetScriptForStakeDelegation(other1.GetPubKey().GetID(), mine1.GetPubKey().GetID())));
+
+    filter.clear();
+    EXPECT_EQ(filter.size(), 0u);
+    EXPECT_FALSE(filter.mayBeMine(KeyToP2PKH(mine1)));
+}
+
+// compares rejecting the outputs of a large wallet with IsMine() and with the filter; run it with
+// --gtest_also_run_disabled_tests
+TEST(walletscriptfilter_tests, DISABLED_filter_benchmark)
+{
+    static const int KeysCount    = 100000;
+    static const int OutputsCount = 20000;
+
+    // the filter of a large wallet; the key store doesn't need the keys to reject outputs
+    CBasicKeyStore     keystore;
+    WalletScriptFilter filter;
+    for (int i = 0; i < KeysCount; i++) {
+        filter.addKey(RandomKeyId());
+    }
+
+    std::vector<CScript> outputs;
+    for (int i = 0; i < OutputsCount; i++) {
+        CScript script;
+        script.SetDestination(RandomKeyId());
+        outputs.push_back(script);
+    }
+
+    for (const CScript& script : outputs) {
+        EXPECT_EQ(IsMine(keystore, script), isminetype::ISMINE_NO);
+    }
+
+    for (const CScript& script : outputs) {
+        EXPECT_FALSE(filter.mayBeMine(script));
+    }
+}
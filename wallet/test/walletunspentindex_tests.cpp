@@ -0,0 +1,347 @@
+#include "googletest/googletest/include/gtest/gtest.h"
+
+#include "init.h"
+#include "mocks/mtxdb.h"
+#include "txmempool.h"
+#include "util.h"
+#include "wallet.h"
+#include "walletunspentindex.h"
+
+#include <boost/filesystem.hpp>
+#include <map>
+
+using ::testing::Invoke;
+
+namespace {
+
+uint256 MakeHash(const int i) { return uint256(static_cast<uint64_t>(i) + 1); }
+
+// the block index entries of a chain with branches, where the blocks of branch b have the hashes
+// MakeHash(b * 1000 + height)
+struct TestChain
+{
+    std::map<int32_t, uint256>     mainChain;
+    std::map<uint256, CBlockIndex> blocks;
+
+    // the blocks of the branch from the given height up to the tip height become the main chain
+    void setMainChain(int fromHeight, int tipHeight, int branch)
+    {
+        for (auto it = mainChain.lower_bound(fromHeight); it != mainChain.end();) {
+            blocks[it->second].hashNext = 0;
+            it                          = mainChain.erase(it);
+        }
+        for (int h = fromHeight; h <= tipHeight; h++) {
+            CBlockIndex bi;
+            bi.blockHash = MakeHash(branch * 1000 + h);
+            bi.nHeight   = h;
+            if (h > 0) {
+                bi.hashPrev                            = mainChain.at(h - 1);
+                blocks.at(mainChain.at(h - 1)).hashNext = bi.blockHash;
+            }
+            blocks[bi.blockHash] = bi;
+            mainChain[h]         = bi.blockHash;
+        }
+    }
+
+    uint256 tip() const { return mainChain.rbegin()->second; }
+    int     tipHeight() const { return mainChain.rbegin()->first; }
+};
+
+CTransaction MakeTx(const COutPoint& input, const std::vector<std::pair<CScript, CAmount>>& outputs)
+{
+    CTransaction tx;
+    tx.vin.push_back(CTxIn(input));
+    for (const auto& output : outputs) {
+        tx.vout.push_back(CTxOut(output.second, output.first));
+    }
+    return tx;
+}
+
+void AddTx(CWallet& wallet, const ITxDB& txdb, const CTransaction& tx, const uint256& blockHash)
+{
+    CWalletTx wtx(&wallet, tx);
+    if (blockHash != 0) {
+        wtx.hashBlock = blockHash;
+        wtx.nIndex    = 1;
+    }
+    LOCK(wallet.cs_wallet);
+    EXPECT_TRUE(wallet.AddToWallet(txdb, wtx, false, nullptr, false));
+}
+
+// the balances are the same as the ones computed over all the transactions of the wallet
+void ExpectBalancesOfFullScan(const CWallet& wallet, const ITxDB& txdb)
+{
+    const uint256 bestBlockHash = txdb.GetBestBlockHash();
+
+    CAmount balance     = 0;
+    CAmount unconfirmed = 0;
+    {
+        LOCK2(cs_main, wallet.cs_wallet);
+        for (const auto& p : wallet.mapWallet) {
+            const CWalletTx& wtx = p.second;
+            if (wtx.IsTrusted(txdb, bestBlockHash)) {
+                balance += wtx.GetAvailableCredit(bestBlockHash, txdb);
+            } else if (wtx.GetDepthInMainChain(txdb, bestBlockHash) == 0 && wtx.InMempool()) {
+                unconfirmed += wtx.GetAvailableCredit(bestBlockHash, txdb);
+            }
+        }
+    }
+    EXPECT_EQ(wallet.GetBalance(txdb), balance);
+    EXPECT_EQ(wallet.GetUnconfirmedBalance(txdb), unconfirmed);
+}
+
+} // namespace
+
+TEST(walletunspentindex_tests, tx_states)
+{
+    WalletUnspentIndex index;
+    EXPECT_FALSE(index.isValid());
+    index.setValid();
+    EXPECT_TRUE(index.isValid());
+
+    index.update(MakeHash(1), WalletUnspentIndex::TxState::Unspent);
+    index.update(MakeHash(2), WalletUnspentIndex::TxState::PendingSpent);
+    index.update(MakeHash(3), WalletUnspentIndex::TxState::Spent);
+    EXPECT_EQ(index.getTxs(), std::set<uint256>({MakeHash(1), MakeHash(2)}));
+    EXPECT_EQ(index.getPendingTxs(), std::set<uint256>({MakeHash(2)}));
+
+    // the spender of the pending tx got confirmed
+    index.update(MakeHash(2), WalletUnspentIndex::TxState::Spent);
+    EXPECT_EQ(index.getTxs(), std::set<uint256>({MakeHash(1)}));
+    EXPECT_TRUE(index.getPendingTxs().empty());
+
+    // the spender was abandoned
+    index.update(MakeHash(1), WalletUnspentIndex::TxState::PendingSpent);
+    index.update(MakeHash(1), WalletUnspentIndex::TxState::Unspent);
+    EXPECT_EQ(index.getTxs(), std::set<uint256>({MakeHash(1)}));
+    EXPECT_TRUE(index.getPendingTxs().empty());
+
+    index.invalidate();
+    EXPECT_FALSE(index.isValid());
+    EXPECT_TRUE(index.getTxs().empty());
+}
+
+TEST(walletunspentindex_tests, reorgs_invalidate)
+{
+    std::map<int32_t, uint256> mainChain;
+    for (int h = 0; h <= 100; h++) {
+        mainChain[h] = MakeHash(h);
+    }
+
+    std::unique_ptr<mTxDB> dbMock = MakeUnique<mTxDB>();
+    EXPECT_CALL(*dbMock, ReadBlockHashOfHeight(testing::_))
+        .WillRepeatedly(Invoke([&mainChain](int32_t height) -> boost::optional<uint256> {
+            const auto it = mainChain.find(height);
+            if (it == mainChain.cend()) {
+                return boost::none;
+            }
+            return it->second;
+        }));
+
+    WalletUnspentIndex index;
+    index.setValid();
+    index.update(MakeHash(1000), WalletUnspentIndex::TxState::Unspent);
+
+    EXPECT_EQ(index.setTip(*dbMock, MakeHash(100), 100), WalletUnspentIndex::TipChange::None);
+    EXPECT_EQ(index.setTip(*dbMock, MakeHash(100), 100), WalletUnspentIndex::TipChange::None);
+
+    mainChain[101] = MakeHash(101);
+    EXPECT_EQ(index.setTip(*dbMock, MakeHash(101), 101), WalletUnspentIndex::TipChange::Extended);
+    EXPECT_TRUE(index.isValid());
+    EXPECT_EQ(index.getTxs().size(), 1u);
+
+    // block 101 is replaced
+    mainChain[101] = MakeHash(1101);
+    mainChain[102] = MakeHash(1102);
+    EXPECT_EQ(index.setTip(*dbMock, MakeHash(1102), 102), WalletUnspentIndex::TipChange::Reorganized);
+    EXPECT_FALSE(index.isValid());
+    EXPECT_TRUE(index.getTxs().empty());
+
+    // a disconnected tip with nothing after it is a reorg too
+    index.setValid();
+    mainChain.erase(102);
+    EXPECT_EQ(index.setTip(*dbMock, MakeHash(1101), 101), WalletUnspentIndex::TipChange::Reorganized);
+    EXPECT_FALSE(index.isValid());
+}
+
+TEST(walletunspentindex_tests, balance_totals)
+{
+    WalletUnspentIndex index;
+    index.setValid();
+
+    WalletUnspentIndex::Balances b1;
+    b1.balance     = 100;
+    b1.coldStaking = 3;
+    b1.delegated   = 4;
+    WalletUnspentIndex::Balances b2;
+    b2.unconfirmed = 20;
+
+    index.update(MakeHash(1), WalletUnspentIndex::TxState::Unspent);
+    index.setTxBalances(MakeHash(1), b1, false);
+    index.update(MakeHash(2), WalletUnspentIndex::TxState::Unspent);
+    index.setTxBalances(MakeHash(2), b2, true);
+    EXPECT_EQ(index.getTotals().balance, 100);
+    EXPECT_EQ(index.getTotals().unconfirmed, 20);
+    EXPECT_EQ(index.getTotals().coldStaking, 3);
+    EXPECT_EQ(index.getTotals().delegated, 4);
+
+    // the unconfirmed tx got confirmed
+    WalletUnspentIndex::Balances b2Confirmed;
+    b2Confirmed.balance = 20;
+    index.setTxBalances(MakeHash(2), b2Confirmed, false);
+    EXPECT_EQ(index.getTotals().balance, 120);
+    EXPECT_EQ(index.getTotals().unconfirmed, 0);
+
+    // spent
+    index.update(MakeHash(1), WalletUnspentIndex::TxState::Spent);
+    EXPECT_EQ(index.getTotals().balance, 20);
+    EXPECT_EQ(index.getTotals().coldStaking, 0);
+    EXPECT_EQ(index.getTotals().delegated, 0);
+
+    index.invalidate();
+    EXPECT_EQ(index.getTotals().balance, 0);
+}
+
+TEST(walletunspentindex_tests, volatile_txs)
+{
+    WalletUnspentIndex index;
+    index.setValid();
+
+    WalletUnspentIndex::Balances b;
+    b.unconfirmed = 20;
+    index.update(MakeHash(1), WalletUnspentIndex::TxState::Unspent);
+    index.setTxBalances(MakeHash(1), b, true);
+    index.update(MakeHash(2), WalletUnspentIndex::TxState::Unspent);
+    index.setTxBalances(MakeHash(2), b, false);
+
+    // computed again for a new best block or a mempool change only
+    boost::optional<std::set<uint256>> staleTxs = index.getStaleVolatileTxs(MakeHash(100), 5);
+    ASSERT_TRUE(staleTxs);
+    EXPECT_EQ(*staleTxs, std::set<uint256>({MakeHash(1)}));
+    index.setVolatileTxsUpdated(MakeHash(100), 5);
+    EXPECT_FALSE(index.getStaleVolatileTxs(MakeHash(100), 5));
+    EXPECT_TRUE(index.getStaleVolatileTxs(MakeHash(101), 5));
+    EXPECT_TRUE(index.getStaleVolatileTxs(MakeHash(100), 6));
+
+    // confirmed and mature
+    index.setTxBalances(MakeHash(1), b, false);
+    staleTxs = index.getStaleVolatileTxs(MakeHash(101), 5);
+    ASSERT_TRUE(staleTxs);
+    EXPECT_TRUE(staleTxs->empty());
+
+    index.setTxBalances(MakeHash(2), b, true);
+    index.update(MakeHash(2), WalletUnspentIndex::TxState::Spent);
+    staleTxs = index.getStaleVolatileTxs(MakeHash(101), 5);
+    ASSERT_TRUE(staleTxs);
+    EXPECT_TRUE(staleTxs->empty());
+
+    // everything is computed again after an invalidation
+    index.setVolatileTxsUpdated(MakeHash(101), 5);
+    index.invalidate();
+    EXPECT_TRUE(index.getStaleVolatileTxs(MakeHash(101), 5));
+}
+
+TEST(walletunspentindex_tests, wallet_balances_follow_reorgs_and_mempool)
+{
+    const std::string walletPath = std::string(TEST_ROOT_PATH) + "/data/walletunspentindex1.dat";
+    if (boost::filesystem::exists(walletPath)) {
+        EXPECT_TRUE(boost::filesystem::remove(walletPath));
+    }
+    // not deleted, like in accounting_tests
+    bool     fFirstRun = true;
+    CWallet* pwallet   = new CWallet(walletPath);
+    EXPECT_EQ(pwallet->LoadWallet(fFirstRun), DB_LOAD_OK);
+    CWallet& wallet = *pwallet;
+
+    CKey key;
+    key.MakeNewKey(true);
+    {
+        LOCK(wallet.cs_wallet);
+        EXPECT_TRUE(wallet.AddKey(key));
+    }
+    const CScript mine = GetScriptForDestination(key.GetPubKey().GetID());
+    CKey          otherKey;
+    otherKey.MakeNewKey(true);
+    const CScript other = GetScriptForDestination(otherKey.GetPubKey().GetID());
+
+    TestChain chain;
+    chain.setMainChain(0, 12, 0);
+
+    std::unique_ptr<mTxDB> dbMock = MakeUnique<mTxDB>();
+    EXPECT_CALL(*dbMock, GetBestBlockHash()).WillRepeatedly(Invoke([&chain]() { return chain.tip(); }));
+    EXPECT_CALL(*dbMock, GetBestChainHeight()).WillRepeatedly(Invoke([&chain]() {
+        return boost::make_optional<int>(chain.tipHeight());
+    }));
+    EXPECT_CALL(*dbMock, ReadBlockIndex(testing::_))
+        .WillRepeatedly(Invoke([&chain](const uint256& hash) -> boost::optional<CBlockIndex> {
+            const auto it = chain.blocks.find(hash);
+            if (it == chain.blocks.cend()) {
+                return boost::none;
+            }
+            return it->second;
+        }));
+    EXPECT_CALL(*dbMock, ReadBlockHashOfHeight(testing::_))
+        .WillRepeatedly(Invoke([&chain](int32_t height) -> boost::optional<uint256> {
+            const auto it = chain.mainChain.find(height);
+            if (it == chain.mainChain.cend()) {
+                return boost::none;
+            }
+            return it->second;
+        }));
+
+    mempool.clear();
+
+    const CTransaction txA = MakeTx(COutPoint(MakeHash(5000), 0), {{mine, 10 * COIN}});
+    const CTransaction txB = MakeTx(COutPoint(MakeHash(5001), 0), {{mine, 7 * COIN}});
+    // an immature coinstake
+    const CTransaction txE = MakeTx(COutPoint(MakeHash(5002), 0), {{CScript(), 0}, {mine, 20 * COIN}});
+    ASSERT_TRUE(txE.IsCoinStake());
+    AddTx(wallet, *dbMock, txA, chain.mainChain.at(5));
+    AddTx(wallet, *dbMock, txB, chain.mainChain.at(10));
+    AddTx(wallet, *dbMock, txE, chain.mainChain.at(12));
+
+    ExpectBalancesOfFullScan(wallet, *dbMock);
+    EXPECT_EQ(wallet.GetBalance(*dbMock), 17 * COIN);
+    EXPECT_EQ(wallet.GetUnconfirmedBalance(*dbMock), 0);
+    EXPECT_EQ(wallet.GetStake(*dbMock), 20 * COIN);
+
+    // a payment from someone else enters the mempool, then leaves it
+    const CTransaction txD = MakeTx(COutPoint(MakeHash(5003), 0), {{mine, 3 * COIN}});
+    AddTx(wallet, *dbMock, txD, 0);
+    ExpectBalancesOfFullScan(wallet, *dbMock);
+    EXPECT_EQ(wallet.GetUnconfirmedBalance(*dbMock), 0);
+    {
+        LOCK(mempool.cs);
+        mempool.addUnchecked(txD.GetHash(), txD);
+    }
+    ExpectBalancesOfFullScan(wallet, *dbMock);
+    EXPECT_EQ(wallet.GetUnconfirmedBalance(*dbMock), 3 * COIN);
+    mempool.remove(txD);
+    ExpectBalancesOfFullScan(wallet, *dbMock);
+    EXPECT_EQ(wallet.GetUnconfirmedBalance(*dbMock), 0);
+
+    // A is spent by a transaction of ours in the mempool, with change
+    const CTransaction txC = MakeTx(COutPoint(txA.GetHash(), 0), {{other, 4 * COIN}, {mine, 5 * COIN}});
+    {
+        LOCK(mempool.cs);
+        mempool.addUnchecked(txC.GetHash(), txC);
+    }
+    AddTx(wallet, *dbMock, txC, 0);
+    ExpectBalancesOfFullScan(wallet, *dbMock);
+    EXPECT_EQ(wallet.GetBalance(*dbMock), 12 * COIN);
+
+    // the blocks of B and E are replaced
+    chain.setMainChain(9, 13, 1);
+    ExpectBalancesOfFullScan(wallet, *dbMock);
+    EXPECT_EQ(wallet.GetBalance(*dbMock), 5 * COIN);
+    EXPECT_EQ(wallet.GetUnconfirmedBalance(*dbMock), 0);
+    EXPECT_EQ(wallet.GetStake(*dbMock), 0);
+
+    // C is confirmed in a new block
+    chain.setMainChain(14, 14, 1);
+    mempool.remove(txC);
+    AddTx(wallet, *dbMock, txC, chain.tip());
+    ExpectBalancesOfFullScan(wallet, *dbMock);
+    EXPECT_EQ(wallet.GetBalance(*dbMock), 5 * COIN);
+    EXPECT_EQ(wallet.GetUnconfirmedBalance(*dbMock), 0);
+}
@@ -0,0 +1,134 @@
+#ifndef TRACKEDVECTOR_H
+#define TRACKEDVECTOR_H
+
+#include "serialize.h"
+#include <utility>
+#include <vector>
+
+/**
+ * STL-like vector that remembers whether it may have been modified since the last call to
+ * ResetModified(). Every non-const access marks it as modified, including the non-const iterators and
+ * element references, since they can be written through later. CTransaction uses it for its inputs and
+ * outputs to know whether the hash it cached is still valid.
+ */
+template <typename T>
+class TrackedVector
+{
+public:
+    typedef typename std::vector<T>::value_type             value_type;
+    typedef typename std::vector<T>::size_type              size_type;
+    typedef typename std::vector<T>::difference_type        difference_type;
+    typedef typename std::vector<T>::reference              reference;
+    typedef typename std::vector<T>::const_reference        const_reference;
+    typedef typename std::vector<T>::iterator               iterator;
+    typedef typename std::vector<T>::const_iterator         const_iterator;
+    typedef typename std::vector<T>::reverse_iterator       reverse_iterator;
+    typedef typename std::vector<T>::const_reverse_iterator const_reverse_iterator;
+
+private:
+    std::vector<T> v;
+    bool           fModified = true;
+
+public:
+    TrackedVector() = default;
+    TrackedVector(const std::vector<T>& other) : v(other) {}
+    TrackedVector(std::vector<T>&& other) : v(std::move(other)) {}
+
+    TrackedVector& operator=(const std::vector<T>& other)
+    {
+        fModified = true;
+        v         = other;
+        return *this;
+    }
+    TrackedVector& operator=(std::vector<T>&& other)
+    {
+        fModified = true;
+        v         = std::move(other);
+        return *this;
+    }
+
+    bool IsModified() const { return fModified; }
+    void ResetModified() { fModified = false; }
+
+    const std::vector<T>& get() const { return v; }
+    std::vector<T>&       getMutable()
+    {
+        fModified = true;
+        return v;
+    }
+    operator const std::vector<T>&() const { return v; }
+
+    size_type              size() const { return v.size(); }
+    bool                   empty() const { return v.empty(); }
+    size_type              capacity() const { return v.capacity(); }
+    const_reference        operator[](size_type i) const { return v[i]; }
+    const_reference        at(size_type i) const { return v.at(i); }
+    const_reference        front() const { return v.front(); }
+    const_reference        back() const { return v.back(); }
+    const_iterator         begin() const { return v.begin(); }
+    const_iterator         end() const { return v.end(); }
+    const_iterator         cbegin() const { return v.cbegin(); }
+    const_iterator         cend() const { return v.cend(); }
+    const_reverse_iterator rbegin() const { return v.rbegin(); }
+    const_reverse_iterator rend() const { return v.rend(); }
+
+    reference operator[](size_type i) { return getMutable()[i]; }
+    reference at(size_type i) { return getMutable().at(i); }
+    reference front() { return getMutable().front(); }
+    reference back() { return getMutable().back(); }
+    iterator  begin() { return getMutable().begin(); }
+    iterator  end() { return getMutable().end(); }
+
+    reverse_iterator rbegin() { return getMutable().rbegin(); }
+    reverse_iterator rend() { return getMutable().rend(); }
+
+    void push_back(const T& x) { getMutable().push_back(x); }
+    void push_back(T&& x) { getMutable().push_back(std::move(x)); }
+    template <typename... Args>
+    void emplace_back(Args&&... args)
+    {
+        getMutable().emplace_back(std::forward<Args>(args)...);
+    }
+    void pop_back() { getMutable().pop_back(); }
+    template <typename... Args>
+    iterator insert(Args&&... args)
+    {
+        return getMutable().insert(std::forward<Args>(args)...);
+    }
+    template <typename... Args>
+    iterator erase(Args&&... args)
+    {
+        return getMutable().erase(std::forward<Args>(args)...);
+    }
+    template <typename... Args>
+    void assign(Args&&... args)
+    {
+        getMutable().assign(std::forward<Args>(args)...);
+    }
+    void resize(size_type n) { getMutable().resize(n); }
+    void resize(size_type n, const T& x) { getMutable().resize(n, x); }
+    void reserve(size_type n) { v.reserve(n); }
+    void clear() { getMutable().clear(); }
+
+    friend bool operator==(const TrackedVector& a, const TrackedVector& b) { return a.v == b.v; }
+    friend bool operator!=(const TrackedVector& a, const TrackedVector& b) { return a.v != b.v; }
+    friend bool operator==(const TrackedVector& a, const std::vector<T>& b) { return a.v == b; }
+    friend bool operator!=(const TrackedVector& a, const std::vector<T>& b) { return a.v != b; }
+
+    unsigned int GetSerializeSize(int nType, int nVersion) const
+    {
+        return ::GetSerializeSize(v, nType, nVersion);
+    }
+    template <typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const
+    {
+        ::Serialize(s, v, nType, nVersion);
+    }
+    template <typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion)
+    {
+        ::Unserialize(s, getMutable(), nType, nVersion);
+    }
+};
+
+#endif // TRACKEDVECTOR_H
@@ -9,6 +9,7 @@
 #include "txindex.h"
 #include "txmempool.h"
 #include "util.h"
+#include <atomic>
 #include <boost/foreach.hpp>
 
 void CTransaction::SetNull()
@@ -19,9 +20,40 @@ void CTransaction::SetNull()
     vout.clear();
     nLockTime = 0;
     nDoS      = 0; // Denial-of-service prevention
+    hashCache = boost::none;
 }
 
-uint256 CTransaction::GetHash() const { return SerializeHash(*this); }
+namespace {
+std::atomic<uint64_t> txHashComputations{0};
+} // namespace
+
+uint256 CTransaction::GetHash() const
+{
+    if (IsHashCacheValid())
+        return hashCache->hash;
+    return ComputeHash();
+}
+
+uint64_t CTransaction::GetHashComputationsCount() { return txHashComputations.load(); }
+
+bool CTransaction::IsHashCacheValid() const
+{
+    return hashCache && !vin.IsModified() && !vout.IsModified() && hashCache->nVersion == nVersion &&
+           hashCache->nTime == nTime && hashCache->nLockTime == nLockTime;
+}
+
+uint256 CTransaction::ComputeHash() const
+{
+    txHashComputations++;
+    return SerializeHash(*this);
+}
+
+void CTransaction::UpdateHashCache()
+{
+    hashCache = HashCache{ComputeHash(), nVersion, nTime, nLockTime};
+    vin.ResetModified();
+    vout.ResetModified();
+}
 
 bool CTransaction::IsNewerThan(const CTransaction& old) const
 {
@@ -377,7 +409,8 @@ bool CTransaction::DisconnectInputs(CTxDB& txdb)
 }
 
 bool CTransaction::FetchInputs(const ITxDB& txdb, const std::map<uint256, CTxIndex>& mapTestPool,
-                               bool fBlock, bool fMiner, MapPrevTx& inputsRet, bool& fInvalid) const
+                               bool fBlock, bool fMiner, MapPrevTx& inputsRet, bool& fInvalid,
+                               const MapPrevTx* prefetchedInputs) const
 {
     // FetchInputs can return false either because we just haven't seen some inputs
     // (in which case the transaction should be stored as an orphan)
@@ -388,43 +421,86 @@ bool CTransaction::FetchInputs(const ITxDB& txdb, const std::map<uint256, CTxInd
     if (IsCoinBase())
         return true; // Coinbase transactions have no inputs to fetch.
 
+    // the prevouts that are neither in the test pool nor prefetched are read from the db in batches
+    // (one for the tx index entries, and one for the txs), instead of one db read per input
+    std::vector<uint256> prevHashes;
+    std::vector<uint256> prevHashesToRead;
     for (unsigned int i = 0; i < vin.size(); i++) {
-        COutPoint prevout = vin[i].prevout;
-        if (inputsRet.count(prevout.hash))
+        const uint256& prevHash = vin[i].prevout.hash;
+        if (inputsRet.count(prevHash))
             continue; // Got it already
 
-        // Read txindex
-        CTxIndex& txindex = inputsRet[prevout.hash].first;
-        bool      fFound  = true;
-        if ((fBlock || fMiner) && mapTestPool.count(prevout.hash)) {
+        const MapPrevTx::const_iterator prefetched =
+            prefetchedInputs ? prefetchedInputs->find(prevHash) : MapPrevTx::const_iterator();
+        const bool fPrefetched = prefetchedInputs && prefetched != prefetchedInputs->end();
+
+        std::pair<CTxIndex, CTransaction>& input = inputsRet[prevHash];
+        if ((fBlock || fMiner) && mapTestPool.count(prevHash)) {
             // Get txindex from current proposed changes
-            txindex = mapTestPool.find(prevout.hash)->second;
+            input.first = mapTestPool.find(prevHash)->second;
+        } else if (fPrefetched) {
+            input.first = prefetched->second.first;
         } else {
-            // Read txindex from txdb
-            fFound = txdb.ReadTxIndex(prevout.hash, txindex);
+            prevHashesToRead.push_back(prevHash);
         }
+        if (fPrefetched) {
+            input.second = prefetched->second.second;
+            continue;
+        }
+        prevHashes.push_back(prevHash);
+    }
+
+    // Read txindex from txdb
+    std::vector<boost::optional<CTxIndex>> readTxIndices;
+    if (!prevHashesToRead.empty() && !txdb.ReadTxIndexBatch(prevHashesToRead, readTxIndices))
+        return NLog.error("FetchInputs() : {} failed to read the tx index of the inputs",
+                          GetHash().ToString());
+    std::set<uint256> prevHashesNotFound;
+    for (unsigned int i = 0; i < prevHashesToRead.size(); i++) {
+        if (readTxIndices[i]) {
+            inputsRet[prevHashesToRead[i]].first = std::move(*readTxIndices[i]);
+        } else {
+            prevHashesNotFound.insert(prevHashesToRead[i]);
+        }
+    }
+
+    std::vector<uint256>    prevHashesOnDisk;
+    std::vector<CDiskTxPos> prevTxPositions;
+    for (const uint256& prevHash : prevHashes) {
+        CTxIndex&  txindex = inputsRet[prevHash].first;
+        const bool fFound  = prevHashesNotFound.count(prevHash) == 0;
         if (!fFound && (fBlock || fMiner))
             return fMiner ? false
                           : NLog.error("FetchInputs() : {} prev tx {} index entry not found",
-                                       GetHash().ToString(), prevout.hash.ToString());
+                                       GetHash().ToString(), prevHash.ToString());
 
         // Read txPrev
-        CTransaction& txPrev = inputsRet[prevout.hash].second;
+        CTransaction& txPrev = inputsRet[prevHash].second;
         if (!fFound || txindex.pos == CDiskTxPos(1, 1)) {
             // Get prev tx from single transactions in memory
-            if (!mempool.lookup(prevout.hash, txPrev))
+            if (!mempool.lookup(prevHash, txPrev))
                 return NLog.error("FetchInputs() : {} mempool Tx prev not found {}",
-                                  GetHash().ToString(), prevout.hash.ToString());
+                                  GetHash().ToString(), prevHash.ToString());
             if (!fFound)
                 txindex.vSpent.resize(txPrev.vout.size());
         } else {
-            // Get prev tx from disk
-            if (!txPrev.ReadFromDisk(txindex.pos, txdb))
-                return NLog.error("FetchInputs() : {} ReadFromDisk prev tx {} failed",
-                                  GetHash().ToString(), prevout.hash.ToString());
+            prevHashesOnDisk.push_back(prevHash);
+            prevTxPositions.push_back(txindex.pos);
         }
     }
 
+    // Get prev txs from disk
+    std::vector<boost::optional<CTransaction>> readTxs;
+    if (!prevTxPositions.empty() && !txdb.ReadTxBatch(prevTxPositions, readTxs))
+        return NLog.error("FetchInputs() : {} ReadTxBatch for the prev txs failed",
+                          GetHash().ToString());
+    for (unsigned int i = 0; i < prevHashesOnDisk.size(); i++) {
+        if (!readTxs[i])
+            return NLog.error("FetchInputs() : {} ReadFromDisk prev tx {} failed",
+                              GetHash().ToString(), prevHashesOnDisk[i].ToString());
+        inputsRet[prevHashesOnDisk[i]].second = std::move(*readTxs[i]);
+    }
+
     // Make sure all prevout.n indexes are valid:
     for (unsigned int i = 0; i < vin.size(); i++) {
         const COutPoint prevout = vin[i].prevout;
@@ -489,7 +565,7 @@ Result<void, TxValidationState>
 CTransaction::ConnectInputs(const ITxDB& txdb, MapPrevTx inputs,
                             std::map<uint256, CTxIndex>& mapTestPool, const CDiskTxPos& posThisTx,
                             const boost::optional<CBlockIndex>& pindexBlock, bool fBlock, bool fMiner,
-                            CBlock* sourceBlockPtr) const
+                            CBlock* sourceBlockPtr, std::vector<CScriptCheck>* pvChecks) const
 {
     // Take over previous transactions' spent pointers
     // fBlock is true when this is called from AcceptBlock when a new best-block is added to the
@@ -602,39 +678,46 @@ CTransaction::ConnectInputs(const ITxDB& txdb, MapPrevTx inputs,
             // still computed and checked, and any change will be caught at the next checkpoint.
             if (!(fBlock &&
                   (txdb.GetBestChainHeight().value_or(0) < Checkpoints::GetTotalBlocksEstimate()))) {
-                // Verify signature
-                bool       fStrictPayToScriptHash = true;
-                const auto verifyRes =
-                    VerifySignature(txPrev, *this, i, fStrictPayToScriptHash, false, 0);
-                if (verifyRes.isErr()) {
-                    // only during transition phase for P2SH: do not invoke anti-DoS code for
-                    // potentially old clients relaying bad P2SH transactions
-                    if (fStrictPayToScriptHash) {
-                        const auto verifyResP2SH = VerifySignature(txPrev, *this, i, false, false, 0);
-                        if (verifyResP2SH.isOk()) {
-                            return Err(MakeInvalidTxState(
-                                TxValidationResult::TX_NOT_STANDARD,
-                                fmt::format("non-mandatory-script-verify-flag ({})",
-                                            ScriptErrorString(verifyResP2SH.unwrapErr(RESULT_PRE))),
-                                fmt::format("ConnectInputs() : {} P2SH VerifySignature failed",
-                                            GetHash().ToString())));
+                bool fStrictPayToScriptHash = true;
+                if (pvChecks) {
+                    // the signature is verified later by the caller, in parallel with other inputs
+                    pvChecks->push_back(
+                        CScriptCheck(txPrev, *this, i, fStrictPayToScriptHash, false, 0));
+                } else {
+                    // Verify signature
+                    const auto verifyRes =
+                        VerifySignature(txPrev, *this, i, fStrictPayToScriptHash, false, 0);
+                    if (verifyRes.isErr()) {
+                        // only during transition phase for P2SH: do not invoke anti-DoS code for
+                        // potentially old clients relaying bad P2SH transactions
+                        if (fStrictPayToScriptHash) {
+                            const auto verifyResP2SH =
+                                VerifySignature(txPrev, *this, i, false, false, 0);
+                            if (verifyResP2SH.isOk()) {
+                                return Err(MakeInvalidTxState(
+                                    TxValidationResult::TX_NOT_STANDARD,
+                                    fmt::format("non-mandatory-script-verify-flag ({})",
+                                                ScriptErrorString(verifyResP2SH.unwrapErr(RESULT_PRE))),
+                                    fmt::format("ConnectInputs() : {} P2SH VerifySignature failed",
+                                                GetHash().ToString())));
+                            }
                         }
-                    }
 
-                    const std::string msg =
-                        fmt::format("mandatory-script-verify-flag-failed ({})",
-                                    ScriptErrorString(verifyRes.unwrapErr(RESULT_PRE)));
+                        const std::string msg =
+                            fmt::format("mandatory-script-verify-flag-failed ({})",
+                                        ScriptErrorString(verifyRes.unwrapErr(RESULT_PRE)));
 
-                    if (sourceBlockPtr) {
-                        sourceBlockPtr->reject =
-                            CBlockReject(REJECT_INVALID, msg, sourceBlockPtr->GetHash());
+                        if (sourceBlockPtr) {
+                            sourceBlockPtr->reject =
+                                CBlockReject(REJECT_INVALID, msg, sourceBlockPtr->GetHash());
+                        }
+                        this->reject = CTransaction::CTxReject(REJECT_INVALID, msg, GetHash());
+                        DoS(100, false);
+                        return Err(
+                            MakeInvalidTxState(TxValidationResult::TX_CONSENSUS, msg,
+                                               fmt::format("ConnectInputs() : {} VerifySignature failed",
+                                                           GetHash().ToString())));
                     }
-                    this->reject = CTransaction::CTxReject(REJECT_INVALID, msg, GetHash());
-                    DoS(100, false);
-                    return Err(
-                        MakeInvalidTxState(TxValidationResult::TX_CONSENSUS, msg,
-                                           fmt::format("ConnectInputs() : {} VerifySignature failed",
-                                                       GetHash().ToString())));
                 }
             }
 
@@ -6,6 +6,7 @@
 #include "inpoint.h"
 #include "outpoint.h"
 #include "serialize.h"
+#include "trackedvector.h"
 #include "txdb.h"
 #include "txin.h"
 #include "txindex.h"
@@ -15,6 +16,7 @@
 #include <vector>
 
 class CTransaction;
+class CScriptCheck;
 
 enum GetMinFee_mode
 {
@@ -31,12 +33,12 @@ using MapPrevTx = std::map<uint256, std::pair<CTxIndex, CTransaction>>;
 class CTransaction
 {
 public:
-    static const int    CURRENT_VERSION = 1;
-    int                 nVersion;
-    unsigned int        nTime;
-    std::vector<CTxIn>  vin;
-    std::vector<CTxOut> vout;
-    unsigned int        nLockTime;
+    static const int      CURRENT_VERSION = 1;
+    int                   nVersion;
+    unsigned int          nTime;
+    TrackedVector<CTxIn>  vin;
+    TrackedVector<CTxOut> vout;
+    unsigned int          nLockTime;
 
     struct CTxReject
     {
@@ -70,6 +72,8 @@ public:
                         READWRITE(vin);
                         READWRITE(vout);
                         READWRITE(nLockTime);
+                        CTransaction* pthis = const_cast<CTransaction*>(this);
+                        if (fRead) pthis->UpdateHashCache();
                         )
     // clang-format on
 
@@ -79,6 +83,9 @@ public:
 
     uint256 GetHash() const;
 
+    /// the number of times a transaction hash was actually computed (i.e., not found in the cache)
+    static uint64_t GetHashComputationsCount();
+
     bool IsNewerThan(const CTransaction& old) const;
 
     bool IsCoinBase() const { return (vin.size() == 1 && vin[0].prevout.IsNull() && vout.size() >= 1); }
@@ -156,10 +163,13 @@ public:
             @param[in] fMiner	True if being called by CreateNewBlock
             @param[out] inputsRet	Pointers to this transaction's inputs
             @param[out] fInvalid	returns true if transaction is invalid
+            @param[in] prefetchedInputs	Inputs already read from txdb (e.g., with
+                                        CBlock::ReadInputsFromDisk()), which aren't read again
             @return	Returns true if all inputs are in txdb or mapTestPool
                 */
     bool FetchInputs(const ITxDB& txdb, const std::map<uint256, CTxIndex>& mapTestPool, bool fBlock,
-                     bool fMiner, MapPrevTx& inputsRet, bool& fInvalid) const;
+                     bool fMiner, MapPrevTx& inputsRet, bool& fInvalid,
+                     const MapPrevTx* prefetchedInputs = nullptr) const;
 
     /** Sanity check previous transactions, then, if all checks succeed,
         mark them as spent by this transaction.
@@ -170,12 +180,14 @@ public:
         @param[in] pindexBlock
         @param[in] fBlock	true if called from ConnectBlock
         @param[in] fMiner	true if called from CreateNewBlock
+        @param[out] pvChecks	if not null, signature checks are appended to it instead of being done
         @return Returns true if all checks succeed
         */
     Result<void, TxValidationState>
     ConnectInputs(const ITxDB& txdb, MapPrevTx inputs, std::map<uint256, CTxIndex>& mapTestPool,
                   const CDiskTxPos& posThisTx, const boost::optional<CBlockIndex>& pindexBlock,
-                  bool fBlock, bool fMiner, CBlock* sourceBlockPtr = nullptr) const;
+                  bool fBlock, bool fMiner, CBlock* sourceBlockPtr = nullptr,
+                  std::vector<CScriptCheck>* pvChecks = nullptr) const;
     Result<void, TxValidationState> CheckTransaction(const ITxDB& txdb,
                                                      CBlock*      sourceBlock = nullptr) const;
     bool GetCoinAge(const ITxDB& txdb, uint64_t& nCoinAge) const; // ppcoin: get transaction coin age
@@ -194,6 +206,23 @@ public:
 
 protected:
     const CTxOut& GetOutputFor(const CTxIn& input, const MapPrevTx& inputs) const;
+
+private:
+    struct HashCache
+    {
+        uint256      hash;
+        int          nVersion;
+        unsigned int nTime;
+        unsigned int nLockTime;
+    };
+
+    // the hash of a deserialized transaction, computed once when it's read, with the members it was
+    // computed from that aren't tracked by vin and vout; it's ignored once any of them is modified
+    boost::optional<HashCache> hashCache;
+
+    bool    IsHashCacheValid() const;
+    uint256 ComputeHash() const;
+    void    UpdateHashCache();
 };
 
 #endif // TRANSACTION_H
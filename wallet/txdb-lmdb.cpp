@@ -18,6 +18,7 @@
 #include "globals.h"
 #include "kernel.h"
 #include "main.h"
+#include "ntp1/ntp1index.h"
 #include "stringmanip.h"
 #include "txdb.h"
 #include "util.h"
@@ -34,6 +35,13 @@ bool                    CTxDB::QuickSyncHigherControl_Enabled = true;
 // variable
 static const std::string STAKESEEN_VALUE = "f";
 
+// the key of the best block up to which the tx index in the db is complete; it exists only while the
+// tx index write cache has changes that are not written to the db
+static const std::string TXINDEX_BEST_CHAIN_KEY = "hashTxIndexBestChain";
+
+// the key of the block up to which the NTP1 index has the blocks of the main chain
+static const std::string NTP1INDEX_BEST_BLOCK_KEY = "hashNTP1IndexBestBlock";
+
 bool IsQuickSyncOSCompatible(const std::string& osValue)
 {
     if (osValue == "any") {
@@ -262,6 +270,9 @@ bool ShouldQuickSyncBeDone(const filesystem::path& dbdir)
 
 void CTxDB::resyncIfNecessary(bool forceClearDB)
 {
+    // the catalog and the best chain state are reloaded from the db in LoadBlockIndex()
+    blockIndexCatalog.clear();
+    bestChain.clear();
 
     nVersion = ReadVersion().value_or(0);
     NLog.write(b_sev::info, "Transaction index version is {}", nVersion);
@@ -339,11 +350,146 @@ CTxDB::CTxDB()
 
 void CTxDB::Close() { db->close(); }
 
-bool CTxDB::TxnBegin(size_t required_size) { return db->beginDBTransaction(required_size); }
+bool CTxDB::TxnBegin(size_t required_size)
+{
+    if (!db->beginDBTransaction(required_size)) {
+        return false;
+    }
+    inTransaction         = true;
+    txIndexCacheFlushed   = false;
+    pendingCatalogChanges = MakeUnique<BlockIndexCatalog::PendingChanges>();
+    pendingTxIndexChanges.reset();
+    pendingBestChain      = boost::none;
+    txIndexCacheBaseBlock = boost::none;
+    // once there's something in the cache, all the tx index changes have to go through it, otherwise
+    // they'd be shadowed by the cached entries
+    if (txIndexWriteCache.isCachingWrites() || !txIndexWriteCache.empty()) {
+        uint256 hashBestChain;
+        if (!txIndexWriteCache.empty() || ReadHashBestChain(hashBestChain)) {
+            pendingTxIndexChanges = MakeUnique<TxIndexWriteCache::PendingChanges>();
+            txIndexCacheBaseBlock = boost::make_optional(hashBestChain != 0, hashBestChain);
+        }
+    }
+    return true;
+}
+
+bool CTxDB::TxnCommit()
+{
+    const std::unique_ptr<BlockIndexCatalog::PendingChanges> changes = std::move(pendingCatalogChanges);
+    const std::unique_ptr<TxIndexWriteCache::PendingChanges> txIndexChanges =
+        std::move(pendingTxIndexChanges);
+    const boost::optional<BestChainState::SnapshotPtr> newBestChain = pendingBestChain;
+    const bool cacheFlushed = txIndexCacheFlushed;
+    pendingBestChain        = boost::none;
+    inTransaction           = false;
+    txIndexCacheFlushed     = false;
+
+    if (txIndexChanges && !txIndexChanges->empty() && txIndexWriteCache.empty()) {
+        // these are the first changes to be cached, so the tx index in the db stops being complete here
+        if (!txIndexCacheBaseBlock ||
+            !Write(TXINDEX_BEST_CHAIN_KEY, *txIndexCacheBaseBlock, IDB::Index::DB_MAIN_INDEX)) {
+            NLog.write(b_sev::err, "Failed to write the tx index best chain marker");
+            db->abortDBTransaction();
+            return false;
+        }
+    }
+    if (!db->commitDBTransaction()) {
+        return false;
+    }
+    // the catalog mirrors only what's committed to the db
+    if (changes && blockIndexCatalog.isLoaded()) {
+        changes->applyTo(blockIndexCatalog);
+    }
+    if (cacheFlushed) {
+        txIndexWriteCache.clear();
+    }
+    if (txIndexChanges) {
+        txIndexWriteCache.apply(*txIndexChanges);
+    }
+    if (newBestChain) {
+        bestChain.set(*newBestChain);
+    }
+    return true;
+}
+
+bool CTxDB::TxnAbort()
+{
+    pendingCatalogChanges.reset();
+    pendingTxIndexChanges.reset();
+    pendingBestChain    = boost::none;
+    inTransaction       = false;
+    txIndexCacheFlushed = false;
+    return db->abortDBTransaction();
+}
+
+bool CTxDB::FlushTxIndexWriteCache()
+{
+    if (!inTransaction) {
+        if (txIndexWriteCache.empty()) {
+            return true;
+        }
+        if (!TxnBegin(2 * txIndexWriteCache.getMemoryUsage())) {
+            return NLog.error("FlushTxIndexWriteCache() : TxnBegin failed");
+        }
+        if (!FlushTxIndexWriteCache()) {
+            TxnAbort();
+            return false;
+        }
+        return TxnCommit();
+    }
+
+    if (txIndexCacheFlushed) {
+        return true;
+    }
+
+    const bool hasMarker = !txIndexWriteCache.empty();
+
+    std::map<uint256, TxIndexWriteCache::Entry> changes = txIndexWriteCache.getAll();
+    if (pendingTxIndexChanges) {
+        for (const auto& p : pendingTxIndexChanges->getAll()) {
+            changes[p.first] = p.second;
+        }
+    }
+
+    for (const auto& p : changes) {
+        if (p.second) {
+            if (!Write(p.first, *p.second, IDB::Index::DB_TX_INDEX)) {
+                return NLog.error("FlushTxIndexWriteCache() : failed to write tx index of {}",
+                                  p.first.ToString());
+            }
+        } else if (Exists(p.first, IDB::Index::DB_TX_INDEX)) {
+            // a tombstone of a tx index that may have never been written to the db
+            if (!Erase(p.first, IDB::Index::DB_TX_INDEX)) {
+                return NLog.error("FlushTxIndexWriteCache() : failed to erase tx index of {}",
+                                  p.first.ToString());
+            }
+        }
+    }
+    if (hasMarker && !Erase(TXINDEX_BEST_CHAIN_KEY, IDB::Index::DB_MAIN_INDEX)) {
+        return NLog.error("FlushTxIndexWriteCache() : failed to erase the tx index best chain marker");
+    }
+
+    // from now on, the tx index changes of this transaction go directly to the db
+    pendingTxIndexChanges.reset();
+    txIndexCacheFlushed = true;
+
+    NLog.write(b_sev::info, "Flushed {} cached tx index entries to the database", changes.size());
 
-bool CTxDB::TxnCommit() { return db->commitDBTransaction(); }
+    return true;
+}
 
-bool CTxDB::TxnAbort() { return db->abortDBTransaction(); }
+boost::optional<TxIndexWriteCache::Entry> CTxDB::GetCachedTxIndex(const uint256& hash) const
+{
+    if (pendingTxIndexChanges) {
+        if (auto entry = pendingTxIndexChanges->get(hash)) {
+            return entry;
+        }
+    }
+    if (txIndexCacheFlushed) {
+        return boost::none;
+    }
+    return txIndexWriteCache.get(hash);
+}
 
 boost::optional<int> CTxDB::ReadVersion()
 {
@@ -360,11 +506,55 @@ bool CTxDB::WriteVersion(int nVersionIn)
 bool CTxDB::ReadTxIndex(const uint256& hash, CTxIndex& txindex) const
 {
     txindex.SetNull();
+    if (const boost::optional<TxIndexWriteCache::Entry> cached = GetCachedTxIndex(hash)) {
+        if (!*cached) {
+            return false;
+        }
+        txindex = **cached;
+        return true;
+    }
     return Read(hash, txindex, IDB::Index::DB_TX_INDEX);
 }
 
+bool CTxDB::ReadTxIndexBatch(const std::vector<uint256>&             hashes,
+                             std::vector<boost::optional<CTxIndex>>& txindices) const
+{
+    txindices.assign(hashes.size(), boost::none);
+
+    // the entries that are not in the tx index write cache are read from the db in one batch
+    std::vector<uint256>     hashesToRead;
+    std::vector<std::size_t> positionsToRead;
+    for (std::size_t i = 0; i < hashes.size(); i++) {
+        if (const boost::optional<TxIndexWriteCache::Entry> cached = GetCachedTxIndex(hashes[i])) {
+            txindices[i] = *cached;
+        } else {
+            hashesToRead.push_back(hashes[i]);
+            positionsToRead.push_back(i);
+        }
+    }
+
+    std::vector<boost::optional<CTxIndex>> readTxIndices;
+    if (!ReadBatch(hashesToRead, readTxIndices, IDB::Index::DB_TX_INDEX)) {
+        return false;
+    }
+    for (std::size_t i = 0; i < readTxIndices.size(); i++) {
+        txindices[positionsToRead[i]] = std::move(readTxIndices[i]);
+    }
+    return true;
+}
+
 bool CTxDB::UpdateTxIndex(const uint256& hash, const CTxIndex& txindex)
 {
+    if (pendingTxIndexChanges) {
+        pendingTxIndexChanges->update(hash, txindex);
+        return true;
+    }
+    if (!inTransaction && !txIndexWriteCache.empty()) {
+        TxIndexWriteCache::PendingChanges changes;
+        changes.update(hash, txindex);
+        txIndexWriteCache.apply(changes);
+        return true;
+    }
     return Write(hash, txindex, IDB::Index::DB_TX_INDEX);
 }
 
@@ -374,6 +564,42 @@ bool CTxDB::ReadTx(const CDiskTxPos& txPos, CTransaction& tx) const
     return Read(txPos.nBlockPos, tx, IDB::Index::DB_BLOCKS_INDEX, 0, txPos.nTxPos);
 }
 
+bool CTxDB::ReadTxBatch(const std::vector<CDiskTxPos>&              txPositions,
+                        std::vector<boost::optional<CTransaction>>& txs) const
+{
+    txs.assign(txPositions.size(), boost::none);
+
+    // txs are stored in their blocks, so the keys are the block hashes and the txs are at offsets
+    std::vector<std::string> ssKeys;
+    ssKeys.reserve(txPositions.size());
+    for (const CDiskTxPos& txPos : txPositions) {
+        boost::optional<std::string> ssKey = SerializeSimple(txPos.nBlockPos);
+        if (!ssKey) {
+            return false;
+        }
+        ssKeys.push_back(std::move(*ssKey));
+    }
+
+    return db->readBatch(
+        IDB::Index::DB_BLOCKS_INDEX, ssKeys, [&](std::size_t i, const char* data, std::size_t size) {
+            const std::size_t offset = txPositions[i].nTxPos;
+            CTransaction      tx;
+            if (offset > size || !DeserializeView(data + offset, size - offset, tx)) {
+                NLog.write(b_sev::err, "Failed to deserialize tx at {} in lmdb ReadTxBatch()",
+                           txPositions[i].ToString());
+                return false;
+            }
+            txs[i] = std::move(tx);
+            return true;
+        });
+}
+
+bool CTxDB::ReadNTP1TxBatch(const std::vector<uint256>&                    hashes,
+                            std::vector<boost::optional<NTP1Transaction>>& ntp1txs) const
+{
+    return ReadBatch(hashes, ntp1txs, IDB::Index::DB_NTP1TX_INDEX);
+}
+
 bool CTxDB::ReadNTP1Tx(const uint256& hash, NTP1Transaction& ntp1tx) const
 {
     ntp1tx.setNull();
@@ -468,9 +694,38 @@ bool CTxDB::WriteBlock(const uint256& hash, const CBlock& blk)
     return Write(hash, blk, IDB::Index::DB_BLOCKS_INDEX);
 }
 
-bool CTxDB::EraseTxIndex(const uint256& hash) { return Erase(hash, IDB::Index::DB_TX_INDEX); }
+bool CTxDB::ReadBlockBytes(const uint256& hash, const BytesViewFunc& func) const
+{
+    // the serialization of a block is the same on disk and on the network
+    const boost::optional<std::string> ssKey = SerializeSimple(hash);
+    if (!ssKey) {
+        return false;
+    }
+    return db->readView(IDB::Index::DB_BLOCKS_INDEX, *ssKey, func, 0, boost::none);
+}
+
+bool CTxDB::EraseTxIndex(const uint256& hash)
+{
+    if (pendingTxIndexChanges) {
+        pendingTxIndexChanges->erase(hash);
+        return true;
+    }
+    if (!inTransaction && !txIndexWriteCache.empty()) {
+        TxIndexWriteCache::PendingChanges changes;
+        changes.erase(hash);
+        txIndexWriteCache.apply(changes);
+        return true;
+    }
+    return Erase(hash, IDB::Index::DB_TX_INDEX);
+}
 
-bool CTxDB::ContainsTx(const uint256& hash) const { return Exists(hash, IDB::Index::DB_TX_INDEX); }
+bool CTxDB::ContainsTx(const uint256& hash) const
+{
+    if (const boost::optional<TxIndexWriteCache::Entry> cached = GetCachedTxIndex(hash)) {
+        return cached->is_initialized();
+    }
+    return Exists(hash, IDB::Index::DB_TX_INDEX);
+}
 
 bool CTxDB::ContainsNTP1Tx(const uint256& hash) const
 {
@@ -504,6 +759,15 @@ bool CTxDB::ReadDiskTx(const COutPoint& outpoint, CTransaction& tx) const
 
 boost::optional<CBlockIndex> CTxDB::ReadBlockIndex(const uint256& blockHash) const
 {
+    if (pendingCatalogChanges) {
+        if (auto bi = pendingCatalogChanges->getBlockIndex(blockHash)) {
+            return bi;
+        }
+    }
+    if (blockIndexCatalog.isLoaded()) {
+        return blockIndexCatalog.get(blockHash);
+    }
+
     CBlockIndex result;
     if (!Read(blockHash, result, IDB::Index::DB_BLOCKINDEX_INDEX)) {
         return boost::none;
@@ -514,16 +778,61 @@ boost::optional<CBlockIndex> CTxDB::ReadBlockIndex(const uint256& blockHash) con
 
 bool CTxDB::WriteBlockIndex(const CBlockIndex& blockindex)
 {
-    return Write(blockindex.GetBlockHash(), blockindex, IDB::Index::DB_BLOCKINDEX_INDEX);
+    if (!Write(blockindex.GetBlockHash(), blockindex, IDB::Index::DB_BLOCKINDEX_INDEX)) {
+        return false;
+    }
+    if (pendingCatalogChanges) {
+        pendingCatalogChanges->addBlockIndex(blockindex);
+    } else if (blockIndexCatalog.isLoaded()) {
+        blockIndexCatalog.add(blockindex);
+    }
+    return true;
+}
+
+boost::optional<CBlockIndex> CTxDB::ReadBlockIndexAncestor(const uint256& blockHash,
+                                                           int32_t        height) const
+{
+    // ancestry never changes, so the catalog can be used as long as it has the block
+    if (blockIndexCatalog.isLoaded()) {
+        if (auto ancestor = blockIndexCatalog.getAncestor(blockHash, height)) {
+            return ancestor;
+        }
+    }
+
+    boost::optional<CBlockIndex> bi = ReadBlockIndex(blockHash);
+    while (bi && bi->nHeight > height) {
+        bi = bi->getPrev(*this);
+    }
+    if (bi && bi->nHeight != height) {
+        return boost::none;
+    }
+    return bi;
 }
 
 bool CTxDB::EraseBlockHashOfHeight(int32_t height)
 {
-    return Erase(height, IDB::Index::DB_BLOCKHEIGHTS_INDEX);
+    if (!Erase(height, IDB::Index::DB_BLOCKHEIGHTS_INDEX)) {
+        return false;
+    }
+    if (pendingCatalogChanges) {
+        pendingCatalogChanges->eraseMainChainHeight(height);
+    } else if (blockIndexCatalog.isLoaded()) {
+        blockIndexCatalog.eraseMainChainHeight(height);
+    }
+    return true;
 }
 
 boost::optional<uint256> CTxDB::ReadBlockHashOfHeight(int32_t height) const
 {
+    if (pendingCatalogChanges) {
+        if (auto h = pendingCatalogChanges->getMainChainHash(height)) {
+            return (*h != 0 ? h : boost::none);
+        }
+    }
+    if (blockIndexCatalog.isLoaded()) {
+        return blockIndexCatalog.getMainChainHash(height);
+    }
+
     uint256 result = 0;
     if (Read(height, result, IDB::Index::DB_BLOCKHEIGHTS_INDEX)) {
         return boost::make_optional(std::move(result));
@@ -534,7 +843,15 @@ boost::optional<uint256> CTxDB::ReadBlockHashOfHeight(int32_t height) const
 
 bool CTxDB::WriteBlockHashOfHeight(int32_t height, const uint256& blockHash)
 {
-    return Write(height, blockHash, IDB::Index::DB_BLOCKHEIGHTS_INDEX);
+    if (!Write(height, blockHash, IDB::Index::DB_BLOCKHEIGHTS_INDEX)) {
+        return false;
+    }
+    if (pendingCatalogChanges) {
+        pendingCatalogChanges->setMainChainHash(height, blockHash);
+    } else if (blockIndexCatalog.isLoaded()) {
+        blockIndexCatalog.setMainChainHash(height, blockHash);
+    }
+    return true;
 }
 
 boost::optional<BlockMetadata> CTxDB::ReadBlockMetadata(const uint256& blockHash) const
@@ -552,14 +869,40 @@ bool CTxDB::WriteBlockMetadata(const BlockMetadata& blockMetadata)
     return Write(blockMetadata.getBlockHash(), blockMetadata, IDB::Index::DB_BLOCKMETADATA_INDEX);
 }
 
+BestChainState::SnapshotPtr CTxDB::GetBestChainSnapshot() const
+{
+    // within a transaction that changed the best chain, the global state is not valid for this object
+    // until the transaction is committed
+    if (pendingBestChain) {
+        return *pendingBestChain;
+    }
+    return bestChain.get();
+}
+
 bool CTxDB::ReadHashBestChain(uint256& hashBestChain) const
 {
+    if (const BestChainState::SnapshotPtr snapshot = GetBestChainSnapshot()) {
+        hashBestChain = snapshot->blockHash;
+        return true;
+    }
     return Read(string("hashBestChain"), hashBestChain, IDB::Index::DB_MAIN_INDEX);
 }
 
 bool CTxDB::WriteHashBestChain(const uint256& hashBestChain)
 {
-    return Write(string("hashBestChain"), hashBestChain, IDB::Index::DB_MAIN_INDEX);
+    if (!Write(string("hashBestChain"), hashBestChain, IDB::Index::DB_MAIN_INDEX)) {
+        return false;
+    }
+    BestChainState::SnapshotPtr snapshot;
+    if (const boost::optional<CBlockIndex> bi = ReadBlockIndex(hashBestChain)) {
+        snapshot = BestChainState::MakeSnapshot(*bi, *this);
+    }
+    if (inTransaction) {
+        pendingBestChain = snapshot;
+    } else {
+        bestChain.set(snapshot);
+    }
+    return true;
 }
 
 bool CTxDB::ReadBestInvalidTrust(CBigNum& bnBestInvalidTrust) const
@@ -625,6 +968,114 @@ boost::optional<bool> CTxDB::WasStakeSeen(const std::pair<COutPoint, unsigned in
     }
 }
 
+bool CTxDB::ReadNTP1AddressOutputs(const std::string&              address,
+                                   std::vector<NTP1IndexedOutput>& outputs) const
+{
+    outputs.clear();
+
+    // the keys are (address, outpoint), so the outputs of an address are the keys with its prefix
+    const boost::optional<std::string> prefix = SerializeSimple(address);
+    if (!prefix) {
+        return false;
+    }
+    const boost::optional<std::map<std::string, std::string>> rawOutputs =
+        db->readAllUniqueWithPrefix(IDB::Index::DB_NTP1ADDRESSOUTPUTS_INDEX, *prefix);
+    if (!rawOutputs) {
+        return false;
+    }
+    for (const auto& p : *rawOutputs) {
+        NTP1IndexedOutput output;
+        if (!DeserializeView(p.second.data(), p.second.size(), output)) {
+            NLog.write(b_sev::err, "Failed to deserialize an NTP1 output of address {}", address);
+            return false;
+        }
+        outputs.push_back(std::move(output));
+    }
+    return true;
+}
+
+bool CTxDB::WriteNTP1AddressOutput(const std::string& address, const NTP1IndexedOutput& output)
+{
+    return Write(std::make_pair(address, output.outpoint), output,
+                 IDB::Index::DB_NTP1ADDRESSOUTPUTS_INDEX);
+}
+
+bool CTxDB::EraseNTP1AddressOutput(const std::string& address, const COutPoint& outpoint)
+{
+    return Erase(std::make_pair(address, outpoint), IDB::Index::DB_NTP1ADDRESSOUTPUTS_INDEX);
+}
+
+boost::optional<NTP1IndexedToken> CTxDB::ReadNTP1IndexedToken(const std::string& tokenId) const
+{
+    if (!Exists(tokenId, IDB::Index::DB_NTP1TOKENS_INDEX)) {
+        return boost::none;
+    }
+    NTP1IndexedToken token;
+    if (Read(tokenId, token, IDB::Index::DB_NTP1TOKENS_INDEX)) {
+        return boost::make_optional(std::move(token));
+    } else {
+        return boost::none;
+    }
+}
+
+bool CTxDB::WriteNTP1IndexedToken(const NTP1IndexedToken& token)
+{
+    return Write(token.tokenId, token, IDB::Index::DB_NTP1TOKENS_INDEX);
+}
+
+bool CTxDB::EraseNTP1IndexedToken(const std::string& tokenId)
+{
+    return Erase(tokenId, IDB::Index::DB_NTP1TOKENS_INDEX);
+}
+
+boost::optional<NTP1IndexedHolding> CTxDB::ReadNTP1TokenHolding(const std::string& tokenId,
+                                                                const std::string& address) const
+{
+    const auto key = std::make_pair(tokenId, address);
+    if (!Exists(key, IDB::Index::DB_NTP1TOKENHOLDERS_INDEX)) {
+        return boost::none;
+    }
+    NTP1IndexedHolding holding;
+    if (Read(key, holding, IDB::Index::DB_NTP1TOKENHOLDERS_INDEX)) {
+        return boost::make_optional(std::move(holding));
+    } else {
+        return boost::none;
+    }
+}
+
+bool CTxDB::WriteNTP1TokenHolding(const NTP1IndexedHolding& holding)
+{
+    return Write(std::make_pair(holding.tokenId, holding.address), holding,
+                 IDB::Index::DB_NTP1TOKENHOLDERS_INDEX);
+}
+
+bool CTxDB::EraseNTP1TokenHolding(const std::string& tokenId, const std::string& address)
+{
+    return Erase(std::make_pair(tokenId, address), IDB::Index::DB_NTP1TOKENHOLDERS_INDEX);
+}
+
+uint256 CTxDB::ReadNTP1IndexBestBlock() const
+{
+    uint256 blockHash = 0;
+    if (!Exists(NTP1INDEX_BEST_BLOCK_KEY, IDB::Index::DB_MAIN_INDEX) ||
+        !Read(NTP1INDEX_BEST_BLOCK_KEY, blockHash, IDB::Index::DB_MAIN_INDEX)) {
+        return 0;
+    }
+    return blockHash;
+}
+
+bool CTxDB::WriteNTP1IndexBestBlock(const uint256& blockHash)
+{
+    return Write(NTP1INDEX_BEST_BLOCK_KEY, blockHash, IDB::Index::DB_MAIN_INDEX);
+}
+
+bool CTxDB::ClearNTP1Index()
+{
+    return WriteNTP1IndexBestBlock(0) && db->clear(IDB::Index::DB_NTP1ADDRESSOUTPUTS_INDEX) &&
+           db->clear(IDB::Index::DB_NTP1TOKENS_INDEX) &&
+           db->clear(IDB::Index::DB_NTP1TOKENHOLDERS_INDEX);
+}
+
 std::string LmdbValToString(const MDB_val& val)
 {
     return std::string((const char*)val.mv_data, val.mv_size);
@@ -632,6 +1083,12 @@ std::string LmdbValToString(const MDB_val& val)
 
 bool CTxDB::LoadBlockIndex()
 {
+    // Load the in-memory block index catalog; from now on, the block index is read from it
+    if (!blockIndexCatalog.loadFromDB(*this)) {
+        NLog.write(b_sev::err, "CTxDB::LoadBlockIndex() : failed to load the block index catalog");
+        return false;
+    }
+
     // Load hashBestChain pointer to end of best chain
     uint256 hashBestChainTemp = 0;
     if (!ReadHashBestChain(hashBestChainTemp)) {
@@ -649,12 +1106,25 @@ bool CTxDB::LoadBlockIndex()
     }
     pindexGenesisBlock = boost::make_shared<CBlockIndex>(*genesisIndex);
 
+    // if the node stopped before the tx index write cache was flushed, the tx index in the db is
+    // complete only up to the marker
+    uint256 hashTxIndexBestChain = 0;
+    if (Read(TXINDEX_BEST_CHAIN_KEY, hashTxIndexBestChain, IDB::Index::DB_MAIN_INDEX)) {
+        if (!RecoverUnflushedTxIndex(hashTxIndexBestChain, hashBestChainTemp)) {
+            NLog.write(b_sev::err, "CTxDB::LoadBlockIndex() : failed to recover the tx index");
+            return false;
+        }
+    }
+
     const boost::optional<CBlockIndex> bestBlockIndex = ReadBlockIndex(hashBestChainTemp);
     if (!bestBlockIndex) {
         NLog.write(b_sev::err, "CTxDB::LoadBlockIndex() : hashBestChain not found in the block index");
         return false;
     }
 
+    // from now on, the best chain is read from memory
+    bestChain.set(BestChainState::MakeSnapshot(*bestBlockIndex, *this));
+
     const int bestHeight = bestBlockIndex->nHeight;
 
     NLog.write(b_sev::err, "LoadBlockIndex(): hashBestChain={}  height={}  trust={}  date={}",
@@ -833,8 +1303,55 @@ bool CTxDB::LoadBlockIndex()
     return true;
 }
 
+bool CTxDB::RecoverUnflushedTxIndex(const uint256& hashTxIndexBestChain, const uint256& hashBestChain)
+{
+    if (hashTxIndexBestChain == hashBestChain) {
+        return Erase(TXINDEX_BEST_CHAIN_KEY, IDB::Index::DB_MAIN_INDEX);
+    }
+
+    const boost::optional<CBlockIndex> txIndexBestIndex = ReadBlockIndex(hashTxIndexBestChain);
+    const boost::optional<CBlockIndex> bestIndex        = ReadBlockIndex(hashBestChain);
+    if (!txIndexBestIndex || !bestIndex) {
+        return NLog.error("RecoverUnflushedTxIndex() : block index of the tx index best chain ({}) or "
+                          "the best chain ({}) not found",
+                          hashTxIndexBestChain.ToString(), hashBestChain.ToString());
+    }
+    const boost::optional<CBlockIndex> ancestor =
+        ReadBlockIndexAncestor(hashBestChain, txIndexBestIndex->nHeight);
+    if (!ancestor || ancestor->GetBlockHash() != hashTxIndexBestChain) {
+        return NLog.error("RecoverUnflushedTxIndex() : tx index best chain {} is not in the best chain",
+                          hashTxIndexBestChain.ToString());
+    }
+
+    NLog.write(b_sev::warn,
+               "The tx index was not flushed before the last shutdown; writing the tx index of the "
+               "blocks from height {} to {} again",
+               txIndexBestIndex->nHeight + 1, bestIndex->nHeight);
+
+    // everything else that connecting these blocks wrote is in the db, so only their tx index entries
+    // are written again, on top of the tx index that is complete up to the marker
+    if (!TxnBegin()) {
+        return NLog.error("RecoverUnflushedTxIndex() : TxnBegin failed");
+    }
+    // the marker is erased with the entries, so they go straight to the db instead of to the cache
+    pendingTxIndexChanges.reset();
+    if (!CBlock::ReconnectTxIndex(*this, hashTxIndexBestChain, hashBestChain) ||
+        !Erase(TXINDEX_BEST_CHAIN_KEY, IDB::Index::DB_MAIN_INDEX)) {
+        TxnAbort();
+        return NLog.error("RecoverUnflushedTxIndex() : failed to write the tx index again");
+    }
+    if (!TxnCommit()) {
+        return NLog.error("RecoverUnflushedTxIndex() : TxnCommit failed");
+    }
+
+    return true;
+}
+
 boost::optional<int> CTxDB::GetBestChainHeight() const
 {
+    if (const BestChainState::SnapshotPtr snapshot = GetBestChainSnapshot()) {
+        return snapshot->height;
+    }
     if (auto v = GetBestBlockIndex()) {
         if (v.is_initialized()) {
             return v->nHeight;
@@ -845,6 +1362,9 @@ boost::optional<int> CTxDB::GetBestChainHeight() const
 
 boost::optional<uint256> CTxDB::GetBestChainTrust() const
 {
+    if (const BestChainState::SnapshotPtr snapshot = GetBestChainSnapshot()) {
+        return snapshot->chainTrust;
+    }
     if (auto v = GetBestBlockIndex()) {
         if (v.is_initialized()) {
             return v->nChainTrust;
@@ -16,12 +16,15 @@
 #include <type_traits>
 #include <vector>
 
+#include "bestchainstate.h"
+#include "blockindexcatalog.h"
 #include "db/lmdb/lmdb.h"
 #include "db/lmdb/lmdbtransaction.h"
 #include "disktxpos.h"
 #include "itxdb.h"
 #include "outpoint.h"
 #include "txindex.h"
+#include "txindexwritecache.h"
 #include "util.h"
 
 class NTP1Transaction;
@@ -71,6 +74,36 @@ class CTxDB : public ITxDB
 {
     std::unique_ptr<LMDB> db;
 
+    // block index changes done in the active db transaction; they're written through to the global
+    // block index catalog only when the transaction is committed
+    std::unique_ptr<BlockIndexCatalog::PendingChanges> pendingCatalogChanges;
+
+    // tx index changes done in the active db transaction while the tx index write cache is in use;
+    // they're moved to the global cache when the transaction is committed
+    std::unique_ptr<TxIndexWriteCache::PendingChanges> pendingTxIndexChanges;
+
+    // the best block when the active db transaction began; if this transaction is the first to put
+    // changes in the tx index write cache, this is where the tx index in the db stops being complete
+    boost::optional<uint256> txIndexCacheBaseBlock;
+
+    // true if the tx index write cache was written in the active db transaction; the cache is then
+    // ignored by this object and cleared when the transaction is committed
+    bool txIndexCacheFlushed = false;
+
+    bool inTransaction = false;
+
+    // the best chain written in the active db transaction, which is published to the global best chain
+    // state when the transaction is committed; none if it wasn't written, and nullptr if it was written
+    // but its block index couldn't be read
+    boost::optional<BestChainState::SnapshotPtr> pendingBestChain;
+
+    boost::optional<TxIndexWriteCache::Entry> GetCachedTxIndex(const uint256& hash) const;
+
+    /// returns nullptr if the best chain has to be read from the db
+    BestChainState::SnapshotPtr GetBestChainSnapshot() const;
+
+    bool RecoverUnflushedTxIndex(const uint256& hashTxIndexBestChain, const uint256& hashBestChain);
+
 public:
     static boost::filesystem::path DB_DIR;
 
@@ -104,23 +137,66 @@ protected:
             return false;
         }
 
-        const boost::optional<std::string> res = db->read(dbindex, *ssKey, offset, boost::none);
-        if (!res) {
-            return false;
-        }
+        // deserialize straight from the db's memory, without copying the value out of it first
+        return db->readView(
+            dbindex, *ssKey,
+            [&](const char* data, std::size_t size) {
+                if (!DeserializeView(data, size, value, serializationTypeModifiers)) {
+                    NLog.write(b_sev::err, "Failed to deserialized in lmdb Read() data for key {}",
+                               ssKey->c_str());
+                    return false;
+                }
+                return true;
+            },
+            offset, boost::none);
+    }
 
+    template <typename T>
+    static bool DeserializeView(const char* data, std::size_t size, T& value,
+                                int serializationTypeModifiers = 0)
+    {
         try {
-            CDataStream ssValue(res->c_str(), res->c_str() + res->size(),
-                                SER_DISK | serializationTypeModifiers, CLIENT_VERSION);
+            CBufferReader ssValue(data, data + size, SER_DISK | serializationTypeModifiers,
+                                  CLIENT_VERSION);
             ssValue >> value;
             return true;
         } catch (const std::exception& e) {
-            NLog.write(b_sev::err, "Failed to deserialized in lmdb Read() data for key {}",
-                       ssKey->c_str());
             return false;
         }
     }
 
+    /**
+     * ReadBatch reads the values of many keys in one db read transaction; values gets an element per
+     * key, in the same order, which is none if the key doesn't exist
+     */
+    template <typename K, typename T>
+    bool ReadBatch(const std::vector<K>& keys, std::vector<boost::optional<T>>& values,
+                   IDB::Index dbindex) const
+    {
+        values.assign(keys.size(), boost::none);
+
+        std::vector<std::string> ssKeys;
+        ssKeys.reserve(keys.size());
+        for (const K& key : keys) {
+            boost::optional<std::string> ssKey = SerializeSimple(key);
+            if (!ssKey) {
+                return false;
+            }
+            ssKeys.push_back(std::move(*ssKey));
+        }
+
+        return db->readBatch(dbindex, ssKeys, [&](std::size_t i, const char* data, std::size_t size) {
+            T value;
+            if (!DeserializeView(data, size, value)) {
+                NLog.write(b_sev::err, "Failed to deserialized in lmdb ReadBatch() data for key {}",
+                           ssKeys[i]);
+                return false;
+            }
+            values[i] = std::move(value);
+            return true;
+        });
+    }
+
     /**
      * ReadMultiple key/value pairs, either starting at "key" or just all the keys in the db. If readAll
      * is true, everything in the db will be read
@@ -254,13 +330,26 @@ public:
     bool TxnCommit();
     bool TxnAbort();
 
+    /**
+     * Writes the tx index write cache to the db. If there's an active transaction, the cache is written
+     * in it (and cleared when it's committed), and the rest of the tx index changes of that transaction
+     * go directly to the db; otherwise, the cache is written in a new transaction.
+     */
+    bool FlushTxIndexWriteCache();
+
     boost::optional<int> ReadVersion();
 
     bool WriteVersion(int nVersionIn) override;
     bool ReadTxIndex(const uint256& hash, CTxIndex& txindex) const override;
+    bool ReadTxIndexBatch(const std::vector<uint256>&             hashes,
+                          std::vector<boost::optional<CTxIndex>>& txindices) const override;
     bool UpdateTxIndex(const uint256& hash, const CTxIndex& txindex) override;
     bool ReadTx(const CDiskTxPos& txPos, CTransaction& tx) const override;
+    bool ReadTxBatch(const std::vector<CDiskTxPos>&              txPositions,
+                     std::vector<boost::optional<CTransaction>>& txs) const override;
     bool ReadNTP1Tx(const uint256& hash, NTP1Transaction& ntp1tx) const override;
+    bool ReadNTP1TxBatch(const std::vector<uint256>&                    hashes,
+                         std::vector<boost::optional<NTP1Transaction>>& ntp1txs) const override;
     bool WriteNTP1Tx(const uint256& hash, const NTP1Transaction& ntp1tx) override;
     bool ReadAllIssuanceTxs(std::vector<uint256>& txs) const override;
     bool ReadNTP1TxsWithTokenSymbol(std::string tokenName, std::vector<uint256>& txs) const override;
@@ -276,8 +365,10 @@ public:
     bool ReadDiskTx(const COutPoint& outpoint, CTransaction& tx) const override;
     bool ReadBlock(const uint256& hash, CBlock& blk, bool fReadTransactions = true) const override;
     bool WriteBlock(const uint256& hash, const CBlock& blk) override;
+    bool ReadBlockBytes(const uint256& hash, const BytesViewFunc& func) const override;
     boost::optional<CBlockIndex> ReadBlockIndex(const uint256& blockHash) const override;
     bool                         WriteBlockIndex(const CBlockIndex& blockindex) override;
+    boost::optional<CBlockIndex> ReadBlockIndexAncestor(const uint256& blockHash, int32_t height) const;
     bool                         EraseBlockHashOfHeight(int32_t height) override;
     boost::optional<uint256>     ReadBlockHashOfHeight(int32_t height) const override;
     bool WriteBlockHashOfHeight(int32_t height, const uint256& blockHash) override;
@@ -290,6 +381,21 @@ public:
     boost::optional<std::map<uint256, CBlockIndex>> ReadAllBlockIndexEntries() const override;
     bool                  WriteStakeSeen(const std::pair<COutPoint, unsigned int>& stake) override;
     boost::optional<bool> WasStakeSeen(const std::pair<COutPoint, unsigned int>& stake) const override;
+    bool ReadNTP1AddressOutputs(const std::string&              address,
+                                std::vector<NTP1IndexedOutput>& outputs) const override;
+    bool WriteNTP1AddressOutput(const std::string& address, const NTP1IndexedOutput& output) override;
+    bool EraseNTP1AddressOutput(const std::string& address, const COutPoint& outpoint) override;
+    boost::optional<NTP1IndexedToken> ReadNTP1IndexedToken(const std::string& tokenId) const override;
+    bool WriteNTP1IndexedToken(const NTP1IndexedToken& token) override;
+    bool EraseNTP1IndexedToken(const std::string& tokenId) override;
+    boost::optional<NTP1IndexedHolding> ReadNTP1TokenHolding(const std::string& tokenId,
+                                                             const std::string& address) const override;
+    bool WriteNTP1TokenHolding(const NTP1IndexedHolding& holding) override;
+    bool EraseNTP1TokenHolding(const std::string& tokenId, const std::string& address) override;
+    uint256 ReadNTP1IndexBestBlock() const override;
+    bool    WriteNTP1IndexBestBlock(const uint256& blockHash) override;
+    /// erases everything in the NTP1 index, which then has to be rebuilt
+    bool ClearNTP1Index();
     bool                  LoadBlockIndex() override;
     boost::optional<int>  GetBestChainHeight() const override;
     boost::optional<uint256>     GetBestChainTrust() const override;
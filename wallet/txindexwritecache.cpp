@@ -0,0 +1,103 @@
+#include "txindexwritecache.h"
+
+void TxIndexWriteCache::PendingChanges::update(const uint256& txHash, const CTxIndex& txindex)
+{
+    changes[txHash] = txindex;
+}
+
+void TxIndexWriteCache::PendingChanges::erase(const uint256& txHash) { changes[txHash] = boost::none; }
+
+boost::optional<TxIndexWriteCache::Entry>
+TxIndexWriteCache::PendingChanges::get(const uint256& txHash) const
+{
+    const auto it = changes.find(txHash);
+    if (it == changes.cend()) {
+        return boost::none;
+    }
+    return boost::make_optional(it->second);
+}
+
+const std::map<uint256, TxIndexWriteCache::Entry>& TxIndexWriteCache::PendingChanges::getAll() const
+{
+    return changes;
+}
+
+bool TxIndexWriteCache::PendingChanges::empty() const { return changes.empty(); }
+
+std::size_t TxIndexWriteCache::EstimateMemoryUsage(const Entry& entry)
+{
+    // the key, the value and the overhead of a node in the hash table
+    static const std::size_t nodeOverhead = 4 * sizeof(void*);
+
+    std::size_t result = sizeof(uint256) + sizeof(Entry) + nodeOverhead;
+    if (entry) {
+        result += entry->vSpent.capacity() * sizeof(CDiskTxPos);
+    }
+    return result;
+}
+
+void TxIndexWriteCache::setMaxMemoryUsage(std::size_t bytes) { maxMemoryUsage = bytes; }
+
+std::size_t TxIndexWriteCache::getMaxMemoryUsage() const { return maxMemoryUsage; }
+
+void TxIndexWriteCache::setCachingWrites(bool value) { cachingWrites = value; }
+
+bool TxIndexWriteCache::isCachingWrites() const { return cachingWrites && maxMemoryUsage > 0; }
+
+boost::optional<TxIndexWriteCache::Entry> TxIndexWriteCache::get(const uint256& txHash) const
+{
+    boost::shared_lock<boost::shared_mutex> lg(mtx);
+    const auto                              it = entries.find(txHash);
+    if (it == entries.cend()) {
+        return boost::none;
+    }
+    return boost::make_optional(it->second);
+}
+
+void TxIndexWriteCache::apply(const PendingChanges& changes)
+{
+    boost::unique_lock<boost::shared_mutex> lg(mtx);
+    for (const auto& p : changes.getAll()) {
+        const auto it = entries.find(p.first);
+        if (it != entries.end()) {
+            memoryUsage -= EstimateMemoryUsage(it->second);
+            it->second = p.second;
+        } else {
+            entries.insert(p);
+        }
+        memoryUsage += EstimateMemoryUsage(p.second);
+    }
+}
+
+std::map<uint256, TxIndexWriteCache::Entry> TxIndexWriteCache::getAll() const
+{
+    boost::shared_lock<boost::shared_mutex> lg(mtx);
+    return std::map<uint256, Entry>(entries.cbegin(), entries.cend());
+}
+
+void TxIndexWriteCache::clear()
+{
+    boost::unique_lock<boost::shared_mutex> lg(mtx);
+    entries.clear();
+    memoryUsage = 0;
+}
+
+bool TxIndexWriteCache::empty() const
+{
+    boost::shared_lock<boost::shared_mutex> lg(mtx);
+    return entries.empty();
+}
+
+std::size_t TxIndexWriteCache::size() const
+{
+    boost::shared_lock<boost::shared_mutex> lg(mtx);
+    return entries.size();
+}
+
+std::size_t TxIndexWriteCache::getMemoryUsage() const
+{
+    boost::shared_lock<boost::shared_mutex> lg(mtx);
+    return memoryUsage;
+}
+
+bool TxIndexWriteCache::isFull() const { return getMemoryUsage() >= maxMemoryUsage; }
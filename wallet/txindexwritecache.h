@@ -0,0 +1,91 @@
+#ifndef TXINDEXWRITECACHE_H
+#define TXINDEXWRITECACHE_H
+
+#include "txindex.h"
+#include "uint256.h"
+#include <atomic>
+#include <boost/optional.hpp>
+#include <boost/thread.hpp>
+#include <cstddef>
+#include <map>
+#include <unordered_map>
+
+/**
+ * @brief The TxIndexWriteCache class keeps the tx index entries (DB_TX_INDEX) that were written while
+ * connecting and disconnecting blocks in memory, and lets CTxDB write them to the database in one
+ * transaction once the cache is full, instead of writing them block by block.
+ *
+ * It's used during the initial sync, where every block updates the tx index entries of the
+ * transactions it spends, which are very often the same ones updated by the previous blocks.
+ *
+ * The cache holds only changes that are not in the database yet. An entry can be a tombstone (none),
+ * which means that the tx index was erased. Reads through CTxDB check the cache before the database.
+ *
+ * While the cache isn't empty, the database has a marker with the best block up to which the tx index
+ * in the database is complete. If the node stops before the cache is flushed, the tx index entries of
+ * the blocks after the marker are written again on startup (see CTxDB::LoadBlockIndex()).
+ */
+class TxIndexWriteCache
+{
+public:
+    /// none means that the tx index was erased
+    using Entry = boost::optional<CTxIndex>;
+
+    /**
+     * Changes done to the tx index within a database transaction. They're applied to the cache only
+     * when the transaction is committed, and discarded if it's aborted.
+     */
+    class PendingChanges
+    {
+        std::map<uint256, Entry> changes;
+
+    public:
+        void update(const uint256& txHash, const CTxIndex& txindex);
+        void erase(const uint256& txHash);
+        /// returns none if there's no change for that tx, and a none entry if the tx index was erased
+        boost::optional<Entry>          get(const uint256& txHash) const;
+        const std::map<uint256, Entry>& getAll() const;
+        bool                            empty() const;
+    };
+
+private:
+    mutable boost::shared_mutex         mtx;
+    std::unordered_map<uint256, Entry> entries;
+    std::size_t                         memoryUsage = 0;
+
+    std::atomic<std::size_t> maxMemoryUsage{0};
+    std::atomic<bool>        cachingWrites{false};
+
+    static std::size_t EstimateMemoryUsage(const Entry& entry);
+
+public:
+    TxIndexWriteCache() {}
+
+    TxIndexWriteCache(const TxIndexWriteCache&) = delete;
+    TxIndexWriteCache& operator=(const TxIndexWriteCache&) = delete;
+
+    /// the size (in bytes) at which the cache is considered full; zero disables the cache
+    void        setMaxMemoryUsage(std::size_t bytes);
+    std::size_t getMaxMemoryUsage() const;
+
+    /// new db transactions cache their tx index writes only while this is on (and the cache is enabled)
+    void setCachingWrites(bool value);
+    bool isCachingWrites() const;
+
+    /// returns none if the tx isn't in the cache, and a none entry if its tx index was erased
+    boost::optional<Entry> get(const uint256& txHash) const;
+
+    void apply(const PendingChanges& changes);
+
+    /// returns all the entries, sorted by key, which is the friendly order to write them to lmdb
+    std::map<uint256, Entry> getAll() const;
+
+    void clear();
+
+    bool        empty() const;
+    std::size_t size() const;
+    std::size_t getMemoryUsage() const;
+    bool        isFull() const;
+};
+
+#endif // TXINDEXWRITECACHE_H
@@ -1102,6 +1102,26 @@ void RenameThread(const char* name)
 #endif
 }
 
+int RaiseFileDescriptorLimit(int nMinFD)
+{
+#if defined(WIN32)
+    return 2048;
+#else
+    struct rlimit limitFD;
+    if (getrlimit(RLIMIT_NOFILE, &limitFD) != -1) {
+        if (limitFD.rlim_cur < (rlim_t)nMinFD) {
+            limitFD.rlim_cur = nMinFD;
+            if (limitFD.rlim_cur > limitFD.rlim_max)
+                limitFD.rlim_cur = limitFD.rlim_max;
+            setrlimit(RLIMIT_NOFILE, &limitFD);
+            getrlimit(RLIMIT_NOFILE, &limitFD);
+        }
+        return static_cast<int>(limitFD.rlim_cur);
+    }
+    return nMinFD; // getrlimit failed, assume it's fine
+#endif
+}
+
 string GeneratePseudoRandomString(const int len)
 {
     static const char alphanum[] = "0123456789"
@@ -551,6 +551,9 @@ inline void ExitThread(size_t nExitCode) { pthread_exit((void*)nExitCode); }
 
 void RenameThread(const char* name);
 
+/** tries to raise the limit of open file descriptors to nMinFD; returns the resulting limit */
+int RaiseFileDescriptorLimit(int nMinFD);
+
 inline uint32_t ByteReverse(uint32_t value)
 {
     value = ((value & 0xFF00FF00) >> 8) | ((value & 0x00FF00FF) << 8);
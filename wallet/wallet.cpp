@@ -7,6 +7,7 @@
 #include "base58.h"
 #include "block.h"
 #include "coincontrol.h"
+#include "coinselection.h"
 #include "crypter.h"
 #include "kernel.h"
 #include "main.h"
@@ -28,15 +29,6 @@ const boost::filesystem::path CWallet::BackupHashFilename = "wallet-hash.txt";
 // mapWallet
 //
 
-struct CompareValueOnly
-{
-    bool operator()(const pair<CAmount, pair<const CWalletTx*, unsigned int>>& t1,
-                    const pair<CAmount, pair<const CWalletTx*, unsigned int>>& t2) const
-    {
-        return t1.first < t2.first;
-    }
-};
-
 CBitcoinAddress CWallet::getNewAddress(const std::string& label)
 {
     return getNewAddress(label, AddressBook::AddressBookPurpose::RECEIVE);
@@ -105,6 +97,7 @@ bool CWallet::AddKey(const CKey& key)
 
     if (!CCryptoKeyStore::AddKey(key))
         return false;
+    scriptFilter.addKey(pubkey.GetID());
     if (!fFileBacked)
         return true;
     if (!IsCrypted())
@@ -117,6 +110,7 @@ bool CWallet::AddCryptedKey(const CPubKey& vchPubKey, const vector<unsigned char
 {
     if (!CCryptoKeyStore::AddCryptedKey(vchPubKey, vchCryptedSecret))
         return false;
+    scriptFilter.addKey(vchPubKey.GetID());
     if (!fFileBacked)
         return true;
     {
@@ -131,6 +125,14 @@ bool CWallet::AddCryptedKey(const CPubKey& vchPubKey, const vector<unsigned char
     return false;
 }
 
+bool CWallet::LoadKey(const CKey& key)
+{
+    if (!CCryptoKeyStore::AddKey(key))
+        return false;
+    scriptFilter.addKey(key.GetPubKey().GetID());
+    return true;
+}
+
 bool CWallet::LoadKeyMetadata(const CPubKey& pubkey, const CKeyMetadata& meta)
 {
     AssertLockHeld(cs_wallet); // mapKeyMetadata
@@ -152,18 +154,39 @@ bool CWallet::LoadMinVersion(int nVersion)
 bool CWallet::LoadCryptedKey(const CPubKey&                    vchPubKey,
                              const std::vector<unsigned char>& vchCryptedSecret)
 {
-    return CCryptoKeyStore::AddCryptedKey(vchPubKey, vchCryptedSecret);
+    if (!CCryptoKeyStore::AddCryptedKey(vchPubKey, vchCryptedSecret))
+        return false;
+    scriptFilter.addKey(vchPubKey.GetID());
+    return true;
 }
 
 bool CWallet::AddCScript(const CScript& redeemScript)
 {
     if (!CCryptoKeyStore::AddCScript(redeemScript))
         return false;
+    scriptFilter.addScript(redeemScript.GetID());
+    {
+        // outputs to the script are ours now
+        LOCK(cs_wallet);
+        unspentIndex.invalidate();
+    }
     if (!fFileBacked)
         return true;
     return CWalletDB(strWalletFile).WriteCScript(Hash160(redeemScript), redeemScript);
 }
 
+std::unique_ptr<KeyStoreSnapshot> CWallet::GetKeyStoreSnapshot() const
+{
+    std::set<CKeyID> keys;
+    GetKeys(keys);
+    ScriptMap scripts;
+    {
+        LOCK(cs_KeyStore);
+        scripts = mapScripts;
+    }
+    return MakeUnique<KeyStoreSnapshot>(std::move(keys), std::move(scripts));
+}
+
 // optional setting to unlock wallet for staking only
 // serves to disable the trivial sendmoney when OS account compromised
 // provides no real security
@@ -183,7 +206,10 @@ bool CWallet::LoadCScript(const CScript& redeemScript)
         return true;
     }
 
-    return CCryptoKeyStore::AddCScript(redeemScript);
+    if (!CCryptoKeyStore::AddCScript(redeemScript))
+        return false;
+    scriptFilter.addScript(redeemScript.GetID());
+    return true;
 }
 
 bool CWallet::Unlock(const SecureString& strWalletPassphrase)
@@ -268,6 +294,13 @@ bool CWallet::ChangeWalletPassphrase(const SecureString& strOldWalletPassphrase,
     return false;
 }
 
+void CWallet::BlockConnected(const uint256& blockHash, int height)
+{
+    blockHeights.blockConnected(blockHash, height);
+}
+
+void CWallet::BlockDisconnected(const uint256& blockHash) { blockHeights.blockDisconnected(blockHash); }
+
 void CWallet::SetBestChain(const CBlockLocator& loc)
 {
     CWalletDB walletdb(strWalletFile);
@@ -447,6 +480,8 @@ void CWallet::MarkDirty()
         LOCK(cs_wallet);
         for (PAIRTYPE(const uint256, CWalletTx) & item : mapWallet)
             item.second.MarkDirty();
+        // what's mine may have changed
+        unspentIndex.invalidate();
     }
 }
 
@@ -594,6 +629,7 @@ void CWallet::MarkConflicted(const ITxDB& txdb, const uint256& hashBlock, const
             wtx.hashBlock = hashBlock;
             wtx.MarkDirty();
             wtx.WriteToDisk(&walletdb);
+            UpdateUnspentIndex(txdb, wtx);
             // Iterate over all its outputs, and mark transactions in the wallet that spend them
             // conflicted too
             auto                     txSpends = mapTxSpends.get();
@@ -655,6 +691,7 @@ bool CWallet::AddToWallet(const ITxDB& txdb, const CWalletTx& wtxIn, bool fFromL
         wtx.BindWallet(this);
         wtxOrdered.insert(std::make_pair(wtx.nOrderPos, TxPair(&wtx, (CAccountingEntry*)0)));
         AddToSpends(hash);
+        unspentIndex.invalidate();
     } else {
 
         LOCK(cs_wallet);
@@ -719,6 +756,7 @@ bool CWallet::AddToWallet(const ITxDB& txdb, const CWalletTx& wtxIn, bool fFromL
 
         // Break debit/credit balance caches:
         wtx.MarkDirty();
+        UpdateUnspentIndex(txdb, wtx);
 
         // Notify UI of new or updated transaction
         NotifyTransactionChanged(this, hash, fInsertedNew ? CT_NEW : CT_UPDATED);
@@ -791,8 +829,10 @@ bool CWallet::EraseFromWallet(uint256 hash)
         return false;
     {
         LOCK(cs_wallet);
-        if (mapWallet.erase(hash))
+        if (mapWallet.erase(hash)) {
             CWalletDB(strWalletFile).EraseTx(hash);
+            unspentIndex.invalidate();
+        }
     }
     return true;
 }
@@ -826,7 +866,13 @@ CAmount CWallet::GetDebit(const CTxIn& txin, const isminefilter& filter) const
     return 0;
 }
 
-isminetype CWallet::IsMine(const CTxOut& txout) const { return ::IsMine(*this, txout.scriptPubKey); }
+isminetype CWallet::IsMine(const CTxOut& txout) const
+{
+    if (!scriptFilter.mayBeMine(txout.scriptPubKey)) {
+        return ISMINE_NO;
+    }
+    return ::IsMine(*this, txout.scriptPubKey);
+}
 
 CAmount CWallet::GetCredit(const CTxOut& txout, const isminefilter& filter) const
 {
@@ -1078,8 +1124,6 @@ int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate)
 
     assert(pindexStart);
 
-    boost::optional<CBlockIndex> pindex = *pindexStart;
-
     uint64_t blockCount = pindexStart->nHeight;
 
     const auto calculateProgress = [](int blockHeight, int maxHeight) -> double {
@@ -1104,34 +1148,77 @@ int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate)
         BOOST_SCOPE_EXIT_END
         NLog.write(b_sev::info, "Starting wallet rescan of {} blocks...", bestHeight);
         uiInterface.WalletBlockchainRescanAtHeight(0);
-        while (pindex) {
-            if (blockCount % 1000 == 0) {
-                const double progressNow = calculateProgress(pindex->nHeight, bestHeight);
-                uiInterface.WalletBlockchainRescanAtHeight(progressNow);
-                uiInterface.InitMessage(
-                    _("Rescanning blocks for wallet: ") + std::to_string(blockCount) + "/" +
-                        std::to_string(bestHeight),
-                    static_cast<double>(blockCount) / static_cast<double>(bestHeight));
-                NLog.write(b_sev::info, "Done scanning {}/{} blocks", blockCount, bestHeight);
+
+        // no need to read and scan blocks that were created before our wallet birthday (as adjusted
+        // for block time variability)
+        const int64_t timeFirstKey = nTimeFirstKey;
+
+        const WalletRescanner::ReadBlockFunc readBlock = [timeFirstKey](int height) {
+            const CTxDB                    workerTxdb;
+            const boost::optional<uint256> blockHash = workerTxdb.ReadBlockHashOfHeight(height);
+            if (!blockHash) {
+                NLog.write(b_sev::err, "Wallet rescan: failed to read the block hash of height {}",
+                           height);
+                return boost::optional<CBlock>();
             }
+            const boost::optional<CBlockIndex> blockIndex = workerTxdb.ReadBlockIndex(*blockHash);
+            if (!blockIndex) {
+                NLog.write(b_sev::err, "Wallet rescan: failed to read the block index of block {}",
+                           blockHash->ToString());
+                return boost::optional<CBlock>();
+            }
+            if (timeFirstKey && (blockIndex->nTime < (timeFirstKey - 7200))) {
+                return boost::optional<CBlock>();
+            }
+            CBlock block;
+            block.ReadFromDisk(&*blockIndex, workerTxdb, true);
+            return boost::make_optional(std::move(block));
+        };
+
+        // the transactions found are written in one database transaction every 1000 blocks
+        std::unique_ptr<CWalletDBBatch> walletBatch = MakeUnique<CWalletDBBatch>(*this, false);
+
+        const WalletRescanner::CommitBlockFunc commitBlock =
+            [&](const WalletRescanner::ScannedBlock& scanned) {
+                if (blockCount % 1000 == 0) {
+                    walletBatch->Commit();
+                    const double progressNow = calculateProgress(scanned.height, bestHeight);
+                    uiInterface.WalletBlockchainRescanAtHeight(progressNow);
+                    uiInterface.InitMessage(
+                        _("Rescanning blocks for wallet: ") + std::to_string(blockCount) + "/" +
+                            std::to_string(bestHeight),
+                        static_cast<double>(blockCount) / static_cast<double>(bestHeight));
+                    NLog.write(b_sev::info, "Done scanning {}/{} blocks", blockCount, bestHeight);
+                }
 
-            blockCount++;
+                blockCount++;
 
-            // no need to read and scan block, if block was created before
-            // our wallet birthday (as adjusted for block time variability)
-            if (nTimeFirstKey && (pindex->nTime < (nTimeFirstKey - 7200))) {
-                pindex = pindex->getNext(txdb);
-                continue;
-            } else {
-                CBlock block;
-                block.ReadFromDisk(&*pindex, txdb, true);
-                for (CTransaction& tx : block.vtx) {
+                if (!scanned.block) {
+                    return;
+                }
+                const CBlock& block = *scanned.block;
+                for (unsigned i = 0; i < block.vtx.size(); i++) {
+                    const CTransaction& tx = block.vtx[i];
+                    // without outputs of the wallet, only the inputs can make it relevant
+                    if (!scanned.txsWithMyOutputs[i] && !IsLinkedToWallet(tx)) {
+                        continue;
+                    }
                     if (AddToWalletIfInvolvingMe(txdb, tx, &block, fUpdate, true))
                         ret++;
                 }
-                pindex = pindex->getNext(txdb);
-            }
-        }
+            };
+
+        // the keys don't change while cs_wallet is held
+        const std::unique_ptr<KeyStoreSnapshot> keys = GetKeyStoreSnapshot();
+        const WalletRescanner                   rescanner(*keys, rescanThreads, &scriptFilter);
+
+        const int64_t startTime = GetTimeMillis();
+        const int     workers =
+            rescanner.run(pindexStart->nHeight, bestHeight, readBlock, commitBlock);
+        NLog.write(b_sev::info, "Wallet rescan of {} blocks took {} ms with {} worker threads",
+                   blockCount - pindexStart->nHeight, GetTimeMillis() - startTime, workers);
+        walletBatch.reset();
+
         uiInterface.InitMessage(_("Updating wallet on disk (do not shutdown)..."), 0.5);
         FlushWalletDB(true, strWalletFile, nullptr);
         uiInterface.InitMessage(_("Rescanning... ") + "(done)", 1);
@@ -1140,6 +1227,26 @@ int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate)
     return ret;
 }
 
+void CWallet::SetRescanThreads(int threads) { rescanThreads = std::max(1, threads); }
+
+int CWallet::GetRescanThreads() const { return rescanThreads; }
+
+bool CWallet::IsLinkedToWallet(const CTransaction& tx) const
+{
+    LOCK(cs_wallet);
+    if (mapWallet.count(tx.GetHash())) {
+        return true;
+    }
+    auto            lock     = mapTxSpends.get_lock();
+    const TxSpends& txSpends = mapTxSpends.get_unsafe();
+    for (const CTxIn& txin : tx.vin) {
+        if (mapWallet.count(txin.prevout.hash) || txSpends.count(txin.prevout)) {
+            return true;
+        }
+    }
+    return false;
+}
+
 void CWallet::ReacceptWalletTransactions(const ITxDB& txdb, bool fFirstLoad)
 {
     LOCK2(cs_main, cs_wallet);
@@ -1237,35 +1344,14 @@ void CWallet::ResendWalletTransactions(const ITxDB& txdb, bool fForce)
 
 CAmount CWallet::GetBalance(const ITxDB& txdb) const
 {
-    CAmount       nTotal        = 0;
-    const uint256 bestBlockHash = txdb.GetBestBlockHash();
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end();
-             ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-            if (pcoin->IsTrusted(txdb, bestBlockHash)) {
-                nTotal += pcoin->GetAvailableCredit(bestBlockHash, txdb);
-            }
-        }
-    }
-
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetBalances(txdb).balance;
 }
 
 CAmount CWallet::GetColdStakingBalance(const ITxDB& txdb) const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        const uint256 bestBlockHash = txdb.GetBestBlockHash();
-        for (const auto& p : mapWallet) {
-            const CWalletTx& pcoin = p.second;
-            if (pcoin.HasP2CSOutputs() && pcoin.IsTrusted(txdb, bestBlockHash))
-                nTotal += pcoin.GetColdStakingCredit(bestBlockHash, txdb);
-        }
-    }
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetBalances(txdb).coldStaking;
 }
 
 CAmount CWallet::GetStakingBalance(const ITxDB& txdb, const bool fIncludeColdStaking) const
@@ -1277,33 +1363,14 @@ CAmount CWallet::GetStakingBalance(const ITxDB& txdb, const bool fIncludeColdSta
 
 CAmount CWallet::GetDelegatedBalance(const ITxDB& txdb) const
 {
-    CAmount       nTotal        = 0;
-    const uint256 bestBlockHash = txdb.GetBestBlockHash();
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (const auto& p : mapWallet) {
-            const CWalletTx& pcoin = p.second;
-            if (pcoin.HasP2CSOutputs() && pcoin.IsTrusted(txdb, bestBlockHash))
-                nTotal += pcoin.GetStakeDelegationCredit(bestBlockHash, txdb);
-        }
-    }
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetBalances(txdb).delegated;
 }
 
 CAmount CWallet::GetUnconfirmedBalance(const ITxDB& txdb) const
 {
-    CAmount       nTotal        = 0;
-    const uint256 bestBlockHash = txdb.GetBestBlockHash();
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (const auto& p : mapWallet) {
-            const CWalletTx& pcoin = p.second;
-            if (!pcoin.IsTrusted(txdb, bestBlockHash) &&
-                pcoin.GetDepthInMainChain(txdb, bestBlockHash) == 0 && pcoin.InMempool())
-                nTotal += pcoin.GetAvailableCredit(bestBlockHash, txdb);
-        }
-    }
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetBalances(txdb).unconfirmed;
 }
 
 CAmount CWallet::GetImmatureColdStakingBalance(const ITxDB& txdb) const
@@ -1361,9 +1428,11 @@ void CWallet::AvailableCoins(const ITxDB& txdb, vector<COutput>& vCoins, bool fO
     {
         const uint256 bestBlockHash = txdb.GetBestBlockHash();
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end();
-             ++it) {
-            const CWalletTx* pcoin = &(*it).second;
+        for (const uint256& wtxid : GetUnspentIndexTxs(txdb, bestBlockHash)) {
+            const auto it = mapWallet.find(wtxid);
+            if (it == mapWallet.cend())
+                continue;
+            const CWalletTx* pcoin = &it->second;
 
             if (!IsFinalTx(*pcoin, txdb))
                 continue;
@@ -1395,8 +1464,7 @@ void CWallet::AvailableCoins(const ITxDB& txdb, vector<COutput>& vCoins, bool fO
                 if (IsSpent(pcoin->GetHash(), i, txdb, bestBlockHash))
                     continue;
 
-                if (!(!coinControl || !coinControl->HasSelected() ||
-                      coinControl->IsSelected((*it).first, i)))
+                if (!(!coinControl || !coinControl->HasSelected() || coinControl->IsSelected(wtxid, i)))
                     continue;
 
                 // --Skip P2CS outputs
@@ -1440,9 +1508,11 @@ bool CWallet::GetAvailableP2CSCoins(const ITxDB& txdb, std::vector<COutput>& vCo
             return false;
         }
 
-        for (const auto& it : mapWallet) {
-            const uint256&   wtxid = it.first;
-            const CWalletTx* pcoin = &it.second;
+        for (const uint256& wtxid : GetUnspentIndexTxs(txdb, bestBlockHash)) {
+            const auto it = mapWallet.find(wtxid);
+            if (it == mapWallet.cend())
+                continue;
+            const CWalletTx* pcoin = &it->second;
 
             bool fConflicted;
             int  nDepth = pcoin->GetDepthAndMempool(fConflicted, txdb, bestBlockHash);
@@ -1482,9 +1552,11 @@ void CWallet::AvailableCoinsForStaking(const ITxDB& txdb, vector<COutput>& vCoin
 
         LOCK2(cs_main, cs_wallet);
         unsigned int nSMA = Params().StakeMinAge(txdb);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end();
-             ++it) {
-            const CWalletTx* pcoin = &(*it).second;
+        for (const uint256& wtxid : GetUnspentIndexTxs(txdb, bestBlockHash)) {
+            const auto it = mapWallet.find(wtxid);
+            if (it == mapWallet.cend())
+                continue;
+            const CWalletTx* pcoin = &it->second;
 
             // Filtering by tx timestamp instead of block timestamp may give false positives but never
             // false negatives
@@ -1561,47 +1633,6 @@ void CWallet::AvailableCoinsForStaking(const ITxDB& txdb, vector<COutput>& vCoin
     }
 }
 
-static void ApproximateBestSubset(vector<pair<CAmount, pair<const CWalletTx*, unsigned int>>> vValue,
-                                  CAmount nTotalLower, CAmount nTargetValue, vector<char>& vfBest,
-                                  CAmount& nBest, int iterations = 1000)
-{
-    vector<char> vfIncluded;
-
-    vfBest.assign(vValue.size(), true);
-    nBest = nTotalLower;
-
-    seed_insecure_rand();
-
-    for (int nRep = 0; nRep < iterations && nBest != nTargetValue; nRep++) {
-        vfIncluded.assign(vValue.size(), false);
-        CAmount nTotal         = 0;
-        bool    fReachedTarget = false;
-        for (int nPass = 0; nPass < 2 && !fReachedTarget; nPass++) {
-            for (unsigned int i = 0; i < vValue.size(); i++) {
-                // The solver here uses a randomized algorithm,
-                // the randomness serves no real security purpose but is just
-                // needed to prevent degenerate behavior and it is important
-                // that the rng fast. We do not use a constant random sequence,
-                // because there may be some privacy improvement by making
-                // the selection random.
-                if (nPass == 0 ? insecure_rand() & 1 : !vfIncluded[i]) {
-                    nTotal += vValue[i].first;
-                    vfIncluded[i] = true;
-                    if (nTotal >= nTargetValue) {
-                        fReachedTarget = true;
-                        if (nTotal < nBest) {
-                            nBest  = nTotal;
-                            vfBest = vfIncluded;
-                        }
-                        nTotal -= vValue[i].first;
-                        vfIncluded[i] = false;
-                    }
-                }
-            }
-        }
-    }
-}
-
 // ppcoin: total coins staked (non-spendable until maturity)
 CAmount CWallet::GetStake(const ITxDB& txdb) const
 {
@@ -1645,29 +1676,16 @@ bool CWallet::AddAccountingEntry(const CAccountingEntry& acentry, CWalletDB& pwa
     return true;
 }
 
-bool CWallet::SelectCoinsMinConf(const ITxDB& txdb, CAmount nTargetValue, unsigned int nSpendTime,
-                                 int nConfMine, int nConfTheirs, vector<COutput> vCoins,
-                                 set<pair<const CWalletTx*, unsigned int>>& setCoinsRet,
-                                 CAmount& nValueRet, bool avoidNTP1Outputs)
+CoinSelectionIndex CWallet::MakeCoinSelectionIndex(const ITxDB& txdb, std::vector<COutput> vCoins,
+                                                   unsigned int nSpendTime, bool avoidNTP1Outputs)
 {
-    setCoinsRet.clear();
-    nValueRet = 0;
-
-    // List of values less than target
-    pair<CAmount, pair<const CWalletTx*, unsigned int>> coinLowestLarger;
-    coinLowestLarger.first        = std::numeric_limits<CAmount>::max();
-    coinLowestLarger.second.first = nullptr;
-    vector<pair<CAmount, pair<const CWalletTx*, unsigned int>>> vValue;
-    CAmount                                                     nTotalLower = 0;
+    CoinSelectionIndex index;
 
     random_shuffle(vCoins.begin(), vCoins.end(), GetRandInt);
 
-    for (COutput output : vCoins) {
+    for (const COutput& output : vCoins) {
         const CWalletTx* pcoin = output.tx;
 
-        if (output.nDepth < (pcoin->IsFromMe(ISMINE_ALL) ? nConfMine : nConfTheirs))
-            continue;
-
         int i = output.i;
 
         if (avoidNTP1Outputs) {
@@ -1710,69 +1728,26 @@ bool CWallet::SelectCoinsMinConf(const ITxDB& txdb, CAmount nTargetValue, unsign
             continue;
         }
 
-        pair<CAmount, pair<const CWalletTx*, unsigned int>> coin = make_pair(n, make_pair(pcoin, i));
-
-        if (n == nTargetValue) {
-            setCoinsRet.insert(coin.second);
-            nValueRet += coin.first;
-            return true;
-        } else if (n < nTargetValue + CENT) {
-            vValue.push_back(coin);
-            nTotalLower += n;
-        } else if (n < coinLowestLarger.first) {
-            coinLowestLarger = coin;
-        }
-    }
-
-    if (nTotalLower == nTargetValue) {
-        for (unsigned int i = 0; i < vValue.size(); ++i) {
-            setCoinsRet.insert(vValue[i].second);
-            nValueRet += vValue[i].first;
-        }
-        return true;
-    }
-
-    if (nTotalLower < nTargetValue) {
-        if (coinLowestLarger.second.first == NULL)
-            return false;
-        setCoinsRet.insert(coinLowestLarger.second);
-        nValueRet += coinLowestLarger.first;
-        return true;
+        CoinSelectionIndex::Coin coin;
+        coin.value  = n;
+        coin.tx     = pcoin;
+        coin.i      = i;
+        coin.depth  = output.nDepth;
+        coin.fromMe = pcoin->IsFromMe(ISMINE_ALL);
+        index.add(coin);
     }
 
-    // Solve subset sum by stochastic approximation
-    sort(vValue.rbegin(), vValue.rend(), CompareValueOnly());
-    vector<char> vfBest;
-    CAmount      nBest;
-
-    ApproximateBestSubset(vValue, nTotalLower, nTargetValue, vfBest, nBest, 1000);
-    if (nBest != nTargetValue && nTotalLower >= nTargetValue + CENT)
-        ApproximateBestSubset(vValue, nTotalLower, nTargetValue + CENT, vfBest, nBest, 1000);
-
-    // If we have a bigger coin and (either the stochastic approximation didn't find a good solution,
-    //                                   or the next bigger coin is closer), return the bigger coin
-    if (coinLowestLarger.second.first &&
-        ((nBest != nTargetValue && nBest < nTargetValue + CENT) || coinLowestLarger.first <= nBest)) {
-        setCoinsRet.insert(coinLowestLarger.second);
-        nValueRet += coinLowestLarger.first;
-    } else {
-        for (unsigned int i = 0; i < vValue.size(); i++)
-            if (vfBest[i]) {
-                setCoinsRet.insert(vValue[i].second);
-                nValueRet += vValue[i].first;
-            }
-
-        if (fDebug) {
-            //// debug print
-            NLog.write(b_sev::debug, "SelectCoins() best subset: ");
-            for (unsigned int i = 0; i < vValue.size(); i++)
-                if (vfBest[i])
-                    NLog.write(b_sev::debug, "{} ", FormatMoney(vValue[i].first));
-            NLog.write(b_sev::debug, "total {}", FormatMoney(nBest));
-        }
-    }
+    return index;
+}
 
-    return true;
+bool CWallet::SelectCoinsMinConf(const ITxDB& txdb, CAmount nTargetValue, unsigned int nSpendTime,
+                                 int nConfMine, int nConfTheirs, vector<COutput> vCoins,
+                                 set<pair<const CWalletTx*, unsigned int>>& setCoinsRet,
+                                 CAmount& nValueRet, bool avoidNTP1Outputs)
+{
+    const CoinSelectionIndex index =
+        MakeCoinSelectionIndex(txdb, std::move(vCoins), nSpendTime, avoidNTP1Outputs);
+    return SelectCoinsFromIndex(index, nTargetValue, nConfMine, nConfTheirs, setCoinsRet, nValueRet);
 }
 
 /**
@@ -1804,6 +1779,173 @@ bool CWallet::IsSpent(const uint256& hash, unsigned int n, const ITxDB& txdb,
     return false;
 }
 
+WalletUnspentIndex::TxState CWallet::GetUnspentIndexState(const ITxDB& txdb, const CWalletTx& wtx,
+                                                          const uint256& bestBlockHash,
+                                                          bool&          spentByUnconfirmed) const
+{
+    const uint256 hash = wtx.GetHash();
+
+    auto            lock     = mapTxSpends.get_lock();
+    const TxSpends& txSpends = mapTxSpends.get_unsafe();
+
+    bool unspent       = false;
+    spentByUnconfirmed = false;
+    for (unsigned int i = 0; i < wtx.vout.size(); i++) {
+        if (IsMine(wtx.vout[i]) == ISMINE_NO)
+            continue;
+
+        bool outputSpentByConfirmed   = false;
+        bool outputSpentByUnconfirmed = false;
+
+        const auto range = txSpends.equal_range(COutPoint(hash, i));
+        for (TxSpends::const_iterator it = range.first; it != range.second; ++it) {
+            const auto mit = mapWallet.find(it->second);
+            if (mit == mapWallet.cend())
+                continue;
+            const int nDepth = mit->second.GetDepthInMainChain(txdb, bestBlockHash);
+            if (nDepth > 0) {
+                outputSpentByConfirmed = true;
+                break;
+            }
+            if (nDepth == 0) {
+                outputSpentByUnconfirmed = true;
+            }
+        }
+        if (outputSpentByConfirmed)
+            continue;
+        if (outputSpentByUnconfirmed) {
+            spentByUnconfirmed = true;
+        } else {
+            unspent = true;
+        }
+    }
+    if (unspent)
+        return WalletUnspentIndex::TxState::Unspent;
+    return spentByUnconfirmed ? WalletUnspentIndex::TxState::PendingSpent
+                              : WalletUnspentIndex::TxState::Spent;
+}
+
+WalletUnspentIndex::Balances CWallet::GetUnspentIndexTxBalances(const ITxDB& txdb, const CWalletTx& wtx,
+                                                                const uint256& bestBlockHash,
+                                                                bool&          isVolatile) const
+{
+    // a transaction in the mempool is final, and stays so, so only the best block and the mempool
+    // change the balances of a transaction that is unconfirmed or immature
+    const int nDepth = wtx.GetDepthInMainChain(txdb, bestBlockHash);
+    isVolatile       = nDepth <= 0 || wtx.GetBlocksToMaturity(txdb, bestBlockHash) > 0;
+
+    WalletUnspentIndex::Balances result;
+    if (wtx.IsTrusted(txdb, bestBlockHash)) {
+        result.balance = wtx.GetAvailableCredit(bestBlockHash, txdb);
+        if (wtx.HasP2CSOutputs()) {
+            result.coldStaking = wtx.GetColdStakingCredit(bestBlockHash, txdb);
+            result.delegated   = wtx.GetStakeDelegationCredit(bestBlockHash, txdb);
+        }
+    } else if (nDepth == 0 && wtx.InMempool()) {
+        result.unconfirmed = wtx.GetAvailableCredit(bestBlockHash, txdb);
+    }
+    return result;
+}
+
+void CWallet::UpdateUnspentIndexTx(const ITxDB& txdb, const CWalletTx& wtx,
+                                   const uint256& bestBlockHash) const
+{
+    const uint256                     hash               = wtx.GetHash();
+    bool                              spentByUnconfirmed = false;
+    const WalletUnspentIndex::TxState state =
+        GetUnspentIndexState(txdb, wtx, bestBlockHash, spentByUnconfirmed);
+    unspentIndex.update(hash, state);
+    if (state == WalletUnspentIndex::TxState::Spent)
+        return;
+
+    bool                               isVolatile = false;
+    const WalletUnspentIndex::Balances balances =
+        GetUnspentIndexTxBalances(txdb, wtx, bestBlockHash, isVolatile);
+    // the unconfirmed spenders may leave the mempool
+    unspentIndex.setTxBalances(hash, balances, isVolatile || spentByUnconfirmed);
+}
+
+void CWallet::UpdateUnspentIndexTx(const ITxDB& txdb, const uint256& hash,
+                                   const uint256& bestBlockHash) const
+{
+    const auto it = mapWallet.find(hash);
+    if (it == mapWallet.cend()) {
+        unspentIndex.update(hash, WalletUnspentIndex::TxState::Spent);
+        return;
+    }
+    UpdateUnspentIndexTx(txdb, it->second, bestBlockHash);
+}
+
+bool CWallet::SyncUnspentIndexTip(const ITxDB& txdb, const uint256& bestBlockHash) const
+{
+    const WalletUnspentIndex::TipChange change =
+        unspentIndex.setTip(txdb, bestBlockHash, txdb.GetBestChainHeight().value_or(0));
+    if (change == WalletUnspentIndex::TipChange::Extended && unspentIndex.isValid()) {
+        // the new blocks may have confirmed the spenders of pending transactions
+        const std::set<uint256> pendingTxs = unspentIndex.getPendingTxs();
+        for (const uint256& h : pendingTxs) {
+            UpdateUnspentIndexTx(txdb, h, bestBlockHash);
+        }
+    }
+    return unspentIndex.isValid();
+}
+
+void CWallet::UpdateUnspentIndex(const ITxDB& txdb, const CTransaction& tx) const
+{
+    AssertLockHeld(cs_wallet);
+
+    if (!unspentIndex.isValid()) {
+        // it'll be built from scratch on its next use
+        return;
+    }
+
+    const uint256 bestBlockHash = txdb.GetBestBlockHash();
+    if (!SyncUnspentIndexTip(txdb, bestBlockHash)) {
+        return;
+    }
+
+    UpdateUnspentIndexTx(txdb, tx.GetHash(), bestBlockHash);
+    for (const CTxIn& txin : tx.vin) {
+        if (mapWallet.count(txin.prevout.hash)) {
+            UpdateUnspentIndexTx(txdb, txin.prevout.hash, bestBlockHash);
+        }
+    }
+}
+
+const std::set<uint256>& CWallet::GetUnspentIndexTxs(const ITxDB&   txdb,
+                                                     const uint256& bestBlockHash) const
+{
+    AssertLockHeld(cs_wallet);
+
+    if (!SyncUnspentIndexTip(txdb, bestBlockHash)) {
+        unspentIndex.invalidate();
+        for (const auto& p : mapWallet) {
+            UpdateUnspentIndexTx(txdb, p.second, bestBlockHash);
+        }
+        unspentIndex.setValid();
+    }
+    return unspentIndex.getTxs();
+}
+
+WalletUnspentIndex::Balances CWallet::GetBalances(const ITxDB& txdb) const
+{
+    AssertLockHeld(cs_wallet);
+
+    const uint256  bestBlockHash  = txdb.GetBestBlockHash();
+    const uint32_t mempoolVersion = nTransactionsUpdated;
+    GetUnspentIndexTxs(txdb, bestBlockHash);
+
+    // the totals are kept up to date with the transactions, except for the volatile ones
+    if (const boost::optional<std::set<uint256>> staleTxs =
+            unspentIndex.getStaleVolatileTxs(bestBlockHash, mempoolVersion)) {
+        for (const uint256& hash : *staleTxs) {
+            UpdateUnspentIndexTx(txdb, hash, bestBlockHash);
+        }
+        unspentIndex.setVolatileTxsUpdated(bestBlockHash, mempoolVersion);
+    }
+    return unspentIndex.getTotals();
+}
+
 bool CWallet::SelectCoins(const ITxDB& txdb, CAmount nTargetValue, unsigned int nSpendTime,
                           set<pair<const CWalletTx*, unsigned int>>& setCoinsRet, CAmount& nValueRet,
                           const CCoinControl* coinControl, bool fIncludeColdStaking,
@@ -1822,12 +1964,13 @@ bool CWallet::SelectCoins(const ITxDB& txdb, CAmount nTargetValue, unsigned int
         return (nValueRet >= nTargetValue);
     }
 
-    return (SelectCoinsMinConf(txdb, nTargetValue, nSpendTime, 1, 10, vCoins, setCoinsRet, nValueRet,
-                               avoidNTP1Outputs) ||
-            SelectCoinsMinConf(txdb, nTargetValue, nSpendTime, 1, 1, vCoins, setCoinsRet, nValueRet,
-                               avoidNTP1Outputs) ||
-            SelectCoinsMinConf(txdb, nTargetValue, nSpendTime, 0, 1, vCoins, setCoinsRet, nValueRet,
-                               avoidNTP1Outputs));
+    // the index is the same for all the tries with less confirmations
+    const CoinSelectionIndex index =
+        MakeCoinSelectionIndex(txdb, std::move(vCoins), nSpendTime, avoidNTP1Outputs);
+
+    return (SelectCoinsFromIndex(index, nTargetValue, 1, 10, setCoinsRet, nValueRet) ||
+            SelectCoinsFromIndex(index, nTargetValue, 1, 1, setCoinsRet, nValueRet) ||
+            SelectCoinsFromIndex(index, nTargetValue, 0, 1, setCoinsRet, nValueRet));
 }
 
 // Select some coins without random shuffle or best subset approximation
@@ -2679,6 +2822,12 @@ DBErrors CWallet::LoadWallet(bool& fFirstRunRet)
     if (nLoadWalletRet != DB_LOAD_OK)
         return nLoadWalletRet;
 
+    {
+        // the transactions were loaded straight into mapWallet
+        LOCK(cs_wallet);
+        unspentIndex.invalidate();
+    }
+
     NewThread(ThreadFlushWalletDB, strWalletFile);
     return DB_LOAD_OK;
 }
@@ -2818,7 +2967,9 @@ bool CWallet::NewKeyPool()
 {
     {
         LOCK(cs_wallet);
-        CWalletDB walletdb(strWalletFile);
+        // all the keys are written in one transaction
+        CWalletDBBatch batch(*this);
+        CWalletDB      walletdb(strWalletFile);
         for (int64_t nIndex : setKeyPool)
             walletdb.ErasePool(nIndex);
         setKeyPool.clear();
@@ -2845,7 +2996,9 @@ bool CWallet::TopUpKeyPool(unsigned int nSize)
         if (IsLocked())
             return false;
 
-        CWalletDB walletdb(strWalletFile);
+        // all the keys are written in one transaction
+        CWalletDBBatch batch(*this);
+        CWalletDB      walletdb(strWalletFile);
 
         // Top up key pool
         unsigned int nTargetSize;
@@ -3109,6 +3262,16 @@ void CWallet::SyncTransaction(const ITxDB& txdb, const CTransaction& tx, const C
     }
 }
 
+CWalletDBBatch::CWalletDBBatch(CWallet& wallet, bool fFlushOnCommit)
+    : walletLock(wallet.cs_wallet, "cs_wallet", __FILE__, __LINE__)
+{
+    if (wallet.fFileBacked) {
+        batch = MakeUnique<CDBBatch>(wallet.strWalletFile, fFlushOnCommit);
+    }
+}
+
+bool CWalletDBBatch::Commit() { return batch && batch->Commit(); }
+
 bool CReserveKey::GetReservedKey(CPubKey& pubkey)
 {
     if (nIndex == -1) {
@@ -3268,6 +3431,7 @@ bool CWallet::AbandonTransaction(const ITxDB& txdb, const uint256& hashTx)
             wtx.setAbandoned();
             wtx.MarkDirty();
             wtx.WriteToDisk(&walletdb);
+            UpdateUnspentIndex(txdb, wtx);
             NotifyTransactionChanged(this, wtx.GetHash(), CT_UPDATED);
             // Iterate over all its outputs, and mark transactions in the wallet that spend them
             // abandoned too
@@ -19,7 +19,11 @@
 #include "script.h"
 #include "ui_interface.h"
 #include "util.h"
+#include "walletblockheights.h"
 #include "walletdb.h"
+#include "walletrescan.h"
+#include "walletscriptfilter.h"
+#include "walletunspentindex.h"
 
 extern bool fWalletUnlockStakingOnly;
 extern bool fConfChange;
@@ -28,6 +32,7 @@ class CWalletTx;
 class CReserveKey;
 class COutput;
 class CCoinControl;
+class CoinSelectionIndex;
 
 std::pair<long, long> ImportBackupWallet(const std::string& Src, std::string& PassPhrase,
                                          bool importReserveToAddressBook);
@@ -115,6 +120,36 @@ private:
 
     void SyncMetaData(std::pair<TxSpends::iterator, TxSpends::iterator>);
 
+    // the transactions with outputs that may be unspent, and the balances computed from them; guarded
+    // by cs_wallet, and rebuilt lazily when needed
+    mutable WalletUnspentIndex unspentIndex;
+
+    /// spentByUnconfirmed is set if some output of the wallet in the tx is spent only by unconfirmed txs
+    WalletUnspentIndex::TxState GetUnspentIndexState(const ITxDB& txdb, const CWalletTx& wtx,
+                                                     const uint256& bestBlockHash,
+                                                     bool&          spentByUnconfirmed) const;
+    WalletUnspentIndex::Balances GetUnspentIndexTxBalances(const ITxDB& txdb, const CWalletTx& wtx,
+                                                           const uint256& bestBlockHash,
+                                                           bool&          isVolatile) const;
+    void UpdateUnspentIndexTx(const ITxDB& txdb, const CWalletTx& wtx,
+                              const uint256& bestBlockHash) const;
+    void UpdateUnspentIndexTx(const ITxDB& txdb, const uint256& hash, const uint256& bestBlockHash) const;
+    bool SyncUnspentIndexTip(const ITxDB& txdb, const uint256& bestBlockHash) const;
+    /// updates the index for a transaction that was added or changed, and the ones it spends from
+    void UpdateUnspentIndex(const ITxDB& txdb, const CTransaction& tx) const;
+    const std::set<uint256>&     GetUnspentIndexTxs(const ITxDB& txdb, const uint256& bestBlockHash) const;
+    WalletUnspentIndex::Balances GetBalances(const ITxDB& txdb) const;
+
+    // the ids of the keys and scripts of the wallet, to reject outputs that aren't ours quickly in
+    // IsMine(); every key and script that's added to the key store is added to it too (thread-safe)
+    WalletScriptFilter scriptFilter;
+
+    // the number of threads that read and match blocks in ScanForWalletTransactions()
+    boost::atomic_int rescanThreads{1};
+
+    /// whether tx is in the wallet, spends outputs of wallet txs or spends what wallet txs spend
+    bool IsLinkedToWallet(const CTransaction& tx) const;
+
 public:
     /// Main wallet lock.
     /// This lock protects all the fields added by CWallet
@@ -169,6 +204,9 @@ public:
     std::map<uint256, CWalletTx> mapWallet;
     std::list<CAccountingEntry>  laccentries;
 
+    // the main chain heights of the blocks of the wallet transactions (thread-safe)
+    WalletBlockHeights blockHeights;
+
     int64_t                nOrderPosNext;
     std::map<uint256, int> mapRequestCount;
 
@@ -199,6 +237,10 @@ public:
     // Get available p2cs utxo
     bool GetAvailableP2CSCoins(const ITxDB& txdb, std::vector<COutput>& vCoins) const;
 
+    // the coins that can be selected from vCoins (without NTP1 tokens, if avoidNTP1Outputs is true)
+    static CoinSelectionIndex MakeCoinSelectionIndex(const ITxDB& txdb, std::vector<COutput> vCoins,
+                                                     unsigned int nSpendTime, bool avoidNTP1Outputs);
+
     static bool SelectCoinsMinConf(const ITxDB& txdb, CAmount nTargetValue, unsigned int nSpendTime,
                                    int nConfMine, int nConfTheirs, std::vector<COutput> vCoins,
                                    std::set<std::pair<const CWalletTx*, unsigned int>>& setCoinsRet,
@@ -212,8 +254,10 @@ public:
     CPubKey GenerateNewKey();
     // Adds a key to the store, and saves it to disk.
     bool AddKey(const CKey& key);
+    // A copy of the key ids and scripts of the wallet, without secrets
+    std::unique_ptr<KeyStoreSnapshot> GetKeyStoreSnapshot() const;
     // Adds a key to the store, without saving it to disk (used by LoadWallet)
-    bool LoadKey(const CKey& key) { return CCryptoKeyStore::AddKey(key); }
+    bool LoadKey(const CKey& key);
     // Load metadata (used by LoadWallet)
     bool LoadKeyMetadata(const CPubKey& pubkey, const CKeyMetadata& metadata);
 
@@ -261,6 +305,8 @@ public:
     bool EraseFromWallet(uint256 hash);
     //    void    WalletUpdateSpent(const CTransaction& prevout, bool fBlock = false);
     int     ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate = false);
+    void    SetRescanThreads(int threads);
+    int     GetRescanThreads() const;
     void    ReacceptWalletTransactions(const ITxDB& txdb, bool fFirstLoad = false);
     void    ResendWalletTransactions(const ITxDB& txdb, bool fForce = false);
     void    SyncTransaction(const ITxDB& txdb, const CTransaction& tx, const CBlock* pblock);
@@ -331,6 +377,8 @@ public:
                          const isminefilter& filter, const bool fUnspent) const;
     CAmount    GetChange(const ITxDB& txdb, const CTransaction& tx) const;
     void       SetBestChain(const CBlockLocator& loc);
+    void       BlockConnected(const uint256& blockHash, int height);
+    void       BlockDisconnected(const uint256& blockHash);
 
     DBErrors LoadWallet(bool& fFirstRunRet);
 
@@ -428,6 +476,23 @@ public:
     CAmount         GetStakingBalance(const ITxDB& txdb, bool fIncludeColdStaking) const;
 };
 
+/**
+ * Groups the database writes of a wallet from the calling thread in one transaction while it lives (see
+ * CDBBatch), and holds the lock of the wallet meanwhile, so that no other thread waits for the
+ * transaction while holding it. Does nothing for wallets that aren't file backed.
+ */
+class CWalletDBBatch
+{
+    CCriticalBlock            walletLock;
+    std::unique_ptr<CDBBatch> batch;
+
+public:
+    explicit CWalletDBBatch(CWallet& wallet, bool fFlushOnCommit = true);
+
+    /// commits the writes so far (see CDBBatch::Commit())
+    bool Commit();
+};
+
 /** A key allocated from the key pool. */
 class CReserveKey
 {
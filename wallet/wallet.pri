@@ -131,11 +131,22 @@ HEADERS += qt/bitcoingui.h \
     qt/json/NTP1MetadataViewer.h \
     SerializationTester.h \
     blockindexcatalog.h   \
+    checkqueue.h          \
+    txindexwritecache.h   \
+    bestchainstate.h      \
+    stakemodifiercache.h  \
+    sigcache.h            \
+    walletunspentindex.h  \
+    walletblockheights.h  \
+    coinselection.h       \
+    walletrescan.h        \
+    walletscriptfilter.h  \
     blockindex.h          \
     outpoint.h            \
     inpoint.h             \
     block.h               \
     transaction.h         \
+    trackedvector.h       \
     globals.h             \
     disktxpos.h           \
     txindex.h             \
@@ -144,6 +155,7 @@ HEADERS += qt/bitcoingui.h \
     txmempool.h           \
     merkletx.h            \
     blocklocator.h        \
+    headerssync.h         \
     udaddress.h           \
     qt/ntp1/issuenewntp1tokendialog.h \
     chainparamsbase.h          \
@@ -190,8 +202,10 @@ HEADERS +=                 \
     ntp1/ntp1txout.h       \
     ntp1/ntp1tokentxdata.h \
     ntp1/ntp1apicalls.h    \
+    ntp1/ntp1index.h       \
     ntp1/ntp1sendtokensonerecipientdata.h \
     ntp1/ntp1script.h      \
+    ntp1/ntp1scriptcache.h \
     ntp1/ntp1script_issuance.h \
     ntp1/ntp1script_transfer.h
 
@@ -305,6 +319,15 @@ SOURCES += qt/bitcoin.cpp \
     qt/ntp1/ntp1metadatapairswidget.cpp \
     SerializationTester.cpp \
     blockindexcatalog.cpp \
+    txindexwritecache.cpp \
+    bestchainstate.cpp    \
+    stakemodifiercache.cpp \
+    sigcache.cpp          \
+    walletunspentindex.cpp \
+    walletblockheights.cpp \
+    coinselection.cpp     \
+    walletrescan.cpp      \
+    walletscriptfilter.cpp \
     blockindex.cpp        \
     outpoint.cpp          \
     inpoint.cpp           \
@@ -318,6 +341,7 @@ SOURCES += qt/bitcoin.cpp \
     txmempool.cpp         \
     merkletx.cpp          \
     blocklocator.cpp      \
+    headerssync.cpp       \
     udaddress.cpp         \
     qt/ntp1/issuenewntp1tokendialog.cpp \
     chainparamsbase.cpp                 \
@@ -365,7 +389,9 @@ SOURCES +=                   \
     ntp1/ntp1txout.cpp       \
     ntp1/ntp1tokentxdata.cpp \
     ntp1/ntp1apicalls.cpp    \
+    ntp1/ntp1index.cpp       \
     ntp1/ntp1script.cpp      \
+    ntp1/ntp1scriptcache.cpp \
     ntp1/ntp1script_issuance.cpp \
     ntp1/ntp1script_transfer.cpp
 
@@ -0,0 +1,121 @@
+#include "walletblockheights.h"
+
+#include "blockindex.h"
+#include "itxdb.h"
+#include "logging/logger.h"
+
+bool WalletBlockHeights::syncTip(const ITxDB& txdb, const uint256& bestBlockHash)
+{
+    if (tipHeight >= 0 && tipHash == bestBlockHash) {
+        return true;
+    }
+
+    const boost::optional<CBlockIndex> bestBlockIndex = txdb.ReadBlockIndex(bestBlockHash);
+    if (!bestBlockIndex) {
+        NLog.write(b_sev::critical,
+                   "CRITICAL ERROR: Failed to read best block index indicated with hash: {}!",
+                   bestBlockHash.ToString());
+        return false;
+    }
+
+    if (tipHeight >= 0) {
+        // the connect/disconnect notifications come after the best block changes, so a reorg is
+        // detected here first
+        const boost::optional<uint256> mainChainHash = txdb.ReadBlockHashOfHeight(tipHeight);
+        if (!mainChainHash || *mainChainHash != tipHash) {
+            heights.clear();
+        }
+    }
+    // even without a reorg, the new blocks weren't in the main chain before
+    notInMainChain.clear();
+
+    tipHash   = bestBlockHash;
+    tipHeight = bestBlockIndex->nHeight;
+    return true;
+}
+
+boost::optional<int> WalletBlockHeights::getDepth(const ITxDB& txdb, const uint256& blockHash,
+                                                  const uint256& bestBlockHash)
+{
+    const auto depthFromHeight = [this](int height) -> boost::optional<int> {
+        if (height > tipHeight) {
+            // the given best block is older than the block
+            return boost::none;
+        }
+        return tipHeight - height + 1;
+    };
+
+    {
+        boost::shared_lock<boost::shared_mutex> lg(mtx);
+        if (tipHeight >= 0 && tipHash == bestBlockHash) {
+            const auto it = heights.find(blockHash);
+            if (it != heights.cend()) {
+                return depthFromHeight(it->second);
+            }
+            if (notInMainChain.count(blockHash)) {
+                return boost::none;
+            }
+        }
+    }
+
+    boost::unique_lock<boost::shared_mutex> lg(mtx);
+    if (!syncTip(txdb, bestBlockHash)) {
+        return boost::none;
+    }
+
+    const auto it = heights.find(blockHash);
+    if (it != heights.cend()) {
+        return depthFromHeight(it->second);
+    }
+    if (notInMainChain.count(blockHash)) {
+        return boost::none;
+    }
+
+    const boost::optional<CBlockIndex> bi = txdb.ReadBlockIndex(blockHash);
+    if (!bi) {
+        NLog.write(b_sev::critical, "CRITICAL ERROR: A WalletTx pointed to a non-existing block: {}!",
+                   blockHash.ToString());
+        return boost::none;
+    }
+    if (!bi->IsInMainChain(bestBlockHash)) {
+        notInMainChain.insert(blockHash);
+        return boost::none;
+    }
+    heights[blockHash] = bi->nHeight;
+    return depthFromHeight(bi->nHeight);
+}
+
+void WalletBlockHeights::blockConnected(const uint256& blockHash, int height)
+{
+    boost::unique_lock<boost::shared_mutex> lg(mtx);
+    // only the blocks that were looked up, which are those of wallet txs, are kept; every block of the
+    // chain is connected, and the others are read when they're looked up for the first time
+    const auto it = heights.find(blockHash);
+    if (it != heights.end()) {
+        it->second = height;
+    } else if (notInMainChain.erase(blockHash) > 0) {
+        heights[blockHash] = height;
+    }
+}
+
+void WalletBlockHeights::blockDisconnected(const uint256& blockHash)
+{
+    boost::unique_lock<boost::shared_mutex> lg(mtx);
+    heights.erase(blockHash);
+    notInMainChain.erase(blockHash);
+}
+
+void WalletBlockHeights::clear()
+{
+    boost::unique_lock<boost::shared_mutex> lg(mtx);
+    heights.clear();
+    notInMainChain.clear();
+    tipHash   = 0;
+    tipHeight = -1;
+}
+
+std::size_t WalletBlockHeights::size() const
+{
+    boost::shared_lock<boost::shared_mutex> lg(mtx);
+    return heights.size();
+}
@@ -0,0 +1,51 @@
+#ifndef WALLETBLOCKHEIGHTS_H
+#define WALLETBLOCKHEIGHTS_H
+
+#include "uint256.h"
+#include <boost/optional.hpp>
+#include <boost/thread.hpp>
+#include <unordered_map>
+#include <unordered_set>
+
+class ITxDB;
+
+/**
+ * @brief The WalletBlockHeights class keeps the main chain heights of the blocks of the wallet
+ * transactions, so that their depth (see CMerkleTx::GetDepthInMainChain()) is found without reading the
+ * block index of every transaction, every time.
+ *
+ * Only the blocks that were looked up are kept. The wallet tells it about blocks connected to and
+ * disconnected from the main chain, which update the blocks that are kept. Since that
+ * happens only after the best block changes, every change of the best block is checked too: if the
+ * last best block it saw isn't in the main chain anymore, everything is dropped; and if the chain was
+ * extended, only the blocks that were known to be out of the main chain are dropped.
+ */
+class WalletBlockHeights
+{
+    mutable boost::shared_mutex mtx;
+
+    std::unordered_map<uint256, int> heights;
+    std::unordered_set<uint256>      notInMainChain;
+
+    uint256 tipHash;
+    int     tipHeight = -1;
+
+    // returns false if the best block couldn't be read
+    bool syncTip(const ITxDB& txdb, const uint256& bestBlockHash);
+
+public:
+    /**
+     * Returns the depth of the block in the main chain of the given best block (1 for the best block
+     * itself), or none if it's not in the main chain
+     */
+    boost::optional<int> getDepth(const ITxDB& txdb, const uint256& blockHash,
+                                  const uint256& bestBlockHash);
+
+    void blockConnected(const uint256& blockHash, int height);
+    void blockDisconnected(const uint256& blockHash);
+
+    void        clear();
+    std::size_t size() const;
+};
+
+#endif // WALLETBLOCKHEIGHTS_H
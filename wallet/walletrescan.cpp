@@ -0,0 +1,179 @@
+#include "walletrescan.h"
+
+#include "logging/logger.h"
+#include "util.h"
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <system_error>
+#include <thread>
+
+KeyStoreSnapshot::KeyStoreSnapshot(std::set<CKeyID> keysIn, ScriptMap scriptsIn)
+    : keys(std::move(keysIn)), scripts(std::move(scriptsIn))
+{
+}
+
+bool KeyStoreSnapshot::AddKey(const CKey& /*key*/) { return false; }
+
+bool KeyStoreSnapshot::HaveKey(const CKeyID& address) const { return keys.count(address) > 0; }
+
+bool KeyStoreSnapshot::GetKey(const CKeyID& /*address*/, CKey& /*keyOut*/) const { return false; }
+
+void KeyStoreSnapshot::GetKeys(std::set<CKeyID>& setAddress) const { setAddress = keys; }
+
+bool KeyStoreSnapshot::AddCScript(const CScript& /*redeemScript*/) { return false; }
+
+bool KeyStoreSnapshot::HaveCScript(const CScriptID& hash) const { return scripts.count(hash) > 0; }
+
+bool KeyStoreSnapshot::GetCScript(const CScriptID& hash, CScript& redeemScriptOut) const
+{
+    const auto it = scripts.find(hash);
+    if (it == scripts.cend()) {
+        return false;
+    }
+    redeemScriptOut = it->second;
+    return true;
+}
+
+WalletRescanner::WalletRescanner(const CKeyStore& keysIn, int threads,
+                                 const WalletScriptFilter* filterIn)
+    : keys(keysIn), filter(filterIn), threadsCount(std::max(0, threads))
+{
+}
+
+std::vector<char> WalletRescanner::MatchTxOutputs(const CKeyStore& keys, const CBlock& block,
+                                                  const WalletScriptFilter* filter)
+{
+    std::vector<char> result(block.vtx.size(), false);
+    for (unsigned i = 0; i < block.vtx.size(); i++) {
+        for (const CTxOut& txout : block.vtx[i].vout) {
+            if (filter && !filter->mayBeMine(txout.scriptPubKey)) {
+                continue;
+            }
+            if (IsMine(keys, txout.scriptPubKey) != isminetype::ISMINE_NO) {
+                result[i] = true;
+                break;
+            }
+        }
+    }
+    return result;
+}
+
+std::vector<WalletRescanner::ScannedBlock>
+WalletRescanner::scanBatch(int fromHeight, int toHeight, const ReadBlockFunc& readBlock) const
+{
+    std::vector<ScannedBlock> result;
+    result.reserve(toHeight - fromHeight + 1);
+    for (int h = fromHeight; h <= toHeight; h++) {
+        result.emplace_back();
+        ScannedBlock& scanned = result.back();
+        scanned.height        = h;
+        try {
+            scanned.block = readBlock(h);
+            if (scanned.block) {
+                scanned.txsWithMyOutputs = MatchTxOutputs(keys, *scanned.block, filter);
+            }
+        } catch (const std::exception& ex) {
+            NLog.write(b_sev::err, "Wallet rescan: failed to scan the block at height {}: {}", h,
+                       ex.what());
+            scanned.block = boost::none;
+        }
+    }
+    return result;
+}
+
+int WalletRescanner::run(int startHeight, int endHeight, const ReadBlockFunc& readBlock,
+                         const CommitBlockFunc& commitBlock) const
+{
+    if (endHeight < startHeight) {
+        return 0;
+    }
+
+    const int batchesCount    = (endHeight - startHeight) / BATCH_SIZE + 1;
+    const int maxBatchesAhead = std::max(1, threadsCount) * BATCHES_AHEAD_PER_THREAD;
+
+    const auto batchFrom = [&](int batch) { return startHeight + batch * BATCH_SIZE; };
+    const auto batchTo   = [&](int batch) {
+        return std::min(endHeight, batchFrom(batch) + BATCH_SIZE - 1);
+    };
+
+    std::mutex                                mtx;
+    std::condition_variable                   cv;
+    std::map<int, std::vector<ScannedBlock>> scannedBatches;
+    int                                       nextBatch        = 0;
+    int                                       committedBatches = 0;
+    bool                                      stop             = false;
+
+    const auto worker = [&]() {
+        while (true) {
+            int batch = 0;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                cv.wait(lock, [&]() {
+                    return stop || nextBatch >= batchesCount ||
+                           nextBatch < committedBatches + maxBatchesAhead;
+                });
+                if (stop || nextBatch >= batchesCount) {
+                    return;
+                }
+                batch = nextBatch++;
+            }
+            std::vector<ScannedBlock> scanned = scanBatch(batchFrom(batch), batchTo(batch), readBlock);
+            {
+                std::lock_guard<std::mutex> lg(mtx);
+                scannedBatches[batch] = std::move(scanned);
+            }
+            cv.notify_all();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(std::min(threadsCount, batchesCount));
+    for (int i = 0; i < std::min(threadsCount, batchesCount); i++) {
+        try {
+            workers.emplace_back(worker);
+        } catch (const std::system_error& ex) {
+            NLog.write(b_sev::warn, "Wallet rescan: failed to start a worker thread: {}", ex.what());
+            break;
+        }
+    }
+
+    const auto stopWorkers = [&]() {
+        {
+            std::lock_guard<std::mutex> lg(mtx);
+            stop = true;
+        }
+        cv.notify_all();
+        for (std::thread& t : workers) {
+            t.join();
+        }
+    };
+
+    try {
+        for (int batch = 0; batch < batchesCount; batch++) {
+            std::vector<ScannedBlock> scanned;
+            if (workers.empty()) {
+                scanned = scanBatch(batchFrom(batch), batchTo(batch), readBlock);
+            } else {
+                std::unique_lock<std::mutex> lock(mtx);
+                cv.wait(lock, [&]() { return scannedBatches.count(batch) > 0; });
+                scanned = std::move(scannedBatches[batch]);
+                scannedBatches.erase(batch);
+                // the workers can go on with the next batches while this one is committed
+                committedBatches = batch + 1;
+            }
+            cv.notify_all();
+
+            for (const ScannedBlock& s : scanned) {
+                commitBlock(s);
+            }
+        }
+    } catch (...) {
+        stopWorkers();
+        throw;
+    }
+    stopWorkers();
+
+    return static_cast<int>(workers.size());
+}
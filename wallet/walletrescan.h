@@ -0,0 +1,86 @@
+#ifndef WALLETRESCAN_H
+#define WALLETRESCAN_H
+
+#include "block.h"
+#include "keystore.h"
+#include "script.h"
+#include "walletscriptfilter.h"
+#include <boost/optional.hpp>
+#include <functional>
+#include <set>
+#include <vector>
+
+/**
+ * @brief The KeyStoreSnapshot class is a read-only copy of the key ids and the scripts of a key store,
+ * without any secrets. It doesn't change, so IsMine() can use it from many threads without locking.
+ */
+class KeyStoreSnapshot : public CKeyStore
+{
+    std::set<CKeyID> keys;
+    ScriptMap        scripts;
+
+public:
+    KeyStoreSnapshot(std::set<CKeyID> keysIn, ScriptMap scriptsIn);
+
+    bool AddKey(const CKey& key) override;
+    bool HaveKey(const CKeyID& address) const override;
+    bool GetKey(const CKeyID& address, CKey& keyOut) const override;
+    void GetKeys(std::set<CKeyID>& setAddress) const override;
+
+    bool AddCScript(const CScript& redeemScript) override;
+    bool HaveCScript(const CScriptID& hash) const override;
+    bool GetCScript(const CScriptID& hash, CScript& redeemScriptOut) const override;
+};
+
+/**
+ * @brief The WalletRescanner class scans a range of heights of the main chain for the transactions of a
+ * wallet, on many threads.
+ *
+ * Worker threads take ranges of heights, read their blocks and mark the transactions with outputs
+ * that belong to the keys of the wallet. The thread that runs the scan commits the blocks in order of
+ * height, because whether a transaction spends coins of the wallet depends on the transactions found
+ * before it. The workers stay a limited number of ranges ahead of the commits, to bound the memory
+ * used by blocks that are waiting.
+ */
+class WalletRescanner
+{
+public:
+    struct ScannedBlock
+    {
+        int height = 0;
+        // none if the block was skipped or couldn't be read
+        boost::optional<CBlock> block;
+        // for every tx of the block, whether it has an output that belongs to the keys
+        std::vector<char> txsWithMyOutputs;
+    };
+
+    // called from the worker threads; returns none for blocks that don't have to be scanned
+    using ReadBlockFunc = std::function<boost::optional<CBlock>(int height)>;
+    // called from the thread that runs the scan, for every height in order
+    using CommitBlockFunc = std::function<void(const ScannedBlock& scanned)>;
+
+    static constexpr int BATCH_SIZE               = 100;
+    static constexpr int BATCHES_AHEAD_PER_THREAD = 4;
+
+private:
+    const CKeyStore&          keys;
+    const WalletScriptFilter* filter;
+    const int                 threadsCount;
+
+    std::vector<ScannedBlock> scanBatch(int fromHeight, int toHeight,
+                                        const ReadBlockFunc& readBlock) const;
+
+public:
+    /// keys must not change while the scan runs (see KeyStoreSnapshot); the filter is optional
+    WalletRescanner(const CKeyStore& keysIn, int threads,
+                    const WalletScriptFilter* filterIn = nullptr);
+
+    /// returns the number of worker threads that were used; zero if the scan ran on the calling thread
+    int run(int startHeight, int endHeight, const ReadBlockFunc& readBlock,
+            const CommitBlockFunc& commitBlock) const;
+
+    static std::vector<char> MatchTxOutputs(const CKeyStore& keys, const CBlock& block,
+                                            const WalletScriptFilter* filter = nullptr);
+};
+
+#endif // WALLETRESCAN_H
@@ -0,0 +1,117 @@
+#include "walletscriptfilter.h"
+
+#include "hash.h"
+#include <cstring>
+
+namespace {
+uint160 IdAt(const CScript& script, std::size_t pos)
+{
+    uint160 result;
+    std::memcpy(result.begin(), &script[pos], sizeof(result));
+    return result;
+}
+} // namespace
+
+// clang-format off
+WalletScriptFilter::ScriptType WalletScriptFilter::MatchTemplate(const CScript&        script,
+                                                                 std::vector<uint160>& idsOut)
+{
+    idsOut.clear();
+
+    if (script.empty()) {
+        return ScriptType::Unknown;
+    }
+
+    // no output template starts with OP_RETURN, so that's either null data or a nonstandard script
+    if (script[0] == OP_RETURN) {
+        return ScriptType::NullData;
+    }
+
+    // OP_DUP OP_HASH160 20 [20 byte key id] OP_EQUALVERIFY OP_CHECKSIG
+    if (script.size() == 25 &&
+        script[0] == OP_DUP &&
+        script[1] == OP_HASH160 &&
+        script[2] == 0x14 &&
+        script[23] == OP_EQUALVERIFY &&
+        script[24] == OP_CHECKSIG) {
+        idsOut.push_back(IdAt(script, 3));
+        return ScriptType::PubKeyHash;
+    }
+
+    // OP_HASH160 20 [20 byte script id] OP_EQUAL
+    if (script.IsPayToScriptHash()) {
+        idsOut.push_back(IdAt(script, 2));
+        return ScriptType::ScriptHash;
+    }
+
+    // 33 [compressed key] OP_CHECKSIG or 65 [uncompressed key] OP_CHECKSIG
+    if ((script.size() == 35 && script[0] == 33 && script[34] == OP_CHECKSIG) ||
+        (script.size() == 67 && script[0] == 65 && script[66] == OP_CHECKSIG)) {
+        idsOut.push_back(Hash160(std::vector<unsigned char>(script.begin() + 1, script.end() - 1)));
+        return ScriptType::PubKey;
+    }
+
+    // OP_DUP OP_HASH160 OP_ROT OP_IF OP_CHECKCOLDSTAKEVERIFY 20 [staker id] OP_ELSE 20 [owner id]
+    // OP_ENDIF OP_EQUALVERIFY OP_CHECKSIG
+    if (script.size() == 51 &&
+        script[0] == OP_DUP &&
+        script[1] == OP_HASH160 &&
+        script[2] == OP_ROT &&
+        script[3] == OP_IF &&
+        script[4] == OP_CHECKCOLDSTAKEVERIFY &&
+        script[5] == 0x14 &&
+        script[26] == OP_ELSE &&
+        script[27] == 0x14 &&
+        script[48] == OP_ENDIF &&
+        script[49] == OP_EQUALVERIFY &&
+        script[50] == OP_CHECKSIG) {
+        idsOut.push_back(IdAt(script, 6));
+        idsOut.push_back(IdAt(script, 28));
+        return ScriptType::ColdStake;
+    }
+
+    return ScriptType::Unknown;
+}
+// clang-format on
+
+void WalletScriptFilter::addKey(const CKeyID& keyId)
+{
+    boost::unique_lock<boost::shared_mutex> lock(mtx);
+    ids.insert(keyId);
+}
+
+void WalletScriptFilter::addScript(const CScriptID& scriptId)
+{
+    boost::unique_lock<boost::shared_mutex> lock(mtx);
+    ids.insert(scriptId);
+}
+
+bool WalletScriptFilter::mayBeMine(const CScript& script) const
+{
+    std::vector<uint160> scriptIds;
+    scriptIds.reserve(2);
+    const ScriptType type = MatchTemplate(script, scriptIds);
+    if (type == ScriptType::Unknown) {
+        return true;
+    }
+
+    boost::shared_lock<boost::shared_mutex> lock(mtx);
+    for (const uint160& id : scriptIds) {
+        if (ids.count(id) > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void WalletScriptFilter::clear()
+{
+    boost::unique_lock<boost::shared_mutex> lock(mtx);
+    ids.clear();
+}
+
+std::size_t WalletScriptFilter::size() const
+{
+    boost::shared_lock<boost::shared_mutex> lock(mtx);
+    return ids.size();
+}
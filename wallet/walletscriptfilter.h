@@ -0,0 +1,58 @@
+#ifndef WALLETSCRIPTFILTER_H
+#define WALLETSCRIPTFILTER_H
+
+#include "script.h"
+#include "uint256.h"
+#include <boost/thread.hpp>
+#include <unordered_set>
+
+/**
+ * @brief The WalletScriptFilter class keeps the ids (hash160) of the keys and the redeem scripts of a
+ * wallet in a hash set, to reject the outputs that don't belong to the wallet before ::IsMine() runs
+ * the solver on them (which also creates a database object for every output).
+ *
+ * The standard output scripts (pay to public key, to public key hash, to script hash, cold staking and
+ * null data) are recognized by their bytes, and are rejected if none of their ids are in the set. The
+ * other scripts (like multisig) always go to ::IsMine(). A script that passes the filter isn't
+ * necessarily of the wallet, so the result of ::IsMine() is what counts then.
+ */
+class WalletScriptFilter
+{
+    struct IdHasher
+    {
+        // the ids are hashes already
+        std::size_t operator()(const uint160& id) const { return id.Get64(0); }
+    };
+
+    mutable boost::shared_mutex             mtx;
+    std::unordered_set<uint160, IdHasher> ids;
+
+public:
+    enum class ScriptType
+    {
+        Unknown,
+        NullData,
+        PubKey,
+        PubKeyHash,
+        ScriptHash,
+        ColdStake,
+    };
+
+    /**
+     * Finds the type of the script by its bytes and returns the ids that the script pays to: one for
+     * pay to public key (the hash of the key), public key hash or script hash, two for cold staking
+     * (the staker and the owner), and none for the other types
+     */
+    static ScriptType MatchTemplate(const CScript& script, std::vector<uint160>& idsOut);
+
+    void addKey(const CKeyID& keyId);
+    void addScript(const CScriptID& scriptId);
+
+    /// false only if the script certainly doesn't belong to the keys and scripts that were added
+    bool mayBeMine(const CScript& script) const;
+
+    void        clear();
+    std::size_t size() const;
+};
+
+#endif // WALLETSCRIPTFILTER_H
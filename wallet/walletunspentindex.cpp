@@ -0,0 +1,119 @@
+#include "walletunspentindex.h"
+
+#include "itxdb.h"
+
+WalletUnspentIndex::Balances& WalletUnspentIndex::Balances::operator+=(const Balances& other)
+{
+    balance += other.balance;
+    unconfirmed += other.unconfirmed;
+    coldStaking += other.coldStaking;
+    delegated += other.delegated;
+    return *this;
+}
+
+WalletUnspentIndex::Balances& WalletUnspentIndex::Balances::operator-=(const Balances& other)
+{
+    balance -= other.balance;
+    unconfirmed -= other.unconfirmed;
+    coldStaking -= other.coldStaking;
+    delegated -= other.delegated;
+    return *this;
+}
+
+bool WalletUnspentIndex::isValid() const { return valid; }
+
+void WalletUnspentIndex::invalidate()
+{
+    txs.clear();
+    pendingTxs.clear();
+    valid = false;
+    txBalances.clear();
+    totals = Balances();
+    volatileTxs.clear();
+    volatileTipHash.SetNull();
+}
+
+void WalletUnspentIndex::setValid() { valid = true; }
+
+void WalletUnspentIndex::update(const uint256& txHash, TxState state)
+{
+    switch (state) {
+    case TxState::Unspent:
+        txs.insert(txHash);
+        pendingTxs.erase(txHash);
+        break;
+    case TxState::PendingSpent:
+        txs.insert(txHash);
+        pendingTxs.insert(txHash);
+        break;
+    case TxState::Spent:
+        txs.erase(txHash);
+        pendingTxs.erase(txHash);
+        eraseTxBalances(txHash);
+        break;
+    }
+}
+
+void WalletUnspentIndex::eraseTxBalances(const uint256& txHash)
+{
+    const auto it = txBalances.find(txHash);
+    if (it != txBalances.end()) {
+        totals -= it->second;
+        txBalances.erase(it);
+    }
+    volatileTxs.erase(txHash);
+}
+
+void WalletUnspentIndex::setTxBalances(const uint256& txHash, const Balances& balances, bool isVolatile)
+{
+    eraseTxBalances(txHash);
+    txBalances[txHash] = balances;
+    totals += balances;
+    if (isVolatile) {
+        volatileTxs.insert(txHash);
+    }
+}
+
+WalletUnspentIndex::TipChange WalletUnspentIndex::setTip(const ITxDB& txdb, const uint256& bestBlockHash,
+                                                         int bestHeight)
+{
+    if (tipHeight < 0 || tipHash == bestBlockHash) {
+        tipHash   = bestBlockHash;
+        tipHeight = bestHeight;
+        return TipChange::None;
+    }
+
+    const boost::optional<uint256> mainChainHash = txdb.ReadBlockHashOfHeight(tipHeight);
+    const bool stillInMainChain = mainChainHash && *mainChainHash == tipHash;
+
+    tipHash   = bestBlockHash;
+    tipHeight = bestHeight;
+
+    if (!stillInMainChain) {
+        // what was spent in the disconnected blocks may be unspent now
+        invalidate();
+        return TipChange::Reorganized;
+    }
+    return TipChange::Extended;
+}
+
+const std::set<uint256>& WalletUnspentIndex::getTxs() const { return txs; }
+
+const std::set<uint256>& WalletUnspentIndex::getPendingTxs() const { return pendingTxs; }
+
+const WalletUnspentIndex::Balances& WalletUnspentIndex::getTotals() const { return totals; }
+
+boost::optional<std::set<uint256>>
+WalletUnspentIndex::getStaleVolatileTxs(const uint256& bestBlockHash, uint32_t mempoolVersion) const
+{
+    if (volatileTipHash == bestBlockHash && volatileMempoolVersion == mempoolVersion) {
+        return boost::none;
+    }
+    return volatileTxs;
+}
+
+void WalletUnspentIndex::setVolatileTxsUpdated(const uint256& bestBlockHash, uint32_t mempoolVersion)
+{
+    volatileTipHash        = bestBlockHash;
+    volatileMempoolVersion = mempoolVersion;
+}
@@ -0,0 +1,113 @@
+#ifndef WALLETUNSPENTINDEX_H
+#define WALLETUNSPENTINDEX_H
+
+#include "amount.h"
+#include "uint256.h"
+#include <boost/optional.hpp>
+#include <cstdint>
+#include <map>
+#include <set>
+
+class ITxDB;
+
+/**
+ * @brief The WalletUnspentIndex class keeps the transactions of a wallet that may have unspent outputs
+ * of the wallet, so that balances and available coins don't have to go over all the transactions of
+ * the wallet.
+ *
+ * A transaction is left out only when every output of the wallet in it is spent by a confirmed
+ * transaction of the wallet. Only a reorg can undo that, so the whole index is dropped (and rebuilt
+ * by the wallet) when the best block it was last used with is disconnected. Transactions whose
+ * outputs are spent by unconfirmed transactions are kept as pending, and the wallet looks at them
+ * again when new blocks are connected.
+ *
+ * The index keeps what every transaction in it adds to the balances, and their totals, which the wallet
+ * updates with the transactions it updates in the index. The balances of some transactions can change
+ * without a change of theirs in the wallet (unconfirmed and immature ones, and ones spent by
+ * unconfirmed transactions); they are kept as volatile, and the wallet computes them again when the
+ * best block or the mempool changed.
+ *
+ * This class isn't thread-safe; the wallet uses it under cs_wallet.
+ */
+class WalletUnspentIndex
+{
+public:
+    enum class TxState
+    {
+        Unspent,
+        PendingSpent, // all the outputs of the wallet are spent, some of them by unconfirmed txs
+        Spent,
+    };
+
+    enum class TipChange
+    {
+        None,
+        Extended,
+        Reorganized,
+    };
+
+    struct Balances
+    {
+        CAmount balance     = 0;
+        CAmount unconfirmed = 0;
+        CAmount coldStaking = 0;
+        CAmount delegated   = 0;
+
+        Balances& operator+=(const Balances& other);
+        Balances& operator-=(const Balances& other);
+    };
+
+private:
+    std::set<uint256> txs;
+    std::set<uint256> pendingTxs;
+    bool              valid = false;
+
+    // the best block the index was last used with
+    uint256 tipHash;
+    int     tipHeight = -1;
+
+    // what every transaction in the index adds to the balances, and the sum of that
+    std::map<uint256, Balances> txBalances;
+    Balances                    totals;
+
+    std::set<uint256> volatileTxs;
+    // the best block and the mempool version the volatile transactions were last computed with
+    uint256  volatileTipHash;
+    uint32_t volatileMempoolVersion = 0;
+
+    void eraseTxBalances(const uint256& txHash);
+
+public:
+    bool isValid() const;
+
+    /// drops all the transactions; the index has to be rebuilt before it's used again
+    void invalidate();
+
+    /// to be called once all the transactions of the wallet were added to an invalidated index
+    void setValid();
+
+    /// a spent transaction is dropped with its balances
+    void update(const uint256& txHash, TxState state);
+
+    /// sets what a transaction in the index adds to the balances
+    void setTxBalances(const uint256& txHash, const Balances& balances, bool isVolatile);
+
+    /**
+     * Moves the index to the given best block. If the best block the index was last used with isn't
+     * in the main chain anymore, the index is invalidated.
+     */
+    TipChange setTip(const ITxDB& txdb, const uint256& bestBlockHash, int bestHeight);
+
+    const std::set<uint256>& getTxs() const;
+    const std::set<uint256>& getPendingTxs() const;
+
+    const Balances& getTotals() const;
+
+    /// the volatile transactions, if they weren't computed with the given best block and mempool yet
+    boost::optional<std::set<uint256>> getStaleVolatileTxs(const uint256& bestBlockHash,
+                                                            uint32_t       mempoolVersion) const;
+    /// to be called once the volatile transactions were computed with the given best block and mempool
+    void setVolatileTxsUpdated(const uint256& bestBlockHash, uint32_t mempoolVersion);
+};
+
+#endif // WALLETUNSPENTINDEX_H